@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "json_reader.h"
+#include "render/renderer.h"
+#include "bench_util.h"
+
+// Measures soft-shadow noise against the number of shadow rays per area light
+// The scene is rendered with one sample per pixel, so the pixel positions are the same in every
+// render and only the light samples change. Each shadow-ray count is compared with a reference
+// rendered with --reference-samples rays per light; noise is the RMSE of the linear colors clamped
+// to [0, 1].
+
+// Sets the shadow-ray count of every area light, renders and returns the time taken in milliseconds
+static double renderWithLightSamples(const SceneData &sceneData, int lightSamples, std::vector<float> &hdr)
+{
+    SceneData data = sceneData;
+    for (Light &light : data.lights)
+    {
+        light.samples = lightSamples;
+    }
+    Renderer renderer(std::make_shared<const Scene>(data, true));
+
+    hdr.assign(static_cast<size_t>(data.camera.imageWidth()) * data.camera.imageHeight() * 3, 0.0f);
+    FrameRequest request(data.camera);
+    request.seed = 1234;
+    request.samplesPerPixel = 1;
+    request.hdrOutput = hdr.data();
+    auto start = Clock::now();
+    renderer.render(request);
+    return millisecondsSince(start);
+}
+
+int main(int argc, char *argv[])
+{
+    std::string scenePath = std::string(RAYTRACER_SCENE_DIR) + "/scene_area_lights.json";
+    int width = 300, height = 200;
+    int referenceSamples = MAX_LIGHT_SAMPLES;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--resolution" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            size_t separator = value.find('x');
+            width = std::stoi(value.substr(0, separator));
+            height = std::stoi(value.substr(separator + 1));
+        }
+        else if (arg == "--reference-samples" && i + 1 < argc)
+        {
+            referenceSamples = std::min(std::stoi(argv[++i]), MAX_LIGHT_SAMPLES);
+        }
+        else if (arg.rfind("--", 0) != 0)
+        {
+            scenePath = arg;
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--resolution <width>x<height>] [--reference-samples <n>] [scene.json]" << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    SceneData sceneData = readSceneFromJson(scenePath);
+    sceneData.camera = sceneData.camera.withResolution(width, height);
+    int areaLights = static_cast<int>(std::count_if(sceneData.lights.begin(), sceneData.lights.end(),
+                                                    [](const Light &light) { return light.isArea(); }));
+    if (areaLights == 0)
+    {
+        std::cerr << "The scene has no area lights: " << scenePath << std::endl;
+        return 1;
+    }
+
+    std::vector<float> reference, image;
+    double referenceMs = renderWithLightSamples(sceneData, referenceSamples, reference);
+    std::cout << scenePath << " at " << width << "x" << height << ", " << areaLights << " area lights, reference "
+              << referenceSamples << " rays per light in " << std::fixed << std::setprecision(0) << referenceMs << " ms" << std::endl;
+    std::cout << std::setw(16) << "rays per light" << std::setw(12) << "ms" << std::setw(12) << "ms/ray"
+              << std::setw(10) << "RMSE" << std::endl;
+
+    double previousError = 0.0;
+    for (int samples = 1; samples < referenceSamples; samples *= 4)
+    {
+        double ms = renderWithLightSamples(sceneData, samples, image);
+        double error = rmse(image, reference);
+        std::cout << std::setw(16) << samples << std::setprecision(1) << std::setw(12) << ms << std::setprecision(2)
+                  << std::setw(12) << ms / samples << std::setprecision(4) << std::setw(10) << error;
+        if (previousError > 0.0)
+        {
+            // Independent samples would halve the error for each 4x more rays
+            std::cout << "  (x" << std::setprecision(2) << previousError / error << " less noise)";
+        }
+        std::cout << std::endl;
+        previousError = error;
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "camera/camera_rays.h"
+#include "render/render.h"
+
+// Compares generating camera rays one call at a time with Camera::generateRay against generating them a
+// tile at a time with CameraRayGenerator, for a pinhole camera, a camera with a shutter interval and a
+// camera with an aperture. Each pixel's generator is seeded as the renderer seeds it. Rows report the
+// rays generated per second (the best of --repeat runs) and the largest difference between the two sets
+// of rays, which is 0 when the tile generator reproduces generateRay exactly.
+
+using Clock = std::chrono::high_resolution_clock;
+
+int main(int argc, char *argv[])
+{
+    int width = 1200, height = 800;
+    int samples = 16;
+    int tileWidth = 32;
+    int repeat = 3;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--resolution" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            size_t separator = value.find('x');
+            width = std::max(1, std::stoi(value.substr(0, separator)));
+            height = separator == std::string::npos ? width : std::max(1, std::stoi(value.substr(separator + 1)));
+        }
+        else if (arg == "--spp" && i + 1 < argc)
+        {
+            samples = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--tile" && i + 1 < argc)
+        {
+            tileWidth = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--repeat" && i + 1 < argc)
+        {
+            repeat = std::max(1, std::stoi(argv[++i]));
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--resolution <width>x<height>] [--spp <n>] [--tile <pixels>] [--repeat <n>]" << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    const unsigned int seed = 1234;
+    std::vector<std::pair<float, float>> points = samples > 1 ? plot_evenly_distributed_points(samples, -1.0f, 1.0f, seed)
+                                                              : std::vector<std::pair<float, float>>{{0.0f, 0.0f}};
+    samples = static_cast<int>(points.size());
+    const Camera pinhole(Vector3(0.0f, 1.0f, -4.0f), Vector3(0.0f, 0.5f, 0.0f), Vector3(0.0f, 1.0f, 0.0f), 45.0f, width, height, 0.1f);
+    const Camera lens(Vector3(0.0f, 1.0f, -4.0f), Vector3(0.0f, 0.5f, 0.0f), Vector3(0.0f, 1.0f, 0.0f), 45.0f, width, height, 0.1f, 0.2f, 4.0f);
+    struct Case
+    {
+        std::string name;
+        Camera camera;
+    };
+    const std::vector<Case> cases = {{"pinhole", pinhole}, {"shutter", pinhole.withShutter(0.0f, 1.0f)}, {"aperture", lens}};
+
+    const double rayCount = static_cast<double>(width) * height * samples;
+    std::cout << width << "x" << height << ", " << samples << " samples per pixel, tiles of " << tileWidth << " pixels" << std::endl;
+    std::cout << std::left << std::setw(10) << "camera" << std::right << std::setw(16) << "generateRay" << std::setw(16) << "tiles"
+              << std::setw(10) << "speedup" << std::setw(14) << "difference" << std::endl;
+    for (const Case &test : cases)
+    {
+        const Camera &camera = test.camera;
+        const CameraRayGenerator generator(camera, points);
+        std::vector<std::minstd_rand> rngs(tileWidth);
+        CameraRayBlock block;
+        double sink = 0.0; // Keeps the rays from being optimised away
+
+        double single = 0.0, tiled = 0.0;
+        for (int run = 0; run < repeat; ++run)
+        {
+            auto start = Clock::now();
+            for (int y = 0; y < height; ++y)
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    std::minstd_rand rng(pixelSeed(seed, x, y));
+                    for (const auto &point : points)
+                    {
+                        sink += camera.generateRay(x + point.first, y + point.second, rng).direction.x;
+                    }
+                }
+            }
+            double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+            single = run == 0 ? elapsed : std::min(single, elapsed);
+
+            start = Clock::now();
+            for (int y = 0; y < height; ++y)
+            {
+                for (int x = 0; x < width; x += tileWidth)
+                {
+                    int columns = std::min(tileWidth, width - x);
+                    for (int column = 0; column < columns; ++column)
+                    {
+                        rngs[column].seed(pixelSeed(seed, x + column, y));
+                    }
+                    generator.generate(x, y, columns, 1, rngs.data(), block);
+                    sink += block.directionX[0];
+                }
+            }
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+            tiled = run == 0 ? elapsed : std::min(tiled, elapsed);
+        }
+
+        // Untimed comparison of every ray
+        float difference = 0.0f;
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; x += tileWidth)
+            {
+                int columns = std::min(tileWidth, width - x);
+                for (int column = 0; column < columns; ++column)
+                {
+                    rngs[column].seed(pixelSeed(seed, x + column, y));
+                }
+                generator.generate(x, y, columns, 1, rngs.data(), block);
+                for (int column = 0; column < columns; ++column)
+                {
+                    std::minstd_rand rng(pixelSeed(seed, x + column, y));
+                    for (int sample = 0; sample < samples; ++sample)
+                    {
+                        Ray expected = camera.generateRay(x + column + points[sample].first, y + points[sample].second, rng);
+                        Ray ray = block.ray(block.index(column, 0, sample));
+                        difference = std::max({difference, (ray.origin - expected.origin).length(),
+                                               (ray.direction - expected.direction).length(), std::fabs(ray.time - expected.time)});
+                    }
+                }
+            }
+        }
+
+        std::cout << std::left << std::setw(10) << test.name << std::right << std::fixed << std::setprecision(1) << std::setw(10)
+                  << rayCount / (single * 1e6) << " Mr/s" << std::setw(10) << rayCount / (tiled * 1e6) << " Mr/s" << std::setprecision(2)
+                  << std::setw(9) << single / tiled << "x" << std::scientific << std::setprecision(1) << std::setw(14) << difference
+                  << std::defaultfloat << (sink == 0.125 ? " " : "") << std::endl;
+    }
+    return 0;
+}
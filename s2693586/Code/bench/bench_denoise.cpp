@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "json_reader.h"
+#include "render/denoise.h"
+#include "render/renderer.h"
+#include "bench_util.h"
+
+// Compares low sample counts plus the denoiser with higher sample counts
+// For each scene a reference is rendered at --reference-spp samples per pixel; 4 spp (raw and
+// denoised), 16 spp and 64 spp renders are then compared against it. Errors are measured on the
+// linear colors clamped to [0, 1].
+
+int main(int argc, char *argv[])
+{
+    int width = 150, height = 100;
+    int referenceSamples = 512;
+    std::vector<std::string> scenes;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--resolution" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            size_t separator = value.find('x');
+            width = std::stoi(value.substr(0, separator));
+            height = std::stoi(value.substr(separator + 1));
+        }
+        else if (arg == "--reference-spp" && i + 1 < argc)
+        {
+            referenceSamples = std::stoi(argv[++i]);
+        }
+        else if (arg.rfind("--", 0) != 0)
+        {
+            scenes.push_back(arg);
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--resolution <width>x<height>] [--reference-spp <n>] [scene.json ...]" << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    if (scenes.empty())
+    {
+        // Path tracing noise, depth of field and antialiased edges
+        for (const char *name : {"scene_pathtrace.json", "scene_aperture.json", "scene_phong.json"})
+        {
+            scenes.push_back(std::string(RAYTRACER_SCENE_DIR) + "/" + name);
+        }
+    }
+
+    const size_t pixelCount = static_cast<size_t>(width) * height;
+    for (const auto &scenePath : scenes)
+    {
+        SceneData sceneData = readSceneFromJson(scenePath);
+        sceneData.camera = sceneData.camera.withResolution(width, height);
+        Renderer renderer(std::make_shared<const Scene>(sceneData, true));
+
+        std::vector<float> reference(pixelCount * 3), image(pixelCount * 3);
+        std::vector<float> albedo(pixelCount * 3), normal(pixelCount * 3), depth(pixelCount), variance(pixelCount);
+        std::vector<uint32_t> materialId(pixelCount);
+
+        FrameRequest request(sceneData.camera);
+        request.seed = 99;
+        request.samplesPerPixel = referenceSamples;
+        request.hdrOutput = reference.data();
+        renderer.render(request);
+
+        std::cout << std::filesystem::path(scenePath).filename().string() << " at " << width << "x" << height
+                  << ", reference " << referenceSamples << " spp" << std::endl;
+        std::cout << std::left << std::setw(18) << "samples" << std::right << std::setw(12) << "render ms"
+                  << std::setw(12) << "denoise ms" << std::setw(12) << "total ms" << std::setw(10) << "RMSE"
+                  << std::setw(10) << "PSNR" << std::endl;
+        auto row = [&](const std::string &name, double renderMs, double denoiseMs)
+        {
+            double error = rmse(image, reference);
+            std::cout << std::left << std::setw(18) << name << std::right << std::fixed << std::setprecision(1)
+                      << std::setw(12) << renderMs << std::setw(12) << denoiseMs << std::setw(12) << renderMs + denoiseMs
+                      << std::setprecision(4) << std::setw(10) << error << std::setprecision(1) << std::setw(10)
+                      << 20.0 * std::log10(1.0 / std::max(error, 1e-6)) << std::endl;
+        };
+
+        request.seed = 1234;
+        request.hdrOutput = image.data();
+        for (int samples : {4, 16, 64})
+        {
+            request.samplesPerPixel = samples;
+            auto start = Clock::now();
+            renderer.render(request);
+            row(std::to_string(samples) + " spp", millisecondsSince(start), 0.0);
+
+            if (samples == 4)
+            {
+                // Render with the auxiliary buffers, then time the denoiser on its own
+                FrameRequest aovRequest = request;
+                aovRequest.albedoOutput = albedo.data();
+                aovRequest.normalOutput = normal.data();
+                aovRequest.depthOutput = depth.data();
+                aovRequest.materialIdOutput = materialId.data();
+                aovRequest.varianceOutput = variance.data();
+                start = Clock::now();
+                renderer.render(aovRequest);
+                double renderMs = millisecondsSince(start);
+                start = Clock::now();
+                denoiseImage(image.data(), variance.data(), albedo.data(), normal.data(), depth.data(), materialId.data(), width, height);
+                row("4 spp + denoise", renderMs, millisecondsSince(start));
+            }
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "json_reader.h"
+#include "render/distributed.h"
+#include "render/renderer.h"
+#include "bench_util.h"
+
+// Measures how distributed rendering scales with the number of local worker processes
+// The frame is rendered in this process first as the reference, then by 1, 2, 4, ... workers
+// started from this executable. Each worker count renders the frame twice and the second render
+// is timed, so scene loading in the workers is not counted. Efficiency is the speedup over one
+// worker divided by the number of workers. Finally one worker is killed in the middle of a frame
+// to check that its tiles are reassigned and the image still matches the reference.
+
+// Largest absolute difference between two HDR images
+static float maxDifference(const std::vector<float> &a, const std::vector<float> &b)
+{
+    float result = 0.0f;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        result = std::max(result, std::fabs(a[i] - b[i]));
+    }
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    int width = 300, height = 200;
+    int tileSize = 32;
+    std::vector<int> workerCounts;
+    std::string workerAddress;
+    std::string scenePath = std::string(RAYTRACER_SCENE_DIR) + "/scene_phong.json";
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--resolution" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            size_t separator = value.find('x');
+            width = std::stoi(value.substr(0, separator));
+            height = std::stoi(value.substr(separator + 1));
+        }
+        else if (arg == "--workers" && i + 1 < argc)
+        {
+            std::stringstream list(argv[++i]);
+            for (std::string count; std::getline(list, count, ',');)
+            {
+                workerCounts.push_back(std::stoi(count));
+            }
+        }
+        else if (arg == "--tile-size" && i + 1 < argc)
+        {
+            tileSize = std::stoi(argv[++i]);
+        }
+        else if (arg == "--worker" && i + 1 < argc)
+        {
+            workerAddress = argv[++i]; // Started by the benchmark itself
+        }
+        else if (arg.rfind("--", 0) != 0)
+        {
+            scenePath = arg;
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--resolution <width>x<height>] [--workers <n>,<n>,...] [--tile-size <n>] [scene.json]" << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    if (workerCounts.empty())
+    {
+        for (int count = 1; count <= static_cast<int>(std::max(4u, std::thread::hardware_concurrency())); count *= 2)
+        {
+            workerCounts.push_back(count);
+        }
+    }
+
+    SceneData sceneData = readSceneFromJson(scenePath);
+    sceneData.camera = sceneData.camera.withResolution(width, height);
+    if (!workerAddress.empty())
+    {
+        return runTileWorker(Renderer(std::make_shared<const Scene>(sceneData, true)), workerAddress);
+    }
+
+    const size_t pixelCount = static_cast<size_t>(width) * height;
+    std::vector<float> reference(pixelCount * 3), image(pixelCount * 3);
+    FrameRequest request(sceneData.camera);
+    request.antialiasing = true;
+    request.seed = 1234;
+    request.hdrOutput = reference.data();
+
+    Renderer renderer(std::make_shared<const Scene>(sceneData, true));
+    auto start = Clock::now();
+    renderer.render(request);
+    double singleProcessMs = millisecondsSince(start);
+    request.hdrOutput = image.data();
+
+    DistributedSettings settings;
+    settings.tileSize = tileSize;
+    std::vector<std::string> workerArguments = {scenePath, "--resolution", std::to_string(width) + "x" + std::to_string(height)};
+
+    std::cout << std::filesystem::path(scenePath).filename().string() << " at " << width << "x" << height << ", "
+              << tileSize << "x" << tileSize << " tiles, " << std::thread::hardware_concurrency() << " cores; in-process render "
+              << std::fixed << std::setprecision(1) << singleProcessMs << " ms" << std::endl;
+    std::cout << std::left << std::setw(10) << "workers" << std::right << std::setw(12) << "total ms" << std::setw(10)
+              << "speedup" << std::setw(12) << "efficiency" << std::setw(14) << "tiles/worker" << std::setw(12)
+              << "max diff" << std::endl;
+
+    double oneWorkerMs = 0.0;
+    for (int count : workerCounts)
+    {
+        LocalWorkerPool pool(count, "/proc/self/exe", workerArguments);
+        renderDistributed(pool.addresses(), sceneData, request, settings); // Waits for the workers to load the scene
+        DistributedStats stats = renderDistributed(pool.addresses(), sceneData, request, settings);
+        if (oneWorkerMs == 0.0)
+        {
+            oneWorkerMs = stats.totalMs * count;
+        }
+        double speedup = oneWorkerMs / stats.totalMs;
+        std::cout << std::left << std::setw(10) << count << std::right << std::setprecision(1) << std::setw(12) << stats.totalMs
+                  << std::setprecision(2) << std::setw(10) << speedup << std::setw(11) << 100.0 * speedup / count << "%"
+                  << std::setprecision(1) << std::setw(14) << static_cast<double>(stats.tiles) / count
+                  << std::setprecision(4) << std::setw(12) << maxDifference(image, reference) << std::endl;
+    }
+
+    // Kill a worker partway through a frame
+    int count = std::max(2, workerCounts.back());
+    LocalWorkerPool pool(count, "/proc/self/exe", workerArguments);
+    DistributedStats warmUp = renderDistributed(pool.addresses(), sceneData, request, settings);
+    std::fill(image.begin(), image.end(), 0.0f);
+    std::thread killer([&]
+                       {
+                           std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(warmUp.totalMs / 3.0));
+                           pool.kill(0);
+                       });
+    DistributedStats stats = renderDistributed(pool.addresses(), sceneData, request, settings);
+    killer.join();
+    std::cout << std::endl
+              << "Worker killed after a third of the frame (" << count << " workers): " << stats.reassigned << " tiles reassigned, "
+              << stats.speculative << " speculative, " << std::setprecision(1) << stats.totalMs << " ms, max diff "
+              << std::setprecision(4) << maxDifference(image, reference) << std::endl;
+    return 0;
+}
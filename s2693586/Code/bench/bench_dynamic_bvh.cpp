@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "bvh/dynamic_bvh.h"
+#include "bench_util.h"
+
+// Compares refitting a BVH after some of its objects moved with rebuilding it every frame
+// A cube of random spheres is simulated for a number of frames; a fixed fraction of the spheres
+// moves with constant velocities, so the refitted tree slowly degrades. Each frame the moved spheres
+// are committed to a DynamicBVH, and the same objects are also built from scratch. Rows report the
+// update and rebuild times, the SAH cost of the refitted tree against a fresh build, and the time to
+// trace a fixed set of random rays through each. Every frame the closest hits of those rays in the updated
+// tree are checked against the fresh build; "differences" counts the rays that hit another object (or
+// none), and should be 0.
+
+int main(int argc, char *argv[])
+{
+    size_t count = 100000;
+    double movingFraction = 0.01;
+    int frames = 60;
+    float threshold = 1.5f;
+    int rayCount = 20000;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--count" && i + 1 < argc)
+        {
+            count = std::max(1L, std::stol(argv[++i]));
+        }
+        else if (arg == "--moving" && i + 1 < argc)
+        {
+            movingFraction = std::clamp(std::stod(argv[++i]), 0.0, 1.0);
+        }
+        else if (arg == "--frames" && i + 1 < argc)
+        {
+            frames = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--threshold" && i + 1 < argc)
+        {
+            threshold = std::stof(argv[++i]);
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--count <n>] [--moving <fraction>] [--frames <n>] [--threshold <cost ratio>]" << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    // Spheres in a cube of side 100, sized to fill about 1% of it
+    const float halfSize = 50.0f;
+    const float radius = 0.3f * std::cbrt(8.0f * halfSize * halfSize * halfSize / count);
+    std::minstd_rand rng(1234);
+    std::uniform_real_distribution<float> coordinate(-halfSize, halfSize), unit(-1.0f, 1.0f);
+    Material material;
+    std::vector<Vector3> centers(count);
+    std::vector<std::shared_ptr<const Geometry>> objects(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        centers[i] = Vector3(coordinate(rng), coordinate(rng), coordinate(rng));
+        objects[i] = std::make_shared<const Sphere>(centers[i], radius, material);
+    }
+
+    // The moving spheres and their velocities (up to 1% of the cube per frame)
+    size_t movingCount = static_cast<size_t>(count * movingFraction);
+    std::vector<size_t> moving(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        moving[i] = i;
+    }
+    std::shuffle(moving.begin(), moving.end(), rng);
+    moving.resize(movingCount);
+    std::vector<Vector3> velocity(movingCount);
+    for (Vector3 &v : velocity)
+    {
+        v = Vector3(unit(rng), unit(rng), unit(rng)) * (0.01f * halfSize);
+    }
+
+    // Random rays through the cube
+    std::vector<Ray> rays;
+    for (int i = 0; i < rayCount; ++i)
+    {
+        Vector3 origin(coordinate(rng), coordinate(rng), coordinate(rng));
+        rays.emplace_back(origin, Vector3(unit(rng), unit(rng), unit(rng)).normalize());
+    }
+    auto traceMs = [&](const BVHNode &root)
+    {
+        auto start = Clock::now();
+        for (const Ray &ray : rays)
+        {
+            Intersection closest;
+            root.intersect(ray, closest);
+        }
+        return millisecondsSince(start);
+    };
+    auto differences = [&](const BVHNode &root, const BVHNode &reference)
+    {
+        size_t count = 0;
+        for (const Ray &ray : rays)
+        {
+            Intersection closest, expected;
+            root.intersect(ray, closest);
+            reference.intersect(ray, expected);
+            count += closest.hit != expected.hit || closest.object != expected.object;
+        }
+        return count;
+    };
+
+    DynamicBVH bvh(objects, threshold);
+    std::cout << count << " spheres, " << movingCount << " moving, " << frames << " frames, rebuild threshold "
+              << threshold << std::endl;
+    std::cout << std::left << std::setw(8) << "frame" << std::right << std::setw(12) << "update ms" << std::setw(12)
+              << "rebuild ms" << std::setw(10) << "refit" << std::setw(10) << "rebuilt" << std::setw(10) << "SAH"
+              << std::setw(12) << "fresh SAH" << std::setw(12) << "rays ms" << std::setw(12) << "fresh ms" << std::setw(13) << "differences" << std::endl;
+
+    double updateTotal = 0.0, rebuildTotal = 0.0;
+    size_t subtreesRebuilt = 0, fullRebuilds = 0, totalDifferences = 0;
+    for (int frame = 1; frame <= frames; ++frame)
+    {
+        for (size_t m = 0; m < movingCount; ++m)
+        {
+            size_t i = moving[m];
+            centers[i] = centers[i] + velocity[m];
+            objects[i] = std::make_shared<const Sphere>(centers[i], radius, material);
+            bvh.update(i, objects[i]);
+        }
+        BVHUpdateStats stats = bvh.commit();
+        updateTotal += stats.updateMs;
+        subtreesRebuilt += stats.rebuiltSubtrees;
+        fullRebuilds += stats.fullRebuild;
+
+        auto start = Clock::now();
+        std::unique_ptr<BVHNode> rebuilt = BVHNode::build(objects);
+        double rebuildMs = millisecondsSince(start);
+        rebuildTotal += rebuildMs;
+        size_t frameDifferences = differences(bvh.root(), *rebuilt);
+        totalDifferences += frameDifferences;
+
+        if (frame == 1 || frame % 10 == 0 || frame == frames)
+        {
+            DynamicBVH fresh(objects);
+            std::cout << std::left << std::setw(8) << frame << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(12) << stats.updateMs << std::setw(12) << rebuildMs << std::setw(10) << stats.refitNodes
+                      << std::setw(10) << stats.rebuiltObjects << std::setw(10) << stats.sahCost << std::setw(12)
+                      << fresh.sahCost() << std::setw(12) << traceMs(bvh.root()) << std::setw(12) << traceMs(fresh.root())
+                      << std::setw(13) << frameDifferences << std::endl;
+        }
+    }
+    std::cout << "Average per frame: update " << std::setprecision(2) << updateTotal / frames << " ms, rebuild "
+              << rebuildTotal / frames << " ms (" << std::setprecision(1) << rebuildTotal / updateTotal << "x); "
+              << subtreesRebuilt << " subtrees rebuilt, " << fullRebuilds << " full rebuilds, " << totalDifferences
+              << " closest hits differing from a fresh build" << std::endl;
+    return totalDifferences == 0 ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "json_reader.h"
+#include "render/renderer.h"
+#include "bench_util.h"
+
+// Compares the recursive Blinn-Phong integrator with the path tracer by time to a target noise level
+// Each integrator renders a reference at --reference-spp samples per pixel; renders at increasing
+// sample counts are then compared against their own integrator's reference. Noise is the RMSE of
+// the linear colors clamped to [0, 1]. The two integrators converge to different images (the path
+// tracer adds indirect light), so each is measured against itself.
+
+// Renders the scene into an HDR buffer and returns the time taken in milliseconds
+static double renderHdr(const Renderer &renderer, const Camera &camera, int samples, unsigned int seed, std::vector<float> &hdr)
+{
+    hdr.assign(static_cast<size_t>(camera.imageWidth()) * camera.imageHeight() * 3, 0.0f);
+    FrameRequest request(camera);
+    request.seed = seed;
+    request.samplesPerPixel = samples;
+    request.hdrOutput = hdr.data();
+    auto start = Clock::now();
+    renderer.render(request);
+    return millisecondsSince(start);
+}
+
+int main(int argc, char *argv[])
+{
+    std::string scenePath = std::string(RAYTRACER_SCENE_DIR) + "/scene_phong_refractive.json";
+    int width = 150, height = 100;
+    int referenceSamples = 256;
+    int maxSamples = 64;
+    int bounces = 0;
+    double target = 0.02;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--resolution" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            size_t separator = value.find('x');
+            width = std::stoi(value.substr(0, separator));
+            height = std::stoi(value.substr(separator + 1));
+        }
+        else if (arg == "--reference-spp" && i + 1 < argc)
+        {
+            referenceSamples = std::stoi(argv[++i]);
+        }
+        else if (arg == "--max-spp" && i + 1 < argc)
+        {
+            maxSamples = std::stoi(argv[++i]);
+        }
+        else if (arg == "--bounces" && i + 1 < argc)
+        {
+            bounces = std::stoi(argv[++i]);
+        }
+        else if (arg == "--target" && i + 1 < argc)
+        {
+            target = std::stod(argv[++i]);
+        }
+        else if (arg.rfind("--", 0) != 0)
+        {
+            scenePath = arg;
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--resolution <width>x<height>] [--reference-spp <n>] [--max-spp <n>]"
+                      << " [--bounces <n>] [--target <rmse>] [scene.json]" << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    SceneData sceneData = readSceneFromJson(scenePath);
+    sceneData.camera = sceneData.camera.withResolution(width, height);
+    if (bounces > 0)
+    {
+        sceneData.nbounces = bounces;
+    }
+    std::cout << scenePath << " at " << width << "x" << height << ", " << sceneData.nbounces << " bounces, target RMSE "
+              << target << std::endl;
+
+    const RenderMode modes[2] = {RenderMode::PHONG, RenderMode::PATH_TRACE};
+    const char *names[2] = {"recursive", "path"};
+    for (int m = 0; m < 2; ++m)
+    {
+        SceneData modeData = sceneData;
+        modeData.renderMode = modes[m];
+        Renderer renderer(std::make_shared<const Scene>(modeData, true));
+
+        std::vector<float> reference, image;
+        double referenceMs = renderHdr(renderer, modeData.camera, referenceSamples, 99, reference);
+        std::cout << std::endl
+                  << names[m] << " (reference: " << referenceSamples << " spp in " << std::fixed << std::setprecision(0)
+                  << referenceMs << " ms)" << std::endl;
+        std::cout << std::setw(8) << "spp" << std::setw(12) << "ms" << std::setw(14) << "ms/sample" << std::setw(12) << "RMSE" << std::endl;
+
+        double timeToTarget = -1.0;
+        int samplesToTarget = 0;
+        for (int samples = 1; samples <= maxSamples; samples *= 4)
+        {
+            double ms = renderHdr(renderer, modeData.camera, samples, 1234, image);
+            double error = rmse(image, reference);
+            std::cout << std::setw(8) << samples << std::fixed << std::setprecision(1) << std::setw(12) << ms
+                      << std::setprecision(3) << std::setw(14) << ms / samples << std::setprecision(4) << std::setw(12) << error << std::endl;
+            if (timeToTarget < 0.0 && error <= target)
+            {
+                timeToTarget = ms;
+                samplesToTarget = samples;
+            }
+        }
+        if (timeToTarget >= 0.0)
+        {
+            std::cout << "time to RMSE " << target << ": " << std::setprecision(1) << timeToTarget << " ms (" << samplesToTarget << " spp)" << std::endl;
+        }
+        else
+        {
+            std::cout << "RMSE " << target << " not reached within " << maxSamples << " spp" << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "json_reader.h"
+#include "render/renderer.h"
+#include "bench_util.h"
+
+// Compares an eager BVH build with lazy builds that defer subtrees until a ray reaches them
+// A large field of random spheres is placed behind the camera of the base scene
+// (jsons/simple_phong.json by default), where only reflected rays can reach them. For each build it reports the build time,
+// the time to the first pixel (build plus rendering the centre pixel), the first and second full
+// frames, and the nodes built by the end of the frame against the eager build.
+
+int main(int argc, char *argv[])
+{
+    int width = 300, height = 200;
+    size_t count = 200000;
+    std::vector<int> lazyDepths = {4, 8, 12};
+    std::string scenePath = std::string(RAYTRACER_SCENE_DIR) + "/simple_phong.json";
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--resolution" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            size_t separator = value.find('x');
+            width = std::stoi(value.substr(0, separator));
+            height = std::stoi(value.substr(separator + 1));
+        }
+        else if (arg == "--count" && i + 1 < argc)
+        {
+            count = std::max(1L, std::stol(argv[++i]));
+        }
+        else if (arg == "--depths" && i + 1 < argc)
+        {
+            lazyDepths.clear();
+            std::stringstream list(argv[++i]);
+            for (std::string depth; std::getline(list, depth, ',');)
+            {
+                lazyDepths.push_back(std::stoi(depth));
+            }
+        }
+        else if (arg.rfind("--", 0) != 0)
+        {
+            scenePath = arg;
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--resolution <width>x<height>] [--count <n>] [--depths <d>,<d>,...] [scene.json]" << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    // Scatter spheres through a cube behind the camera, whose bounds stay clear of it
+    SceneData sceneData = readSceneFromJson(scenePath);
+    sceneData.camera = sceneData.camera.withResolution(width, height);
+    {
+        Ray view = sceneData.camera.generateRay(width / 2.0f, height / 2.0f);
+        const float halfSize = 40.0f, clearRadius = 4.0f;
+        Vector3 center = view.origin - view.direction * (halfSize * std::sqrt(3.0f) + clearRadius);
+        float radius = 0.3f * std::cbrt(8.0f * halfSize * halfSize * halfSize / count);
+        Material material; // Plain grey diffuse
+        std::minstd_rand rng(1234);
+        std::uniform_real_distribution<float> coordinate(-halfSize, halfSize);
+        sceneData.spheres.reserve(sceneData.spheres.size() + count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            sceneData.spheres.emplace_back(center + Vector3(coordinate(rng), coordinate(rng), coordinate(rng)), radius, material);
+        }
+    }
+
+    std::cout << std::filesystem::path(scenePath).filename().string() << " with " << count << " extra spheres at "
+              << width << "x" << height << std::endl;
+    std::cout << std::left << std::setw(10) << "build" << std::right << std::setw(12) << "build ms" << std::setw(14)
+              << "first px ms" << std::setw(12) << "frame ms" << std::setw(12) << "again ms" << std::setw(12) << "nodes"
+              << std::setw(12) << "build work" << std::setw(10) << "expanded" << std::setw(10) << "diff" << std::endl;
+
+    const size_t pixelCount = static_cast<size_t>(width) * height;
+    std::vector<float> reference(pixelCount * 3), image(pixelCount * 3);
+    uint64_t eagerNodes = 0;
+    double eagerBuildMs = 0.0;
+    std::vector<int> builds = {0};
+    builds.insert(builds.end(), lazyDepths.begin(), lazyDepths.end());
+    for (int lazyDepth : builds)
+    {
+        SceneData data = sceneData;
+        data.lazyBVHDepth = lazyDepth;
+        BVHNode::resetBuildStats();
+
+        auto start = Clock::now();
+        Renderer renderer(std::make_shared<const Scene>(std::move(data), true));
+        double buildMs = millisecondsSince(start);
+
+        float pixel[3];
+        FrameRequest request(sceneData.camera);
+        request.seed = 1234;
+        request.cropX = width / 2;
+        request.cropY = height / 2;
+        request.cropWidth = request.cropHeight = 1;
+        request.hdrOutput = pixel;
+        renderer.render(request);
+        double firstPixelMs = millisecondsSince(start);
+
+        request.cropX = request.cropY = request.cropWidth = request.cropHeight = 0;
+        request.hdrOutput = lazyDepth == 0 ? reference.data() : image.data();
+        start = Clock::now();
+        renderer.render(request);
+        double frameMs = millisecondsSince(start);
+        start = Clock::now();
+        renderer.render(request);
+        double againMs = millisecondsSince(start);
+
+        BVHBuildStats stats = BVHNode::buildStats();
+        if (lazyDepth == 0)
+        {
+            eagerNodes = stats.nodes;
+            eagerBuildMs = stats.buildMs;
+        }
+        float difference = 0.0f;
+        for (size_t i = 0; lazyDepth > 0 && i < image.size(); ++i)
+        {
+            difference = std::max(difference, std::fabs(image[i] - reference[i]));
+        }
+
+        std::ostringstream name, expanded;
+        name << (lazyDepth == 0 ? "eager" : "lazy " + std::to_string(lazyDepth));
+        expanded << stats.expanded << "/" << stats.deferred;
+        std::cout << std::left << std::setw(10) << name.str() << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << buildMs << std::setw(14) << firstPixelMs << std::setw(12) << frameMs
+                  << std::setw(12) << againMs << std::setw(11) << 100.0 * stats.nodes / eagerNodes << "%"
+                  << std::setw(11) << 100.0 * stats.buildMs / eagerBuildMs << "%" << std::setw(10) << expanded.str()
+                  << std::setprecision(4) << std::setw(10) << difference << std::endl;
+    }
+    return 0;
+}
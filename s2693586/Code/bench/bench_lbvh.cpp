@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "bvh/linear_bvh.h"
+#include "bvh/spatial_split_bvh.h"
+#include "bench_util.h"
+
+// Compares the build speed and trace speed of the BVH builders
+// Two scenes of random spheres are built: spread uniformly through a cube, and gathered in small
+// Gaussian clusters. Each is built with BVHNode::build (median splits), an SAH build with object
+// splits (SpatialSplitBVH with no duplication budget), and LinearBVH with 30-bit and 63-bit Morton
+// codes, without and with treelet optimisation. Rows report the build time, the objects built per
+// second per core, the SAH cost of the tree (relative to its root's area), the interior nodes
+// visited per ray, and the rays traced per second through the tree (collapsed to --width children
+// per node when given).
+
+// Surface area heuristic cost of a subtree, with interior and object tests costing the same
+static double sahCost(const BVHNode &node)
+{
+    AABB box = node.boundingBox;
+    if (node.moving)
+    {
+        box.expand(node.endBoundingBox);
+    }
+    if (!node.left && !node.right)
+    {
+        return box.surfaceArea() * node.objects.size();
+    }
+    return box.surfaceArea() + (node.left ? sahCost(*node.left) : 0.0) + (node.right ? sahCost(*node.right) : 0.0);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t count = 200000;
+    int rayCount = 100000;
+    int width = 2;
+    int treeletLeaves = 7;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--count" && i + 1 < argc)
+        {
+            count = std::max(2L, std::stol(argv[++i]));
+        }
+        else if (arg == "--rays" && i + 1 < argc)
+        {
+            rayCount = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--width" && i + 1 < argc)
+        {
+            width = std::stoi(argv[++i]);
+        }
+        else if (arg == "--treelets" && i + 1 < argc)
+        {
+            treeletLeaves = std::stoi(argv[++i]);
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--count <n>] [--rays <n>] [--width <4 or 8>] [--treelets <leaves>]" << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+
+    // Spheres in a cube of side 100, sized to fill about 1% of it, spread out or in clusters of 100
+    const float halfSize = 50.0f;
+    const float radius = 0.3f * std::cbrt(8.0f * halfSize * halfSize * halfSize / count);
+    std::minstd_rand rng(1234);
+    std::uniform_real_distribution<float> coordinate(-halfSize, halfSize), unit(-1.0f, 1.0f);
+    std::normal_distribution<float> offset(0.0f, 20.0f * radius);
+    Material material;
+    std::vector<std::shared_ptr<const Geometry>> uniform, clustered;
+    Vector3 cluster;
+    for (size_t i = 0; i < count; ++i)
+    {
+        uniform.push_back(std::make_shared<const Sphere>(Vector3(coordinate(rng), coordinate(rng), coordinate(rng)), radius, material));
+        if (i % 100 == 0)
+        {
+            cluster = Vector3(coordinate(rng), coordinate(rng), coordinate(rng));
+        }
+        clustered.push_back(std::make_shared<const Sphere>(cluster + Vector3(offset(rng), offset(rng), offset(rng)), radius, material));
+    }
+
+    // Random rays through the cube
+    std::vector<Ray> rays;
+    for (int i = 0; i < rayCount; ++i)
+    {
+        Vector3 origin(coordinate(rng), coordinate(rng), coordinate(rng));
+        Vector3 direction(unit(rng), unit(rng), unit(rng));
+        rays.emplace_back(origin, direction.normalize());
+    }
+
+    struct Builder
+    {
+        std::string name;
+        std::function<std::unique_ptr<BVHNode>(const std::vector<std::shared_ptr<const Geometry>> &)> build;
+        int threads;
+    };
+    std::string treelets = "+treelet" + std::to_string(treeletLeaves);
+    std::vector<Builder> builders = {
+        {"median", [](const auto &objects) { return BVHNode::build(objects); }, 1},
+        {"SAH", [](const auto &objects) { return SpatialSplitBVH::build(objects, 0.0f); }, 1},
+        {"LBVH30", [](const auto &objects) { return LinearBVH::build(objects, 30); }, threads},
+        {"LBVH63", [](const auto &objects) { return LinearBVH::build(objects, 63); }, threads},
+        {"LBVH30" + treelets, [&](const auto &objects) { return LinearBVH::build(objects, 30, treeletLeaves); }, threads},
+    };
+
+    std::cout << count << " spheres per scene, " << rayCount << " rays, " << threads << " threads";
+    std::cout << (width > 2 ? ", traced through " + std::to_string(width) + "-wide trees" : "") << std::endl;
+    std::cout << std::left << std::setw(11) << "scene" << std::setw(16) << "build" << std::right << std::setw(10) << "build ms"
+              << std::setw(14) << "Mobj/s/core" << std::setw(10) << "SAH" << std::setw(10) << "visits" << std::setw(10)
+              << "Mrays/s" << std::endl;
+    for (const auto &[name, objects] : {std::make_pair("uniform", &uniform), std::make_pair("clustered", &clustered)})
+    {
+        for (const Builder &builder : builders)
+        {
+            auto start = Clock::now();
+            std::unique_ptr<BVHNode> root = builder.build(*objects);
+            double buildMs = millisecondsSince(start);
+            double cost = sahCost(*root) / root->boundingBox.surfaceArea();
+            if (width > 2)
+            {
+                root->widen(width);
+            }
+
+            // Untimed pass collecting the traversal work, then the timed pass
+            TraversalStats stats;
+            for (const Ray &ray : rays)
+            {
+                Intersection closest;
+                closest.distance = std::numeric_limits<float>::max();
+                root->intersect(ray, closest, &stats);
+            }
+            start = Clock::now();
+            for (const Ray &ray : rays)
+            {
+                Intersection closest;
+                closest.distance = std::numeric_limits<float>::max();
+                root->intersect(ray, closest);
+            }
+            double raysMs = millisecondsSince(start);
+
+            std::cout << std::left << std::setw(11) << name << std::setw(16) << builder.name << std::right << std::fixed
+                      << std::setprecision(1) << std::setw(10) << buildMs << std::setprecision(2) << std::setw(14)
+                      << objects->size() / (buildMs * 1000.0 * builder.threads) << std::setprecision(1) << std::setw(10) << cost
+                      << std::setw(10) << static_cast<double>(stats.nodeVisits) / stats.rays << std::setprecision(3)
+                      << std::setw(10) << rays.size() / (raysMs * 1000.0) << std::endl;
+        }
+    }
+    std::cout << "Mobj/s/core divides by the threads a builder uses; SAH is the tree's cost relative to its root area" << std::endl;
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <malloc.h>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "json_reader.h"
+#include "render/renderer.h"
+#include "bench_util.h"
+
+// Compares the memory use and speed of separate triangles with the low-memory triangle mesh
+// A wavy grid of triangles filling the view is placed behind the objects of the base scene
+// (jsons/simple_phong.json by default). The scene is built with separate full-precision
+// triangles, then packed with 16-bit and 8-bit BVH bounds. For each build it reports the heap
+// held by the scene per triangle, the build time, a rendered frame, a set of random camera rays
+// traced through the BVH, the slowdown of both against the full-precision build, the largest pixel
+// difference from the full-precision frame and the share of pixels that differ by more than 0.01.
+// Quantized vertices move by up to the reported vertex error, which changes a few pixels.
+
+// Heap bytes currently allocated, including large blocks allocated with mmap
+static size_t heapBytes()
+{
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+int main(int argc, char *argv[])
+{
+    int width = 300, height = 200;
+    int grid = 500;
+    int rayCount = 200000;
+    std::string scenePath = std::string(RAYTRACER_SCENE_DIR) + "/simple_phong.json";
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--resolution" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            size_t separator = value.find('x');
+            width = std::stoi(value.substr(0, separator));
+            height = std::stoi(value.substr(separator + 1));
+        }
+        else if (arg == "--grid" && i + 1 < argc)
+        {
+            grid = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--rays" && i + 1 < argc)
+        {
+            rayCount = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg.rfind("--", 0) != 0)
+        {
+            scenePath = arg;
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--resolution <width>x<height>] [--grid <quads per side>] [--rays <n>] [scene.json]" << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    // Span the view with a grid of quads at a fixed distance, displaced along the view direction
+    SceneData sceneData = readSceneFromJson(scenePath);
+    sceneData.camera = sceneData.camera.withResolution(width, height);
+    {
+        const float distance = 4.0f, amplitude = 0.15f;
+        Ray view = sceneData.camera.generateRay(width / 2.0f, height / 2.0f);
+        auto corner = [&](float x, float y)
+        {
+            Ray ray = sceneData.camera.generateRay(x, y);
+            return ray.origin + ray.direction * (distance / ray.direction.dot(view.direction));
+        };
+        const float marginX = 0.05f * width, marginY = 0.05f * height; // Keep the grid's edges out of view
+        Vector3 topLeft = corner(-marginX, -marginY), topRight = corner(width + marginX, -marginY);
+        Vector3 bottomLeft = corner(-marginX, height + marginY), bottomRight = corner(width + marginX, height + marginY);
+        auto point = [&](int i, int j)
+        {
+            float u = static_cast<float>(i) / grid, v = static_cast<float>(j) / grid;
+            Vector3 onPlane = (topLeft * (1.0f - u) + topRight * u) * (1.0f - v) + (bottomLeft * (1.0f - u) + bottomRight * u) * v;
+            return onPlane + view.direction * (amplitude * std::sin(40.0f * u) * std::sin(30.0f * v));
+        };
+        // Each triangle gets its own IDs, as if it were one more shape entry after the base scene's in the JSON
+        uint32_t objectId = 0, primitiveId = 0;
+        auto lastIds = [&](const auto &shapes)
+        {
+            for (const auto &shape : shapes)
+            {
+                objectId = std::max(objectId, shape.objectId);
+                primitiveId = std::max(primitiveId, shape.firstPrimitiveId);
+            }
+        };
+        lastIds(sceneData.spheres);
+        lastIds(sceneData.cylinders);
+        lastIds(sceneData.triangles);
+        for (const auto &set : sceneData.particles)
+        {
+            objectId = std::max(objectId, set->objectId);
+            primitiveId = std::max(primitiveId, set->firstPrimitiveId + static_cast<uint32_t>(set->size()) - 1);
+        }
+        auto addTriangle = [&](const Vector3 &a, const Vector3 &b, const Vector3 &c)
+        {
+            Material material(Vector3(0.5f, 0.6f, 0.8f));
+            material.id = ++objectId;
+            sceneData.triangles.emplace_back(a, b, c, material);
+            sceneData.triangles.back().objectId = material.id;
+            sceneData.triangles.back().firstPrimitiveId = ++primitiveId;
+        };
+        sceneData.triangles.reserve(sceneData.triangles.size() + 2 * static_cast<size_t>(grid) * grid);
+        for (int j = 0; j < grid; ++j)
+        {
+            for (int i = 0; i < grid; ++i)
+            {
+                addTriangle(point(i, j), point(i + 1, j), point(i + 1, j + 1));
+                addTriangle(point(i, j), point(i + 1, j + 1), point(i, j + 1));
+            }
+        }
+    }
+    const size_t triangleCount = sceneData.triangles.size();
+
+    // Random camera rays, traced directly through the BVH
+    std::vector<Ray> rays;
+    {
+        std::minstd_rand rng(1234);
+        std::uniform_real_distribution<float> x(0.0f, width), y(0.0f, height);
+        for (int i = 0; i < rayCount; ++i)
+        {
+            rays.push_back(sceneData.camera.generateRay(x(rng), y(rng)));
+        }
+    }
+
+    std::cout << std::filesystem::path(scenePath).filename().string() << " with " << triangleCount << " triangles at "
+              << width << "x" << height << ", " << rayCount << " rays" << std::endl;
+    std::cout << std::left << std::setw(10) << "build" << std::right << std::setw(10) << "MB" << std::setw(12) << "bytes/tri"
+              << std::setw(12) << "build ms" << std::setw(12) << "frame ms" << std::setw(12) << "rays ms" << std::setw(12)
+              << "slowdown" << std::setw(10) << "diff" << std::setw(10) << "changed" << std::setw(14) << "vertex error" << std::endl;
+
+    const size_t pixelCount = static_cast<size_t>(width) * height;
+    std::vector<float> reference(pixelCount * 3), image(pixelCount * 3);
+    double referenceRaysMs = 0.0, referenceFrameMs = 0.0;
+    for (int bits : {0, 16, 8})
+    {
+        size_t heapBefore = heapBytes();
+        auto start = Clock::now();
+        SceneData data = sceneData;
+        data.lowMemoryBits = bits;
+        auto scene = std::make_shared<const Scene>(std::move(data), true);
+        double buildMs = millisecondsSince(start);
+        size_t sceneBytes = heapBytes() - heapBefore;
+
+        Renderer renderer(scene);
+        FrameRequest request(sceneData.camera);
+        request.seed = 1234;
+        request.hdrOutput = bits == 0 ? reference.data() : image.data();
+        start = Clock::now();
+        renderer.render(request);
+        double frameMs = millisecondsSince(start);
+
+        start = Clock::now();
+        size_t hits = 0;
+        for (const Ray &ray : rays)
+        {
+            Intersection closest;
+            closest.distance = std::numeric_limits<float>::max();
+            hits += scene->bvh()->intersect(ray, closest);
+        }
+        double raysMs = millisecondsSince(start);
+        if (bits == 0)
+        {
+            referenceRaysMs = raysMs;
+            referenceFrameMs = frameMs;
+        }
+
+        float difference = 0.0f;
+        size_t changed = 0;
+        for (size_t pixel = 0; bits > 0 && pixel < pixelCount; ++pixel)
+        {
+            float pixelDifference = 0.0f;
+            for (size_t i = 3 * pixel; i < 3 * pixel + 3; ++i)
+            {
+                pixelDifference = std::max(pixelDifference, std::fabs(image[i] - reference[i]));
+            }
+            difference = std::max(difference, pixelDifference);
+            changed += pixelDifference > 0.01f;
+        }
+        std::ostringstream name, slowdown;
+        name << (bits == 0 ? "full" : std::to_string(bits) + "-bit");
+        slowdown << std::fixed << std::setprecision(2) << frameMs / referenceFrameMs << "/" << raysMs / referenceRaysMs << "x";
+        std::cout << std::left << std::setw(10) << name.str() << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(10) << sceneBytes / 1048576.0 << std::setw(12) << static_cast<double>(sceneBytes) / triangleCount
+                  << std::setw(12) << buildMs << std::setw(12) << frameMs << std::setw(12) << raysMs << std::setw(12)
+                  << slowdown.str() << std::setprecision(4) << std::setw(10) << difference << std::setprecision(2) << std::setw(9)
+                  << 100.0 * changed / pixelCount << "%" << std::setprecision(6)
+                  << std::setw(14) << (scene->mesh() ? scene->mesh()->maxVertexError() : 0.0f) << std::endl;
+        if (hits == 0)
+        {
+            std::cout << "No ray hit the scene" << std::endl;
+        }
+    }
+    std::cout << "Slowdown is frame/rays time over the full-precision build" << std::endl;
+    return 0;
+}
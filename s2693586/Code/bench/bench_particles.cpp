@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include "json_reader.h"
+#include "render/renderer.h"
+#include "bench_util.h"
+
+// Compares a large particle cloud stored as a ParticleSet with the same particles stored as
+// individual Sphere objects: heap memory per particle, build time and rendering throughput
+// The cloud replaces the particles of the base scene (jsons/scene_particles.json by default)
+
+// Bytes currently allocated on the heap, or 0 where the C library cannot report it
+static size_t heapBytes()
+{
+#ifdef __GLIBC__
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd; // Small blocks plus large mmap-backed blocks
+#else
+    return 0;
+#endif
+}
+
+struct PathResult
+{
+    double bytesPerParticle;
+    double buildMs;
+    double renderMs;
+    std::vector<uint8_t> image;
+};
+
+// Builds a scene with the given data and renders it, measuring the heap it holds
+// Parameters:
+// - width, height: Image resolution of the camera
+// - makeScene: Creates the scene data holding the particles (run while heap usage is measured)
+static PathResult measure(int repeat, size_t count, const Camera &camera, int width, int height, unsigned int seed,
+                          const std::function<SceneData()> &makeScene)
+{
+    PathResult result;
+    size_t before = heapBytes();
+    auto start = Clock::now();
+    std::shared_ptr<const Scene> scene = std::make_shared<const Scene>(makeScene(), true);
+    result.buildMs = millisecondsSince(start);
+    result.bytesPerParticle = static_cast<double>(heapBytes() - before) / count;
+
+    result.image.resize(static_cast<size_t>(width) * height * 3);
+    FrameRequest request(camera);
+    request.seed = seed;
+    request.rgbOutput = result.image.data();
+    Renderer renderer(scene);
+    result.renderMs = bestOf(repeat, [&] { renderer.render(request); });
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    int repeat = 3;
+    size_t count = 200000;
+    int width = 300, height = 200;
+    std::string scenePath = std::string(RAYTRACER_SCENE_DIR) + "/scene_particles.json";
+    std::string writePath;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--repeat" && i + 1 < argc)
+        {
+            repeat = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--count" && i + 1 < argc)
+        {
+            count = std::max(1L, std::stol(argv[++i]));
+        }
+        else if (arg == "--resolution" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            size_t separator = value.find('x');
+            width = std::stoi(value.substr(0, separator));
+            height = std::stoi(value.substr(separator + 1));
+        }
+        else if (arg == "--scene" && i + 1 < argc)
+        {
+            scenePath = argv[++i];
+        }
+        else if (arg == "--write" && i + 1 < argc)
+        {
+            writePath = argv[++i];
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--count <n>] [--repeat <n>] [--resolution <width>x<height>]"
+                      << " [--scene <scene.json>] [--write <particles.bin>]" << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    SceneData base = readSceneFromJson(scenePath);
+    if (base.particles.empty())
+    {
+        std::cerr << "Scene has no particle set to replace: " << scenePath << std::endl;
+        return 1;
+    }
+    Material material = base.particles.front()->material;
+    AABB region = base.particles.front()->boundingBox();
+    base.particles.clear();
+    Camera camera = base.camera.withResolution(width, height);
+
+    // Random particles filling the base set's bounds, sized to keep the cloud equally dense
+    std::vector<ParticleSet::Particle> particles(count);
+    {
+        Vector3 extent = region.maxBounds - region.minBounds;
+        float radius = 0.35f * std::cbrt(extent.x * extent.y * extent.z / count);
+        std::minstd_rand rng(1234);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        for (auto &p : particles)
+        {
+            p.x = region.minBounds.x + unit(rng) * extent.x;
+            p.y = region.minBounds.y + unit(rng) * extent.y;
+            p.z = region.minBounds.z + unit(rng) * extent.z;
+            p.radius = radius * (0.75f + 0.5f * unit(rng));
+        }
+    }
+    if (!writePath.empty())
+    {
+        ParticleSet::save(writePath, particles);
+        std::cout << "Wrote " << count << " particles to " << writePath << std::endl;
+    }
+
+    const unsigned int seed = 1234;
+    PathResult compact = measure(repeat, count, camera, width, height, seed, [&]
+                                 {
+                                     SceneData sceneData = base;
+                                     sceneData.particles.push_back(std::make_shared<const ParticleSet>(particles, material));
+                                     return sceneData; });
+    PathResult spheres = measure(repeat, count, camera, width, height, seed, [&]
+                                 {
+                                     SceneData sceneData = base;
+                                     sceneData.spheres.reserve(sceneData.spheres.size() + count);
+                                     for (const auto &p : particles)
+                                     {
+                                         sceneData.spheres.emplace_back(Vector3(p.x, p.y, p.z), p.radius, material);
+                                     }
+                                     return sceneData; });
+
+    // Both paths must produce the same picture
+    size_t differing = 0;
+    for (size_t i = 0; i < compact.image.size(); ++i)
+    {
+        differing += std::abs(compact.image[i] - spheres.image[i]) > 16;
+    }
+
+    double primaryRays = static_cast<double>(width) * height;
+    std::cout << count << " particles, " << width << "x" << height << std::endl;
+    std::cout << std::left << std::setw(14) << "path" << std::right
+              << std::setw(16) << "bytes/particle" << std::setw(12) << "build ms"
+              << std::setw(12) << "render ms" << std::setw(12) << "Mrays/s" << std::endl;
+    auto row = [&](const char *name, const PathResult &r)
+    {
+        std::cout << std::left << std::setw(14) << name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(16) << r.bytesPerParticle << std::setw(12) << r.buildMs
+                  << std::setw(12) << r.renderMs << std::setw(12) << primaryRays / (r.renderMs * 1000.0) << std::endl;
+    };
+    row("ParticleSet", compact);
+    row("Sphere", spheres);
+    std::cout << "Memory ratio: " << std::setprecision(1) << spheres.bytesPerParticle / compact.bytesPerParticle
+              << "x, speedup: " << std::setprecision(2) << spheres.renderMs / compact.renderMs
+              << "x, differing channels: " << differing << std::endl;
+    return 0;
+}
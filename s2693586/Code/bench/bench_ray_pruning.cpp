@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "json_reader.h"
+#include "render/renderer.h"
+#include "shading/ray_tree_stats.h"
+#include "bench_util.h"
+
+// Measures the reflection and refraction rays saved by weight-based pruning and the error it adds
+// Each scene is rendered without pruning and at several minimum ray weights, with the same seed, and
+// the 8-bit images are compared. The per-material table (at --weight) lists the secondary rays spawned
+// by each material's surfaces and the largest error among the pixels whose material ID buffer shows it.
+
+struct PruningRender
+{
+    double ms = 0.0;
+    std::vector<uint8_t> rgb;
+    std::vector<uint32_t> materialId;
+    std::vector<RayTreeCounts> counts;
+};
+
+// Renders the scene with the given minimum ray weight, counting secondary rays per material
+static PruningRender renderWithWeight(const SceneData &sceneData, float minRayWeight, bool antialiasing, int repeat)
+{
+    SceneData data = sceneData;
+    data.minRayWeight = minRayWeight;
+    Renderer renderer(std::make_shared<const Scene>(data, true));
+
+    PruningRender result;
+    size_t pixelCount = static_cast<size_t>(data.camera.imageWidth()) * data.camera.imageHeight();
+    result.rgb.resize(pixelCount * 3);
+    result.materialId.resize(pixelCount);
+
+    FrameRequest request(data.camera);
+    request.seed = 1234;
+    request.antialiasing = antialiasing;
+    request.rgbOutput = result.rgb.data();
+    for (int i = 0; i < repeat; ++i)
+    {
+        auto start = Clock::now();
+        renderer.render(request);
+        double ms = millisecondsSince(start);
+        result.ms = i == 0 ? ms : std::min(result.ms, ms);
+    }
+
+    // Count the rays and record the material IDs in a separate pass, so the timings exclude both
+    RayTreeStats::reset();
+    RayTreeStats::setEnabled(true);
+    request.materialIdOutput = result.materialId.data();
+    renderer.render(request);
+    RayTreeStats::setEnabled(false);
+    result.counts = RayTreeStats::snapshot();
+    return result;
+}
+
+// Largest per-channel difference between two 8-bit images, over the pixels selected by the filter
+template <typename Filter>
+static int maxPixelError(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b, Filter include)
+{
+    int error = 0;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (include(i / 3))
+        {
+            error = std::max(error, std::abs(static_cast<int>(a[i]) - static_cast<int>(b[i])));
+        }
+    }
+    return error;
+}
+
+static RayTreeCounts total(const std::vector<RayTreeCounts> &counts)
+{
+    RayTreeCounts sum;
+    for (const RayTreeCounts &c : counts)
+    {
+        sum.reflections += c.reflections;
+        sum.refractions += c.refractions;
+        sum.prunedReflections += c.prunedReflections;
+        sum.prunedRefractions += c.prunedRefractions;
+    }
+    return sum;
+}
+
+int main(int argc, char *argv[])
+{
+    int width = 300, height = 200;
+    int repeat = 3;
+    bool antialiasing = false;
+    float materialWeight = 0.5f / 255.0f; // Half an 8-bit step
+    std::vector<std::string> scenes;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--resolution" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            size_t separator = value.find('x');
+            width = std::stoi(value.substr(0, separator));
+            height = std::stoi(value.substr(separator + 1));
+        }
+        else if (arg == "--repeat" && i + 1 < argc)
+        {
+            repeat = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--weight" && i + 1 < argc)
+        {
+            materialWeight = std::stof(argv[++i]);
+        }
+        else if (arg == "--antialiasing")
+        {
+            antialiasing = true;
+        }
+        else if (arg.rfind("--", 0) != 0)
+        {
+            scenes.push_back(arg);
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--resolution <width>x<height>] [--repeat <n>] [--weight <w>] [--antialiasing] [scene.json ...]"
+                      << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    if (scenes.empty())
+    {
+        // Scenes with mirrors and glass
+        for (const char *name : {"mirror_image.json", "scene_phong.json", "scene_phong_refractive.json", "complex.json"})
+        {
+            scenes.push_back(std::string(RAYTRACER_SCENE_DIR) + "/" + name);
+        }
+    }
+
+    std::vector<float> weights = {0.5f / 255.0f, 1.0f / 255.0f, 4.0f / 255.0f, 16.0f / 255.0f};
+    if (std::find(weights.begin(), weights.end(), materialWeight) == weights.end())
+    {
+        weights.push_back(materialWeight);
+        std::sort(weights.begin(), weights.end());
+    }
+
+    for (const auto &scenePath : scenes)
+    {
+        SceneData sceneData = readSceneFromJson(scenePath);
+        sceneData.camera = sceneData.camera.withResolution(width, height);
+        PruningRender reference = renderWithWeight(sceneData, 0.0f, antialiasing, repeat);
+        RayTreeCounts referenceTotal = total(reference.counts);
+
+        std::cout << std::filesystem::path(scenePath).filename().string() << " at " << width << "x" << height << ": "
+                  << referenceTotal.spawned() << " secondary rays without pruning in " << std::fixed << std::setprecision(1)
+                  << reference.ms << " ms" << std::endl;
+        std::cout << std::setw(12) << "min weight" << std::setw(12) << "spawned" << std::setw(10) << "pruned" << std::setw(10) << "ms"
+                  << std::setw(10) << "speedup" << std::setw(14) << "max error" << std::endl;
+        PruningRender chosen;
+        for (float weight : weights)
+        {
+            PruningRender pruned = renderWithWeight(sceneData, weight, antialiasing, repeat);
+            RayTreeCounts counts = total(pruned.counts);
+            std::cout << std::setw(8) << std::setprecision(1) << weight * 255.0f << "/255" << std::setw(12) << counts.spawned()
+                      << std::setw(9) << 100.0 * counts.pruned() / std::max<uint64_t>(counts.spawned(), 1) << "%" << std::setw(10)
+                      << pruned.ms << std::setprecision(2) << std::setw(9) << reference.ms / pruned.ms << "x" << std::setw(14)
+                      << maxPixelError(pruned.rgb, reference.rgb, [](size_t) { return true; }) << std::endl;
+            if (weight == materialWeight)
+            {
+                chosen = std::move(pruned);
+            }
+        }
+
+        // Per-material breakdown at the chosen weight
+        std::cout << "  per material at " << std::setprecision(1) << materialWeight * 255.0f << "/255:" << std::endl;
+        std::cout << std::setw(12) << "material" << std::setw(14) << "reflections" << std::setw(10) << "pruned" << std::setw(14)
+                  << "refractions" << std::setw(10) << "pruned" << std::setw(14) << "max error" << std::endl;
+        for (uint32_t id = 1; id < chosen.counts.size(); ++id)
+        {
+            const RayTreeCounts &c = chosen.counts[id];
+            if (c.spawned() == 0)
+            {
+                continue;
+            }
+            int error = maxPixelError(chosen.rgb, reference.rgb, [&](size_t pixel) { return reference.materialId[pixel] == id; });
+            std::cout << std::setw(12) << id << std::setw(14) << c.reflections << std::setw(10) << c.prunedReflections
+                      << std::setw(14) << c.refractions << std::setw(10) << c.prunedRefractions << std::setw(14) << error << std::endl;
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "json_reader.h"
+#include "render/renderer.h"
+#include "bench_util.h"
+
+// Benchmarks scene loading, BVH construction and rendering for a set of scenes
+// Each stage is run --repeat times and the fastest time is reported
+
+int main(int argc, char *argv[])
+{
+    int repeat = 3;
+    int width = 0, height = 0;
+    bool bruteForce = false;
+    std::vector<std::string> scenes;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--repeat" && i + 1 < argc)
+        {
+            repeat = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--resolution" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            size_t separator = value.find('x');
+            width = std::stoi(value.substr(0, separator));
+            height = std::stoi(value.substr(separator + 1));
+        }
+        else if (arg == "--brute-force")
+        {
+            bruteForce = true;
+        }
+        else if (arg == "--help")
+        {
+            std::cout << "Usage: " << argv[0] << " [--repeat <n>] [--resolution <width>x<height>] [--brute-force] [scene.json ...]" << std::endl;
+            return 0;
+        }
+        else
+        {
+            scenes.push_back(arg);
+        }
+    }
+
+    // Default to every scene shipped with the renderer
+    if (scenes.empty())
+    {
+        for (const auto &entry : std::filesystem::directory_iterator(RAYTRACER_SCENE_DIR))
+        {
+            if (entry.path().extension() == ".json")
+            {
+                scenes.push_back(entry.path().string());
+            }
+        }
+        std::sort(scenes.begin(), scenes.end());
+    }
+
+    const unsigned int seed = 1234;
+
+    std::cout << std::left << std::setw(28) << "scene" << std::right
+              << std::setw(12) << "parse ms" << std::setw(12) << "build ms"
+              << std::setw(12) << "bvh ms" << std::setw(12) << "Mrays/s";
+    if (bruteForce)
+    {
+        std::cout << std::setw(12) << "brute ms";
+    }
+    std::cout << std::endl;
+
+    for (const auto &scenePath : scenes)
+    {
+        SceneData sceneData = readSceneFromJson(scenePath);
+        double parseMs = bestOf(repeat, [&] { readSceneFromJson(scenePath); });
+
+        if (width > 0 && height > 0)
+        {
+            sceneData.width = width;
+            sceneData.height = height;
+            sceneData.camera = sceneData.camera.withResolution(width, height);
+        }
+
+        std::shared_ptr<const Scene> scene;
+        double buildMs = bestOf(repeat, [&] { scene = std::make_shared<const Scene>(sceneData, true); });
+
+        // Render into an in-memory buffer so file output is not part of the timing
+        std::vector<uint8_t> image(static_cast<size_t>(sceneData.width) * sceneData.height * 3);
+        FrameRequest request(sceneData.camera);
+        request.seed = seed;
+        request.rgbOutput = image.data();
+
+        Renderer renderer(scene);
+        double bvhMs = bestOf(repeat, [&] { renderer.render(request); });
+        double primaryRays = static_cast<double>(sceneData.width) * sceneData.height;
+
+        std::cout << std::left << std::setw(28) << std::filesystem::path(scenePath).filename().string() << std::right
+                  << std::fixed << std::setprecision(2)
+                  << std::setw(12) << parseMs << std::setw(12) << buildMs
+                  << std::setw(12) << bvhMs << std::setw(12) << primaryRays / (bvhMs * 1000.0);
+        if (bruteForce)
+        {
+            Renderer bruteRenderer(std::make_shared<const Scene>(sceneData, false));
+            double bruteMs = bestOf(repeat, [&] { bruteRenderer.render(request); });
+            std::cout << std::setw(12) << bruteMs;
+        }
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "json_reader.h"
+#include "render/renderer.h"
+#include "bench_util.h"
+
+// Compares the pixel kernels compiled for each frame's features with the general kernel, which compiles in
+// every feature and checks each one as it goes
+// Every scene is rendered plain, with antialiasing and with the albedo and normal buffers, and scenes with
+// mirrors or glass are also rendered with every material made diffuse. Rows list the features the frame was
+// rendered with (see RenderFeatures), the fastest of --repeat renders with each kernel, and the largest
+// difference between the two 8-bit images, which is 0 when the specialised kernel reproduces the general one.
+
+// Renders the request once and returns the time taken in milliseconds
+static double renderTime(const Renderer &renderer, const FrameRequest &request)
+{
+    auto start = Clock::now();
+    renderer.render(request);
+    return millisecondsSince(start);
+}
+
+int main(int argc, char *argv[])
+{
+    int width = 300, height = 200;
+    int repeat = 3;
+    std::vector<std::string> scenes;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--resolution" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            size_t separator = value.find('x');
+            width = std::stoi(value.substr(0, separator));
+            height = std::stoi(value.substr(separator + 1));
+        }
+        else if (arg == "--repeat" && i + 1 < argc)
+        {
+            repeat = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--help")
+        {
+            std::cout << "Usage: " << argv[0] << " [--resolution <width>x<height>] [--repeat <n>] [scene.json ...]" << std::endl;
+            return 0;
+        }
+        else
+        {
+            scenes.push_back(arg);
+        }
+    }
+
+    // Default to scenes covering each render mode, glass and mirrors, and depth of field
+    if (scenes.empty())
+    {
+        for (const char *name : {"binary_primitives.json", "scene_phong.json", "complex.json", "scene_phong_refractive.json",
+                                 "scene_aperture.json", "scene_pathtrace.json"})
+        {
+            scenes.push_back(std::string(RAYTRACER_SCENE_DIR) + "/" + name);
+        }
+    }
+
+    std::cout << width << "x" << height << std::endl;
+    std::cout << std::left << std::setw(38) << "scene" << std::setw(32) << "features" << std::right << std::setw(12) << "general"
+              << std::setw(14) << "specialised" << std::setw(10) << "speedup" << std::setw(12) << "difference" << std::endl;
+    std::vector<std::pair<std::string, SceneData>> variants;
+    for (const std::string &scenePath : scenes)
+    {
+        SceneData sceneData = readSceneFromJson(scenePath);
+        sceneData.camera = sceneData.camera.withResolution(width, height);
+        std::string name = std::filesystem::path(scenePath).filename().string();
+        variants.emplace_back(name, sceneData);
+
+        // The same scene without mirrors and glass (particle sets keep their shared material)
+        bool specular = false;
+        auto makeDiffuse = [&](auto &shapes)
+        {
+            for (auto &shape : shapes)
+            {
+                specular = specular || shape.material.isReflective || shape.material.isRefractive;
+                shape.material.isReflective = shape.material.isRefractive = false;
+            }
+        };
+        makeDiffuse(sceneData.spheres);
+        makeDiffuse(sceneData.cylinders);
+        makeDiffuse(sceneData.triangles);
+        if (specular && sceneData.renderMode == RenderMode::PHONG)
+        {
+            variants.emplace_back(name + " (diffuse)", sceneData);
+        }
+    }
+
+    for (const auto &[name, sceneData] : variants)
+    {
+        Renderer renderer(std::make_shared<const Scene>(sceneData, true));
+        size_t pixelCount = static_cast<size_t>(width) * height;
+        std::string previous;
+        for (int options = 0; options < 3; ++options)
+        {
+            std::vector<uint8_t> general(pixelCount * 3), specialised(pixelCount * 3);
+            std::vector<float> albedo(pixelCount * 3), normal(pixelCount * 3);
+            FrameRequest request(sceneData.camera);
+            request.seed = 1234;
+            request.applyToneMap = true;
+            request.antialiasing = options == 1;
+            if (options == 2)
+            {
+                request.albedoOutput = albedo.data();
+                request.normalOutput = normal.data();
+            }
+            request.rgbOutput = general.data();
+            std::string features = renderer.features(request).name();
+            if (features == previous)
+            {
+                continue; // Binary renders take one sample per pixel, antialiased or not
+            }
+            previous = features;
+
+            // The two kernels take turns, so changes in machine load affect both alike
+            double generalMs = 0.0, specialisedMs = 0.0;
+            for (int i = 0; i < repeat; ++i)
+            {
+                request.rgbOutput = general.data();
+                request.specialisedKernel = false;
+                double ms = renderTime(renderer, request);
+                generalMs = i == 0 ? ms : std::min(generalMs, ms);
+                request.rgbOutput = specialised.data();
+                request.specialisedKernel = true;
+                ms = renderTime(renderer, request);
+                specialisedMs = i == 0 ? ms : std::min(specialisedMs, ms);
+            }
+
+            int difference = 0;
+            for (size_t i = 0; i < general.size(); ++i)
+            {
+                difference = std::max(difference, std::abs(static_cast<int>(general[i]) - static_cast<int>(specialised[i])));
+            }
+            std::cout << std::left << std::setw(38) << name << std::setw(32) << features << std::right << std::fixed << std::setprecision(1)
+                      << std::setw(9) << generalMs << " ms" << std::setw(11) << specialisedMs << " ms" << std::setprecision(2) << std::setw(9)
+                      << generalMs / specialisedMs << "x" << std::setw(12) << difference << std::defaultfloat << std::endl;
+        }
+    }
+    return 0;
+}
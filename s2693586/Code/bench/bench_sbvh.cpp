@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "bvh/spatial_split_bvh.h"
+#include "bench_util.h"
+
+// Compares BVHNode::build with SAH builds without and with spatial splits on overlap-heavy scenes
+// - slivers: long, thin triangles at random orientations in a cube
+// - city: a grid of buildings with walls and pitched (diagonal) roofs, standing on two large ground
+//   triangles that span the whole scene, with small spheres scattered on the ground
+// Each scene is built with BVHNode::build (median splits), SpatialSplitBVH with no budget (object
+// splits only) and SpatialSplitBVH with the given budget. The same random rays are traced through
+// each tree. Rows report the build time, nodes, references per object, the interior nodes visited
+// and the boxes and objects tested per ray, the rays traced per second, and the rays whose closest
+// hit differs from the object-split SAH tree's. With --width, the trees are collapsed into wide ones
+// (visited nearest child first) before tracing.
+
+// A long, thin triangle around center along direction
+static std::shared_ptr<const Geometry> sliver(const Vector3 &center, const Vector3 &direction, const Vector3 &side, float length, float width,
+                                              const Material &material)
+{
+    Vector3 end = direction * (0.5f * length);
+    return std::make_shared<const Triangle>(center - end, center + end, center - end + side * width, material);
+}
+
+// Adds the two triangles of the quad a, b, c, d
+static void addQuad(std::vector<std::shared_ptr<const Geometry>> &objects, const Vector3 &a, const Vector3 &b, const Vector3 &c,
+                    const Vector3 &d, const Material &material)
+{
+    objects.push_back(std::make_shared<const Triangle>(a, b, c, material));
+    objects.push_back(std::make_shared<const Triangle>(a, c, d, material));
+}
+
+int main(int argc, char *argv[])
+{
+    size_t count = 50000;
+    int rayCount = 100000;
+    float budget = 0.3f;
+    int width = 2;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--count" && i + 1 < argc)
+        {
+            count = std::max(1L, std::stol(argv[++i]));
+        }
+        else if (arg == "--rays" && i + 1 < argc)
+        {
+            rayCount = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--budget" && i + 1 < argc)
+        {
+            budget = std::max(0.0f, std::stof(argv[++i]));
+        }
+        else if (arg == "--width" && i + 1 < argc)
+        {
+            width = std::stoi(argv[++i]);
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--count <objects>] [--rays <n>] [--budget <duplication budget>] [--width <4 or 8>]" << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    std::minstd_rand rng(1234);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f), positive(0.0f, 1.0f);
+    auto randomDirection = [&]
+    {
+        Vector3 direction;
+        do
+        {
+            direction = Vector3(unit(rng), unit(rng), unit(rng));
+        } while (direction.length() > 1.0f || direction.length() < 1e-3f);
+        return direction.normalize();
+    };
+    Material material;
+
+    // Slivers: triangles a fifth of the cube long and a hundredth of that wide
+    std::vector<std::shared_ptr<const Geometry>> slivers;
+    for (size_t i = 0; i < count; ++i)
+    {
+        Vector3 direction = randomDirection();
+        Vector3 side = direction.cross(randomDirection()).normalize();
+        slivers.push_back(sliver(Vector3(unit(rng), unit(rng), unit(rng)) * 50.0f, direction, side, 20.0f, 0.2f, material));
+    }
+
+    // City: buildings of 8 wall and 4 roof triangles in a grid, with the rest of the objects as spheres
+    std::vector<std::shared_ptr<const Geometry>> city;
+    const int blocks = std::max(1, static_cast<int>(std::sqrt(count / 24.0)));
+    const float spacing = 100.0f / blocks;
+    addQuad(city, Vector3(-50.0f, 0.0f, -50.0f), Vector3(50.0f, 0.0f, -50.0f), Vector3(50.0f, 0.0f, 50.0f), Vector3(-50.0f, 0.0f, 50.0f), material);
+    for (int i = 0; i < blocks; ++i)
+    {
+        for (int j = 0; j < blocks; ++j)
+        {
+            float x0 = -50.0f + (i + 0.2f) * spacing, x1 = x0 + 0.6f * spacing;
+            float z0 = -50.0f + (j + 0.2f) * spacing, z1 = z0 + 0.6f * spacing;
+            float height = spacing * (0.5f + 2.0f * positive(rng)), ridge = height + 0.3f * spacing;
+            Vector3 a(x0, 0.0f, z0), b(x1, 0.0f, z0), c(x1, 0.0f, z1), d(x0, 0.0f, z1);
+            Vector3 up(0.0f, height, 0.0f);
+            addQuad(city, a, b, b + up, a + up, material);
+            addQuad(city, b, c, c + up, b + up, material);
+            addQuad(city, c, d, d + up, c + up, material);
+            addQuad(city, d, a, a + up, d + up, material);
+            Vector3 ridgeStart(x0, ridge, 0.5f * (z0 + z1)), ridgeEnd(x1, ridge, 0.5f * (z0 + z1));
+            addQuad(city, a + up, b + up, ridgeEnd, ridgeStart, material);
+            addQuad(city, c + up, d + up, ridgeStart, ridgeEnd, material);
+        }
+    }
+    while (city.size() < count)
+    {
+        float radius = 0.05f * spacing;
+        city.push_back(std::make_shared<const Sphere>(Vector3(unit(rng) * 50.0f, radius, unit(rng) * 50.0f), radius, material));
+    }
+
+    struct Case
+    {
+        std::string name;
+        const std::vector<std::shared_ptr<const Geometry>> *objects;
+        std::function<Ray()> ray;
+    };
+    std::vector<Case> cases = {
+        {"slivers", &slivers, [&] { return Ray(Vector3(unit(rng), unit(rng), unit(rng)) * 50.0f, randomDirection()); }},
+        {"city", &city, [&]
+         {
+             Vector3 direction = randomDirection();
+             direction.y = -std::fabs(direction.y); // Look down onto the city from above the roofs
+             return Ray(Vector3(unit(rng) * 50.0f, spacing * 3.0f, unit(rng) * 50.0f), direction.normalize());
+         }},
+    };
+
+    std::cout << count << " objects per scene, " << rayCount << " rays, budget " << budget;
+    std::cout << (width > 2 ? ", traced through " + std::to_string(width) + "-wide trees" : "") << std::endl;
+    std::cout << std::left << std::setw(10) << "scene" << std::setw(10) << "build" << std::right << std::setw(12) << "build ms"
+              << std::setw(10) << "nodes" << std::setw(8) << "refs" << std::setw(10) << "visits" << std::setw(10) << "boxes"
+              << std::setw(10) << "objects" << std::setw(10) << "Mrays/s" << std::setw(10) << "speedup" << std::setw(8) << "diff"
+              << std::endl;
+    for (Case &scene : cases)
+    {
+        std::vector<Ray> rays;
+        for (int i = 0; i < rayCount; ++i)
+        {
+            rays.push_back(scene.ray());
+        }
+
+        std::vector<float> reference(rays.size());
+        double medianMs = 0.0;
+        for (float caseBudget : {-1.0f, 0.0f, budget})
+        {
+            SpatialSplitStats buildStats;
+            auto start = Clock::now();
+            std::unique_ptr<BVHNode> root = caseBudget < 0.0f ? BVHNode::build(*scene.objects)
+                                                              : SpatialSplitBVH::build(*scene.objects, caseBudget, &buildStats);
+            double buildMs = millisecondsSince(start);
+            if (width > 2)
+            {
+                root->widen(width);
+            }
+
+            // Untimed pass collecting the traversal work
+            TraversalStats stats;
+            size_t differences = 0;
+            for (size_t i = 0; i < rays.size(); ++i)
+            {
+                Intersection closest;
+                closest.distance = std::numeric_limits<float>::max();
+                root->intersect(rays[i], closest, &stats);
+                float distance = closest.hit ? closest.distance : -1.0f;
+                if (caseBudget == 0.0f)
+                {
+                    reference[i] = distance;
+                }
+                differences += caseBudget > 0.0f && distance != reference[i];
+            }
+
+            start = Clock::now();
+            for (const Ray &ray : rays)
+            {
+                Intersection closest;
+                closest.distance = std::numeric_limits<float>::max();
+                root->intersect(ray, closest);
+            }
+            double raysMs = millisecondsSince(start);
+            if (caseBudget < 0.0f)
+            {
+                medianMs = raysMs;
+            }
+
+            std::string name = caseBudget < 0.0f ? "median" : caseBudget == 0.0f ? "SAH" : "SBVH";
+            double perRay = 1.0 / stats.rays;
+            std::cout << std::left << std::setw(10) << scene.name << std::setw(10) << name << std::right << std::fixed
+                      << std::setprecision(1) << std::setw(12) << buildMs << std::setw(10)
+                      << (caseBudget < 0.0f ? std::string("-") : std::to_string(buildStats.nodes)) << std::setprecision(2)
+                      << std::setw(8) << (caseBudget < 0.0f ? 1.0 : static_cast<double>(buildStats.references) / buildStats.objects)
+                      << std::setw(10) << stats.nodeVisits * perRay << std::setw(10) << stats.boxTests * perRay << std::setw(10)
+                      << stats.objectTests * perRay << std::setw(10) << rays.size() / (raysMs * 1000.0) << std::setw(9)
+                      << medianMs / raysMs << "x" << std::setw(8) << differences << std::endl;
+        }
+    }
+    std::cout << "refs is leaf references per object; visits, boxes and objects are per ray; diff counts SBVH hits that differ from SAH" << std::endl;
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "json_reader.h"
+#include "bvh/shadow_cache.h"
+#include "render/renderer.h"
+#include "bench_util.h"
+
+// Compares BVH renders with and without the last-occluder shadow cache
+// Each scene is rendered --repeat times in each mode, alternating, and the fastest time is kept. The counters
+// show how many shadow rays were blocked and how many of those the cached occluder answered
+// without a BVH traversal.
+
+// Renders the request once and returns the time taken in milliseconds
+static double timeRender(const Renderer &renderer, const FrameRequest &request)
+{
+    auto start = Clock::now();
+    renderer.render(request);
+    return millisecondsSince(start);
+}
+
+int main(int argc, char *argv[])
+{
+    int width = 300, height = 200;
+    int repeat = 3;
+    bool antialiasing = false;
+    std::vector<std::string> scenes;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--resolution" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            size_t separator = value.find('x');
+            width = std::stoi(value.substr(0, separator));
+            height = std::stoi(value.substr(separator + 1));
+        }
+        else if (arg == "--repeat" && i + 1 < argc)
+        {
+            repeat = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--antialiasing")
+        {
+            antialiasing = true;
+        }
+        else if (arg.rfind("--", 0) != 0)
+        {
+            scenes.push_back(arg);
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--resolution <width>x<height>] [--repeat <n>] [--antialiasing] [scene.json ...]" << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    if (scenes.empty())
+    {
+        // A detailed model and the scenes with mirrors and several lights
+        for (const char *name : {"complex.json", "mirror_image.json", "scene_phong.json", "scene_phong_refractive.json", "scene_area_lights.json"})
+        {
+            scenes.push_back(std::string(RAYTRACER_SCENE_DIR) + "/" + name);
+        }
+    }
+
+    std::cout << std::left << std::setw(30) << "scene" << std::right << std::setw(8) << "lights" << std::setw(14) << "shadow rays"
+              << std::setw(10) << "blocked" << std::setw(10) << "cached" << std::setw(12) << "off ms" << std::setw(12) << "on ms"
+              << std::setw(10) << "speedup" << std::endl;
+    for (const auto &scenePath : scenes)
+    {
+        SceneData sceneData = readSceneFromJson(scenePath);
+        sceneData.camera = sceneData.camera.withResolution(width, height);
+        size_t lightCount = sceneData.lights.size();
+        Renderer renderer(std::make_shared<const Scene>(sceneData, true));
+
+        FrameRequest request(sceneData.camera);
+        request.seed = 1234;
+        request.antialiasing = antialiasing;
+        std::vector<float> hdr(static_cast<size_t>(width) * height * 3);
+        request.hdrOutput = hdr.data();
+
+        // Alternate the modes so both see the same machine load, and keep the fastest of each
+        double offMs = 0.0, onMs = 0.0;
+        ShadowCache::resetStats();
+        for (int i = 0; i < repeat; ++i)
+        {
+            ShadowCache::setEnabled(false);
+            double ms = timeRender(renderer, request);
+            offMs = i == 0 ? ms : std::min(offMs, ms);
+            ShadowCache::setEnabled(true);
+            ms = timeRender(renderer, request);
+            onMs = i == 0 ? ms : std::min(onMs, ms);
+        }
+        ShadowCacheStats stats = ShadowCache::stats();
+
+        uint64_t perRender = stats.queries / repeat;
+        std::cout << std::left << std::setw(30) << std::filesystem::path(scenePath).filename().string() << std::right
+                  << std::setw(8) << lightCount << std::setw(14) << perRender << std::fixed << std::setprecision(1)
+                  << std::setw(9) << 100.0 * stats.blocked / std::max<uint64_t>(stats.queries, 1) << "%" << std::setw(9)
+                  << 100.0 * stats.hitRate() << "%" << std::setw(12) << offMs << std::setw(12) << onMs << std::setprecision(2)
+                  << std::setw(9) << offMs / onMs << "x" << std::endl;
+    }
+    return 0;
+}
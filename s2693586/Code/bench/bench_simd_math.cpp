@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include "bvh/aabb.h"
+#include "camera/simd_math.h"
+#include "bench_util.h"
+
+// Compares the hot-path math layer (camera/simd_math.h) with the Vector3 code it replaces
+// - box: ray-box slab tests, the branch-free AABB::intersect against the axis-by-axis loop it replaced
+//   (indexing vectors through Vector3::operator[] and stopping at the first miss)
+// - normalize: Vector3::normalize through the checking operator/ (as before), Vector3::normalize, Float3
+//   and Vec3x8 (eight vectors stored component by component)
+// Rows report millions of operations per second (the best of --repeat runs) and the largest difference
+// from the first row, which is 0 when the results are identical.
+
+// AABB::intersect as it was before the math layer
+static bool referenceIntersect(const AABB &box, const Ray &ray, float &tMin, float &tMax)
+{
+    constexpr float epsilon = 1e-8f;
+    tMin = 0.0f;
+    tMax = std::numeric_limits<float>::max();
+    for (int i = 0; i < 3; ++i)
+    {
+        float invD = (std::fabs(ray.direction[i]) > epsilon) ? 1.0f / ray.direction[i] : std::numeric_limits<float>::infinity();
+        float t0 = (box.minBounds[i] - ray.origin[i]) * invD;
+        float t1 = (box.maxBounds[i] - ray.origin[i]) * invD;
+        if (invD < 0.0f)
+        {
+            std::swap(t0, t1);
+        }
+        tMin = std::max(tMin, t0);
+        tMax = std::min(tMax, t1);
+        if (tMax <= tMin + epsilon)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Vector3::normalize as it was before the math layer, dividing through the checking operator/
+static Vector3 referenceNormalize(const Vector3 &v)
+{
+    float len = v.length();
+    return len > 0 ? v / len : Vector3(0, 0, 0);
+}
+
+static void printRow(const std::string &name, double operations, double ms, double difference)
+{
+    std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(1) << std::setw(10)
+              << operations / (ms * 1e3) << std::scientific << std::setprecision(1) << std::setw(14) << difference
+              << std::defaultfloat << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    int boxCount = 1024, rayCount = 4096, vectorCount = 1 << 20;
+    int repeat = 3;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--boxes" && i + 1 < argc)
+        {
+            boxCount = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--rays" && i + 1 < argc)
+        {
+            rayCount = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--vectors" && i + 1 < argc)
+        {
+            vectorCount = std::max(8, std::stoi(argv[++i])) / 8 * 8;
+        }
+        else if (arg == "--repeat" && i + 1 < argc)
+        {
+            repeat = std::max(1, std::stoi(argv[++i]));
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--boxes <n>] [--rays <n>] [--vectors <n>] [--repeat <n>]" << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    // Boxes in a cube of side 20, some of them flat, and rays from inside it, some along an axis
+    std::minstd_rand rng(1234);
+    std::uniform_real_distribution<float> coordinate(-10.0f, 10.0f), size(0.0f, 2.0f), unit(-1.0f, 1.0f);
+    std::vector<AABB> boxes;
+    for (int i = 0; i < boxCount; ++i)
+    {
+        Vector3 corner(coordinate(rng), coordinate(rng), coordinate(rng));
+        Vector3 extent(size(rng), size(rng), i % 8 == 0 ? 0.0f : size(rng));
+        boxes.emplace_back(corner, corner + extent);
+    }
+    std::vector<Ray> rays;
+    for (int i = 0; i < rayCount; ++i)
+    {
+        Vector3 direction(unit(rng), unit(rng), unit(rng));
+        if (i % 16 == 0)
+        {
+            direction = Vector3(0.0f, 0.0f, 1.0f);
+        }
+        rays.emplace_back(Vector3(coordinate(rng), coordinate(rng), coordinate(rng)), direction);
+    }
+
+    std::cout << std::left << std::setw(24) << "operation" << std::right << std::setw(10) << "M/s" << std::setw(14) << "difference"
+              << std::endl;
+    long long sink = 0;
+    const double tests = static_cast<double>(boxCount) * rayCount;
+    double ms = bestOf(repeat, [&]
+                            {
+                                for (const Ray &ray : rays)
+                                {
+                                    for (const AABB &box : boxes)
+                                    {
+                                        float tMin, tMax;
+                                        sink += referenceIntersect(box, ray, tMin, tMax);
+                                    }
+                                } });
+    printRow("box (axis by axis)", tests, ms, 0.0);
+    ms = bestOf(repeat, [&]
+                     {
+                         for (const Ray &ray : rays)
+                         {
+                             for (const AABB &box : boxes)
+                             {
+                                 float tMin, tMax;
+                                 sink += box.intersect(ray, tMin, tMax);
+                             }
+                         } });
+    double difference = 0.0;
+    for (const Ray &ray : rays)
+    {
+        for (const AABB &box : boxes)
+        {
+            float referenceMin, referenceMax, tMin, tMax;
+            bool expected = referenceIntersect(box, ray, referenceMin, referenceMax);
+            if (box.intersect(ray, tMin, tMax) != expected)
+            {
+                difference = std::numeric_limits<double>::infinity();
+            }
+            else if (expected)
+            {
+                difference = std::max({difference, static_cast<double>(std::fabs(tMin - referenceMin)),
+                                       static_cast<double>(std::fabs(tMax - referenceMax))});
+            }
+        }
+    }
+    printRow("box (branch-free)", tests, ms, difference);
+
+    // Vectors to normalize, kept both as Vector3 and component by component
+    std::vector<Vector3> vectors(vectorCount), expected(vectorCount), normalized(vectorCount);
+    std::vector<float> xs(vectorCount), ys(vectorCount), zs(vectorCount);
+    for (int i = 0; i < vectorCount; ++i)
+    {
+        vectors[i] = i % 1024 == 0 ? Vector3(0.0f) : Vector3(coordinate(rng), coordinate(rng), coordinate(rng));
+        xs[i] = vectors[i].x;
+        ys[i] = vectors[i].y;
+        zs[i] = vectors[i].z;
+    }
+    auto largestDifference = [&](const std::vector<Vector3> &results)
+    {
+        double largest = 0.0;
+        for (int i = 0; i < vectorCount; ++i)
+        {
+            largest = std::max(largest, static_cast<double>((results[i] - expected[i]).length()));
+        }
+        return largest;
+    };
+
+    // Every 1024th vector is zero, and normalizes to zero
+    ms = bestOf(repeat, [&]
+                     {
+                         for (int i = 0; i < vectorCount; ++i)
+                         {
+                             expected[i] = referenceNormalize(vectors[i]);
+                         } });
+    printRow("normalize (checked)", vectorCount, ms, 0.0);
+    ms = bestOf(repeat, [&]
+                     {
+                         for (int i = 0; i < vectorCount; ++i)
+                         {
+                             normalized[i] = vectors[i].normalize();
+                         } });
+    printRow("normalize (Vector3)", vectorCount, ms, largestDifference(normalized));
+    ms = bestOf(repeat, [&]
+                     {
+                         for (int i = 0; i < vectorCount; ++i)
+                         {
+                             normalized[i] = normalize(Float3(vectors[i])).toVector3();
+                         } });
+    printRow("normalize (Float3)", vectorCount, ms, largestDifference(normalized));
+    std::vector<float> outX(vectorCount), outY(vectorCount), outZ(vectorCount);
+    ms = bestOf(repeat, [&]
+                     {
+                         for (int i = 0; i < vectorCount; i += 8)
+                         {
+                             normalize(Vec3x8::load(&xs[i], &ys[i], &zs[i])).store(&outX[i], &outY[i], &outZ[i]);
+                         } });
+    for (int i = 0; i < vectorCount; ++i)
+    {
+        normalized[i] = Vector3(outX[i], outY[i], outZ[i]);
+    }
+    printRow("normalize (Vec3x8)", vectorCount, ms, largestDifference(normalized));
+    return sink == -1 ? 1 : 0;
+}
@@ -0,0 +1,39 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+// Helpers shared by the benchmarks
+
+// Includes
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "timing.h" // Clock and millisecondsSince
+
+// Runs fn the given number of times and returns the fastest run in milliseconds
+template <typename Fn>
+double bestOf(int repeat, Fn &&fn)
+{
+    double best = 0.0;
+    for (int i = 0; i < repeat; ++i)
+    {
+        auto start = Clock::now();
+        fn();
+        double elapsed = millisecondsSince(start);
+        best = (i == 0) ? elapsed : std::min(best, elapsed);
+    }
+    return best;
+}
+
+// Root-mean-square difference of two HDR images, with colors clamped to [0, 1]
+inline double rmse(const std::vector<float> &a, const std::vector<float> &b)
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        double d = std::clamp(a[i], 0.0f, 1.0f) - std::clamp(b[i], 0.0f, 1.0f);
+        sum += d * d;
+    }
+    return std::sqrt(sum / a.size());
+}
+
+#endif // BENCH_UTIL_H
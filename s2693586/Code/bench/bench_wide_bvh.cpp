@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "bvh/bvh_node.h"
+#include "bvh/wide_bvh.h"
+#include "bench_util.h"
+
+// Compares the binary BVH with the 4-wide and 8-wide BVHs collapsed from it
+// A cube of random spheres is built into a binary BVH, which is then collapsed. The same random
+// rays, starting inside the cube, are traced through each tree. Rows report the build or collapse
+// time, the node count, the interior nodes visited, the boxes and objects tested and the depth
+// reached per ray, the rays traced per second, and the rays whose closest hit differs from the
+// binary tree's.
+
+// Counts the nodes of a binary tree
+static size_t countNodes(const BVHNode &node)
+{
+    return 1 + (node.left ? countNodes(*node.left) : 0) + (node.right ? countNodes(*node.right) : 0);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t count = 200000;
+    int rayCount = 500000;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--count" && i + 1 < argc)
+        {
+            count = std::max(1L, std::stol(argv[++i]));
+        }
+        else if (arg == "--rays" && i + 1 < argc)
+        {
+            rayCount = std::max(1, std::stoi(argv[++i]));
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--count <n>] [--rays <n>]" << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    // Spheres in a cube of side 100, sized to fill about 1% of it
+    const float halfSize = 50.0f;
+    const float radius = 0.3f * std::cbrt(8.0f * halfSize * halfSize * halfSize / count);
+    std::minstd_rand rng(1234);
+    std::uniform_real_distribution<float> coordinate(-halfSize, halfSize), unit(-1.0f, 1.0f);
+    Material material;
+    std::vector<std::shared_ptr<const Geometry>> objects(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        objects[i] = std::make_shared<const Sphere>(Vector3(coordinate(rng), coordinate(rng), coordinate(rng)), radius, material);
+    }
+
+    // Random rays through the cube
+    std::vector<Ray> rays;
+    for (int i = 0; i < rayCount; ++i)
+    {
+        Vector3 origin(coordinate(rng), coordinate(rng), coordinate(rng));
+        rays.emplace_back(origin, Vector3(unit(rng), unit(rng), unit(rng)).normalize());
+    }
+
+    std::cout << count << " spheres, " << rayCount << " rays" << std::endl;
+    std::cout << std::left << std::setw(8) << "width" << std::right << std::setw(12) << "build ms" << std::setw(10) << "nodes"
+              << std::setw(10) << "visits" << std::setw(10) << "boxes" << std::setw(10) << "objects" << std::setw(10)
+              << "depth" << std::setw(10) << "max" << std::setw(12) << "Mrays/s" << std::setw(10) << "speedup" << std::setw(8)
+              << "diff" << std::endl;
+
+    auto start = Clock::now();
+    std::unique_ptr<BVHNode> binary = BVHNode::build(objects);
+    double binaryMs = millisecondsSince(start);
+
+    std::vector<float> reference(rays.size());
+    double referenceMs = 0.0;
+    for (int width : {2, 4, 8})
+    {
+        start = Clock::now();
+        std::unique_ptr<WideBVH> wide = width > 2 ? WideBVH::collapse(*binary, width) : nullptr;
+        double buildMs = width > 2 ? millisecondsSince(start) : binaryMs;
+        size_t nodes = wide ? wide->nodeCount() : countNodes(*binary);
+        auto intersect = [&](const Ray &ray, Intersection &closest, TraversalStats *stats)
+        { return wide ? wide->intersect(ray, closest, stats) : binary->intersect(ray, closest, stats); };
+
+        // Untimed pass collecting the traversal work
+        TraversalStats stats;
+        size_t differences = 0;
+        for (size_t i = 0; i < rays.size(); ++i)
+        {
+            Intersection closest;
+            closest.distance = std::numeric_limits<float>::max();
+            intersect(rays[i], closest, &stats);
+            float distance = closest.hit ? closest.distance : -1.0f;
+            if (width == 2)
+            {
+                reference[i] = distance;
+            }
+            differences += distance != reference[i];
+        }
+
+        start = Clock::now();
+        for (const Ray &ray : rays)
+        {
+            Intersection closest;
+            closest.distance = std::numeric_limits<float>::max();
+            intersect(ray, closest, nullptr);
+        }
+        double raysMs = millisecondsSince(start);
+        if (width == 2)
+        {
+            referenceMs = raysMs;
+        }
+
+        double perRay = 1.0 / stats.rays;
+        std::cout << std::left << std::setw(8) << width << std::right << std::fixed << std::setprecision(1) << std::setw(12)
+                  << buildMs << std::setw(10) << nodes << std::setprecision(2) << std::setw(10) << stats.nodeVisits * perRay
+                  << std::setw(10) << stats.boxTests * perRay << std::setw(10) << stats.objectTests * perRay << std::setw(10)
+                  << stats.depthSum * perRay << std::setw(10) << stats.maxDepth << std::setw(12) << rays.size() / (raysMs * 1000.0)
+                  << std::setw(9) << referenceMs / raysMs << "x" << std::setw(8) << differences << std::endl;
+    }
+    std::cout << "Build ms is the binary build, or collapsing it; visits, boxes, objects and depth are per ray" << std::endl;
+    return 0;
+}
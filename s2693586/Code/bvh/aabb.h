@@ -3,6 +3,7 @@
 
 #include "../camera/vector3.h"
 #include "../camera/ray.h"
+#include "../camera/simd_math.h" // Branch-free slab test
 #include <limits>
 #include <cmath>
 
@@ -33,27 +34,49 @@ public:
         );
     }
 
+    // Returns the part of this box inside another box (empty if they do not overlap)
+    AABB intersection(const AABB &other) const {
+        return AABB(
+            Vector3(std::max(minBounds.x, other.minBounds.x), std::max(minBounds.y, other.minBounds.y), std::max(minBounds.z, other.minBounds.z)),
+            Vector3(std::min(maxBounds.x, other.maxBounds.x), std::min(maxBounds.y, other.maxBounds.y), std::min(maxBounds.z, other.maxBounds.z)));
+    }
+
+    // True if the box contains no point
+    bool empty() const {
+        return minBounds.x > maxBounds.x || minBounds.y > maxBounds.y || minBounds.z > maxBounds.z;
+    }
+
+    // Surface area of the box (0 for an empty box)
+    float surfaceArea() const {
+        Vector3 extent = maxBounds - minBounds;
+        if (extent.x < 0.0f || extent.y < 0.0f || extent.z < 0.0f) return 0.0f;
+        return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+    }
+
+    // Linearly interpolates between this box (t = 0) and another box (t = 1)
+    AABB interpolate(const AABB &end, float t) const {
+        return AABB(minBounds * (1.0f - t) + end.minBounds * t, maxBounds * (1.0f - t) + end.maxBounds * t);
+    }
+
     // Ray-AABB intersection
+    // The three slabs are tested together without branches, giving the same result as testing them one
+    // axis at a time and stopping at the first miss
     bool intersect(const Ray &ray, float &tMin, float &tMax) const {
         constexpr float epsilon = 1e-8f; // Small value to handle precision issues
-        tMin = 0.0f;
-        tMax = std::numeric_limits<float>::max();
-
-        for (int i = 0; i < 3; ++i) {
-            float invD = (std::fabs(ray.direction[i]) > epsilon) ? 1.0f / ray.direction[i] : std::numeric_limits<float>::infinity();
-            float t0 = (minBounds[i] - ray.origin[i]) * invD;
-            float t1 = (maxBounds[i] - ray.origin[i]) * invD;
-
-            if (invD < 0.0f) std::swap(t0, t1); // Ensure t0 is the near intersection, t1 is the far intersection
-            tMin = std::max(tMin, t0);           // Update the entry point
-            tMax = std::min(tMax, t1);           // Update the exit point
-
-            // Early exit if there's no intersection
-            if (tMax <= tMin + epsilon) {
-                return false;
-            }
-        }
-        return true;
+        const Float4 origin = Float3(ray.origin).v, direction = Float3(ray.direction).v;
+
+        // Directions near 0 along an axis get an infinite (positive) reciprocal
+        Float4 invD = select(abs(direction) > Float4(epsilon), Float4(1.0f) / direction, Float4(std::numeric_limits<float>::infinity()));
+        Float4 t0 = (Float3(minBounds).v - origin) * invD;
+        Float4 t1 = (Float3(maxBounds).v - origin) * invD;
+        Float4 negative = invD < Float4(0.0f);
+        Float4 entry = select(negative, t1, t0); // Near and far intersection per slab
+        Float4 exit = select(negative, t0, t1);
+
+        // A slab whose distances are NaN (0 times an infinite reciprocal) leaves the interval unchanged
+        tMin = max3(max(entry, Float4(0.0f)));
+        tMax = min3(min(exit, Float4(std::numeric_limits<float>::max())));
+        return tMax > tMin + epsilon;
     }
 };
 
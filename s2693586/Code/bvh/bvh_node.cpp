@@ -0,0 +1,326 @@
+#include "bvh_node.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include "shadow_cache.h" // Cached shadow occluders refer to objects in a hierarchy
+#include "wide_bvh.h"     // Wide hierarchy collapsed from a binary one
+
+using Clock = std::chrono::high_resolution_clock;
+
+// Build counters, updated with relaxed atomics since they are only read for reporting
+static std::atomic<uint64_t> nodesBuilt{0};
+static std::atomic<uint64_t> subtreesDeferred{0};
+static std::atomic<uint64_t> subtreesExpanded{0};
+static std::atomic<uint64_t> expansionsDiscarded{0};
+static std::atomic<uint64_t> buildNanoseconds{0};
+
+// Objects in a subtree worth deferring; smaller sets are built right away
+static constexpr size_t MIN_DEFERRED_OBJECTS = 16;
+
+// Defined here, where WideBVH is complete
+BVHNode::BVHNode() = default;
+
+// Every node that dies bumps the shadow cache epoch: its objects may be freed with it, and a later
+// hierarchy (of a Scene, a DynamicBVH or a direct build) may reuse its address
+BVHNode::~BVHNode()
+{
+    delete expansion.load(std::memory_order_acquire);
+    ShadowCache::invalidate();
+}
+
+void BVHNode::bound(const std::vector<std::shared_ptr<const Geometry>> &objects)
+{
+    // Compute the bounding boxes of all objects at the start and end of the frame
+    for (const auto &obj : objects)
+    {
+        boundingBox.expand(obj->boundingBox());
+        endBoundingBox.expand(obj->boundingBoxAt(1.0f));
+        moving = moving || obj->isMoving();
+    }
+}
+
+std::unique_ptr<BVHNode> BVHNode::defer(std::vector<std::shared_ptr<const Geometry>> objects, int depth, int lazyDepth)
+{
+    auto node = std::make_unique<BVHNode>();
+    node->bound(objects);
+    node->objects = std::move(objects);
+    node->deferredDepth = depth;
+    node->lazyDepth = lazyDepth;
+    subtreesDeferred.fetch_add(1, std::memory_order_relaxed);
+    return node;
+}
+
+const BVHNode *BVHNode::expand() const
+{
+    BVHNode *subtree = expansion.load(std::memory_order_acquire);
+    if (subtree)
+    {
+        return subtree;
+    }
+
+    auto start = Clock::now();
+    std::unique_ptr<BVHNode> built = build(objects, deferredDepth, lazyDepth);
+    buildNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count(),
+                               std::memory_order_relaxed);
+
+    // Publish the subtree unless another thread got there first
+    if (expansion.compare_exchange_strong(subtree, built.get(), std::memory_order_acq_rel, std::memory_order_acquire))
+    {
+        subtreesExpanded.fetch_add(1, std::memory_order_relaxed);
+        return built.release();
+    }
+    expansionsDiscarded.fetch_add(1, std::memory_order_relaxed);
+    return subtree;
+}
+
+void BVHNode::refit()
+{
+    boundingBox = endBoundingBox = AABB();
+    moving = false;
+    if (!left && !right)
+    {
+        bound(objects);
+        return;
+    }
+    for (const BVHNode *child : {left.get(), right.get()})
+    {
+        if (child)
+        {
+            boundingBox.expand(child->boundingBox);
+            endBoundingBox.expand(child->endBoundingBox);
+            moving = moving || child->moving;
+        }
+    }
+}
+
+BVHBuildStats BVHNode::buildStats()
+{
+    BVHBuildStats stats;
+    stats.nodes = nodesBuilt.load(std::memory_order_relaxed);
+    stats.deferred = subtreesDeferred.load(std::memory_order_relaxed);
+    stats.expanded = subtreesExpanded.load(std::memory_order_relaxed);
+    stats.discarded = expansionsDiscarded.load(std::memory_order_relaxed);
+    stats.buildMs = buildNanoseconds.load(std::memory_order_relaxed) / 1e6;
+    return stats;
+}
+
+void BVHNode::resetBuildStats()
+{
+    nodesBuilt = 0;
+    subtreesDeferred = 0;
+    subtreesExpanded = 0;
+    expansionsDiscarded = 0;
+    buildNanoseconds = 0;
+}
+
+// Builds the hierarchy recursively, splitting at the median centroid along the largest axis
+std::unique_ptr<BVHNode> BVHNode::build(std::vector<std::shared_ptr<const Geometry>> objects, int depth, int lazyDepth)
+{
+    auto start = Clock::now();
+    auto node = std::make_unique<BVHNode>();
+    nodesBuilt.fetch_add(1, std::memory_order_relaxed);
+    node->bound(objects);
+
+    // Base cases: leaf node if depth limit exceeded or not enough objects to split
+    static constexpr int MAX_LEAF_SIZE = 4;
+    if (depth > MAX_DEPTH || objects.size() <= MAX_LEAF_SIZE)
+    {
+        node->objects = objects;
+        return node;
+    }
+
+    // Calculate axis to split on based on the largest bounding box extent (at mid-frame for moving objects)
+    AABB splitBox = node->moving ? node->boundingBox.interpolate(node->endBoundingBox, 0.5f) : node->boundingBox;
+    Vector3 boundsSize = splitBox.maxBounds - splitBox.minBounds;
+    int splitAxis = (boundsSize.x > boundsSize.y) ? ((boundsSize.x > boundsSize.z) ? 0 : 2) : ((boundsSize.y > boundsSize.z) ? 1 : 2);
+
+    // Sort objects along the chosen axis based on their mid-frame centroids
+    auto centroidOf = [](const std::shared_ptr<const Geometry> &obj)
+    { return obj->centroid() + obj->motion * 0.5f; };
+    std::sort(objects.begin(), objects.end(), [&](const std::shared_ptr<const Geometry> &a, const std::shared_ptr<const Geometry> &b)
+              { return centroidOf(a)[splitAxis] < centroidOf(b)[splitAxis]; });
+
+    // Midpoint split along the sorted axis
+    size_t mid = objects.size() / 2;
+    float splitPosition = centroidOf(objects[mid])[splitAxis];
+
+    // Split objects into left and right lists, considering objects that span the split plane
+    std::vector<std::shared_ptr<const Geometry>> leftObjects;
+    std::vector<std::shared_ptr<const Geometry>> rightObjects;
+
+    for (const auto &obj : objects)
+    {
+        AABB objectBox = obj->boundingBoxAt(0.5f);
+        float minBound = objectBox.minBounds[splitAxis];
+        float maxBound = objectBox.maxBounds[splitAxis];
+
+        if (maxBound <= splitPosition)
+        {
+            // Fully in the left partition
+            leftObjects.push_back(obj);
+        }
+        else if (minBound >= splitPosition)
+        {
+            // Fully in the right partition
+            rightObjects.push_back(obj);
+        }
+        else
+        {
+            // Spans both partitions, assign based on heuristic (e.g., SAH or balancing)
+            if (leftObjects.size() <= rightObjects.size())
+            {
+                leftObjects.push_back(obj);
+            }
+            else
+            {
+                rightObjects.push_back(obj);
+            }
+        }
+    }
+
+    // Prevent infinite recursion by checking if split was effective
+    if (leftObjects.size() == objects.size() || rightObjects.size() == objects.size())
+    {
+        node->objects = objects; // Treat as a leaf node if splitting is ineffective
+        return node;
+    }
+
+    // Recursively build child nodes with increased depth, or defer them every lazyDepth levels
+    auto child = [&](std::vector<std::shared_ptr<const Geometry>> &childObjects)
+    {
+        bool deferred = lazyDepth > 0 && (depth + 1) % lazyDepth == 0 && childObjects.size() >= MIN_DEFERRED_OBJECTS;
+        return deferred ? defer(std::move(childObjects), depth + 1, lazyDepth) : build(std::move(childObjects), depth + 1, lazyDepth);
+    };
+    node->left = child(leftObjects);
+    node->right = child(rightObjects);
+
+    if (depth == 0)
+    {
+        buildNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count(),
+                                   std::memory_order_relaxed);
+    }
+    return node;
+}
+
+void BVHNode::widen(int width)
+{
+    wide = WideBVH::collapse(*this, width);
+    left.reset();
+    right.reset();
+    objects.clear();
+    objects.shrink_to_fit();
+}
+
+// Ray intersection method for the BVH
+template <typename Hit>
+bool BVHNode::intersectClosest(const Ray &ray, Hit &closest, TraversalStats *stats) const
+{
+    if (wide)
+    {
+        return wide->intersect(ray, closest, stats);
+    }
+    int deepest = 0;
+    bool hit = traverse(ray, closest, stats, 0, deepest);
+    if (stats)
+    {
+        ++stats->rays;
+        stats->depthSum += deepest;
+        stats->maxDepth = std::max(stats->maxDepth, deepest);
+    }
+    return hit;
+}
+
+template <typename Hit>
+bool BVHNode::traverse(const Ray &ray, Hit &closest, TraversalStats *stats, int depth, int &deepest) const
+{
+    float tMin = 0.0f, tMax = std::numeric_limits<float>::max();
+
+    // Step 1: Check for intersection with bounding box (at the ray's time for moving objects)
+    if (stats)
+    {
+        ++stats->boxTests;
+    }
+    if (!boundsAt(ray.time).intersect(ray, tMin, tMax))
+    {
+        return false; // No intersection with this node's bounding box
+    }
+    if (deferredDepth >= 0)
+    {
+        return expand()->traverse(ray, closest, stats, depth, deepest);
+    }
+    deepest = std::max(deepest, depth);
+
+    // Step 2: Leaf node - directly test stored objects for intersections
+    if (!left && !right)
+    {
+        if (stats)
+        {
+            stats->objectTests += objects.size();
+        }
+        bool hit = false;
+        for (const auto &obj : objects)
+        {
+            hit |= obj->intersectCloser(ray, closest); // Update to the closest intersection
+        }
+        return hit; // Return true if any object was hit in this leaf node
+    }
+
+    // Step 3: Non-leaf node - recursively check child nodes for intersection
+    if (stats)
+    {
+        ++stats->nodeVisits;
+    }
+    bool hitLeft = left && left->traverse(ray, closest, stats, depth + 1, deepest);
+    bool hitRight = right && right->traverse(ray, closest, stats, depth + 1, deepest);
+
+    // Return true if either child node was hit
+    return hitLeft || hitRight;
+}
+
+bool BVHNode::intersect(const Ray &ray, Intersection &closestIntersection, TraversalStats *stats) const
+{
+    return intersectClosest(ray, closestIntersection, stats);
+}
+
+bool BVHNode::intersect(const Ray &ray, VisibilityHit &closest, TraversalStats *stats) const
+{
+    return intersectClosest(ray, closest, stats);
+}
+
+bool BVHNode::intersectShadowRay(const Ray &ray, float maxDistance, const Geometry **occluder) const
+{
+    if (wide)
+    {
+        return wide->intersectShadowRay(ray, maxDistance, occluder);
+    }
+    float tMin = 0.0f, tMax = maxDistance;
+
+    if (!boundsAt(ray.time).intersect(ray, tMin, tMax))
+    {
+        return false;
+    }
+    if (deferredDepth >= 0)
+    {
+        return expand()->intersectShadowRay(ray, maxDistance, occluder);
+    }
+
+    if (!left && !right) // Leaf node
+    {
+        for (const auto &obj : objects)
+        {
+            if (obj->occludes(ray, maxDistance))
+            {
+                if (occluder)
+                {
+                    *occluder = obj.get();
+                }
+                return true; // Early exit for shadow
+            }
+        }
+        return false;
+    }
+
+    // Recursively check left and right with early exit
+    return (left && left->intersectShadowRay(ray, maxDistance, occluder)) ||
+           (right && right->intersectShadowRay(ray, maxDistance, occluder));
+}
@@ -1,170 +1,119 @@
 #ifndef BVH_NODE_H
 #define BVH_NODE_H
 
+#include <atomic>
+#include <cstdint>
 #include <vector>
 #include <memory>
-#include <algorithm>
-#include <iostream>
 #include "aabb.h"
 #include "../geometry/geometry.h"
 
+// Work done building BVH nodes, summed over all hierarchies and threads
+struct BVHBuildStats
+{
+    uint64_t nodes = 0;     // Nodes built, up front or when expanding deferred subtrees
+    uint64_t deferred = 0;  // Subtrees left unbuilt until a ray reaches them
+    uint64_t expanded = 0;  // Deferred subtrees built on first use
+    uint64_t discarded = 0; // Expansions thrown away because another thread published the subtree first
+    double buildMs = 0.0;   // Time spent building, summed over the threads that built
+};
+
+// Work done by traversals given a TraversalStats, summed over their rays
+struct TraversalStats
+{
+    uint64_t rays = 0;        // Closest-hit rays traced
+    uint64_t nodeVisits = 0;  // Interior nodes whose children were tested
+    uint64_t boxTests = 0;    // Ray-box tests, counting each child of a wide node
+    uint64_t objectTests = 0; // Ray-object tests in leaves
+    uint64_t depthSum = 0;    // Depth of the deepest node each ray reached, summed over the rays
+    int maxDepth = 0;         // Deepest node reached by any ray
+};
+
+class WideBVH;
+
 class BVHNode
 {
 public:
-    AABB boundingBox;
+    AABB boundingBox;    // Bounds of the objects at time 0
+    AABB endBoundingBox; // Bounds of the objects at time 1, interpolated for rays in between
+    bool moving = false; // True if any object below this node moves
     std::unique_ptr<BVHNode> left;
     std::unique_ptr<BVHNode> right;
     std::vector<std::shared_ptr<const Geometry>> objects;
 
-    BVHNode() = default;
+    BVHNode();
+    ~BVHNode();
 
     // Depth limit to prevent infinite recursion
     static const int MAX_DEPTH = 20;
 
-    static std::unique_ptr<BVHNode> build(std::vector<std::shared_ptr<const Geometry>> objects, int depth = 0)
-    {
-        auto node = std::make_unique<BVHNode>();
-
-        // Base cases: leaf node if depth limit exceeded or not enough objects to split
-        static constexpr int MAX_LEAF_SIZE = 4;
-        if (depth > MAX_DEPTH || objects.size() <= MAX_LEAF_SIZE)
-        {
-            node->objects = objects;
-            for (const auto &obj : objects)
-            {
-                node->boundingBox.expand(obj->boundingBox());
-            }
-            return node;
-        }
-        
-        // Compute bounding box for all objects
-        AABB combinedBox;
-        for (const auto &obj : objects)
-        {
-            combinedBox.expand(obj->boundingBox());
-        }
-        node->boundingBox = combinedBox;
-
-        // Calculate axis to split on based on the largest bounding box extent
-        Vector3 boundsSize = node->boundingBox.maxBounds - node->boundingBox.minBounds;
-        int splitAxis = (boundsSize.x > boundsSize.y) ? ((boundsSize.x > boundsSize.z) ? 0 : 2) : ((boundsSize.y > boundsSize.z) ? 1 : 2);
-
-        // Sort objects along the chosen axis based on their centroids
-        std::sort(objects.begin(), objects.end(), [splitAxis](const std::shared_ptr<const Geometry> &a, const std::shared_ptr<const Geometry> &b)
-                  { return a->centroid()[splitAxis] < b->centroid()[splitAxis]; });
-
-        // Midpoint split along the sorted axis
-        size_t mid = objects.size() / 2;
-        float splitPosition = objects[mid]->centroid()[splitAxis];
-
-        // Split objects into left and right lists, considering objects that span the split plane
-        std::vector<std::shared_ptr<const Geometry>> leftObjects;
-        std::vector<std::shared_ptr<const Geometry>> rightObjects;
-
-        for (const auto &obj : objects)
-        {
-            float minBound = obj->boundingBox().minBounds[splitAxis];
-            float maxBound = obj->boundingBox().maxBounds[splitAxis];
-
-            if (maxBound <= splitPosition)
-            {
-                // Fully in the left partition
-                leftObjects.push_back(obj);
-            }
-            else if (minBound >= splitPosition)
-            {
-                // Fully in the right partition
-                rightObjects.push_back(obj);
-            }
-            else
-            {
-                // Spans both partitions, assign based on heuristic (e.g., SAH or balancing)
-                if (leftObjects.size() <= rightObjects.size())
-                {
-                    leftObjects.push_back(obj);
-                }
-                else
-                {
-                    rightObjects.push_back(obj);
-                }
-            }
-        }
-
-        // Prevent infinite recursion by checking if split was effective
-        if (leftObjects.size() == objects.size() || rightObjects.size() == objects.size())
-        {
-            node->objects = objects; // Treat as a leaf node if splitting is ineffective
-            return node;
-        }
-
-        // Recursively build child nodes with increased depth
-        node->left = build(leftObjects, depth + 1);
-        node->right = build(rightObjects, depth + 1);
-
-        return node;
-    }
+    // Builds a BVH over the given objects, splitting along the largest axis of their bounds
+    // Moving objects are bounded at the start and end of the frame and split by their mid-frame position
+    // Parameters:
+    // - objects: Geometry to place in the hierarchy
+    // - depth: Current depth of the node being built
+    // - lazyDepth: When above 0, subtrees rooted every lazyDepth levels are deferred: only their bounds
+    //   are computed, and the rest is built the first time a ray enters them
+    // Returns: The root node of the (sub)tree
+    static std::unique_ptr<BVHNode> build(std::vector<std::shared_ptr<const Geometry>> objects, int depth = 0, int lazyDepth = 0);
+
+    // Recomputes the node's bounds from its objects, or from its children's bounds for interior nodes
+    // Refitting a hierarchy bottom-up after its objects moved keeps it valid without restructuring it
+    void refit();
+
+    // Counters of the nodes built so far, and of deferred subtrees and their expansion
+    static BVHBuildStats buildStats();
+    static void resetBuildStats();
+
+    // Replaces the hierarchy below this (fully built) node with a wide BVH collapsed from it
+    // Rays are then traced through the wide nodes, which test all their children's boxes at once
+    // Parameters:
+    // - width: Children per wide node, 4 or 8
+    void widen(int width);
 
     // Ray intersection method for the BVH
-    bool intersect(const Ray &ray, Intersection &closestIntersection) const
-    {
-        float tMin = 0.0f, tMax = std::numeric_limits<float>::max();
-
-        // Step 1: Check for intersection with bounding box
-        if (!boundingBox.intersect(ray, tMin, tMax))
-        {
-            return false; // No intersection with this node's bounding box
-        }
-
-        // Step 2: Leaf node - directly test stored objects for intersections
-        if (!left && !right)
-        {
-            bool hit = false;
-            for (const auto &obj : objects)
-            {
-                Intersection tempIntersection = obj->intersect(ray);
-                if (tempIntersection.hit && tempIntersection.distance < closestIntersection.distance)
-                {
-                    closestIntersection = tempIntersection; // Update to the closest intersection
-                    hit = true;
-                }
-            }
-            return hit; // Return true if any object was hit in this leaf node
-        }
-
-        // Step 3: Non-leaf node - recursively check child nodes for intersection
-        bool hitLeft = left && left->intersect(ray, closestIntersection);
-        bool hitRight = right && right->intersect(ray, closestIntersection);
-
-        // Return true if either child node was hit
-        return hitLeft || hitRight;
-    }
-
-    bool intersectShadowRay(const Ray &ray, float maxDistance) const
-    {
-        float tMin = 0.0f, tMax = maxDistance;
-
-        if (!boundingBox.intersect(ray, tMin, tMax))
-        {
-            return false;
-        }
-
-        if (!left && !right) // Leaf node
-        {
-            for (const auto &obj : objects)
-            {
-                Intersection tempIntersection = obj->intersect(ray);
-                if (tempIntersection.hit && tempIntersection.distance < maxDistance)
-                {
-                    return true; // Early exit for shadow
-                }
-            }
-            return false;
-        }
-
-        // Recursively check left and right with early exit
-        return (left && left->intersectShadowRay(ray, maxDistance)) ||
-               (right && right->intersectShadowRay(ray, maxDistance));
-    }
+    // Updates closestIntersection when a closer hit is found and returns true if any object was hit
+    // Adds the traversal's work to stats when it is not nullptr
+    bool intersect(const Ray &ray, Intersection &closestIntersection, TraversalStats *stats = nullptr) const;
+
+    // Closest-hit traversal for visibility outputs, which records only the distance and what was hit
+    // Updates closest when a hit closer than it is found and returns true if any was
+    bool intersect(const Ray &ray, VisibilityHit &closest, TraversalStats *stats = nullptr) const;
+
+    // Returns true if any object blocks the ray before maxDistance
+    // Parameters:
+    // - ray: The shadow ray
+    // - maxDistance: Distance to the light
+    // - occluder: Receives the blocking object when not nullptr
+    bool intersectShadowRay(const Ray &ray, float maxDistance, const Geometry **occluder = nullptr) const;
+
+private:
+    int deferredDepth = -1; // Depth of a deferred subtree (which keeps its objects until expanded); -1 when built
+    int lazyDepth = 0;      // Deferral interval passed on when the subtree is expanded
+    mutable std::atomic<BVHNode *> expansion{nullptr}; // Subtree built from a deferred node, published once
+    std::unique_ptr<const WideBVH> wide;               // Wide hierarchy replacing the children, set by widen()
+
+    // Creates a deferred node holding the objects and their bounds
+    static std::unique_ptr<BVHNode> defer(std::vector<std::shared_ptr<const Geometry>> objects, int depth, int lazyDepth);
+
+    // Returns the subtree of a deferred node, building it if no thread has yet
+    // Threads racing on the same node each build a copy; the first to publish it wins and the others
+    // discard theirs, so traversal never waits on a lock
+    const BVHNode *expand() const;
+
+    // Expands the node's bounds to cover the objects
+    void bound(const std::vector<std::shared_ptr<const Geometry>> &objects);
+
+    // Closest-hit traversal (of either kind) starting at the root
+    template <typename Hit>
+    bool intersectClosest(const Ray &ray, Hit &closest, TraversalStats *stats) const;
+
+    // Closest-hit traversal of the subtree at the given depth, recording the deepest node reached
+    template <typename Hit>
+    bool traverse(const Ray &ray, Hit &closest, TraversalStats *stats, int depth, int &deepest) const;
+
+    // Returns the node bounds at the ray's time
+    AABB boundsAt(float time) const { return moving ? boundingBox.interpolate(endBoundingBox, time) : boundingBox; }
 };
 
 
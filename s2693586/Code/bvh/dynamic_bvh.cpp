@@ -0,0 +1,212 @@
+#include "dynamic_bvh.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include "shadow_cache.h" // Cached occluders may be replaced objects
+
+using Clock = std::chrono::high_resolution_clock;
+
+// SAH weights of visiting an interior node and of testing one object
+static constexpr double TRAVERSAL_COST = 1.0;
+static constexpr double INTERSECTION_COST = 1.0;
+
+// Surface area a node's box sweeps over the frame
+static double sweptArea(const BVHNode &node)
+{
+    AABB box = node.boundingBox;
+    if (node.moving)
+    {
+        box.expand(node.endBoundingBox);
+    }
+    return box.surfaceArea();
+}
+
+// SAH cost of a node on its own, without its children
+static double nodeCost(const BVHNode &node)
+{
+    bool leaf = !node.left && !node.right;
+    return sweptArea(node) * (leaf ? INTERSECTION_COST * node.objects.size() : TRAVERSAL_COST);
+}
+
+DynamicBVH::DynamicBVH(std::vector<std::shared_ptr<const Geometry>> objects, float rebuildThreshold)
+    : objects(std::move(objects)), rebuildThreshold(rebuildThreshold)
+{
+    for (size_t i = 0; i < this->objects.size(); ++i)
+    {
+        indexOf[this->objects[i].get()] = i;
+    }
+    rebuild();
+}
+
+void DynamicBVH::rebuild()
+{
+    nodes.clear();
+    slots.assign(objects.size(), Slot());
+    pending.clear();
+    rootNode = BVHNode::build(objects);
+    index(rootNode.get(), nullptr, 0);
+}
+
+double DynamicBVH::index(BVHNode *node, BVHNode *parent, int depth)
+{
+    NodeInfo &info = nodes[node];
+    info.parent = parent;
+    info.depth = depth;
+    double cost = nodeCost(*node);
+    if (!node->left && !node->right)
+    {
+        for (size_t i = 0; i < node->objects.size(); ++i)
+        {
+            slots[indexOf.at(node->objects[i].get())] = Slot{node, i};
+        }
+    }
+    for (BVHNode *child : {node->left.get(), node->right.get()})
+    {
+        if (child)
+        {
+            cost += index(child, node, depth + 1);
+        }
+    }
+    info.builtCost = info.cost = cost; // References into the map survive rehashing
+    info.builtArea = sweptArea(*node);
+    return cost;
+}
+
+void DynamicBVH::update(size_t index, std::shared_ptr<const Geometry> object)
+{
+    if (index >= objects.size() || !object)
+    {
+        std::cerr << "Invalid DynamicBVH update of object " << index << std::endl;
+        throw std::out_of_range("DynamicBVH object index out of range");
+    }
+    indexOf.erase(objects[index].get());
+    indexOf[object.get()] = index;
+    const Slot &slot = slots[index];
+    slot.leaf->objects[slot.position] = object;
+    objects[index] = std::move(object);
+    pending.push_back(index);
+}
+
+double DynamicBVH::refit(BVHNode *node, size_t &refitNodes)
+{
+    NodeInfo &info = nodes.at(node);
+    if (!info.dirty)
+    {
+        return info.cost;
+    }
+    double cost = 0.0;
+    for (BVHNode *child : {node->left.get(), node->right.get()})
+    {
+        if (child)
+        {
+            cost += refit(child, refitNodes);
+        }
+    }
+    node->refit();
+    ++refitNodes;
+    info.cost = cost + nodeCost(*node);
+    return info.cost;
+}
+
+void DynamicBVH::forget(const BVHNode *node, std::vector<std::shared_ptr<const Geometry>> &subtreeObjects)
+{
+    nodes.erase(node);
+    if (!node->left && !node->right)
+    {
+        subtreeObjects.insert(subtreeObjects.end(), node->objects.begin(), node->objects.end());
+    }
+    for (const BVHNode *child : {node->left.get(), node->right.get()})
+    {
+        if (child)
+        {
+            forget(child, subtreeObjects);
+        }
+    }
+}
+
+double DynamicBVH::rebuildDegraded(std::unique_ptr<BVHNode> &node, BVHUpdateStats &stats)
+{
+    NodeInfo &info = nodes.at(node.get());
+    if (!info.dirty)
+    {
+        return info.cost;
+    }
+    info.dirty = false;
+
+    // A child whose box outgrew its build has objects that now belong elsewhere under this node
+    bool childEscaped = false;
+    for (const BVHNode *child : {node->left.get(), node->right.get()})
+    {
+        if (child)
+        {
+            const NodeInfo &childInfo = nodes.at(child);
+            childEscaped = childEscaped || (childInfo.dirty && sweptArea(*child) > rebuildThreshold * childInfo.builtArea);
+        }
+    }
+    if (!childEscaped && info.cost <= rebuildThreshold * info.builtCost)
+    {
+        // Still good enough; its cost follows from the children, some of which may be rebuilt
+        double cost = nodeCost(*node);
+        for (std::unique_ptr<BVHNode> *child : {&node->left, &node->right})
+        {
+            if (*child)
+            {
+                cost += rebuildDegraded(*child, stats);
+            }
+        }
+        info.cost = cost;
+        return cost;
+    }
+
+    // Replace the subtree with a fresh build over its objects, at the same depth
+    // Its bounds are those of its objects either way, so the ancestors' boxes stay valid
+    BVHNode *parent = info.parent;
+    int depth = info.depth;
+    std::vector<std::shared_ptr<const Geometry>> subtreeObjects;
+    forget(node.get(), subtreeObjects);
+    stats.rebuiltObjects += subtreeObjects.size();
+    ++stats.rebuiltSubtrees;
+    stats.fullRebuild = stats.fullRebuild || parent == nullptr;
+    node = BVHNode::build(std::move(subtreeObjects), depth);
+    return index(node.get(), parent, depth);
+}
+
+BVHUpdateStats DynamicBVH::commit()
+{
+    auto start = Clock::now();
+    BVHUpdateStats stats;
+    stats.moved = pending.size();
+
+    // Mark the paths from the replaced objects to the root
+    for (size_t i : pending)
+    {
+        for (BVHNode *node = slots[i].leaf; node; )
+        {
+            NodeInfo &info = nodes.at(node);
+            if (info.dirty)
+            {
+                break; // The rest of the path is already marked
+            }
+            info.dirty = true;
+            node = info.parent;
+        }
+    }
+    pending.clear();
+
+    if (stats.moved > 0)
+    {
+        refit(rootNode.get(), stats.refitNodes);
+        rebuildDegraded(rootNode, stats);
+        ShadowCache::invalidate(); // Replaced objects may be freed without any node being destroyed
+    }
+    stats.sahCost = sahCost();
+    stats.updateMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    return stats;
+}
+
+double DynamicBVH::sahCost() const
+{
+    double rootArea = sweptArea(*rootNode);
+    return rootArea > 0.0 ? nodes.at(rootNode.get()).cost / rootArea : 0.0;
+}
@@ -0,0 +1,104 @@
+#ifndef DYNAMIC_BVH_H
+#define DYNAMIC_BVH_H
+
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "bvh_node.h"
+
+// Work done by one DynamicBVH::commit
+struct BVHUpdateStats
+{
+    size_t moved = 0;           // Objects replaced since the previous commit
+    size_t refitNodes = 0;      // Nodes whose bounds were recomputed
+    size_t rebuiltSubtrees = 0; // Subtrees rebuilt because their SAH cost degraded
+    size_t rebuiltObjects = 0;  // Objects in the rebuilt subtrees
+    bool fullRebuild = false;   // The whole tree was rebuilt
+    double sahCost = 0.0;       // SAH cost of the tree after the update
+    double updateMs = 0.0;      // Time taken by the commit
+};
+
+// A BVH whose objects can be replaced between frames
+// Objects are addressed by their index in the list the tree was built from. Replacing some of them
+// only recomputes the bounds on the paths from their leaves to the root, so the tree keeps its
+// structure and an update costs time in proportion to the moved objects, not the scene. Refitting
+// lets the tree's quality drift as objects move apart, so every node remembers its SAH cost (the
+// summed surface area of the boxes below it, weighted by their traversal and intersection work)
+// from when it was built. A subtree whose cost has grown past the threshold is rebuilt from its
+// objects. An object that moved far stretches the boxes of all its ancestors, which rebuilding
+// below them cannot shrink; so once a node's own box has grown past the threshold, its parent is
+// rebuilt instead, regrouping the objects with their new neighbours. When that is the root, the whole
+// tree is rebuilt. The tree is always built without deferred subtrees.
+class DynamicBVH
+{
+public:
+    // Builds the hierarchy
+    // Parameters:
+    // - objects: Geometry to place in the hierarchy
+    // - rebuildThreshold: Cost ratio (current over built) above which a subtree is rebuilt
+    explicit DynamicBVH(std::vector<std::shared_ptr<const Geometry>> objects, float rebuildThreshold = 1.5f);
+
+    const BVHNode &root() const { return *rootNode; }
+
+    size_t size() const { return objects.size(); }
+    const std::shared_ptr<const Geometry> &object(size_t index) const { return objects[index]; }
+
+    // Replaces an object, e.g. with a moved copy; the tree is brought up to date by commit()
+    void update(size_t index, std::shared_ptr<const Geometry> object);
+
+    // Refits the bounds above every object replaced since the last commit and rebuilds the
+    // subtrees whose cost degraded past the threshold
+    // Shadow occluder caches are invalidated, as they may refer to replaced objects
+    BVHUpdateStats commit();
+
+    // Rebuilds the whole hierarchy from the current objects
+    void rebuild();
+
+    // SAH cost of the whole tree, relative to the root's surface area
+    // This is the expected number of node visits and object tests of a ray crossing the root's box
+    double sahCost() const;
+
+private:
+    // Bookkeeping of a node
+    struct NodeInfo
+    {
+        BVHNode *parent = nullptr;
+        int depth = 0;
+        double builtCost = 0.0; // Unnormalised SAH cost of the subtree when it was built
+        double builtArea = 0.0; // Surface area of the node's box when it was built
+        double cost = 0.0;      // The same after the latest refit
+        bool dirty = false;     // Contains an object replaced since the last commit
+    };
+
+    // Where an object sits in the tree
+    struct Slot
+    {
+        BVHNode *leaf = nullptr;
+        size_t position = 0; // Index in the leaf's objects
+    };
+
+    std::vector<std::shared_ptr<const Geometry>> objects;
+    std::unordered_map<const Geometry *, size_t> indexOf; // Object index of each geometry in the tree
+    std::unique_ptr<BVHNode> rootNode;
+    std::unordered_map<const BVHNode *, NodeInfo> nodes;
+    std::vector<Slot> slots;
+    std::vector<size_t> pending; // Objects replaced since the last commit
+    float rebuildThreshold;
+
+    // Records the nodes, object slots and costs of a (newly built) subtree
+    // Returns: The subtree's SAH cost
+    double index(BVHNode *node, BVHNode *parent, int depth);
+
+    // Recomputes the bounds and cost of the dirty nodes below node, bottom-up
+    double refit(BVHNode *node, size_t &refitNodes);
+
+    // Rebuilds the topmost degraded subtrees among the dirty nodes below node and clears their marks
+    // Returns: The subtree's SAH cost afterwards
+    double rebuildDegraded(std::unique_ptr<BVHNode> &node, BVHUpdateStats &stats);
+
+    // Forgets the bookkeeping of a subtree about to be replaced
+    void forget(const BVHNode *node, std::vector<std::shared_ptr<const Geometry>> &subtreeObjects);
+};
+
+#endif // DYNAMIC_BVH_H
@@ -0,0 +1,373 @@
+#include "linear_bvh.h"
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "../timing.h" // Clock and millisecondsSince
+
+// Ranges of at most this many objects become leaves, as in BVHNode::build
+static constexpr uint32_t MAX_LEAF_SIZE = 4;
+
+// Largest treelet: finding its best topology takes 3^n steps
+static constexpr int MAX_TREELET_LEAVES = 8;
+
+namespace
+{
+    // Spreads the low 21 bits of value so that two zero bits follow each (bit i moves to bit 3i)
+    uint64_t spreadBits(uint64_t value)
+    {
+        value &= 0x1fffff;
+        value = (value | value << 32) & 0x1f00000000ffffull;
+        value = (value | value << 16) & 0x1f0000ff0000ffull;
+        value = (value | value << 8) & 0x100f00f00f00f00full;
+        value = (value | value << 4) & 0x10c30c30c30c30c3ull;
+        value = (value | value << 2) & 0x1249249249249249ull;
+        return value;
+    }
+
+    // Sorts the codes, carrying the object indices along, with a stable radix sort of 8-bit digits
+    // In each pass every thread counts the digits of its share of the codes, then scatters its share
+    // after those of the threads before it, so the passes need no locks
+    void radixSort(std::vector<uint64_t> &codes, std::vector<uint32_t> &indices, int bits, int &threads)
+    {
+        const size_t count = codes.size();
+        std::vector<uint64_t> sortedCodes(count);
+        std::vector<uint32_t> sortedIndices(count);
+        std::vector<size_t> offsets;
+        for (int shift = 0; shift < bits; shift += 8)
+        {
+#pragma omp parallel
+            {
+                int thread = 0, threadCount = 1;
+#ifdef _OPENMP
+                thread = omp_get_thread_num();
+                threadCount = omp_get_num_threads();
+#endif
+#pragma omp single
+                {
+                    offsets.assign(static_cast<size_t>(threadCount) * 256, 0);
+                    threads = threadCount;
+                }
+                size_t begin = count * thread / threadCount, end = count * (thread + 1) / threadCount;
+                size_t *digitOffsets = &offsets[static_cast<size_t>(thread) * 256];
+                for (size_t i = begin; i < end; ++i)
+                {
+                    ++digitOffsets[(codes[i] >> shift) & 255];
+                }
+#pragma omp barrier
+#pragma omp single
+                {
+                    size_t total = 0;
+                    for (int digit = 0; digit < 256; ++digit)
+                    {
+                        for (int t = 0; t < threadCount; ++t)
+                        {
+                            size_t digitCount = offsets[static_cast<size_t>(t) * 256 + digit];
+                            offsets[static_cast<size_t>(t) * 256 + digit] = total;
+                            total += digitCount;
+                        }
+                    }
+                }
+                for (size_t i = begin; i < end; ++i)
+                {
+                    size_t &offset = digitOffsets[(codes[i] >> shift) & 255];
+                    sortedCodes[offset] = codes[i];
+                    sortedIndices[offset] = indices[i];
+                    ++offset;
+                }
+            }
+            codes.swap(sortedCodes);
+            indices.swap(sortedIndices);
+        }
+    }
+
+    // Interior node found from the sorted codes: its children, each an interior node index or the
+    // bitwise complement of an object's position in sorted order, and its range of sorted objects
+    struct InternalNode
+    {
+        int32_t left, right;
+        uint32_t first, last;
+    };
+
+    // Length of the common prefix of the codes at positions i and j, or -1 outside the codes
+    // Equal codes are told apart by their positions
+    inline int commonPrefix(const std::vector<uint64_t> &codes, int64_t i, int64_t j)
+    {
+        if (j < 0 || j >= static_cast<int64_t>(codes.size()))
+        {
+            return -1;
+        }
+        uint64_t difference = codes[i] ^ codes[j];
+        return difference != 0 ? __builtin_clzll(difference) : 64 + __builtin_clzll(static_cast<uint64_t>(i ^ j));
+    }
+
+    // Finds interior node i of the hierarchy over the sorted codes (Karras 2012)
+    InternalNode findInternalNode(const std::vector<uint64_t> &codes, int64_t i)
+    {
+        // Direction of the node's range from i, and the prefix its sibling shares with it
+        int direction = commonPrefix(codes, i, i + 1) > commonPrefix(codes, i, i - 1) ? 1 : -1;
+        int siblingPrefix = commonPrefix(codes, i, i - direction);
+
+        // Find the other end of the range, longer prefixes first by doubling then by bisection
+        int64_t maxLength = 2;
+        while (commonPrefix(codes, i, i + maxLength * direction) > siblingPrefix)
+        {
+            maxLength *= 2;
+        }
+        int64_t length = 0;
+        for (int64_t step = maxLength / 2; step >= 1; step /= 2)
+        {
+            if (commonPrefix(codes, i, i + (length + step) * direction) > siblingPrefix)
+            {
+                length += step;
+            }
+        }
+        int64_t j = i + length * direction;
+
+        // Split where the range's shared prefix ends
+        int nodePrefix = commonPrefix(codes, i, j);
+        int64_t split = 0;
+        int64_t step = length;
+        do
+        {
+            step = (step + 1) >> 1;
+            if (commonPrefix(codes, i, i + (split + step) * direction) > nodePrefix)
+            {
+                split += step;
+            }
+        } while (step > 1);
+        int64_t gamma = i + split * direction + std::min(direction, 0);
+
+        InternalNode node;
+        node.first = static_cast<uint32_t>(std::min(i, j));
+        node.last = static_cast<uint32_t>(std::max(i, j));
+        node.left = node.first == gamma ? ~static_cast<int32_t>(gamma) : static_cast<int32_t>(gamma);
+        node.right = node.last == gamma + 1 ? ~static_cast<int32_t>(gamma + 1) : static_cast<int32_t>(gamma + 1);
+        return node;
+    }
+
+    // Creates the BVHNode subtree for a reference to an interior node or a single object
+    std::unique_ptr<BVHNode> emit(int32_t reference, const std::vector<InternalNode> &internalNodes, const std::vector<uint32_t> &order,
+                                  const std::vector<std::shared_ptr<const Geometry>> &objects, uint64_t &nodeCount)
+    {
+        uint32_t first = reference < 0 ? ~reference : internalNodes[reference].first;
+        uint32_t last = reference < 0 ? ~reference : internalNodes[reference].last;
+        auto node = std::make_unique<BVHNode>();
+        ++nodeCount;
+        if (last - first + 1 <= MAX_LEAF_SIZE)
+        {
+            for (uint32_t k = first; k <= last; ++k)
+            {
+                node->objects.push_back(objects[order[k]]);
+            }
+        }
+        else
+        {
+            node->left = emit(internalNodes[reference].left, internalNodes, order, objects, nodeCount);
+            node->right = emit(internalNodes[reference].right, internalNodes, order, objects, nodeCount);
+        }
+        node->refit();
+        return node;
+    }
+
+    // Box a node covers over the frame
+    AABB sweptBox(const BVHNode &node)
+    {
+        AABB box = node.boundingBox;
+        if (node.moving)
+        {
+            box.expand(node.endBoundingBox);
+        }
+        return box;
+    }
+
+    // Rebuilds the interior nodes of a treelet below target, joining the subtrees in subset as the
+    // splits found for each subset direct
+    void joinTreelet(BVHNode &target, unsigned subset, std::unique_ptr<BVHNode> *subtrees, const unsigned *splits)
+    {
+        unsigned parts[2] = {splits[subset], subset ^ splits[subset]};
+        std::unique_ptr<BVHNode> *children[2] = {&target.left, &target.right};
+        for (int k = 0; k < 2; ++k)
+        {
+            if ((parts[k] & (parts[k] - 1)) == 0)
+            {
+                *children[k] = std::move(subtrees[__builtin_ctz(parts[k])]);
+            }
+            else
+            {
+                *children[k] = std::make_unique<BVHNode>();
+                joinTreelet(**children[k], parts[k], subtrees, splits);
+            }
+        }
+        target.refit();
+    }
+
+    // Optimises the treelets below node, then the one rooted at node
+    void optimizeTreelet(BVHNode &node, int treeletLeaves)
+    {
+        if (!node.left || !node.right)
+        {
+            return;
+        }
+        optimizeTreelet(*node.left, treeletLeaves);
+        optimizeTreelet(*node.right, treeletLeaves);
+
+        // Open the interior subtree with the largest area until the treelet is full
+        std::unique_ptr<BVHNode> subtrees[MAX_TREELET_LEAVES];
+        int count = 0;
+        subtrees[count++] = std::move(node.left);
+        subtrees[count++] = std::move(node.right);
+        while (count < treeletLeaves)
+        {
+            int best = -1;
+            float bestArea = -1.0f;
+            for (int i = 0; i < count; ++i)
+            {
+                float area = sweptBox(*subtrees[i]).surfaceArea();
+                if (subtrees[i]->left && subtrees[i]->right && area > bestArea)
+                {
+                    best = i;
+                    bestArea = area;
+                }
+            }
+            if (best < 0)
+            {
+                break; // Only leaves left
+            }
+            std::unique_ptr<BVHNode> opened = std::move(subtrees[best]);
+            subtrees[best] = std::move(opened->left);
+            subtrees[count++] = std::move(opened->right);
+        }
+
+        // Lowest total area of the interior nodes joining each subset of the subtrees; the subtrees
+        // themselves cost the same in any arrangement. Each subset's parts are smaller subsets, which
+        // come earlier in numeric order.
+        const unsigned full = (1u << count) - 1;
+        AABB boxes[1 << MAX_TREELET_LEAVES];
+        float costs[1 << MAX_TREELET_LEAVES];
+        unsigned splits[1 << MAX_TREELET_LEAVES];
+        for (unsigned subset = 1; subset <= full; ++subset)
+        {
+            unsigned lowest = subset & (0u - subset);
+            if (subset == lowest)
+            {
+                boxes[subset] = sweptBox(*subtrees[__builtin_ctz(subset)]);
+                costs[subset] = 0.0f;
+                continue;
+            }
+            boxes[subset] = boxes[subset ^ lowest];
+            boxes[subset].expand(boxes[lowest]);
+            float bestCost = std::numeric_limits<float>::max();
+            for (unsigned part = (subset - 1) & subset; part > 0; part = (part - 1) & subset)
+            {
+                float cost = costs[part] + costs[subset ^ part];
+                if ((part & lowest) && cost < bestCost)
+                {
+                    bestCost = cost;
+                    splits[subset] = part;
+                }
+            }
+            costs[subset] = boxes[subset].surfaceArea() + bestCost;
+        }
+        joinTreelet(node, full, subtrees, splits);
+    }
+}
+
+std::unique_ptr<BVHNode> LinearBVH::build(const std::vector<std::shared_ptr<const Geometry>> &objects, int mortonBits, int treeletLeaves,
+                                          LinearBVHStats *stats)
+{
+    if (mortonBits != 30 && mortonBits != 63)
+    {
+        std::cerr << "Invalid Morton code length: " << mortonBits << " (expected 30 or 63 bits)" << std::endl;
+        throw std::invalid_argument("Invalid Morton code length.");
+    }
+    if (treeletLeaves < 0 || treeletLeaves > MAX_TREELET_LEAVES)
+    {
+        std::cerr << "Invalid treelet size: " << treeletLeaves << " (expected at most " << MAX_TREELET_LEAVES << " leaves)" << std::endl;
+        throw std::invalid_argument("Invalid treelet size.");
+    }
+    auto start = Clock::now();
+    LinearBVHStats buildStats;
+    buildStats.objects = objects.size();
+    const int64_t count = static_cast<int64_t>(objects.size());
+
+    // Morton codes of the mid-frame centroids, quantized within their bounds
+    auto step = Clock::now();
+    std::vector<Vector3> centroids(count);
+    AABB centroidBounds;
+    for (int64_t i = 0; i < count; ++i)
+    {
+        centroids[i] = objects[i]->centroid() + objects[i]->motion * 0.5f;
+        centroidBounds.expand(AABB(centroids[i], centroids[i]));
+    }
+    const int axisBits = mortonBits / 3;
+    const float cells = static_cast<float>(1u << axisBits);
+    Vector3 extent = centroidBounds.maxBounds - centroidBounds.minBounds;
+    Vector3 scale(extent.x > 0.0f ? cells / extent.x : 0.0f, extent.y > 0.0f ? cells / extent.y : 0.0f,
+                  extent.z > 0.0f ? cells / extent.z : 0.0f);
+    std::vector<uint64_t> codes(count);
+    std::vector<uint32_t> order(count);
+#pragma omp parallel for
+    for (int64_t i = 0; i < count; ++i)
+    {
+        Vector3 cell = (centroids[i] - centroidBounds.minBounds) * scale;
+        uint64_t x = static_cast<uint64_t>(std::clamp(cell.x, 0.0f, cells - 1.0f));
+        uint64_t y = static_cast<uint64_t>(std::clamp(cell.y, 0.0f, cells - 1.0f));
+        uint64_t z = static_cast<uint64_t>(std::clamp(cell.z, 0.0f, cells - 1.0f));
+        codes[i] = spreadBits(x) << 2 | spreadBits(y) << 1 | spreadBits(z);
+        order[i] = static_cast<uint32_t>(i);
+    }
+    buildStats.mortonMs = millisecondsSince(step);
+
+    step = Clock::now();
+    radixSort(codes, order, mortonBits, buildStats.threads);
+    buildStats.sortMs = millisecondsSince(step);
+
+    // Interior nodes, each found independently, then the BVHNode tree from the root (interior node 0)
+    step = Clock::now();
+    std::unique_ptr<BVHNode> root;
+    if (count < 2)
+    {
+        root = std::make_unique<BVHNode>();
+        root->objects = objects;
+        root->refit();
+        buildStats.nodes = 1;
+    }
+    else
+    {
+        std::vector<InternalNode> internalNodes(count - 1);
+#pragma omp parallel for
+        for (int64_t i = 0; i < count - 1; ++i)
+        {
+            internalNodes[i] = findInternalNode(codes, i);
+        }
+        root = emit(0, internalNodes, order, objects, buildStats.nodes);
+    }
+    buildStats.emitMs = millisecondsSince(step);
+
+    if (treeletLeaves > 2)
+    {
+        step = Clock::now();
+        optimizeTreelets(*root, treeletLeaves);
+        buildStats.treeletMs = millisecondsSince(step);
+    }
+    buildStats.buildMs = millisecondsSince(start);
+    if (stats)
+    {
+        *stats = buildStats;
+    }
+    return root;
+}
+
+void LinearBVH::optimizeTreelets(BVHNode &root, int treeletLeaves)
+{
+    if (treeletLeaves < 3 || treeletLeaves > MAX_TREELET_LEAVES)
+    {
+        std::cerr << "Invalid treelet size: " << treeletLeaves << " (expected 3 to " << MAX_TREELET_LEAVES << " leaves)" << std::endl;
+        throw std::invalid_argument("Invalid treelet size.");
+    }
+    optimizeTreelet(root, treeletLeaves);
+}
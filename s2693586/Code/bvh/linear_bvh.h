@@ -0,0 +1,54 @@
+#ifndef LINEAR_BVH_H
+#define LINEAR_BVH_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "bvh_node.h"
+
+// Work done by a linear BVH build
+struct LinearBVHStats
+{
+    uint64_t objects = 0;
+    uint64_t nodes = 0;     // Nodes of the emitted hierarchy
+    int threads = 1;        // Threads sorting the codes and finding the hierarchy
+    double mortonMs = 0.0;  // Computing the codes
+    double sortMs = 0.0;    // Radix-sorting them
+    double emitMs = 0.0;    // Finding the hierarchy and creating its nodes
+    double treeletMs = 0.0; // Optimising treelets
+    double buildMs = 0.0;   // All of the above
+};
+
+// Builds a BVHNode hierarchy from Morton codes (LBVH), in time linear in the number of objects
+// The centroids of the objects are quantized within their bounds and interleaved into 30-bit
+// (10 bits per axis) or 63-bit (21 bits per axis) Morton codes, which are radix-sorted in parallel.
+// Sorted, the objects below any node of the hierarchy are a contiguous range sharing a code prefix,
+// so each interior node is found independently from the codes around it, in parallel (Karras 2012).
+// Ranges of at most four objects become leaves. The hierarchy ignores object sizes, so it traces
+// more slowly than one split by surface area; optimizeTreelets restructures it to win some of that
+// back.
+class LinearBVH
+{
+public:
+    // Builds the hierarchy over the objects
+    // Parameters:
+    // - objects: Geometry to place in the hierarchy
+    // - mortonBits: Code length, 30 or 63 (for scenes whose objects are too close for 10 bits per axis)
+    // - treeletLeaves: When above 2, optimise treelets of up to this many leaves (at most 8) afterwards
+    // - stats: Receives the times of the build when not nullptr
+    // Throws std::invalid_argument for other code lengths or treelet sizes
+    // Returns: The root node
+    static std::unique_ptr<BVHNode> build(const std::vector<std::shared_ptr<const Geometry>> &objects, int mortonBits = 30,
+                                          int treeletLeaves = 0, LinearBVHStats *stats = nullptr);
+
+    // Restructures a hierarchy bottom-up to lower its surface area heuristic (SAH) cost (Karras and
+    // Aila 2013). At each interior node, the descendant with the largest surface area is opened until
+    // the node has the given number of subtrees below it, and these are rejoined in the order of
+    // lowest total area of the interior nodes, found exactly over all subsets of the subtrees.
+    // Parameters:
+    // - root: Fully built hierarchy to restructure
+    // - treeletLeaves: Subtrees per treelet, 3 to 8
+    static void optimizeTreelets(BVHNode &root, int treeletLeaves);
+};
+
+#endif // LINEAR_BVH_H
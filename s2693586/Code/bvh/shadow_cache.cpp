@@ -0,0 +1,147 @@
+#include "shadow_cache.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    std::atomic<bool> cacheEnabled{true};
+    std::atomic<uint64_t> cacheEpoch{0}; // Bumped whenever cached occluders may have been freed
+
+    // Counters written only by their own thread; relaxed atomics let stats() read them while rendering
+    struct ThreadCounters
+    {
+        std::atomic<uint64_t> queries{0};
+        std::atomic<uint64_t> blocked{0};
+        std::atomic<uint64_t> hits{0};
+    };
+
+    // Counters of every live thread, and the totals of threads that have exited
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<ThreadCounters *> threads;
+        ShadowCacheStats retired;
+    };
+
+    Registry &registry()
+    {
+        static Registry instance;
+        return instance;
+    }
+
+    // Cached occluders of one thread
+    struct ThreadCache
+    {
+        const BVHNode *root = nullptr;           // BVH the occluders belong to
+        uint64_t epoch = 0;                      // cacheEpoch when the occluders were recorded
+        std::vector<const Geometry *> occluders; // Last occluder per light (nullptr if none)
+        ThreadCounters counters;
+
+        ThreadCache()
+        {
+            Registry &r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.threads.push_back(&counters);
+        }
+
+        ~ThreadCache()
+        {
+            Registry &r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.retired.queries += counters.queries.load(std::memory_order_relaxed);
+            r.retired.blocked += counters.blocked.load(std::memory_order_relaxed);
+            r.retired.hits += counters.hits.load(std::memory_order_relaxed);
+            r.threads.erase(std::find(r.threads.begin(), r.threads.end(), &counters));
+        }
+    };
+
+    // Adds one to a counter only its own thread writes
+    inline void increment(std::atomic<uint64_t> &counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+}
+
+bool ShadowCache::occluded(const BVHNode &root, const Ray &ray, float maxDistance, size_t lightIndex)
+{
+    if (!cacheEnabled.load(std::memory_order_relaxed))
+    {
+        return root.intersectShadowRay(ray, maxDistance);
+    }
+
+    thread_local ThreadCache cache;
+    uint64_t epoch = cacheEpoch.load(std::memory_order_acquire);
+    if (cache.root != &root || cache.epoch != epoch)
+    {
+        cache.root = &root;
+        cache.epoch = epoch;
+        std::fill(cache.occluders.begin(), cache.occluders.end(), nullptr);
+    }
+    if (lightIndex >= cache.occluders.size())
+    {
+        cache.occluders.resize(lightIndex + 1, nullptr);
+    }
+    increment(cache.counters.queries);
+
+    // Try the light's last occluder first
+    const Geometry *&occluder = cache.occluders[lightIndex];
+    if (occluder)
+    {
+        if (occluder->occludes(ray, maxDistance))
+        {
+            increment(cache.counters.blocked);
+            increment(cache.counters.hits);
+            return true;
+        }
+    }
+
+    // Full traversal; remember whatever blocks the ray unless it is an aggregate, and keep the old
+    // occluder if nothing does
+    const Geometry *blocker = nullptr;
+    if (root.intersectShadowRay(ray, maxDistance, &blocker))
+    {
+        increment(cache.counters.blocked);
+        occluder = blocker->isAggregate() ? nullptr : blocker;
+        return true;
+    }
+    return false;
+}
+
+void ShadowCache::setEnabled(bool enabled)
+{
+    cacheEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void ShadowCache::invalidate()
+{
+    cacheEpoch.fetch_add(1, std::memory_order_release);
+}
+
+ShadowCacheStats ShadowCache::stats()
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    ShadowCacheStats total = r.retired;
+    for (const ThreadCounters *counters : r.threads)
+    {
+        total.queries += counters->queries.load(std::memory_order_relaxed);
+        total.blocked += counters->blocked.load(std::memory_order_relaxed);
+        total.hits += counters->hits.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void ShadowCache::resetStats()
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.retired = ShadowCacheStats();
+    for (ThreadCounters *counters : r.threads)
+    {
+        counters->queries.store(0, std::memory_order_relaxed);
+        counters->blocked.store(0, std::memory_order_relaxed);
+        counters->hits.store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef SHADOW_CACHE_H
+#define SHADOW_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include "bvh_node.h"
+
+// Counters of the shadow occluder cache, summed over all threads
+struct ShadowCacheStats
+{
+    uint64_t queries = 0; // Shadow rays tested through the cache
+    uint64_t blocked = 0; // Shadow rays found blocked, by the cached occluder or the traversal
+    uint64_t hits = 0;    // Shadow rays blocked by the cached occluder, with no BVH traversal
+
+    // Fraction of blocked shadow rays answered by the cache
+    double hitRate() const { return blocked > 0 ? static_cast<double>(hits) / blocked : 0.0; }
+};
+
+// Per-thread, per-light cache of the last primitive that blocked a shadow ray
+// Neighbouring shading points usually see a light blocked by the same primitive, so each render
+// thread remembers, for every light, the object that blocked its last shadow ray and tests it
+// before traversing the BVH. A hit answers the ray with one primitive test; a miss falls back to
+// the full traversal, whose occluder replaces the cached one (aggregates such as particle sets are
+// not cached, as testing one is no cheaper than the traversal). The caches need no locks; they are
+// cleared when a thread moves to another BVH or any BVHNode is destroyed, so they never refer to freed objects.
+class ShadowCache
+{
+public:
+    // Returns true if any object blocks the ray before maxDistance
+    // Parameters:
+    // - root: BVH to traverse when the cached occluder does not block the ray
+    // - ray: The shadow ray
+    // - maxDistance: Distance to the light
+    // - lightIndex: Index of the light the ray is sent to
+    static bool occluded(const BVHNode &root, const Ray &ray, float maxDistance, size_t lightIndex);
+
+    // Turns the cache on or off (on by default); when off, every ray traverses the BVH
+    static void setEnabled(bool enabled);
+
+    // Drops the cached occluders of every thread (called by ~BVHNode, and when a DynamicBVH commit replaces
+    // objects)
+    static void invalidate();
+
+    // Returns the counters summed over all threads, including threads that have exited
+    static ShadowCacheStats stats();
+
+    // Clears the counters
+    static void resetStats();
+};
+
+#endif // SHADOW_CACHE_H
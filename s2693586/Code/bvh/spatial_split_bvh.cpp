@@ -0,0 +1,359 @@
+#include "spatial_split_bvh.h"
+#include <algorithm>
+#include <chrono>
+
+using Clock = std::chrono::high_resolution_clock;
+
+// Leaves hold at most this many references, as in BVHNode::build
+static constexpr size_t MAX_LEAF_SIZE = 4;
+
+// Candidate planes per axis are the boundaries between this many bins; spatial splits use fewer, as
+// every reference is clipped to each bin it crosses
+static constexpr int BINS = 32;
+static constexpr int SPATIAL_BINS = 16;
+
+// Spatial splits are tried where the object split's children overlap by more than this fraction of
+// the root's surface area; below it clipping gains too little to pay for the extra references
+static constexpr float MIN_OVERLAP = 1e-4f;
+
+// Half thickness given to flat node boxes; AABB::intersect misses boxes with no thickness, which
+// clipping axis-aligned triangles produces often
+static constexpr float FLAT_PADDING = 1e-4f;
+
+namespace
+{
+    struct Bin
+    {
+        AABB box;
+        size_t count = 0;
+    };
+
+    Vector3 center(const AABB &box)
+    {
+        return (box.minBounds + box.maxBounds) * 0.5f;
+    }
+
+    void padFlatAxes(AABB &box)
+    {
+        for (int axis = 0; axis < 3 && !box.empty(); ++axis)
+        {
+            if (box.maxBounds[axis] - box.minBounds[axis] < FLAT_PADDING)
+            {
+                box.minBounds[axis] -= FLAT_PADDING;
+                box.maxBounds[axis] += FLAT_PADDING;
+            }
+        }
+    }
+}
+
+SpatialSplitBVH::SpatialSplitBVH(const std::vector<std::shared_ptr<const Geometry>> &objects, float duplicationBudget)
+    : objects(objects),
+      referenceLimit(objects.size() + static_cast<size_t>(std::max(0.0f, duplicationBudget) * objects.size())),
+      referenceCount(objects.size())
+{
+}
+
+std::unique_ptr<BVHNode> SpatialSplitBVH::build(const std::vector<std::shared_ptr<const Geometry>> &objects, float duplicationBudget,
+                                                SpatialSplitStats *stats)
+{
+    auto start = Clock::now();
+
+    SpatialSplitBVH builder(objects, duplicationBudget);
+    std::vector<Reference> references(objects.size());
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        const Geometry &object = *objects[i];
+        references[i] = Reference{object.isMoving() ? object.boundingBoxAt(0.5f) : object.boundingBox(), static_cast<uint32_t>(i)};
+    }
+    std::unique_ptr<BVHNode> root = builder.buildNode(std::move(references), 0);
+
+    builder.stats.objects = objects.size();
+    builder.stats.buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    if (stats)
+    {
+        *stats = builder.stats;
+    }
+    return root;
+}
+
+std::unique_ptr<BVHNode> SpatialSplitBVH::buildNode(std::vector<Reference> references, int depth)
+{
+    auto node = std::make_unique<BVHNode>();
+    ++stats.nodes;
+    for (const Reference &reference : references)
+    {
+        const Geometry &object = *objects[reference.object];
+        if (object.isMoving())
+        {
+            node->boundingBox.expand(object.boundingBox());
+            node->endBoundingBox.expand(object.boundingBoxAt(1.0f));
+            node->moving = true;
+        }
+        else
+        {
+            node->boundingBox.expand(reference.box);
+            node->endBoundingBox.expand(reference.box);
+        }
+    }
+    padFlatAxes(node->boundingBox);
+    padFlatAxes(node->endBoundingBox);
+    if (depth == 0)
+    {
+        rootArea = node->boundingBox.surfaceArea();
+    }
+
+    // Leaf node if the depth limit is exceeded or there are few enough references
+    if (depth > BVHNode::MAX_DEPTH || references.size() <= MAX_LEAF_SIZE)
+    {
+        for (const Reference &reference : references)
+        {
+            node->objects.push_back(objects[reference.object]);
+        }
+        stats.references += references.size();
+        return node;
+    }
+
+    // Prefer a spatial split where the object split leaves overlapping children and clipping is cheaper
+    Split split = findObjectSplit(references);
+    bool spatial = false;
+    if (!node->moving && referenceCount < referenceLimit)
+    {
+        float overlap = split.cost >= 0.0f ? split.leftBox.intersection(split.rightBox).surfaceArea() : rootArea;
+        if (overlap > MIN_OVERLAP * rootArea)
+        {
+            Split spatialSplit = findSpatialSplit(references, node->boundingBox);
+            if (spatialSplit.cost >= 0.0f && (split.cost < 0.0f || spatialSplit.cost < split.cost))
+            {
+                split = spatialSplit;
+                spatial = true;
+            }
+        }
+    }
+
+    std::vector<Reference> leftReferences, rightReferences;
+    int axis = split.axis;
+    if (spatial)
+    {
+        ++stats.spatialSplits;
+        AABB leftBox = split.leftBox, rightBox = split.rightBox;
+        float leftCount = static_cast<float>(split.leftCount), rightCount = static_cast<float>(split.rightCount);
+        for (const Reference &reference : references)
+        {
+            if (reference.box.maxBounds[axis] <= split.position)
+            {
+                leftReferences.push_back(reference);
+                continue;
+            }
+            if (reference.box.minBounds[axis] >= split.position)
+            {
+                rightReferences.push_back(reference);
+                continue;
+            }
+
+            // Crossing the plane: keep it whole on one side when that costs less than clipping it
+            AABB leftWith = leftBox, rightWith = rightBox;
+            leftWith.expand(reference.box);
+            rightWith.expand(reference.box);
+            float clipCost = leftBox.surfaceArea() * leftCount + rightBox.surfaceArea() * rightCount;
+            float leftCost = leftWith.surfaceArea() * leftCount + rightBox.surfaceArea() * (rightCount - 1.0f);
+            float rightCost = leftBox.surfaceArea() * (leftCount - 1.0f) + rightWith.surfaceArea() * rightCount;
+            if (leftCost < clipCost && leftCost <= rightCost)
+            {
+                leftReferences.push_back(reference);
+                leftBox = leftWith;
+                rightCount -= 1.0f;
+            }
+            else if (rightCost < clipCost)
+            {
+                rightReferences.push_back(reference);
+                rightBox = rightWith;
+                leftCount -= 1.0f;
+            }
+            else
+            {
+                AABB leftPart, rightPart;
+                clip(reference, axis, split.position, leftPart, rightPart);
+                if (!leftPart.empty())
+                {
+                    leftReferences.push_back(Reference{leftPart, reference.object});
+                }
+                if (!rightPart.empty())
+                {
+                    rightReferences.push_back(Reference{rightPart, reference.object});
+                }
+                referenceCount += !leftPart.empty() && !rightPart.empty();
+            }
+        }
+    }
+    else if (split.cost >= 0.0f)
+    {
+        ++stats.objectSplits;
+        for (const Reference &reference : references)
+        {
+            (center(reference.box)[axis] < split.position ? leftReferences : rightReferences).push_back(reference);
+        }
+    }
+
+    if (leftReferences.empty() || rightReferences.empty())
+    {
+        // The bins could not separate the references (such as when their centroids coincide): halve
+        // them in centroid order along the longest axis of the node
+        Vector3 size = node->boundingBox.maxBounds - node->boundingBox.minBounds;
+        axis = (size.x > size.y) ? ((size.x > size.z) ? 0 : 2) : ((size.y > size.z) ? 1 : 2);
+        std::sort(references.begin(), references.end(), [axis](const Reference &a, const Reference &b)
+                  { return center(a.box)[axis] < center(b.box)[axis]; });
+        size_t mid = references.size() / 2;
+        leftReferences.assign(references.begin(), references.begin() + mid);
+        rightReferences.assign(references.begin() + mid, references.end());
+    }
+    references.clear();
+    references.shrink_to_fit();
+
+    node->left = buildNode(std::move(leftReferences), depth + 1);
+    node->right = buildNode(std::move(rightReferences), depth + 1);
+    return node;
+}
+
+SpatialSplitBVH::Split SpatialSplitBVH::findObjectSplit(const std::vector<Reference> &references) const
+{
+    AABB centroids;
+    for (const Reference &reference : references)
+    {
+        Vector3 point = center(reference.box);
+        centroids.expand(AABB(point, point));
+    }
+
+    Split best;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float origin = centroids.minBounds[axis], extent = centroids.maxBounds[axis] - origin;
+        if (!(extent > 0.0f))
+        {
+            continue;
+        }
+
+        // Bin the references by centroid
+        Bin bins[BINS];
+        float scale = BINS / extent;
+        for (const Reference &reference : references)
+        {
+            int bin = std::min(BINS - 1, static_cast<int>((center(reference.box)[axis] - origin) * scale));
+            bins[bin].box.expand(reference.box);
+            ++bins[bin].count;
+        }
+
+        // Sweep from the right, then evaluate each boundary sweeping from the left
+        Bin right[BINS];
+        for (int i = BINS - 1; i > 0; --i)
+        {
+            right[i] = i + 1 < BINS ? right[i + 1] : Bin();
+            right[i].box.expand(bins[i].box);
+            right[i].count += bins[i].count;
+        }
+        Bin left;
+        for (int i = 1; i < BINS; ++i)
+        {
+            left.box.expand(bins[i - 1].box);
+            left.count += bins[i - 1].count;
+            if (left.count == 0 || right[i].count == 0)
+            {
+                continue;
+            }
+            float cost = left.box.surfaceArea() * left.count + right[i].box.surfaceArea() * right[i].count;
+            if (best.cost < 0.0f || cost < best.cost)
+            {
+                best.cost = cost;
+                best.axis = axis;
+                best.position = origin + i / scale;
+                best.leftBox = left.box;
+                best.rightBox = right[i].box;
+                best.leftCount = left.count;
+                best.rightCount = right[i].count;
+            }
+        }
+    }
+    return best;
+}
+
+SpatialSplitBVH::Split SpatialSplitBVH::findSpatialSplit(const std::vector<Reference> &references, const AABB &nodeBox) const
+{
+    Split best;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float origin = nodeBox.minBounds[axis], extent = nodeBox.maxBounds[axis] - origin;
+        if (!(extent > 0.0f))
+        {
+            continue;
+        }
+
+        // Bin the references by the slabs they cover, clipping them to each slab they cross
+        // Counting a reference where it enters and where it exits gives each side's count for every plane
+        Bin bins[SPATIAL_BINS];
+        size_t enter[SPATIAL_BINS] = {}, exit[SPATIAL_BINS] = {};
+        float width = extent / SPATIAL_BINS;
+        auto binOf = [&](float position)
+        { return std::clamp(static_cast<int>((position - origin) / width), 0, SPATIAL_BINS - 1); };
+        for (const Reference &reference : references)
+        {
+            int first = binOf(reference.box.minBounds[axis]), last = binOf(reference.box.maxBounds[axis]);
+            ++enter[first];
+            ++exit[last];
+            if (first == last)
+            {
+                bins[first].box.expand(reference.box);
+                continue;
+            }
+            for (int bin = first; bin <= last; ++bin)
+            {
+                AABB slab = reference.box;
+                slab.minBounds[axis] = std::max(slab.minBounds[axis], origin + bin * width);
+                slab.maxBounds[axis] = std::min(slab.maxBounds[axis], bin == SPATIAL_BINS - 1 ? nodeBox.maxBounds[axis] : origin + (bin + 1) * width);
+                AABB part = objects[reference.object]->clippedBounds(slab);
+                if (!part.empty())
+                {
+                    bins[bin].box.expand(part);
+                }
+            }
+        }
+
+        Bin right[SPATIAL_BINS];
+        for (int i = SPATIAL_BINS - 1; i > 0; --i)
+        {
+            right[i] = i + 1 < SPATIAL_BINS ? right[i + 1] : Bin();
+            right[i].box.expand(bins[i].box);
+            right[i].count += exit[i];
+        }
+        Bin left;
+        for (int i = 1; i < SPATIAL_BINS; ++i)
+        {
+            left.box.expand(bins[i - 1].box);
+            left.count += enter[i - 1];
+            if (left.count == 0 || right[i].count == 0)
+            {
+                continue;
+            }
+            float cost = left.box.surfaceArea() * left.count + right[i].box.surfaceArea() * right[i].count;
+            if (best.cost < 0.0f || cost < best.cost)
+            {
+                best.cost = cost;
+                best.axis = axis;
+                best.position = origin + i * width;
+                best.leftBox = left.box;
+                best.rightBox = right[i].box;
+                best.leftCount = left.count;
+                best.rightCount = right[i].count;
+            }
+        }
+    }
+    return best;
+}
+
+void SpatialSplitBVH::clip(const Reference &reference, int axis, float position, AABB &left, AABB &right) const
+{
+    AABB leftSlab = reference.box, rightSlab = reference.box;
+    leftSlab.maxBounds[axis] = position;
+    rightSlab.minBounds[axis] = position;
+    const Geometry &object = *objects[reference.object];
+    left = object.clippedBounds(leftSlab);
+    right = object.clippedBounds(rightSlab);
+}
@@ -0,0 +1,79 @@
+#ifndef SPATIAL_SPLIT_BVH_H
+#define SPATIAL_SPLIT_BVH_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "bvh_node.h"
+
+// Work done by a spatial-split BVH build
+struct SpatialSplitStats
+{
+    uint64_t objects = 0;       // Objects placed in the hierarchy
+    uint64_t references = 0;    // Object references in the leaves, counting each clipped part
+    uint64_t nodes = 0;         // Nodes built
+    uint64_t spatialSplits = 0; // Nodes split by a plane that clips the objects crossing it
+    uint64_t objectSplits = 0;  // Nodes split by partitioning whole objects
+    double buildMs = 0.0;
+};
+
+// Builds a BVHNode hierarchy with the surface area heuristic (SAH), using spatial splits (SBVH)
+// Each node is split by the cheaper of two candidates, each evaluated in bins along all three axes:
+// - an object split, partitioning whole objects by the centroid of their bounds
+// - a spatial split, cutting the node's box by a plane; objects crossing it are referenced on both
+//   sides with their bounds clipped to each side (Geometry::clippedBounds), unless moving one
+//   wholly to a side is cheaper
+// Spatial splits are only tried where the children of the best object split overlap, and only until
+// the references added reach the duplication budget; past it the build uses object splits alone.
+// Objects that move during the frame are never clipped, so nodes holding one use object splits.
+// The result is a regular BVHNode tree whose leaves may share objects, so it is traversed (and can
+// be widened) like any other.
+class SpatialSplitBVH
+{
+public:
+    // Builds the hierarchy over the objects
+    // Parameters:
+    // - objects: Geometry to place in the hierarchy
+    // - duplicationBudget: Fraction of objects.size() that clipped references may add (0 gives an
+    //   SAH build with object splits only)
+    // - stats: Receives the counts of the build when not nullptr
+    // Returns: The root node
+    static std::unique_ptr<BVHNode> build(const std::vector<std::shared_ptr<const Geometry>> &objects, float duplicationBudget,
+                                          SpatialSplitStats *stats = nullptr);
+
+private:
+    // An object, or the part of it inside box
+    struct Reference
+    {
+        AABB box;        // Bounds at time 0, clipped for static objects; mid-frame bounds for moving ones
+        uint32_t object; // Index of the object
+    };
+
+    // Best split found for a node
+    struct Split
+    {
+        float cost = -1.0f; // SAH cost relative to the node's area; negative if none was found
+        int axis = 0;
+        float position = 0.0f;     // Plane of a spatial split, or the centroid bin boundary of an object split
+        AABB leftBox, rightBox;    // Children bounds predicted by the bins
+        size_t leftCount = 0, rightCount = 0;
+    };
+
+    const std::vector<std::shared_ptr<const Geometry>> &objects;
+    size_t referenceLimit;  // Most references spatial splits may create
+    size_t referenceCount;  // References created so far
+    float rootArea = 0.0f;  // Surface area of the root's box
+    SpatialSplitStats stats;
+
+    SpatialSplitBVH(const std::vector<std::shared_ptr<const Geometry>> &objects, float duplicationBudget);
+
+    std::unique_ptr<BVHNode> buildNode(std::vector<Reference> references, int depth);
+
+    Split findObjectSplit(const std::vector<Reference> &references) const;
+    Split findSpatialSplit(const std::vector<Reference> &references, const AABB &nodeBox) const;
+
+    // Clips the reference to either side of the plane; a part is empty if nothing is left on its side
+    void clip(const Reference &reference, int axis, float position, AABB &left, AABB &right) const;
+};
+
+#endif // SPATIAL_SPLIT_BVH_H
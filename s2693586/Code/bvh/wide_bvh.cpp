@@ -0,0 +1,417 @@
+#include "wide_bvh.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h> // SSE intrinsics for the four-wide box test
+#define WIDE_BVH_SSE 1
+#endif
+#if defined(WIDE_BVH_SSE) && defined(__GNUC__)
+#include <immintrin.h> // AVX intrinsics, compiled for the eight-wide box test only and chosen at run time
+#define WIDE_BVH_AVX 1
+#endif
+
+// Entries a traversal stack can hold: each visit down to MAX_DEPTH pushes at most width - 1 more entries
+static constexpr int STACK_SIZE = 8 * (WideBVH::MAX_DEPTH + 1);
+
+namespace
+{
+    // Ray origin and reciprocal direction, set up once per traversal
+    struct RayData
+    {
+        float origin[3];
+        float inverseDirection[3];
+
+        explicit RayData(const Ray &ray)
+        {
+            // Reciprocals of all three axes at once, with near-zero directions given a large one of the same sign
+            Float4 direction = Float3(ray.direction).v;
+            Float4 sign = direction & Float4(-0.0f);
+            Float4 inverse = select(abs(direction) > Float4(1e-8f), Float4(1.0f) / direction, Float4(1e30f) | sign);
+            alignas(16) float lanes[4];
+            inverse.store(lanes);
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                inverseDirection[axis] = lanes[axis];
+            }
+            origin[0] = ray.origin.x;
+            origin[1] = ray.origin.y;
+            origin[2] = ray.origin.z;
+        }
+    };
+
+    // Traversal stack entry: a child reference, the distance at which the ray enters it, and its depth
+    struct StackEntry
+    {
+        int32_t reference;
+        float distance;
+        int depth;
+    };
+
+    // Tests the ray against four boxes stored plane by plane, each plane stride floats after the last
+    // Returns: A bit mask of the boxes hit before maxDistance; entry receives the entry distances
+    inline int testBoxes4(const float *planes, int stride, const RayData &ray, float maxDistance, float *entry)
+    {
+#ifdef WIDE_BVH_SSE
+        __m128 tMin = _mm_setzero_ps(), tMax = _mm_set1_ps(maxDistance);
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            __m128 origin = _mm_set1_ps(ray.origin[axis]), inverseDirection = _mm_set1_ps(ray.inverseDirection[axis]);
+            __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(planes + axis * stride), origin), inverseDirection);
+            __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(planes + (axis + 3) * stride), origin), inverseDirection);
+            tMin = _mm_max_ps(tMin, _mm_min_ps(t0, t1));
+            tMax = _mm_min_ps(tMax, _mm_max_ps(t0, t1));
+        }
+        _mm_storeu_ps(entry, tMin);
+        return _mm_movemask_ps(_mm_cmple_ps(tMin, tMax));
+#else
+        int mask = 0;
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            float tMin = 0.0f, tMax = maxDistance;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                float t0 = (planes[axis * stride + lane] - ray.origin[axis]) * ray.inverseDirection[axis];
+                float t1 = (planes[(axis + 3) * stride + lane] - ray.origin[axis]) * ray.inverseDirection[axis];
+                tMin = std::max(tMin, std::min(t0, t1));
+                tMax = std::min(tMax, std::max(t0, t1));
+            }
+            entry[lane] = tMin;
+            mask |= (tMin <= tMax) << lane;
+        }
+        return mask;
+#endif
+    }
+
+#ifdef WIDE_BVH_AVX
+    // Eight-wide version of testBoxes4, for CPUs with AVX
+    __attribute__((target("avx"))) int testBoxes8Avx(const float *planes, const RayData &ray, float maxDistance, float *entry)
+    {
+        __m256 tMin = _mm256_setzero_ps(), tMax = _mm256_set1_ps(maxDistance);
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            __m256 origin = _mm256_set1_ps(ray.origin[axis]), inverseDirection = _mm256_set1_ps(ray.inverseDirection[axis]);
+            __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(planes + axis * 8), origin), inverseDirection);
+            __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(planes + (axis + 3) * 8), origin), inverseDirection);
+            tMin = _mm256_max_ps(tMin, _mm256_min_ps(t0, t1));
+            tMax = _mm256_min_ps(tMax, _mm256_max_ps(t0, t1));
+        }
+        _mm256_storeu_ps(entry, tMin);
+        return _mm256_movemask_ps(_mm256_cmp_ps(tMin, tMax, _CMP_LE_OQ));
+    }
+
+    bool cpuHasAvx()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx");
+    }
+#endif
+
+    // Tests the ray against the W boxes of a node's children, stored plane by plane
+    template <int W>
+    inline int testBoxes(const float (&bounds)[6][W], const RayData &ray, float maxDistance, float *entry)
+    {
+        if (W == 4)
+        {
+            return testBoxes4(bounds[0], W, ray, maxDistance, entry);
+        }
+#ifdef WIDE_BVH_AVX
+        static const bool avx = cpuHasAvx();
+        if (avx)
+        {
+            return testBoxes8Avx(bounds[0], ray, maxDistance, entry);
+        }
+#endif
+        return testBoxes4(bounds[0], W, ray, maxDistance, entry) | (testBoxes4(bounds[0] + 4, W, ray, maxDistance, entry + 4) << 4);
+    }
+
+    // Box a binary node covers over the frame, for choosing which nodes to open
+    AABB sweptBox(const BVHNode &node)
+    {
+        AABB box = node.boundingBox;
+        if (node.moving)
+        {
+            box.expand(node.endBoundingBox);
+        }
+        return box;
+    }
+}
+
+std::unique_ptr<WideBVH> WideBVH::collapse(const BVHNode &root, int width)
+{
+    if (width != 4 && width != 8)
+    {
+        std::cerr << "Invalid wide BVH width: " << width << " (expected 4 or 8)" << std::endl;
+        throw std::invalid_argument("Invalid wide BVH width.");
+    }
+    std::unique_ptr<WideBVH> bvh(new WideBVH());
+    bvh->nodeWidth = width;
+    bvh->rootChild = width == 4 ? bvh->reference(bvh->nodes4, root, 0) : bvh->reference(bvh->nodes8, root, 0);
+    bvh->nodes4.shrink_to_fit();
+    bvh->nodes8.shrink_to_fit();
+    bvh->endBounds.shrink_to_fit();
+    bvh->leaves.shrink_to_fit();
+    bvh->objects.shrink_to_fit();
+    return bvh;
+}
+
+template <int W>
+int32_t WideBVH::reference(std::vector<Node<W>> &nodes, const BVHNode &node, int depth)
+{
+    if (node.left || node.right)
+    {
+        return collapseNode(nodes, node, depth);
+    }
+    leaves.push_back(Leaf{static_cast<uint32_t>(objects.size()), static_cast<uint32_t>(node.objects.size())});
+    objects.insert(objects.end(), node.objects.begin(), node.objects.end());
+    return ~static_cast<int32_t>(leaves.size() - 1);
+}
+
+template <int W>
+int32_t WideBVH::collapseNode(std::vector<Node<W>> &nodes, const BVHNode &node, int depth)
+{
+    if (depth > MAX_DEPTH)
+    {
+        std::cerr << "Wide BVH deeper than " << MAX_DEPTH << " levels" << std::endl;
+        throw std::invalid_argument("Wide BVH too deep.");
+    }
+    const BVHNode *children[W];
+    int count = 0;
+    for (const BVHNode *child : {node.left.get(), node.right.get()})
+    {
+        if (child)
+        {
+            children[count++] = child;
+        }
+    }
+
+    // Open the interior child with the largest surface area until the node is full
+    while (count < W)
+    {
+        int best = -1;
+        float bestArea = -1.0f;
+        for (int i = 0; i < count; ++i)
+        {
+            float area = sweptBox(*children[i]).surfaceArea();
+            if ((children[i]->left || children[i]->right) && area > bestArea)
+            {
+                best = i;
+                bestArea = area;
+            }
+        }
+        if (best < 0)
+        {
+            break; // Only leaves left
+        }
+        const BVHNode *opened = children[best];
+        children[best] = opened->left ? opened->left.get() : opened->right.get();
+        if (opened->left && opened->right)
+        {
+            children[count++] = opened->right.get();
+        }
+    }
+
+    // Store the children's boxes plane by plane; unused lanes are masked out by count
+    int32_t index = static_cast<int32_t>(nodes.size());
+    nodes.emplace_back();
+    Node<W> wideNode = Node<W>();
+    wideNode.count = count;
+    wideNode.endBounds = -1;
+    bool moving = false;
+    for (int i = 0; i < count; ++i)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            wideNode.bounds[axis][i] = children[i]->boundingBox.minBounds[axis];
+            wideNode.bounds[axis + 3][i] = children[i]->boundingBox.maxBounds[axis];
+        }
+        moving = moving || children[i]->moving;
+    }
+    if (moving)
+    {
+        // Boxes at the end of the frame; static children keep their boxes
+        wideNode.endBounds = static_cast<int32_t>(endBounds.size() / (6 * W));
+        size_t start = endBounds.size();
+        endBounds.insert(endBounds.end(), &wideNode.bounds[0][0], &wideNode.bounds[0][0] + 6 * W);
+        for (int i = 0; i < count; ++i)
+        {
+            if (children[i]->moving)
+            {
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    endBounds[start + axis * W + i] = children[i]->endBoundingBox.minBounds[axis];
+                    endBounds[start + (axis + 3) * W + i] = children[i]->endBoundingBox.maxBounds[axis];
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        wideNode.children[i] = reference(nodes, *children[i], depth + 1);
+    }
+    nodes[index] = wideNode;
+    return index;
+}
+
+bool WideBVH::intersect(const Ray &ray, Intersection &closestIntersection, TraversalStats *stats) const
+{
+    return nodeWidth == 4 ? traverse(nodes4, ray, closestIntersection, stats) : traverse(nodes8, ray, closestIntersection, stats);
+}
+
+bool WideBVH::intersect(const Ray &ray, VisibilityHit &closest, TraversalStats *stats) const
+{
+    return nodeWidth == 4 ? traverse(nodes4, ray, closest, stats) : traverse(nodes8, ray, closest, stats);
+}
+
+bool WideBVH::intersectShadowRay(const Ray &ray, float maxDistance, const Geometry **occluder) const
+{
+    return nodeWidth == 4 ? traverseShadow(nodes4, ray, maxDistance, occluder) : traverseShadow(nodes8, ray, maxDistance, occluder);
+}
+
+// Tests the ray against a node's children at the ray's time, returning the mask of children hit
+template <int W>
+static inline int testNode(const float (&bounds)[6][W], int32_t endIndex, int count, const std::vector<float> &endBounds,
+                           const Ray &ray, const RayData &rayData, float maxDistance, float *entry)
+{
+    int mask;
+    if (endIndex < 0)
+    {
+        mask = testBoxes(bounds, rayData, maxDistance, entry);
+    }
+    else
+    {
+        // Interpolate the boxes of moving children to the ray's time
+        alignas(4 * W) float boundsAt[6][W];
+        const float *end = &endBounds[static_cast<size_t>(endIndex) * 6 * W];
+        for (int plane = 0; plane < 6; ++plane)
+        {
+            for (int i = 0; i < W; ++i)
+            {
+                boundsAt[plane][i] = bounds[plane][i] + (end[plane * W + i] - bounds[plane][i]) * ray.time;
+            }
+        }
+        mask = testBoxes(boundsAt, rayData, maxDistance, entry);
+    }
+    return mask & ((1 << count) - 1);
+}
+
+template <int W, typename Hit>
+bool WideBVH::traverse(const std::vector<Node<W>> &nodes, const Ray &ray, Hit &closest, TraversalStats *stats) const
+{
+    if (objects.empty())
+    {
+        return false;
+    }
+    RayData rayData(ray);
+    StackEntry stack[STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = StackEntry{rootChild, 0.0f, 0};
+    bool hit = false;
+    int deepest = 0;
+
+    while (stackSize > 0)
+    {
+        StackEntry current = stack[--stackSize];
+        if (current.distance > closest.distance)
+        {
+            continue; // Entered beyond the closest hit found since it was pushed
+        }
+        deepest = std::max(deepest, current.depth);
+
+        // Leaf: test its objects
+        if (current.reference < 0)
+        {
+            const Leaf &leaf = leaves[~current.reference];
+            if (stats)
+            {
+                stats->objectTests += leaf.count;
+            }
+            for (uint32_t i = leaf.first; i < leaf.first + leaf.count; ++i)
+            {
+                hit |= objects[i]->intersectCloser(ray, closest);
+            }
+            continue;
+        }
+
+        const Node<W> &node = nodes[current.reference];
+        if (stats)
+        {
+            ++stats->nodeVisits;
+            stats->boxTests += node.count;
+        }
+        float entry[W];
+        int mask = testNode(node.bounds, node.endBounds, node.count, endBounds, ray, rayData, closest.distance, entry);
+
+        // Sort the hit children by entry distance, farthest first, so the nearest is popped first
+        int order[W];
+        int hits = 0;
+        for (; mask != 0; mask &= mask - 1)
+        {
+            int child = __builtin_ctz(mask);
+            int position = hits++;
+            for (; position > 0 && entry[order[position - 1]] < entry[child]; --position)
+            {
+                order[position] = order[position - 1];
+            }
+            order[position] = child;
+        }
+        for (int i = 0; i < hits; ++i)
+        {
+            stack[stackSize++] = StackEntry{node.children[order[i]], entry[order[i]], current.depth + 1};
+        }
+    }
+
+    if (stats)
+    {
+        ++stats->rays;
+        stats->depthSum += deepest;
+        stats->maxDepth = std::max(stats->maxDepth, deepest);
+    }
+    return hit;
+}
+
+template <int W>
+bool WideBVH::traverseShadow(const std::vector<Node<W>> &nodes, const Ray &ray, float maxDistance, const Geometry **occluder) const
+{
+    if (objects.empty())
+    {
+        return false;
+    }
+    RayData rayData(ray);
+    int32_t stack[STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = rootChild;
+
+    while (stackSize > 0)
+    {
+        int32_t reference = stack[--stackSize];
+        if (reference < 0)
+        {
+            const Leaf &leaf = leaves[~reference];
+            for (uint32_t i = leaf.first; i < leaf.first + leaf.count; ++i)
+            {
+                if (objects[i]->occludes(ray, maxDistance))
+                {
+                    if (occluder)
+                    {
+                        *occluder = objects[i].get();
+                    }
+                    return true; // Early exit for shadow
+                }
+            }
+            continue;
+        }
+
+        // Any blocker ends the search, so children are visited in storage order
+        const Node<W> &node = nodes[reference];
+        float entry[W];
+        for (int mask = testNode(node.bounds, node.endBounds, node.count, endBounds, ray, rayData, maxDistance, entry); mask != 0;
+             mask &= mask - 1)
+        {
+            stack[stackSize++] = node.children[__builtin_ctz(mask)];
+        }
+    }
+    return false;
+}
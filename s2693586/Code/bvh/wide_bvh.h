@@ -0,0 +1,79 @@
+#ifndef WIDE_BVH_H
+#define WIDE_BVH_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "bvh_node.h"
+
+// A BVH with up to 4 or 8 children per node, collapsed from a binary BVHNode tree
+// Each wide node stores its children's boxes plane by plane, so one SSE (4-wide) or AVX (8-wide)
+// pass tests a ray against all of them; 8-wide nodes fall back to two SSE passes on CPUs without
+// AVX. Hit children are visited nearest first, and closest-hit rays skip children that start
+// beyond the closest hit found so far. Collapsing keeps the binary tree's leaves and replaces
+// chains of binary nodes with one wide node, so rays visit fewer, shallower nodes.
+class WideBVH
+{
+public:
+    // Deepest wide node a hierarchy may have, which sizes the traversal stacks
+    static constexpr int MAX_DEPTH = 64;
+
+    // Collapses the (fully built) binary hierarchy below root
+    // Parameters:
+    // - root: Binary hierarchy to collapse; its objects are shared with the wide one
+    // - width: Children per node, 4 or 8
+    // Throws std::invalid_argument for any other width, or if the wide hierarchy would exceed MAX_DEPTH
+    static std::unique_ptr<WideBVH> collapse(const BVHNode &root, int width);
+
+    int width() const { return nodeWidth; }
+    size_t nodeCount() const { return nodeWidth == 4 ? nodes4.size() : nodes8.size(); }
+
+    // Same as BVHNode::intersect
+    bool intersect(const Ray &ray, Intersection &closestIntersection, TraversalStats *stats = nullptr) const;
+    bool intersect(const Ray &ray, VisibilityHit &closest, TraversalStats *stats = nullptr) const;
+
+    // Same as BVHNode::intersectShadowRay
+    bool intersectShadowRay(const Ray &ray, float maxDistance, const Geometry **occluder = nullptr) const;
+
+private:
+    // Children of a wide node, with their boxes stored as one array of W values per plane
+    // A child reference is a node index, or the bitwise complement of a leaf index
+    template <int W>
+    struct alignas(4 * W) Node
+    {
+        float bounds[6][W];   // minX, minY, minZ, maxX, maxY, maxZ of each child at time 0
+        int32_t children[W];
+        int32_t endBounds;    // Index of the children's boxes at time 1 when any child moves, or -1
+        int32_t count;        // Children in use
+    };
+
+    // Objects [first, first + count) of a binary leaf
+    struct Leaf
+    {
+        uint32_t first, count;
+    };
+
+    int nodeWidth = 4;
+    std::vector<Node<4>> nodes4;
+    std::vector<Node<8>> nodes8;
+    std::vector<float> endBounds; // 6 * width values per moving node
+    std::vector<Leaf> leaves;
+    std::vector<std::shared_ptr<const Geometry>> objects; // Objects in leaf order
+    int32_t rootChild = 0;                                 // Root reference: node 0, or a single leaf
+
+    // Creates the wide node at the given depth for a binary interior node and returns its index
+    template <int W>
+    int32_t collapseNode(std::vector<Node<W>> &nodes, const BVHNode &node, int depth);
+
+    // Returns the reference to a binary child: a new leaf, or the wide node collapsed from it
+    template <int W>
+    int32_t reference(std::vector<Node<W>> &nodes, const BVHNode &node, int depth);
+
+    template <int W, typename Hit>
+    bool traverse(const std::vector<Node<W>> &nodes, const Ray &ray, Hit &closest, TraversalStats *stats) const;
+
+    template <int W>
+    bool traverseShadow(const std::vector<Node<W>> &nodes, const Ray &ray, float maxDistance, const Geometry **occluder) const;
+};
+
+#endif // WIDE_BVH_H
@@ -35,6 +35,18 @@ Camera::Camera(const Vector3 &position, const Vector3 &lookAt, const Vector3 &up
 // - x, y: Pixel coordinates in the image (0-based indexing)
 // Returns: A Ray object originating from the camera and passing through the pixel
 Ray Camera::generateRay(float x, float y) const
+{
+    // Each thread keeps its own generator so concurrent calls do not share RNG state
+    static thread_local std::minstd_rand gen(std::random_device{}());
+    return generateRay(x, y, gen);
+}
+
+// Function to generate a ray for a specific pixel using a caller-provided generator
+// Parameters:
+// - x, y: Pixel coordinates in the image (0-based indexing)
+// - rng: Random generator used for aperture sampling
+// Returns: A Ray object originating from the camera and passing through the pixel
+Ray Camera::generateRay(float x, float y, std::minstd_rand &rng) const
 {
     // Convert pixel coordinates to normalized device coordinates (NDC)
     float ndcX = (2 * (x + 0.5f) / static_cast<float>(width) - 1) * aspectRatio * scale; // Scale by aspect ratio and FOV
@@ -44,11 +56,13 @@ Ray Camera::generateRay(float x, float y) const
     // Handle pinhole camera case (aperture = 0)
     if (aperture == 0.0f)
     {
-        return Ray(position, direction); // Direct ray without depth of field effects
+        Ray ray = Ray::fromUnitDirection(position, direction, sampleTime(rng)); // Direct ray without depth of field effects
+        ray.coneAngle = 2.0f * scale / static_cast<float>(height); // Pixel footprint per unit distance
+        return ray;
     }
 
     // Simulate depth of field by sampling a random point on the aperture
-    Vector3 apertureSample = sampleAperture();
+    Vector3 apertureSample = sampleAperture(rng);
     // Compute the focal point (where the ray converges based on focal distance)
     float t = focalDistance / direction.dot(forward); // Scale based on focal distance
     Vector3 focalPoint = position + direction * t;
@@ -58,25 +72,62 @@ Ray Camera::generateRay(float x, float y) const
     Vector3 newDirection = (focalPoint - rayOrigin).normalize();
 
     // Return the ray with modified origin and direction
-    return Ray(rayOrigin, newDirection);
+    Ray ray = Ray::fromUnitDirection(rayOrigin, newDirection, sampleTime(rng));
+    ray.coneAngle = 2.0f * scale / static_cast<float>(height);
+    return ray;
 }
 
-// Helper function to sample a random point on the aperture (lens)
-// Returns: A Vector3 representing the sampled point on the aperture
-Vector3 Camera::sampleAperture() const
+// Returns a copy of the camera with a new shutter interval
+// Parameters:
+// - open, close: Times (0 to 1 within the frame) at which the shutter opens and closes
+// Returns: A Camera sharing this camera's pose, lens and resolution
+Camera Camera::withShutter(float open, float close) const
 {
+    Camera shuttered(*this);
+    shuttered.openTime = open;
+    shuttered.closeTime = close;
+    return shuttered;
+}
 
-    // Use random number generators for uniform sampling within a unit disk
-    static std::random_device rd;                                   // Random device for seeding
-    static std::mt19937 gen(rd());                                  // Mersenne Twister RNG
-    static std::uniform_real_distribution<float> dist(-1.0f, 1.0f); // Uniform distribution in [-1, 1]
-
-    float x, y;
-    do
+// Helper function to sample a time within the shutter interval
+// Parameters:
+// - rng: Random generator to draw the sample from (untouched when the shutter interval is empty)
+// Returns: The time at which the ray samples the scene
+float Camera::sampleTime(std::minstd_rand &rng) const
+{
+    if (closeTime <= openTime)
     {
-        x = dist(gen);
-        y = dist(gen);
-    } while (x * x + y * y > 1.0f); // Ensure the sample is inside the unit disk
+        return openTime;
+    }
+    std::uniform_real_distribution<float> dist(openTime, closeTime);
+    return dist(rng);
+}
+
+// Returns a copy of the camera with a new image resolution
+// Parameters:
+// - width, height: New image dimensions (in pixels)
+// Returns: A Camera sharing this camera's pose, lens and field of view
+Camera Camera::withResolution(int width, int height) const
+{
+    Camera resized(*this);
+    resized.width = width;
+    resized.height = height;
+    resized.aspectRatio = static_cast<float>(width) / static_cast<float>(height);
+    return resized;
+}
 
+// Helper function to sample a random point on the aperture (lens)
+// Parameters:
+// - rng: Random generator to draw the sample from
+// Returns: A Vector3 representing the sampled point on the aperture
+Vector3 Camera::sampleAperture(std::minstd_rand &rng) const
+{
+    // Uniform distribution in [-1, 1] over a square, mapped onto the unit disk: unlike rejection sampling,
+    // every pair of numbers is used and nearby numbers stay nearby on the lens
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    float a = dist(rng);
+    float b = dist(rng);
+    float x, y;
+    concentricDisk(a, b, x, y);
     return Vector3(x * aperture * 0.5f, y * aperture * 0.5f, 0.0f); // Scale to aperture size
 }
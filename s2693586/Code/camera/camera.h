@@ -3,6 +3,8 @@
 
 #include "vector3.h" // Include Vector3 class for 3D vector operations
 #include "ray.h"     // Include Ray class for ray generation
+#include <cmath>     // fabs for the lens mapping
+#include <random>    // Random engines used for aperture sampling
 
 // Class representing a camera in 3D space
 // A camera generates rays for ray tracing, simulating the projection of a scene onto an image plane
@@ -28,6 +30,32 @@ public:
     // Returns: A Ray object starting from the camera and pointing towards the scene
     Ray generateRay(float x, float y) const;
 
+    // Generates a ray for a given pixel, drawing aperture samples from the supplied generator
+    // Parameters:
+    // - x, y: Pixel coordinates in the image plane
+    // - rng: Random generator owned by the caller (e.g. seeded per pixel for reproducible renders)
+    // Returns: A Ray object starting from the camera and pointing towards the scene
+    Ray generateRay(float x, float y, std::minstd_rand &rng) const;
+
+    // Image resolution the camera generates rays for
+    int imageWidth() const { return width; }
+    int imageHeight() const { return height; }
+
+    // Returns a copy of the camera rendering at a different image resolution
+    // The view direction and field of view are kept; only the pixel grid changes
+    Camera withResolution(int width, int height) const;
+
+    // Shutter interval within the frame (0 to 1); rays are given times in this interval
+    float shutterOpen() const { return openTime; }
+    float shutterClose() const { return closeTime; }
+
+    // True if rays start across an aperture (depth of field) rather than at a pinhole
+    bool hasAperture() const { return aperture != 0.0f; }
+
+    // Returns a copy of the camera with a different shutter interval
+    // An empty interval (open == close) renders the scene at that single time without motion blur
+    Camera withShutter(float open, float close) const;
+
 private:
     Vector3 position;    // Camera position in world space
     Vector3 forward;     // Forward direction of the camera (normalized)
@@ -43,9 +71,34 @@ private:
     float aperture;      // Size of the camera's aperture (controls blur strength)
     float focalDistance; // Distance to the focal plane (determines the focus depth)
 
+    // Motion blur properties
+    float openTime = 0.0f;  // Time the shutter opens
+    float closeTime = 0.0f; // Time the shutter closes
+
     // Helper function to sample a random point on the aperture (lens)
     // Used for simulating depth of field effects
-    Vector3 sampleAperture() const;
+    Vector3 sampleAperture(std::minstd_rand &rng) const;
+
+    // Maps a point of the square [-1, 1] x [-1, 1] onto the unit disk, so that concentric squares become
+    // concentric circles (Shirley and Chiu's concentric mapping)
+    // The angle from the axis of the larger coordinate stays within pi / 4, where short polynomials give its
+    // sine and cosine to float precision
+    static void concentricDisk(float a, float b, float &x, float &y)
+    {
+        bool horizontal = std::fabs(a) > std::fabs(b);
+        float radius = horizontal ? a : b;
+        float angle = radius != 0.0f ? 0.785398163f * ((horizontal ? b : a) / radius) : 0.0f;
+        float square = angle * angle;
+        float sine = angle + angle * square * (-1.0f / 6.0f + square * (1.0f / 120.0f + square * (-1.0f / 5040.0f)));
+        float cosine = 1.0f + square * (-0.5f + square * (1.0f / 24.0f + square * (-1.0f / 720.0f + square * (1.0f / 40320.0f))));
+        x = radius * (horizontal ? cosine : sine);
+        y = radius * (horizontal ? sine : cosine);
+    }
+
+    // Helper function to sample a ray time within the shutter interval
+    float sampleTime(std::minstd_rand &rng) const;
+
+    friend class CameraRayGenerator; // Generates the same rays as generateRay a tile at a time
 
 public:
     float exposure; // Exposure setting to control image brightness
@@ -0,0 +1,68 @@
+#include "camera_animation.h"
+#include <algorithm>
+#include <cmath>
+
+// Linear interpolation between two values
+template <typename T>
+static T lerp(const T &a, const T &b, float t)
+{
+    return a * (1.0f - t) + b * t;
+}
+
+CameraKeyframe CameraAnimation::evaluate(int frame) const
+{
+    float time = frame / fps;
+
+    if (turntable)
+    {
+        // Rotate the base position around the axis through lookAt (Rodrigues' rotation formula)
+        float progress = frameCount() > 0 ? static_cast<float>(frame - firstFrame) / frameCount() : 0.0f;
+        float angle = 2.0f * static_cast<float>(M_PI) * revolutions * progress;
+        Vector3 k = turntableAxis.normalize();
+        Vector3 offset = base.position - base.lookAt;
+        Vector3 rotated = offset * std::cos(angle) + k.cross(offset) * std::sin(angle) + k * (k.dot(offset) * (1.0f - std::cos(angle)));
+
+        CameraKeyframe result = base;
+        result.time = time;
+        result.position = base.lookAt + rotated;
+        return result;
+    }
+
+    if (keyframes.empty())
+    {
+        return base;
+    }
+
+    // Hold the first and last keyframes outside the keyed range
+    if (time <= keyframes.front().time)
+    {
+        return keyframes.front();
+    }
+    if (time >= keyframes.back().time)
+    {
+        return keyframes.back();
+    }
+
+    // Find the keyframes surrounding the frame time
+    auto next = std::upper_bound(keyframes.begin(), keyframes.end(), time,
+                                 [](float t, const CameraKeyframe &key)
+                                 { return t < key.time; });
+    const CameraKeyframe &k1 = *next;
+    const CameraKeyframe &k0 = *(next - 1);
+    float t = (k1.time > k0.time) ? (time - k0.time) / (k1.time - k0.time) : 0.0f;
+
+    CameraKeyframe result;
+    result.time = time;
+    result.position = lerp(k0.position, k1.position, t);
+    result.lookAt = lerp(k0.lookAt, k1.lookAt, t);
+    result.fov = lerp(k0.fov, k1.fov, t);
+    result.aperture = lerp(k0.aperture, k1.aperture, t);
+    result.focalDistance = lerp(k0.focalDistance, k1.focalDistance, t);
+    return result;
+}
+
+Camera CameraAnimation::cameraAt(int frame, int width, int height, float exposure) const
+{
+    CameraKeyframe key = evaluate(frame);
+    return Camera(key.position, key.lookAt, upVector, key.fov, width, height, exposure, key.aperture, key.focalDistance);
+}
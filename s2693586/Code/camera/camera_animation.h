@@ -0,0 +1,58 @@
+#ifndef CAMERA_ANIMATION_H
+#define CAMERA_ANIMATION_H
+
+#include <vector>
+#include "vector3.h" // Include Vector3 class for positions and directions
+#include "camera.h"  // Include Camera class built for each frame
+
+// Camera settings at one point in time
+struct CameraKeyframe
+{
+    float time;          // Time of the keyframe in seconds
+    Vector3 position;    // Camera position in world space
+    Vector3 lookAt;      // Point the camera is looking at
+    float fov;           // Field of view in degrees
+    float aperture;      // Aperture size (0 for a pinhole camera)
+    float focalDistance; // Distance to the focal plane
+};
+
+// Class describing a camera path and the range of frames to render along it
+// The path is either a list of keyframes or a turntable that orbits the base camera
+// around its lookAt point
+class CameraAnimation
+{
+public:
+    CameraKeyframe base;                   // Settings of the JSON camera block
+    std::vector<CameraKeyframe> keyframes; // Keyframes sorted by time
+    int firstFrame = 0;                    // First frame to render (inclusive)
+    int lastFrame = -1;                    // Last frame to render (inclusive)
+    float fps = 24.0f;                     // Frames per second, converting frames to keyframe times
+    Vector3 upVector = Vector3(0, 1, 0);   // Up direction used for every frame
+
+    // Turntable settings, used when turntable is true
+    bool turntable = false;
+    Vector3 turntableAxis = Vector3(0, 1, 0); // Rotation axis through the lookAt point
+    float revolutions = 1.0f;                 // Full turns over the frame range
+
+    // Returns true if the scene defines a camera animation
+    bool enabled() const { return turntable || !keyframes.empty(); }
+
+    // Number of frames in the range
+    int frameCount() const { return lastFrame >= firstFrame ? lastFrame - firstFrame + 1 : 0; }
+
+    // Evaluates the camera settings for a frame
+    // Keyframes are interpolated linearly and held before the first and after the last one
+    // Parameters:
+    // - frame: Frame number
+    // Returns: The interpolated camera settings
+    CameraKeyframe evaluate(int frame) const;
+
+    // Builds the camera for a frame
+    // Parameters:
+    // - frame: Frame number
+    // - width, height, exposure: Image settings shared by every frame
+    // Returns: The Camera to render the frame with
+    Camera cameraAt(int frame, int width, int height, float exposure) const;
+};
+
+#endif // CAMERA_ANIMATION_H
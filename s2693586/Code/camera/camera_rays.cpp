@@ -0,0 +1,166 @@
+#include "camera_rays.h"
+#include <algorithm>
+#include <cmath>
+#include "simd_math.h" // Eight rays at a time
+
+CameraRayGenerator::CameraRayGenerator(const Camera &camera, const std::vector<std::pair<float, float>> &points)
+    : camera(camera), samples(static_cast<int>(points.size()))
+{
+    // The same expressions as Camera::generateRay, so the rays match it bit for bit
+    const int width = camera.width, height = camera.height;
+    columnX.resize(static_cast<size_t>(samples) * width);
+    columnY.resize(columnX.size());
+    columnZ.resize(columnX.size());
+    rowNdc.resize(static_cast<size_t>(samples) * height);
+    for (int sample = 0; sample < samples; ++sample)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            float u = x + points[sample].first;
+            float ndcX = (2 * (u + 0.5f) / static_cast<float>(width) - 1) * camera.aspectRatio * camera.scale;
+            Vector3 term = camera.forward + ndcX * camera.right;
+            size_t i = static_cast<size_t>(sample) * width + x;
+            columnX[i] = term.x;
+            columnY[i] = term.y;
+            columnZ[i] = term.z;
+        }
+        for (int y = 0; y < height; ++y)
+        {
+            float v = y + points[sample].second;
+            rowNdc[static_cast<size_t>(sample) * height + y] = (1 - 2 * (v + 0.5f) / static_cast<float>(height)) * camera.scale;
+        }
+    }
+}
+
+bool CameraRayGenerator::random() const
+{
+    return camera.aperture != 0.0f || camera.closeTime > camera.openTime;
+}
+
+void CameraRayGenerator::generate(int x, int y, int width, int height, std::minstd_rand *rngs, CameraRayBlock &block) const
+{
+    block.width = width;
+    block.height = height;
+    block.samples = samples;
+    block.coneAngle = 2.0f * camera.scale / static_cast<float>(camera.height);
+    const size_t count = block.size();
+    for (std::vector<float> *component : {&block.originX, &block.originY, &block.originZ, &block.directionX, &block.directionY,
+                                          &block.directionZ, &block.time})
+    {
+        component->resize(count);
+    }
+
+    // Random numbers first, drawn pixel by pixel in the order generateRay draws them. With an aperture, the
+    // two numbers of the lens position are kept in originX and originY until they are mapped onto the lens
+    const Vector3 &position = camera.position;
+    const bool lens = camera.aperture != 0.0f;
+    if (random())
+    {
+        std::uniform_real_distribution<float> square(-1.0f, 1.0f); // As drawn by Camera::sampleAperture
+        for (int row = 0; row < height; ++row)
+        {
+            for (int column = 0; column < width; ++column)
+            {
+                std::minstd_rand &rng = rngs[static_cast<size_t>(row) * width + column];
+                for (int sample = 0; sample < samples; ++sample)
+                {
+                    size_t i = block.index(column, row, sample);
+                    if (lens)
+                    {
+                        block.originX[i] = square(rng);
+                        block.originY[i] = square(rng);
+                    }
+                    else
+                    {
+                        block.originX[i] = position.x;
+                        block.originY[i] = position.y;
+                    }
+                    block.time[i] = camera.sampleTime(rng);
+                }
+            }
+        }
+    }
+    else
+    {
+        std::fill(block.originX.begin(), block.originX.end(), position.x);
+        std::fill(block.originY.begin(), block.originY.end(), position.y);
+        std::fill(block.time.begin(), block.time.end(), camera.openTime);
+    }
+    std::fill(block.originZ.begin(), block.originZ.end(), position.z);
+
+    if (lens)
+    {
+        generateDirections<true>(x, y, block);
+    }
+    else
+    {
+        generateDirections<false>(x, y, block);
+    }
+}
+
+template <bool Lens>
+void CameraRayGenerator::generateDirections(int x, int y, CameraRayBlock &block) const
+{
+    // Lens positions and directions, a run of columns at a time: each run shares its row term
+    const int width = block.width, height = block.height;
+    const Vector3 &position = camera.position, &forward = camera.forward, &up = camera.up;
+    const float lensScale = camera.aperture, half = 0.5f;
+    for (int row = 0; row < height; ++row)
+    {
+        for (int sample = 0; sample < samples; ++sample)
+        {
+            const size_t columnStart = static_cast<size_t>(sample) * camera.width + x;
+            const float ndcY = rowNdc[static_cast<size_t>(sample) * camera.height + y + row];
+            const size_t first = block.index(0, row, sample);
+            int column = 0;
+            const Vec3x8 rowTerm = Float8(ndcY) * Vec3x8(up);
+            for (; column + 8 <= width; column += 8)
+            {
+                const size_t i = first + column;
+                Vec3x8 direction = normalize(Vec3x8::load(&columnX[columnStart + column], &columnY[columnStart + column],
+                                                          &columnZ[columnStart + column]) + rowTerm);
+                if constexpr (Lens)
+                {
+                    // Camera::concentricDisk on eight lens positions: the larger coordinate picks the wedge
+                    Float8 a = Float8::load(&block.originX[i]), b = Float8::load(&block.originY[i]);
+                    Float8 horizontal = abs(a) > abs(b);
+                    Float8 radius = select(horizontal, a, b);
+                    Float8 angle = select(radius != Float8(0.0f), Float8(0.785398163f) * (select(horizontal, b, a) / radius), Float8(0.0f));
+                    Float8 square = angle * angle;
+                    Float8 sine = angle + angle * square * (Float8(-1.0f / 6.0f) + square * (Float8(1.0f / 120.0f) + square * Float8(-1.0f / 5040.0f)));
+                    Float8 cosine = Float8(1.0f) + square * (Float8(-0.5f) + square * (Float8(1.0f / 24.0f) + square * (Float8(-1.0f / 720.0f) +
+                                                                                                                      square * Float8(1.0f / 40320.0f))));
+                    Float8 diskX = radius * select(horizontal, cosine, sine), diskY = radius * select(horizontal, sine, cosine);
+                    Vec3x8 origin(Float8(position.x) + diskX * Float8(lensScale) * Float8(half),
+                                  Float8(position.y) + diskY * Float8(lensScale) * Float8(half), Float8(position.z));
+                    origin.x.store(&block.originX[i]);
+                    origin.y.store(&block.originY[i]);
+
+                    // Aim from the lens position at the point the pinhole ray meets the focal plane
+                    Float8 t = Float8(camera.focalDistance) / dot(direction, Vec3x8(forward));
+                    direction = normalize(Vec3x8(position) + direction * t - origin);
+                }
+                direction.store(&block.directionX[i], &block.directionY[i], &block.directionZ[i]);
+            }
+            for (; column < width; ++column)
+            {
+                size_t i = first + column;
+                Vector3 term(columnX[columnStart + column], columnY[columnStart + column], columnZ[columnStart + column]);
+                Vector3 direction = (term + ndcY * up).normalize();
+                if constexpr (Lens)
+                {
+                    float diskX, diskY;
+                    Camera::concentricDisk(block.originX[i], block.originY[i], diskX, diskY);
+                    Vector3 origin = position + Vector3(diskX * lensScale * half, diskY * lensScale * half, 0.0f);
+                    block.originX[i] = origin.x;
+                    block.originY[i] = origin.y;
+                    Vector3 focalPoint = position + direction * (camera.focalDistance / direction.dot(forward));
+                    direction = (focalPoint - origin).normalize();
+                }
+                block.directionX[i] = direction.x;
+                block.directionY[i] = direction.y;
+                block.directionZ[i] = direction.z;
+            }
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef CAMERA_RAYS_H
+#define CAMERA_RAYS_H
+
+#include <cstddef>
+#include <random>
+#include <utility>
+#include <vector>
+#include "camera.h" // Camera the rays are generated for
+#include "ray.h"    // Rays assembled from a block
+
+// Camera rays of a tile stored component by component (a structure of arrays), so that SIMD code loads and
+// stores the same component of several rays at once
+// The rays of each tile row are grouped by sample: ray index(column, row, sample) follows the rays of the
+// same row and sample in the columns before it
+struct CameraRayBlock
+{
+    std::vector<float> originX, originY, originZ;
+    std::vector<float> directionX, directionY, directionZ; // Normalized
+    std::vector<float> time;
+    float coneAngle = 0.0f;                 // Pixel footprint per unit distance, the same for every ray
+    int width = 0, height = 0, samples = 0; // Tile and samples per pixel the block was generated for
+
+    size_t size() const { return static_cast<size_t>(width) * height * samples; }
+
+    // Position of a ray in the arrays
+    // Parameters:
+    // - column, row: Pixel within the tile
+    // - sample: Index into the sample offsets the block was generated with
+    size_t index(int column, int row, int sample) const
+    {
+        return (static_cast<size_t>(row) * samples + sample) * width + column;
+    }
+
+    // Assembles the ray at the given position in the arrays
+    Ray ray(size_t i) const
+    {
+        Ray ray = Ray::fromUnitDirection(Vector3(originX[i], originY[i], originZ[i]),
+                                         Vector3(directionX[i], directionY[i], directionZ[i]), time[i]);
+        ray.coneAngle = coneAngle;
+        return ray;
+    }
+};
+
+// Generates the camera rays of every sample of a tile of pixels at once
+// The image-plane coordinates of each column and row are computed once per sample offset when the
+// generator is made, so a ray costs a multiply-add per axis and a normalization, done eight rays at a time
+// with Vec3x8 (simd_math.h). Lens positions are drawn from each pixel's generator exactly as Camera::generateRay draws
+// them, so a block holds the same rays as calls to generateRay with the same offsets and generators.
+class CameraRayGenerator
+{
+public:
+    // Parameters:
+    // - camera: Camera to generate rays for
+    // - points: Sample offsets within a pixel (as passed to generateRay, added to the pixel coordinates)
+    CameraRayGenerator(const Camera &camera, const std::vector<std::pair<float, float>> &points);
+
+    // True if the camera draws lens positions or times from the pixels' generators
+    bool random() const;
+
+    // Generates the rays of every sample of the pixels in a tile
+    // Parameters:
+    // - x, y: Camera pixel coordinates of the tile's first column and row
+    // - width, height: Tile size in pixels
+    // - rngs: One generator per pixel of the tile, row by row, drawn from for each sample in turn (may be
+    //   nullptr when random() is false)
+    // - block: Receives the rays
+    void generate(int x, int y, int width, int height, std::minstd_rand *rngs, CameraRayBlock &block) const;
+
+private:
+    // Computes the directions of a block whose random numbers are drawn, and with Lens maps the lens
+    // positions kept in originX and originY onto the aperture; compiled once with and once without the lens
+    template <bool Lens>
+    void generateDirections(int x, int y, CameraRayBlock &block) const;
+
+    Camera camera;
+    int samples;
+    std::vector<float> columnX, columnY, columnZ; // forward + ndcX * right, per sample and image column
+    std::vector<float> rowNdc;                    // ndcY (the weight of up), per sample and image row
+};
+
+#endif // CAMERA_RAYS_H
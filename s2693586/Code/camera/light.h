@@ -1,20 +1,142 @@
 #ifndef LIGHT_H
 #define LIGHT_H
 
+#include <cmath>
 #include "../camera/vector3.h" // Include Vector3 class for representing 3D vectors
 
+// Largest number of shadow-ray samples taken per light at a shading point
+const int MAX_LIGHT_SAMPLES = 256;
+
+// Shape of a light source
+enum class LightShape
+{
+    POINT,     // Infinitely small light at its position
+    RECTANGLE, // Parallelogram centred on its position, spanned by two edges
+    DISK,      // Disk centred on its position, in the plane of two axes
+    SPHERE     // Sphere centred on its position
+};
+
 // Class representing a light source in the scene
-// A light source is defined by its position in 3D space and its intensity (RGB values)
+// A light source is defined by its position in 3D space and its intensity (RGB values). Area lights
+// also have a shape and are sampled at several points per shading point, each sample acting as a
+// point light that carries an equal share of the intensity.
 class Light
 {
 public:
-    Vector3 position;  // Position of the light source in world space
-    Vector3 intensity; // Intensity of the light, represented as RGB values
+    Vector3 position;                     // Position of the light source in world space (the centre of area lights)
+    Vector3 intensity;                    // Intensity of the light, represented as RGB values
+    LightShape shape = LightShape::POINT; // Shape of the light
+    Vector3 axisU, axisV;                 // Rectangle: the full edges; disk: unit axes of its plane
+    float radius = 0.0f;                  // Radius of disk and sphere lights
+    int samples = 1;                      // Shadow rays per shading point for area lights (rounded down to a square)
 
     // Constructor
     // Initializes the light source with a specified position and intensity
     Light(const Vector3 &position, const Vector3 &intensity)
         : position(position), intensity(intensity) {}
+
+    // Creates a rectangular area light
+    // Parameters:
+    // - center: Centre of the rectangle
+    // - edgeU, edgeV: Edges spanning the rectangle
+    // - intensity: Total intensity of the light
+    // - samples: Shadow rays per shading point
+    static Light rectangle(const Vector3 &center, const Vector3 &edgeU, const Vector3 &edgeV, const Vector3 &intensity, int samples)
+    {
+        Light light(center, intensity);
+        light.shape = LightShape::RECTANGLE;
+        light.axisU = edgeU;
+        light.axisV = edgeV;
+        light.samples = samples;
+        return light;
+    }
+
+    // Creates a disk area light
+    // Parameters:
+    // - center: Centre of the disk
+    // - normal: Normal of the disk's plane
+    // - radius: Radius of the disk
+    // - intensity: Total intensity of the light
+    // - samples: Shadow rays per shading point
+    static Light disk(const Vector3 &center, const Vector3 &normal, float radius, const Vector3 &intensity, int samples)
+    {
+        Light light(center, intensity);
+        light.shape = LightShape::DISK;
+        Vector3 n = normal.normalize();
+        Vector3 helper = std::fabs(n.x) > 0.9f ? Vector3(0.0f, 1.0f, 0.0f) : Vector3(1.0f, 0.0f, 0.0f);
+        light.axisU = n.cross(helper).normalize();
+        light.axisV = n.cross(light.axisU);
+        light.radius = radius;
+        light.samples = samples;
+        return light;
+    }
+
+    // Creates a spherical area light
+    // Parameters:
+    // - center: Centre of the sphere
+    // - radius: Radius of the sphere
+    // - intensity: Total intensity of the light
+    // - samples: Shadow rays per shading point
+    static Light sphere(const Vector3 &center, float radius, const Vector3 &intensity, int samples)
+    {
+        Light light(center, intensity);
+        light.shape = LightShape::SPHERE;
+        light.radius = radius;
+        light.samples = samples;
+        return light;
+    }
+
+    // Returns true for lights with an extent, which need more than one shadow ray
+    bool isArea() const { return shape != LightShape::POINT; }
+
+    // Returns the point on the light for the sample (u, v) in [0, 1)^2
+    // Parameters:
+    // - u, v: Sample coordinates; a stratified grid of them gives stratified points on the light
+    // - from: The shading point; sphere lights are sampled on the half facing it
+    Vector3 samplePoint(float u, float v, const Vector3 &from) const
+    {
+        const float pi = 3.14159265358979f;
+        switch (shape)
+        {
+        case LightShape::RECTANGLE:
+            return position + axisU * (u - 0.5f) + axisV * (v - 0.5f);
+        case LightShape::DISK:
+        {
+            // Concentric mapping keeps neighbouring strata compact on the disk
+            float a = 2.0f * u - 1.0f, b = 2.0f * v - 1.0f;
+            float r, phi;
+            if (a == 0.0f && b == 0.0f)
+            {
+                return position;
+            }
+            if (std::fabs(a) > std::fabs(b))
+            {
+                r = a;
+                phi = (pi / 4.0f) * (b / a);
+            }
+            else
+            {
+                r = b;
+                phi = pi / 2.0f - (pi / 4.0f) * (a / b);
+            }
+            return position + (axisU * std::cos(phi) + axisV * std::sin(phi)) * (r * radius);
+        }
+        case LightShape::SPHERE:
+        {
+            // Uniform over the hemisphere facing the shading point
+            Vector3 w = (from - position).normalize();
+            Vector3 helper = std::fabs(w.x) > 0.9f ? Vector3(0.0f, 1.0f, 0.0f) : Vector3(1.0f, 0.0f, 0.0f);
+            Vector3 s = w.cross(helper).normalize();
+            Vector3 t = w.cross(s);
+            float z = u;
+            float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+            float phi = 2.0f * pi * v;
+            return position + (s * (r * std::cos(phi)) + t * (r * std::sin(phi)) + w * z) * radius;
+        }
+        default:
+            return position;
+        }
+    }
 };
 
 #endif // LIGHT_H
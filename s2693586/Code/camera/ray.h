@@ -10,15 +10,37 @@ class Ray
 public:
     Vector3 origin;    // The starting point of the ray
     Vector3 direction; // The direction of the ray (normalized)
+    float time;        // Time within the frame (0 to 1) at which the ray samples moving shapes
+
+    // Ray cone used to estimate the surface footprint of a pixel (for texture filtering)
+    float coneWidth = 0.0f; // Width of the cone at the ray origin
+    float coneAngle = 0.0f; // Growth of the width per unit distance along the ray
 
     // Default constructor
     // Initializes the ray with an origin at (0, 0, 0) and a default direction (0, 1, 0)
-    Ray() : origin(Vector3()), direction(Vector3(0, 1, 0)) {}
+    Ray() : origin(Vector3()), direction(Vector3(0, 1, 0)), time(0.0f) {}
 
     // Parameterized constructor
-    // Initializes the ray with a specified origin and direction
+    // Initializes the ray with a specified origin, direction and time
     // The direction vector is automatically normalized
-    Ray(const Vector3 &origin, const Vector3 &direction) : origin(origin), direction(direction.normalize()) {}
+    Ray(const Vector3 &origin, const Vector3 &direction, float time = 0.0f) : origin(origin), direction(direction.normalize()), time(time) {}
+
+    // Builds a ray from a direction that is already normalized, without normalizing it again
+    static Ray fromUnitDirection(const Vector3 &origin, const Vector3 &direction, float time = 0.0f)
+    {
+        Ray ray;
+        ray.origin = origin;
+        ray.direction = direction;
+        ray.time = time;
+        return ray;
+    }
+
+    // Continues the cone of a parent ray from the point it hit at the given distance
+    void inheritCone(const Ray &parent, float distance)
+    {
+        coneWidth = parent.coneWidth + parent.coneAngle * distance;
+        coneAngle = parent.coneAngle;
+    }
 };
 
 #endif // RAY_H
@@ -0,0 +1,308 @@
+#ifndef SIMD_MATH_H
+#define SIMD_MATH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include "vector3.h" // Converted to and from the hot-path types
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h> // SSE2 intrinsics for Float4
+#define SIMD_MATH_SSE 1
+#endif
+#if defined(SIMD_MATH_SSE) && defined(__AVX__)
+#include <immintrin.h> // AVX intrinsics for Float8, when the whole build targets AVX
+#define SIMD_MATH_AVX 1
+#endif
+
+// Vector math for the hot paths: ray generation, box tests and other kernels
+// Unlike Vector3, nothing here branches, prints or throws: dividing by zero gives an IEEE infinity or NaN,
+// and min and max return their second operand when either operand is NaN (as SSE does). Every operation
+// is forced inline, so a kernel that calls one where it cannot be inlined fails to compile rather than
+// silently keeping a call in its inner loop.
+#if defined(__GNUC__)
+#define SIMD_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define SIMD_INLINE __forceinline
+#else
+#define SIMD_INLINE inline
+#endif
+
+// Four floats, in an SSE register where available
+// Comparisons return masks with all bits of the true lanes set, for select()
+struct alignas(16) Float4
+{
+#ifdef SIMD_MATH_SSE
+    __m128 v;
+
+    SIMD_INLINE Float4() noexcept : v(_mm_setzero_ps()) {}
+    SIMD_INLINE explicit Float4(__m128 v) noexcept : v(v) {}
+    SIMD_INLINE explicit Float4(float value) noexcept : v(_mm_set1_ps(value)) {}
+    SIMD_INLINE Float4(float x, float y, float z, float w) noexcept : v(_mm_setr_ps(x, y, z, w)) {}
+    SIMD_INLINE static Float4 load(const float *p) noexcept { return Float4(_mm_loadu_ps(p)); }
+    SIMD_INLINE void store(float *p) const noexcept { _mm_storeu_ps(p, v); }
+    SIMD_INLINE float lane(int i) const noexcept
+    {
+        alignas(16) float f[4];
+        _mm_store_ps(f, v);
+        return f[i & 3];
+    }
+#else
+    float f[4];
+
+    SIMD_INLINE Float4() noexcept : f{0.0f, 0.0f, 0.0f, 0.0f} {}
+    SIMD_INLINE explicit Float4(float value) noexcept : f{value, value, value, value} {}
+    SIMD_INLINE Float4(float x, float y, float z, float w) noexcept : f{x, y, z, w} {}
+    SIMD_INLINE static Float4 load(const float *p) noexcept { return Float4(p[0], p[1], p[2], p[3]); }
+    SIMD_INLINE void store(float *p) const noexcept { std::memcpy(p, f, sizeof(f)); }
+    SIMD_INLINE float lane(int i) const noexcept { return f[i & 3]; }
+#endif
+};
+
+#ifdef SIMD_MATH_SSE
+SIMD_INLINE Float4 operator+(Float4 a, Float4 b) noexcept { return Float4(_mm_add_ps(a.v, b.v)); }
+SIMD_INLINE Float4 operator-(Float4 a, Float4 b) noexcept { return Float4(_mm_sub_ps(a.v, b.v)); }
+SIMD_INLINE Float4 operator*(Float4 a, Float4 b) noexcept { return Float4(_mm_mul_ps(a.v, b.v)); }
+SIMD_INLINE Float4 operator/(Float4 a, Float4 b) noexcept { return Float4(_mm_div_ps(a.v, b.v)); }
+SIMD_INLINE Float4 min(Float4 a, Float4 b) noexcept { return Float4(_mm_min_ps(a.v, b.v)); }
+SIMD_INLINE Float4 max(Float4 a, Float4 b) noexcept { return Float4(_mm_max_ps(a.v, b.v)); }
+SIMD_INLINE Float4 sqrt(Float4 a) noexcept { return Float4(_mm_sqrt_ps(a.v)); }
+SIMD_INLINE Float4 abs(Float4 a) noexcept { return Float4(_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)); }
+SIMD_INLINE Float4 operator<(Float4 a, Float4 b) noexcept { return Float4(_mm_cmplt_ps(a.v, b.v)); }
+SIMD_INLINE Float4 operator>(Float4 a, Float4 b) noexcept { return Float4(_mm_cmpgt_ps(a.v, b.v)); }
+SIMD_INLINE Float4 operator<=(Float4 a, Float4 b) noexcept { return Float4(_mm_cmple_ps(a.v, b.v)); }
+SIMD_INLINE Float4 operator!=(Float4 a, Float4 b) noexcept { return Float4(_mm_cmpneq_ps(a.v, b.v)); }
+SIMD_INLINE Float4 operator&(Float4 a, Float4 b) noexcept { return Float4(_mm_and_ps(a.v, b.v)); }
+SIMD_INLINE Float4 operator|(Float4 a, Float4 b) noexcept { return Float4(_mm_or_ps(a.v, b.v)); }
+// Lanes of a where mask is set, of b elsewhere
+SIMD_INLINE Float4 select(Float4 mask, Float4 a, Float4 b) noexcept { return Float4(_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))); }
+// One bit per lane, set where the mask is
+SIMD_INLINE int bits(Float4 mask) noexcept { return _mm_movemask_ps(mask.v); }
+// Smallest and largest of the first three lanes, which must not be NaN
+SIMD_INLINE float min3(Float4 a) noexcept
+{
+    __m128 m = _mm_min_ps(a.v, _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(_mm_min_ps(m, _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(2, 2, 2, 2))));
+}
+SIMD_INLINE float max3(Float4 a) noexcept
+{
+    __m128 m = _mm_max_ps(a.v, _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(_mm_max_ps(m, _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(2, 2, 2, 2))));
+}
+#else
+namespace simd_detail
+{
+    SIMD_INLINE float floatOf(uint32_t word) noexcept
+    {
+        float value;
+        std::memcpy(&value, &word, sizeof(value));
+        return value;
+    }
+    SIMD_INLINE float maskOf(bool set) noexcept { return floatOf(set ? 0xffffffffu : 0u); }
+    SIMD_INLINE uint32_t wordOf(float value) noexcept
+    {
+        uint32_t word;
+        std::memcpy(&word, &value, sizeof(word));
+        return word;
+    }
+    template <typename Op>
+    SIMD_INLINE Float4 lanes(Float4 a, Float4 b, Op op) noexcept
+    {
+        return Float4(op(a.f[0], b.f[0]), op(a.f[1], b.f[1]), op(a.f[2], b.f[2]), op(a.f[3], b.f[3]));
+    }
+}
+SIMD_INLINE Float4 operator+(Float4 a, Float4 b) noexcept { return simd_detail::lanes(a, b, [](float x, float y) { return x + y; }); }
+SIMD_INLINE Float4 operator-(Float4 a, Float4 b) noexcept { return simd_detail::lanes(a, b, [](float x, float y) { return x - y; }); }
+SIMD_INLINE Float4 operator*(Float4 a, Float4 b) noexcept { return simd_detail::lanes(a, b, [](float x, float y) { return x * y; }); }
+SIMD_INLINE Float4 operator/(Float4 a, Float4 b) noexcept { return simd_detail::lanes(a, b, [](float x, float y) { return x / y; }); }
+SIMD_INLINE Float4 min(Float4 a, Float4 b) noexcept { return simd_detail::lanes(a, b, [](float x, float y) { return x < y ? x : y; }); }
+SIMD_INLINE Float4 max(Float4 a, Float4 b) noexcept { return simd_detail::lanes(a, b, [](float x, float y) { return x > y ? x : y; }); }
+SIMD_INLINE Float4 sqrt(Float4 a) noexcept { return Float4(std::sqrt(a.f[0]), std::sqrt(a.f[1]), std::sqrt(a.f[2]), std::sqrt(a.f[3])); }
+SIMD_INLINE Float4 abs(Float4 a) noexcept { return Float4(std::fabs(a.f[0]), std::fabs(a.f[1]), std::fabs(a.f[2]), std::fabs(a.f[3])); }
+SIMD_INLINE Float4 operator<(Float4 a, Float4 b) noexcept { return simd_detail::lanes(a, b, [](float x, float y) { return simd_detail::maskOf(x < y); }); }
+SIMD_INLINE Float4 operator>(Float4 a, Float4 b) noexcept { return simd_detail::lanes(a, b, [](float x, float y) { return simd_detail::maskOf(x > y); }); }
+SIMD_INLINE Float4 operator<=(Float4 a, Float4 b) noexcept { return simd_detail::lanes(a, b, [](float x, float y) { return simd_detail::maskOf(x <= y); }); }
+SIMD_INLINE Float4 operator!=(Float4 a, Float4 b) noexcept { return simd_detail::lanes(a, b, [](float x, float y) { return simd_detail::maskOf(x != y); }); }
+SIMD_INLINE Float4 operator&(Float4 a, Float4 b) noexcept
+{
+    return simd_detail::lanes(a, b, [](float x, float y) { return simd_detail::floatOf(simd_detail::wordOf(x) & simd_detail::wordOf(y)); });
+}
+SIMD_INLINE Float4 operator|(Float4 a, Float4 b) noexcept
+{
+    return simd_detail::lanes(a, b, [](float x, float y) { return simd_detail::floatOf(simd_detail::wordOf(x) | simd_detail::wordOf(y)); });
+}
+SIMD_INLINE Float4 select(Float4 mask, Float4 a, Float4 b) noexcept
+{
+    return Float4(simd_detail::wordOf(mask.f[0]) ? a.f[0] : b.f[0], simd_detail::wordOf(mask.f[1]) ? a.f[1] : b.f[1],
+                  simd_detail::wordOf(mask.f[2]) ? a.f[2] : b.f[2], simd_detail::wordOf(mask.f[3]) ? a.f[3] : b.f[3]);
+}
+SIMD_INLINE int bits(Float4 mask) noexcept
+{
+    return (simd_detail::wordOf(mask.f[0]) ? 1 : 0) | (simd_detail::wordOf(mask.f[1]) ? 2 : 0) |
+           (simd_detail::wordOf(mask.f[2]) ? 4 : 0) | (simd_detail::wordOf(mask.f[3]) ? 8 : 0);
+}
+SIMD_INLINE float min3(Float4 a) noexcept { return std::min(std::min(a.f[0], a.f[1]), a.f[2]); }
+SIMD_INLINE float max3(Float4 a) noexcept { return std::max(std::max(a.f[0], a.f[1]), a.f[2]); }
+#endif
+
+// A 3D vector in the first three lanes of a Float4, with the fourth lane kept at 0
+struct Float3
+{
+    Float4 v;
+
+    SIMD_INLINE Float3() noexcept {}
+    SIMD_INLINE explicit Float3(Float4 v) noexcept : v(v) {}
+    SIMD_INLINE Float3(float x, float y, float z) noexcept : v(x, y, z, 0.0f) {}
+    SIMD_INLINE explicit Float3(const Vector3 &vector) noexcept : v(vector.x, vector.y, vector.z, 0.0f) {}
+
+    SIMD_INLINE float x() const noexcept { return v.lane(0); }
+    SIMD_INLINE float y() const noexcept { return v.lane(1); }
+    SIMD_INLINE float z() const noexcept { return v.lane(2); }
+    SIMD_INLINE Vector3 toVector3() const noexcept
+    {
+        alignas(16) float f[4];
+        v.store(f);
+        return Vector3(f[0], f[1], f[2]);
+    }
+};
+
+SIMD_INLINE Float3 operator+(Float3 a, Float3 b) noexcept { return Float3(a.v + b.v); }
+SIMD_INLINE Float3 operator-(Float3 a, Float3 b) noexcept { return Float3(a.v - b.v); }
+SIMD_INLINE Float3 operator*(Float3 a, float s) noexcept { return Float3(a.v * Float4(s)); }
+SIMD_INLINE Float3 operator*(Float3 a, Float3 b) noexcept { return Float3(a.v * b.v); }
+SIMD_INLINE Float3 min(Float3 a, Float3 b) noexcept { return Float3(min(a.v, b.v)); }
+SIMD_INLINE Float3 max(Float3 a, Float3 b) noexcept { return Float3(max(a.v, b.v)); }
+
+// x * x + y * y + z * z, added in that order as Vector3::dot does
+SIMD_INLINE float dot(Float3 a, Float3 b) noexcept
+{
+    alignas(16) float f[4];
+    (a.v * b.v).store(f);
+    return f[0] + f[1] + f[2];
+}
+SIMD_INLINE Float3 cross(Float3 a, Float3 b) noexcept
+{
+    return Float3(a.y() * b.z() - a.z() * b.y(), a.z() * b.x() - a.x() * b.z(), a.x() * b.y() - a.y() * b.x());
+}
+SIMD_INLINE float length(Float3 a) noexcept { return std::sqrt(dot(a, a)); }
+
+// The vector divided by its length, or the zero vector for a zero vector (as Vector3::normalize)
+SIMD_INLINE Float3 normalize(Float3 a) noexcept
+{
+    Float4 len(length(a));
+    return Float3(select(len > Float4(0.0f), a.v / len, Float4(0.0f)));
+}
+
+// Eight floats, in an AVX register when the build targets AVX and in two Float4 otherwise
+struct alignas(32) Float8
+{
+#ifdef SIMD_MATH_AVX
+    __m256 v;
+
+    SIMD_INLINE Float8() noexcept : v(_mm256_setzero_ps()) {}
+    SIMD_INLINE explicit Float8(__m256 v) noexcept : v(v) {}
+    SIMD_INLINE explicit Float8(float value) noexcept : v(_mm256_set1_ps(value)) {}
+    SIMD_INLINE static Float8 load(const float *p) noexcept { return Float8(_mm256_loadu_ps(p)); }
+    SIMD_INLINE void store(float *p) const noexcept { _mm256_storeu_ps(p, v); }
+#else
+    Float4 lo, hi;
+
+    SIMD_INLINE Float8() noexcept {}
+    SIMD_INLINE Float8(Float4 lo, Float4 hi) noexcept : lo(lo), hi(hi) {}
+    SIMD_INLINE explicit Float8(float value) noexcept : lo(value), hi(value) {}
+    SIMD_INLINE static Float8 load(const float *p) noexcept { return Float8(Float4::load(p), Float4::load(p + 4)); }
+    SIMD_INLINE void store(float *p) const noexcept
+    {
+        lo.store(p);
+        hi.store(p + 4);
+    }
+#endif
+};
+
+#ifdef SIMD_MATH_AVX
+SIMD_INLINE Float8 operator+(Float8 a, Float8 b) noexcept { return Float8(_mm256_add_ps(a.v, b.v)); }
+SIMD_INLINE Float8 operator-(Float8 a, Float8 b) noexcept { return Float8(_mm256_sub_ps(a.v, b.v)); }
+SIMD_INLINE Float8 operator*(Float8 a, Float8 b) noexcept { return Float8(_mm256_mul_ps(a.v, b.v)); }
+SIMD_INLINE Float8 operator/(Float8 a, Float8 b) noexcept { return Float8(_mm256_div_ps(a.v, b.v)); }
+SIMD_INLINE Float8 min(Float8 a, Float8 b) noexcept { return Float8(_mm256_min_ps(a.v, b.v)); }
+SIMD_INLINE Float8 max(Float8 a, Float8 b) noexcept { return Float8(_mm256_max_ps(a.v, b.v)); }
+SIMD_INLINE Float8 sqrt(Float8 a) noexcept { return Float8(_mm256_sqrt_ps(a.v)); }
+SIMD_INLINE Float8 abs(Float8 a) noexcept { return Float8(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)); }
+SIMD_INLINE Float8 operator<(Float8 a, Float8 b) noexcept { return Float8(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)); }
+SIMD_INLINE Float8 operator>(Float8 a, Float8 b) noexcept { return Float8(_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)); }
+SIMD_INLINE Float8 operator<=(Float8 a, Float8 b) noexcept { return Float8(_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)); }
+SIMD_INLINE Float8 operator!=(Float8 a, Float8 b) noexcept { return Float8(_mm256_cmp_ps(a.v, b.v, _CMP_NEQ_UQ)); }
+SIMD_INLINE Float8 select(Float8 mask, Float8 a, Float8 b) noexcept { return Float8(_mm256_blendv_ps(b.v, a.v, mask.v)); }
+SIMD_INLINE int bits(Float8 mask) noexcept { return _mm256_movemask_ps(mask.v); }
+#else
+SIMD_INLINE Float8 operator+(Float8 a, Float8 b) noexcept { return Float8(a.lo + b.lo, a.hi + b.hi); }
+SIMD_INLINE Float8 operator-(Float8 a, Float8 b) noexcept { return Float8(a.lo - b.lo, a.hi - b.hi); }
+SIMD_INLINE Float8 operator*(Float8 a, Float8 b) noexcept { return Float8(a.lo * b.lo, a.hi * b.hi); }
+SIMD_INLINE Float8 operator/(Float8 a, Float8 b) noexcept { return Float8(a.lo / b.lo, a.hi / b.hi); }
+SIMD_INLINE Float8 min(Float8 a, Float8 b) noexcept { return Float8(min(a.lo, b.lo), min(a.hi, b.hi)); }
+SIMD_INLINE Float8 max(Float8 a, Float8 b) noexcept { return Float8(max(a.lo, b.lo), max(a.hi, b.hi)); }
+SIMD_INLINE Float8 sqrt(Float8 a) noexcept { return Float8(sqrt(a.lo), sqrt(a.hi)); }
+SIMD_INLINE Float8 abs(Float8 a) noexcept { return Float8(abs(a.lo), abs(a.hi)); }
+SIMD_INLINE Float8 operator<(Float8 a, Float8 b) noexcept { return Float8(a.lo < b.lo, a.hi < b.hi); }
+SIMD_INLINE Float8 operator>(Float8 a, Float8 b) noexcept { return Float8(a.lo > b.lo, a.hi > b.hi); }
+SIMD_INLINE Float8 operator<=(Float8 a, Float8 b) noexcept { return Float8(a.lo <= b.lo, a.hi <= b.hi); }
+SIMD_INLINE Float8 operator!=(Float8 a, Float8 b) noexcept { return Float8(a.lo != b.lo, a.hi != b.hi); }
+SIMD_INLINE Float8 select(Float8 mask, Float8 a, Float8 b) noexcept { return Float8(select(mask.lo, a.lo, b.lo), select(mask.hi, a.hi, b.hi)); }
+SIMD_INLINE int bits(Float8 mask) noexcept { return bits(mask.lo) | (bits(mask.hi) << 4); }
+#endif
+
+// Eight 3D vectors stored component by component, for kernels working on eight rays or points at once
+struct Vec3x8
+{
+    Float8 x, y, z;
+
+    SIMD_INLINE Vec3x8() noexcept {}
+    SIMD_INLINE Vec3x8(Float8 x, Float8 y, Float8 z) noexcept : x(x), y(y), z(z) {}
+    // The same vector in every lane
+    SIMD_INLINE explicit Vec3x8(const Vector3 &v) noexcept : x(v.x), y(v.y), z(v.z) {}
+    // Loads eight vectors from separate component arrays
+    SIMD_INLINE static Vec3x8 load(const float *x, const float *y, const float *z) noexcept
+    {
+        return Vec3x8(Float8::load(x), Float8::load(y), Float8::load(z));
+    }
+    SIMD_INLINE void store(float *outX, float *outY, float *outZ) const noexcept
+    {
+        x.store(outX);
+        y.store(outY);
+        z.store(outZ);
+    }
+};
+
+SIMD_INLINE Vec3x8 operator+(const Vec3x8 &a, const Vec3x8 &b) noexcept { return Vec3x8(a.x + b.x, a.y + b.y, a.z + b.z); }
+SIMD_INLINE Vec3x8 operator-(const Vec3x8 &a, const Vec3x8 &b) noexcept { return Vec3x8(a.x - b.x, a.y - b.y, a.z - b.z); }
+SIMD_INLINE Vec3x8 operator*(const Vec3x8 &a, Float8 s) noexcept { return Vec3x8(a.x * s, a.y * s, a.z * s); }
+SIMD_INLINE Vec3x8 operator*(Float8 s, const Vec3x8 &a) noexcept { return Vec3x8(s * a.x, s * a.y, s * a.z); }
+SIMD_INLINE Vec3x8 operator/(const Vec3x8 &a, Float8 s) noexcept { return Vec3x8(a.x / s, a.y / s, a.z / s); }
+SIMD_INLINE Vec3x8 select(Float8 mask, const Vec3x8 &a, const Vec3x8 &b) noexcept
+{
+    return Vec3x8(select(mask, a.x, b.x), select(mask, a.y, b.y), select(mask, a.z, b.z));
+}
+SIMD_INLINE Float8 dot(const Vec3x8 &a, const Vec3x8 &b) noexcept { return a.x * b.x + a.y * b.y + a.z * b.z; }
+SIMD_INLINE Vec3x8 cross(const Vec3x8 &a, const Vec3x8 &b) noexcept
+{
+    return Vec3x8(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+SIMD_INLINE Float8 length(const Vec3x8 &a) noexcept { return sqrt(dot(a, a)); }
+
+// Each vector divided by its length, with zero vectors kept at zero (as Vector3::normalize)
+SIMD_INLINE Vec3x8 normalize(const Vec3x8 &a) noexcept
+{
+    Float8 len = length(a);
+    return select(len > Float8(0.0f), a / len, Vec3x8(Float8(0.0f), Float8(0.0f), Float8(0.0f)));
+}
+
+static_assert(std::is_trivially_copyable<Float4>::value && std::is_trivially_copyable<Float8>::value &&
+                  std::is_trivially_copyable<Vec3x8>::value,
+              "Hot-path vectors must be plain registers");
+static_assert(noexcept(std::declval<Float4>() / std::declval<Float4>()) && noexcept(normalize(std::declval<Float3>())) &&
+                  noexcept(normalize(std::declval<Vec3x8>())),
+              "Hot-path vector operations must not throw");
+
+#endif // SIMD_MATH_H
@@ -3,6 +3,8 @@
 
 #include <cmath>    // For mathematical operations like sqrt, pow
 #include <iostream> // For output stream operations
+#include <stdexcept> // For exceptions thrown on invalid operations
+#include <algorithm> // For std::min and std::max
 
 // Class representing a 3D vector with basic vector operations
 class Vector3
@@ -94,7 +96,7 @@ public:
         float len = length();
         if (len > 0)
         {
-            return *this / len; // Normalize by dividing each component by the length
+            return Vector3(x / len, y / len, z / len); // Divide each component by the (nonzero) length
         }
         return Vector3(0, 0, 0); // Return zero vector if the length is zero
     }
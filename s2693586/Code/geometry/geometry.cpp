@@ -1,10 +1,28 @@
 #include "geometry.h"
 #include <cmath>
+#include <algorithm>
+#include <limits>
+#include <vector>
 
-Intersection Sphere::intersect(const Ray &ray) const
+Intersection Sphere::intersectAtRest(const Ray &ray) const
 {
     Intersection result;
+    float t;
+    uint32_t primitive;
+    if (hitDistanceAtRest(ray, std::numeric_limits<float>::max(), t, primitive))
+    {
+        // Populate intersection result
+        result.hit = true;
+        result.distance = t;
+        result.point = ray.origin + ray.direction * t;       // Compute intersection point
+        result.normal = (result.point - center).normalize(); // Compute surface normal
+        result.material = material;                          // Assign material properties
+    }
+    return result;
+}
 
+bool Sphere::hitDistanceAtRest(const Ray &ray, float maxDistance, float &distance, uint32_t &primitive) const
+{
     // Vector from ray origin to sphere center
     Vector3 oc = ray.origin - center;
 
@@ -17,28 +35,19 @@ Intersection Sphere::intersect(const Ray &ray) const
     // Check if the discriminant indicates an intersection
     if (discriminant < 0)
     {
-        return result; // No intersection
+        return false; // No intersection
     }
-    else
-    {
-        // Compute the two solutions of the quadratic equation
-        float sqrtDiscriminant = std::sqrt(discriminant);
-        float t1 = (-b - sqrtDiscriminant) / (2.0f * a);
-        float t2 = (-b + sqrtDiscriminant) / (2.0f * a);
 
-        // Choose the nearest positive intersection point
-        float t = (t1 > 0 && t2 > 0) ? std::min(t1, t2) : ((t1 > 0) ? t1 : t2);
-        if (t > 0)
-        {
-            // Populate intersection result
-            result.hit = true;
-            result.distance = t;
-            result.point = ray.origin + ray.direction * t;       // Compute intersection point
-            result.normal = (result.point - center).normalize(); // Compute surface normal
-            result.material = material;                          // Assign material properties
-        }
-    }
-    return result;
+    // Compute the two solutions of the quadratic equation
+    float sqrtDiscriminant = std::sqrt(discriminant);
+    float t1 = (-b - sqrtDiscriminant) / (2.0f * a);
+    float t2 = (-b + sqrtDiscriminant) / (2.0f * a);
+
+    // Choose the nearest positive intersection point
+    float t = (t1 > 0 && t2 > 0) ? std::min(t1, t2) : ((t1 > 0) ? t1 : t2);
+    primitive = 0;
+    distance = t;
+    return t > 0 && t < maxDistance;
 }
 
 AABB Sphere::boundingBox() const
@@ -47,7 +56,18 @@ AABB Sphere::boundingBox() const
     return AABB(center - radiusVec, center + radiusVec);
 }
 
-Intersection Cylinder::intersect(const Ray &ray) const
+TextureCoordinates Sphere::textureCoordinatesAtRest(const Vector3 &point) const
+{
+    // Longitude around the vertical axis and latitude from the top pole
+    Vector3 n = (point - center).normalize();
+    TextureCoordinates uv;
+    uv.u = 0.5f + std::atan2(n.z, n.x) / (2.0f * static_cast<float>(M_PI));
+    uv.v = 0.5f - std::asin(std::clamp(n.y, -1.0f, 1.0f)) / static_cast<float>(M_PI);
+    uv.scale = static_cast<float>(M_PI) * radius * std::sqrt(2.0f); // Between 2*pi*r along u and pi*r along v
+    return uv;
+}
+
+Intersection Cylinder::intersectAtRest(const Ray &ray) const
 {
     Intersection result;
 
@@ -204,10 +224,38 @@ Vector3 Cylinder::centroid() const
     return center + (axis.normalize() * (height * 0.5f));
 }
 
-Intersection Triangle::intersect(const Ray &ray) const
+TextureCoordinates Cylinder::textureCoordinatesAtRest(const Vector3 &point) const
 {
-    Intersection result;
+    Vector3 axisNormalized = axis.normalize();
+    Vector3 offset = point - center;
+    float projectionLength = offset.dot(axisNormalized);
+    Vector3 radial = offset - axisNormalized * projectionLength;
+
+    // Two directions perpendicular to the axis, measuring the angle around it
+    Vector3 helper = std::fabs(axisNormalized.x) < 0.9f ? Vector3(1, 0, 0) : Vector3(0, 1, 0);
+    Vector3 tangent = axisNormalized.cross(helper).normalize();
+    Vector3 bitangent = axisNormalized.cross(tangent);
+
+    TextureCoordinates uv;
+    if (std::fabs(std::fabs(projectionLength) - height) <= 1e-3f * std::max(height, 1.0f))
+    {
+        // Caps: planar mapping of the disk onto the unit square
+        uv.u = 0.5f + radial.dot(tangent) / (2.0f * radius);
+        uv.v = 0.5f + radial.dot(bitangent) / (2.0f * radius);
+        uv.scale = 2.0f * radius;
+    }
+    else
+    {
+        // Side: angle around the axis and height from the top
+        uv.u = 0.5f + std::atan2(radial.dot(bitangent), radial.dot(tangent)) / (2.0f * static_cast<float>(M_PI));
+        uv.v = (height - projectionLength) / (2.0f * height);
+        uv.scale = std::sqrt(2.0f * static_cast<float>(M_PI) * radius * 2.0f * height);
+    }
+    return uv;
+}
 
+bool intersectTriangle(const Ray &ray, const Vector3 &v0, const Vector3 &v1, const Vector3 &v2, float &distance)
+{
     // Möller–Trumbore intersection algorithm
     Vector3 edge1 = v1 - v0;
     Vector3 edge2 = v2 - v0;
@@ -216,41 +264,63 @@ Intersection Triangle::intersect(const Ray &ray) const
 
     if (a > -1e-6 && a < 1e-6)
     {
-        return result; // Ray is parallel to the triangle
+        return false; // Ray is parallel to the triangle
     }
     float f = 1.0 / a;
     Vector3 s = ray.origin - v0;
     float u = f * s.dot(h);
     if (u < 0.0 || u > 1.0)
     {
-        return result; // Intersection is outside of the triangle
+        return false; // Intersection is outside of the triangle
     }
 
     Vector3 q = s.cross(edge1);
     float v = f * ray.direction.dot(q);
     if (v < 0.0 || u + v > 1.0)
     {
-        return result; // Intersection is outside of the triangle
+        return false; // Intersection is outside of the triangle
     }
 
     float t = f * edge2.dot(q);
     if (t > 1e-6)
     {
-        result.hit = true;
-        result.distance = t;
-        result.point = ray.origin + ray.direction * t;
+        distance = t;
+        return true;
+    }
+    return false;
+}
 
-        // Ensure normal points in the opposite direction of the ray
-        Vector3 computedNormal = edge1.cross(edge2).normalize();
-        result.normal = (ray.direction.dot(computedNormal) < 0) ? computedNormal : -computedNormal;
+bool intersectTriangle(const Ray &ray, const Vector3 &v0, const Vector3 &v1, const Vector3 &v2, float &distance, Vector3 &normal)
+{
+    if (!intersectTriangle(ray, v0, v1, v2, distance))
+    {
+        return false;
+    }
 
+    // Ensure normal points in the opposite direction of the ray
+    Vector3 computedNormal = (v1 - v0).cross(v2 - v0).normalize();
+    normal = (ray.direction.dot(computedNormal) < 0) ? computedNormal : -computedNormal;
+    return true;
+}
+
+Intersection Triangle::intersectAtRest(const Ray &ray) const
+{
+    Intersection result;
+    if (intersectTriangle(ray, v0, v1, v2, result.distance, result.normal))
+    {
+        result.hit = true;
+        result.point = ray.origin + ray.direction * result.distance;
         result.material = material;
     }
-
     return result;
 }
 
-// Triangle bounding box implementation
+bool Triangle::hitDistanceAtRest(const Ray &ray, float maxDistance, float &distance, uint32_t &primitive) const
+{
+    primitive = 0;
+    return intersectTriangle(ray, v0, v1, v2, distance) && distance < maxDistance;
+}
+
 AABB Triangle::boundingBox() const
 {
     Vector3 minBound(
@@ -273,3 +343,79 @@ AABB Triangle::boundingBox() const
 
     return AABB(minBound, maxBound);
 }
+
+AABB Triangle::clippedBounds(const AABB &box) const
+{
+    // Clip the triangle against each plane of the box in turn (Sutherland-Hodgman); each plane adds
+    // at most one vertex, so the polygon never exceeds nine
+    Vector3 polygon[9] = {v0, v1, v2}, clipped[9];
+    int size = 3;
+    for (int plane = 0; plane < 6 && size > 0; ++plane)
+    {
+        int axis = plane % 3;
+        bool isMax = plane >= 3;
+        float position = isMax ? box.maxBounds[axis] : box.minBounds[axis];
+        auto inside = [&](const Vector3 &point)
+        { return isMax ? point[axis] <= position : point[axis] >= position; };
+
+        if (std::all_of(polygon, polygon + size, inside))
+        {
+            continue; // Nothing to clip on this plane
+        }
+        int clippedSize = 0;
+        for (int i = 0; i < size; ++i)
+        {
+            const Vector3 &current = polygon[i];
+            const Vector3 &next = polygon[(i + 1) % size];
+            if (inside(current))
+            {
+                clipped[clippedSize++] = current;
+            }
+            if (inside(current) != inside(next))
+            {
+                // Edge crosses the plane: keep the crossing point, placed exactly on the plane
+                float t = (position - current[axis]) / (next[axis] - current[axis]);
+                Vector3 crossing = current + (next - current) * t;
+                crossing[axis] = position;
+                clipped[clippedSize++] = crossing;
+            }
+        }
+        std::copy(clipped, clipped + clippedSize, polygon);
+        size = clippedSize;
+    }
+
+    if (size == 0)
+    {
+        return Geometry::clippedBounds(box); // Rounding lost a sliver of the triangle; keep it conservatively
+    }
+    AABB bounds;
+    for (int i = 0; i < size; ++i)
+    {
+        bounds.expand(AABB(polygon[i], polygon[i]));
+    }
+    return bounds.intersection(box);
+}
+
+TextureCoordinates Triangle::textureCoordinatesAtRest(const Vector3 &point) const
+{
+    // Barycentric coordinates of the point
+    Vector3 edge1 = v1 - v0;
+    Vector3 edge2 = v2 - v0;
+    Vector3 p = point - v0;
+    float d00 = edge1.dot(edge1), d01 = edge1.dot(edge2), d11 = edge2.dot(edge2);
+    float d20 = p.dot(edge1), d21 = p.dot(edge2);
+    float denom = d00 * d11 - d01 * d01;
+    float b1 = denom != 0.0f ? (d11 * d20 - d01 * d21) / denom : 0.0f;
+    float b2 = denom != 0.0f ? (d00 * d21 - d01 * d20) / denom : 0.0f;
+    float b0 = 1.0f - b1 - b2;
+
+    TextureCoordinates uv;
+    uv.u = b0 * uv0[0] + b1 * uv1[0] + b2 * uv2[0];
+    uv.v = b0 * uv0[1] + b1 * uv1[1] + b2 * uv2[1];
+
+    // Ratio of the triangle's area in world space to its area in texture space
+    float worldArea = edge1.cross(edge2).length();
+    float uvArea = std::fabs((uv1[0] - uv0[0]) * (uv2[1] - uv0[1]) - (uv2[0] - uv0[0]) * (uv1[1] - uv0[1]));
+    uv.scale = std::sqrt(uvArea > 0.0f ? worldArea / uvArea : worldArea);
+    return uv;
+}
@@ -6,18 +6,38 @@
 #include "../camera/vector3.h"    // Include Vector3 class for 3D vector operations
 #include "../material/material.h" // Include Material class for material properties
 #include "../camera/light.h"      // Include Light class for lighting information
+#include <cstdint>
+#include <limits>
+
+class Geometry;
+
+// Texture coordinates of a surface point
+struct TextureCoordinates
+{
+    float u, v;  // Coordinates in texture space, v = 0 at the top of the image
+    float scale; // Approximate world-space size of one unit of u or v, used for filtering
+};
 
 // Struct to store intersection details between a ray and an object
 struct Intersection
 {
-    bool hit;          // Whether the ray intersects the object
-    float distance;    // Distance from the ray origin to the intersection point
-    Vector3 point;     // The intersection point in world space
-    Vector3 normal;    // The surface normal at the intersection point
-    Material material; // Material properties of the intersected object
+    bool hit;               // Whether the ray intersects the object
+    float distance;         // Distance from the ray origin to the intersection point
+    Vector3 point;          // The intersection point in world space
+    Vector3 normal;         // The surface normal at the intersection point
+    Material material;      // Material properties of the intersected object
+    const Geometry *object; // The intersected object (for texture coordinates)
 
     // Default constructor to initialize default values
-    Intersection() : hit(false), distance(0), point(Vector3()), normal(Vector3()), material() {}
+    Intersection() : hit(false), distance(0), point(Vector3()), normal(Vector3()), material(), object(nullptr) {}
+};
+
+// Closest hit of a visibility query (depth and ID outputs), which needs no point, normal or material
+struct VisibilityHit
+{
+    float distance = std::numeric_limits<float>::max(); // Only hits closer than this are recorded
+    const Geometry *object = nullptr;                    // The object hit, or nullptr
+    uint32_t primitive = 0;                              // Primitive hit within an aggregate (0 for single shapes)
 };
 
 // Abstract base class for all geometric objects
@@ -26,16 +46,134 @@ class Geometry
 public:
     virtual ~Geometry() {}
 
-    // Pure virtual methods that must be implemented by derived classes
+    // Linear motion: the object is translated by motion * time, with time running from 0 to 1 over a frame
+    Vector3 motion = Vector3(0.0f, 0.0f, 0.0f);
+
+    // Identifies the object in object-ID outputs: its entry in the scene's shape list, from 1 (0 is the background)
+    uint32_t objectId = 0;
+
+    // ID of the object's first primitive in primitive-ID outputs; aggregates number their primitives on from it
+    uint32_t firstPrimitiveId = 0;
+
+    // Returns true if the object moves during the frame
+    bool isMoving() const { return motion.x != 0.0f || motion.y != 0.0f || motion.z != 0.0f; }
 
-    // Computes the intersection between the ray and the object
-    virtual Intersection intersect(const Ray &ray) const = 0;
+    // Computes the intersection between the ray and the object at the ray's time
+    Intersection intersect(const Ray &ray) const
+    {
+        if (!isMoving())
+        {
+            Intersection result = intersectAtRest(ray);
+            result.object = this;
+            return result;
+        }
 
-    // Returns the bounding box of the object for use in acceleration structures
+        // Move the ray into the object's frame at time 0, then move the hit point back
+        Vector3 offset = motion * ray.time;
+        Intersection result = intersectAtRest(Ray(ray.origin - offset, ray.direction, ray.time));
+        result.point += offset;
+        result.object = this;
+        return result;
+    }
+
+    // Records the hit in closest if the object is hit closer than it, at the ray's time
+    // Returns true if closest was updated
+    bool intersectCloser(const Ray &ray, Intersection &closest) const
+    {
+        Intersection result = intersect(ray);
+        if (result.hit && result.distance < closest.distance)
+        {
+            closest = result;
+            return true;
+        }
+        return false;
+    }
+
+    // Same for a visibility query: only the distance and the primitive hit are computed
+    bool intersectCloser(const Ray &ray, VisibilityHit &closest) const
+    {
+        Ray atRest = isMoving() ? Ray(ray.origin - motion * ray.time, ray.direction, ray.time) : ray;
+        float distance;
+        uint32_t primitive = 0;
+        if (!hitDistanceAtRest(atRest, closest.distance, distance, primitive))
+        {
+            return false;
+        }
+        closest.distance = distance;
+        closest.object = this;
+        closest.primitive = primitive;
+        return true;
+    }
+
+    // Returns true if the object blocks the ray before maxDistance, at the ray's time
+    bool occludes(const Ray &ray, float maxDistance) const
+    {
+        if (!isMoving())
+        {
+            return occludesAtRest(ray, maxDistance);
+        }
+        return occludesAtRest(Ray(ray.origin - motion * ray.time, ray.direction, ray.time), maxDistance);
+    }
+
+    // Computes texture coordinates for a point on the surface at the given time
+    // Coordinates are only evaluated for textured materials, so intersection tests stay cheap
+    TextureCoordinates textureCoordinates(const Vector3 &point, float time) const
+    {
+        return textureCoordinatesAtRest(point - motion * time);
+    }
+
+    // Returns the bounding box of the object at the given time
+    AABB boundingBoxAt(float time) const
+    {
+        AABB box = boundingBox();
+        Vector3 offset = motion * time;
+        return AABB(box.minBounds + offset, box.maxBounds + offset);
+    }
+
+    // Object and primitive IDs of a primitive of the object, as recorded in a VisibilityHit
+    // Aggregates packing primitives of several objects override them
+    virtual uint32_t objectIdOf(uint32_t /*primitive*/) const { return objectId; }
+    virtual uint32_t primitiveIdOf(uint32_t primitive) const { return firstPrimitiveId + primitive; }
+
+    // True for objects holding many primitives under their own BVH, such as particle sets
+    // Testing one costs about as much as a traversal, so they are not cached as shadow occluders
+    virtual bool isAggregate() const { return false; }
+
+    // Returns the bounds of the part of the object (at time 0) inside box, for spatial-split BVH builds
+    // The default clips the object's bounding box; shapes can return tighter bounds
+    virtual AABB clippedBounds(const AABB &box) const { return boundingBox().intersection(box); }
+
+    // Pure virtual methods that must be implemented by derived classes
+
+    // Returns the bounding box of the object at time 0 for use in acceleration structures
     virtual AABB boundingBox() const = 0;
 
-    // Returns the centroid (geometric center) of the object
+    // Returns the centroid (geometric center) of the object at time 0
     virtual Vector3 centroid() const = 0;
+
+protected:
+    // Computes the intersection between the ray and the object at time 0
+    virtual Intersection intersectAtRest(const Ray &ray) const = 0;
+
+    // Returns true if the object blocks the ray before maxDistance at time 0
+    // Aggregates of many primitives override this to stop at the first blocking hit
+    virtual bool occludesAtRest(const Ray &ray, float maxDistance) const
+    {
+        Intersection hit = intersectAtRest(ray);
+        return hit.hit && hit.distance < maxDistance;
+    }
+
+    // Finds the nearest hit before maxDistance at time 0, giving its distance and the primitive hit
+    // The default runs the full intersection; shapes override it to skip the point, normal and material
+    virtual bool hitDistanceAtRest(const Ray &ray, float maxDistance, float &distance, uint32_t &/*primitive*/) const
+    {
+        Intersection hit = intersectAtRest(ray);
+        distance = hit.distance;
+        return hit.hit && hit.distance < maxDistance;
+    }
+
+    // Computes texture coordinates for a surface point of the object at time 0
+    virtual TextureCoordinates textureCoordinatesAtRest(const Vector3 &point) const = 0;
 };
 
 // Sphere class, representing a sphere object in the scene
@@ -50,14 +188,21 @@ public:
     Sphere(const Vector3 &center, float radius, const Material &material)
         : center(center), radius(radius), material(material) {}
 
-    // Override the intersect method to compute ray-sphere intersection
-    Intersection intersect(const Ray &ray) const override;
-
     // Override the boundingBox method to compute the sphere's AABB
     AABB boundingBox() const override;
 
     // Returns the sphere's center as its centroid
     Vector3 centroid() const override { return center; }
+
+protected:
+    // Override the intersectAtRest method to compute ray-sphere intersection
+    Intersection intersectAtRest(const Ray &ray) const override;
+
+    // Solves for the nearest hit distance only
+    bool hitDistanceAtRest(const Ray &ray, float maxDistance, float &distance, uint32_t &primitive) const override;
+
+    // Override the textureCoordinatesAtRest method with spherical (longitude, latitude) coordinates
+    TextureCoordinates textureCoordinatesAtRest(const Vector3 &point) const override;
 };
 
 // Cylinder class, representing a cylindrical object in the scene
@@ -74,14 +219,18 @@ public:
     Cylinder(const Vector3 &center, const Vector3 &axis, float radius, float height, const Material &material)
         : center(center), axis(axis.normalize()), radius(radius), height(height), material(material) {}
 
-    // Override the intersect method to compute ray-cylinder intersection
-    Intersection intersect(const Ray &ray) const override;
-
     // Override the boundingBox method to compute the cylinder's AABB
     AABB boundingBox() const override;
 
     // Compute the centroid of the cylinder
     Vector3 centroid() const override;
+
+protected:
+    // Override the intersectAtRest method to compute ray-cylinder intersection
+    Intersection intersectAtRest(const Ray &ray) const override;
+
+    // Override the textureCoordinatesAtRest method with cylindrical (angle, height), planar on the caps coordinates
+    TextureCoordinates textureCoordinatesAtRest(const Vector3 &point) const override;
 };
 
 // Triangle class, representing a triangular object in the scene
@@ -91,18 +240,45 @@ public:
     Vector3 v0, v1, v2; // Vertices of the triangle
     Material material;  // Material properties of the triangle
 
+    // Texture coordinates (u, v) of each vertex
+    float uv0[2] = {0.0f, 0.0f};
+    float uv1[2] = {1.0f, 0.0f};
+    float uv2[2] = {0.0f, 1.0f};
+
     // Constructor to initialize a triangle
     Triangle(const Vector3 &v0, const Vector3 &v1, const Vector3 &v2, const Material &material)
         : v0(v0), v1(v1), v2(v2), material(material) {}
 
-    // Override the intersect method to compute ray-triangle intersection
-    Intersection intersect(const Ray &ray) const override;
-
     // Override the boundingBox method to compute the triangle's AABB
     AABB boundingBox() const override;
 
     // Compute the centroid (average of vertices) of the triangle
     Vector3 centroid() const override { return (v0 + v1 + v2) / 3.0f; }
+
+    // Bounds of the polygon left after clipping the triangle to the box
+    AABB clippedBounds(const AABB &box) const override;
+
+protected:
+    // Override the intersectAtRest method to compute ray-triangle intersection
+    Intersection intersectAtRest(const Ray &ray) const override;
+
+    // Runs the ray-triangle test without computing the normal
+    bool hitDistanceAtRest(const Ray &ray, float maxDistance, float &distance, uint32_t &primitive) const override;
+
+    // Override the textureCoordinatesAtRest method with interpolated from the vertex coordinates coordinates
+    TextureCoordinates textureCoordinatesAtRest(const Vector3 &point) const override;
 };
 
+// Möller–Trumbore ray-triangle test, shared by Triangle and TriangleMesh
+// Parameters:
+// - ray: The ray to test
+// - v0, v1, v2: Vertices of the triangle
+// - distance: Receives the distance along the ray to the hit
+// - normal: Receives the unit normal, facing against the ray
+// Returns: True if the ray hits the triangle in front of its origin
+bool intersectTriangle(const Ray &ray, const Vector3 &v0, const Vector3 &v1, const Vector3 &v2, float &distance, Vector3 &normal);
+
+// The same test without the normal, for visibility queries and for finding the closest of many triangles
+bool intersectTriangle(const Ray &ray, const Vector3 &v0, const Vector3 &v1, const Vector3 &v2, float &distance);
+
 #endif // GEOMETRY_H
@@ -1,4 +1,5 @@
 #include "intersection.h"
+#include <limits>
 
 // Function to find the closest intersection of a ray with geometric objects in the scene
 // Parameters:
@@ -6,11 +7,13 @@
 // - spheres: A list of spheres in the scene
 // - cylinders: A list of cylinders in the scene
 // - triangles: A list of triangles in the scene
+// - particles: Particle sets in the scene
 // Returns:
 // - The closest Intersection object containing details of the intersection (if any)
 
 Intersection findClosestIntersection(const Ray &ray, const std::vector<Sphere> &spheres,
-                                     const std::vector<Cylinder> &cylinders, const std::vector<Triangle> &triangles)
+                                     const std::vector<Cylinder> &cylinders, const std::vector<Triangle> &triangles,
+                                     const std::vector<std::shared_ptr<const ParticleSet>> &particles)
 {
     // Initialize the closest intersection with no hit and maximum distance
     Intersection closestIntersection;
@@ -55,6 +58,16 @@ Intersection findClosestIntersection(const Ray &ray, const std::vector<Sphere> &
         }
     }
 
+    // Check intersection with each particle set (each traverses its own BVH)
+    for (const auto &particleSet : particles)
+    {
+        Intersection intersection = particleSet->intersect(ray);
+        if (intersection.hit && intersection.distance < closestIntersection.distance)
+        {
+            closestIntersection = intersection;
+        }
+    }
+
     // Return the closest intersection found
     return closestIntersection;
 }
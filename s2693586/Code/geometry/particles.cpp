@@ -0,0 +1,279 @@
+#include "particles.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h> // SSE2 intrinsics for the four-wide leaf test
+#define PARTICLES_SSE 1
+#endif
+
+static_assert(sizeof(ParticleSet::Particle) == 16, "Particle records must be 16 bytes");
+
+ParticleSet::ParticleSet(std::vector<Particle> particles, const Material &material)
+    : material(material), particles(std::move(particles))
+{
+    count = this->particles.size();
+    if (count == 0)
+    {
+        return;
+    }
+    nodes.reserve(2 * ((count + LEAF_SIZE - 1) / LEAF_SIZE) - 1);
+    build(0, static_cast<uint32_t>(count));
+    bounds = AABB(Vector3(nodes[0].minBounds[0], nodes[0].minBounds[1], nodes[0].minBounds[2]),
+                  Vector3(nodes[0].maxBounds[0], nodes[0].maxBounds[1], nodes[0].maxBounds[2]));
+
+    // Pad so the last leaf can always be loaded four records at a time
+    this->particles.resize(count + 3, Particle{0.0f, 0.0f, 0.0f, 0.0f});
+    this->particles.shrink_to_fit();
+}
+
+// Builds the hierarchy recursively, splitting near the median center along the largest axis
+uint32_t ParticleSet::build(uint32_t begin, uint32_t end)
+{
+    uint32_t index = static_cast<uint32_t>(nodes.size());
+    nodes.push_back(Node());
+
+    // Bounds of the particles and of their centers
+    float minBounds[3], maxBounds[3], minCenter[3], maxCenter[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        minBounds[axis] = minCenter[axis] = std::numeric_limits<float>::max();
+        maxBounds[axis] = maxCenter[axis] = -std::numeric_limits<float>::max();
+    }
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        const float *center = &particles[i].x;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            minBounds[axis] = std::min(minBounds[axis], center[axis] - particles[i].radius);
+            maxBounds[axis] = std::max(maxBounds[axis], center[axis] + particles[i].radius);
+            minCenter[axis] = std::min(minCenter[axis], center[axis]);
+            maxCenter[axis] = std::max(maxCenter[axis], center[axis]);
+        }
+    }
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        nodes[index].minBounds[axis] = minBounds[axis];
+        nodes[index].maxBounds[axis] = maxBounds[axis];
+    }
+
+    // Leaf node: small enough to test directly
+    if (end - begin <= LEAF_SIZE)
+    {
+        nodes[index].first = begin;
+        nodes[index].count = end - begin;
+        return index;
+    }
+
+    int splitAxis = 0;
+    for (int axis = 1; axis < 3; ++axis)
+    {
+        if (maxCenter[axis] - minCenter[axis] > maxCenter[splitAxis] - minCenter[splitAxis])
+        {
+            splitAxis = axis;
+        }
+    }
+    // Split on a leaf boundary so every leaf except the last is full
+    uint32_t leaves = (end - begin + LEAF_SIZE - 1) / LEAF_SIZE;
+    uint32_t mid = begin + (leaves / 2) * LEAF_SIZE;
+    std::nth_element(particles.begin() + begin, particles.begin() + mid, particles.begin() + end,
+                     [splitAxis](const Particle &a, const Particle &b)
+                     { return (&a.x)[splitAxis] < (&b.x)[splitAxis]; });
+
+    // The left child follows this node; the right child's index is stored in first
+    build(begin, mid);
+    uint32_t right = build(mid, end);
+    nodes[index].first = right;
+    nodes[index].count = 0;
+    return index;
+}
+
+// Slab test of a node's bounds, returning false if the box is missed or lies beyond maxDistance
+static inline bool hitNode(const float *minBounds, const float *maxBounds, const float *origin, const float *inverseDirection, float maxDistance)
+{
+    float tMin = 0.0f, tMax = maxDistance;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float t0 = (minBounds[axis] - origin[axis]) * inverseDirection[axis];
+        float t1 = (maxBounds[axis] - origin[axis]) * inverseDirection[axis];
+        tMin = std::max(tMin, std::min(t0, t1));
+        tMax = std::min(tMax, std::max(t0, t1));
+    }
+    return tMin <= tMax;
+}
+
+uint32_t ParticleSet::closestParticle(const Ray &ray, float &closest) const
+{
+    uint32_t closestIndex = std::numeric_limits<uint32_t>::max();
+    if (nodes.empty())
+    {
+        return closestIndex;
+    }
+
+    const float origin[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+    const float direction[3] = {ray.direction.x, ray.direction.y, ray.direction.z};
+    float inverseDirection[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        inverseDirection[axis] = std::fabs(direction[axis]) > 1e-8f ? 1.0f / direction[axis] : std::copysign(1e30f, direction[axis]);
+    }
+
+#ifdef PARTICLES_SSE
+    const __m128 originX = _mm_set1_ps(origin[0]), originY = _mm_set1_ps(origin[1]), originZ = _mm_set1_ps(origin[2]);
+    const __m128 directionX = _mm_set1_ps(direction[0]), directionY = _mm_set1_ps(direction[1]), directionZ = _mm_set1_ps(direction[2]);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 laneIndex = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+#endif
+
+    uint32_t stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0)
+    {
+        const Node &node = nodes[stack[--stackSize]];
+        if (!hitNode(node.minBounds, node.maxBounds, origin, inverseDirection, closest))
+        {
+            continue;
+        }
+        if (node.count == 0)
+        {
+            // Visit the left child (stored next) first
+            stack[stackSize++] = node.first;
+            stack[stackSize++] = static_cast<uint32_t>(&node - nodes.data()) + 1;
+            continue;
+        }
+
+        for (uint32_t i = node.first; i < node.first + node.count; i += 4)
+        {
+#ifdef PARTICLES_SSE
+            // Load four records and transpose them into x, y, z and radius vectors
+            __m128 x = _mm_loadu_ps(&particles[i].x);
+            __m128 y = _mm_loadu_ps(&particles[i + 1].x);
+            __m128 z = _mm_loadu_ps(&particles[i + 2].x);
+            __m128 r = _mm_loadu_ps(&particles[i + 3].x);
+            _MM_TRANSPOSE4_PS(x, y, z, r);
+
+            // Ray-sphere quadratic for a normalized direction: t = b -+ sqrt(b^2 - c)
+            __m128 ocX = _mm_sub_ps(x, originX), ocY = _mm_sub_ps(y, originY), ocZ = _mm_sub_ps(z, originZ);
+            __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocX, directionX), _mm_mul_ps(ocY, directionY)), _mm_mul_ps(ocZ, directionZ));
+            __m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ocX, ocX), _mm_mul_ps(ocY, ocY)), _mm_mul_ps(ocZ, ocZ)), _mm_mul_ps(r, r));
+            __m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), c);
+            __m128 root = _mm_sqrt_ps(_mm_max_ps(discriminant, zero));
+            __m128 tNear = _mm_sub_ps(b, root);
+            __m128 tFar = _mm_add_ps(b, root);
+
+            // Nearest positive root; the far root is used when the origin is inside the sphere
+            __m128 nearValid = _mm_cmpgt_ps(tNear, zero);
+            __m128 t = _mm_or_ps(_mm_and_ps(nearValid, tNear), _mm_andnot_ps(nearValid, tFar));
+            __m128 hit = _mm_and_ps(_mm_cmpge_ps(discriminant, zero), _mm_cmpgt_ps(t, zero));
+            hit = _mm_and_ps(hit, _mm_cmplt_ps(t, _mm_set1_ps(closest)));
+            hit = _mm_and_ps(hit, _mm_cmplt_ps(laneIndex, _mm_set1_ps(static_cast<float>(node.first + node.count - i))));
+
+            int mask = _mm_movemask_ps(hit);
+            if (mask != 0)
+            {
+                alignas(16) float distances[4];
+                _mm_store_ps(distances, t);
+                for (int lane = 0; lane < 4; ++lane)
+                {
+                    if ((mask & (1 << lane)) && distances[lane] < closest)
+                    {
+                        closest = distances[lane];
+                        closestIndex = i + lane;
+                    }
+                }
+            }
+#else
+            for (uint32_t j = i; j < std::min(i + 4, node.first + node.count); ++j)
+            {
+                const Particle &p = particles[j];
+                float ocX = p.x - origin[0], ocY = p.y - origin[1], ocZ = p.z - origin[2];
+                float b = ocX * direction[0] + ocY * direction[1] + ocZ * direction[2];
+                float discriminant = b * b - (ocX * ocX + ocY * ocY + ocZ * ocZ - p.radius * p.radius);
+                if (discriminant < 0.0f)
+                {
+                    continue;
+                }
+                float root = std::sqrt(discriminant);
+                float t = (b - root > 0.0f) ? b - root : b + root;
+                if (t > 0.0f && t < closest)
+                {
+                    closest = t;
+                    closestIndex = j;
+                }
+            }
+#endif
+        }
+    }
+
+    return closestIndex;
+}
+
+Intersection ParticleSet::intersectAtRest(const Ray &ray) const
+{
+    Intersection result;
+    float closest = std::numeric_limits<float>::max();
+    uint32_t closestIndex = closestParticle(ray, closest);
+    if (closestIndex != std::numeric_limits<uint32_t>::max())
+    {
+        const Particle &p = particles[closestIndex];
+        result.hit = true;
+        result.distance = closest;
+        result.point = ray.origin + ray.direction * closest;
+        result.normal = (result.point - Vector3(p.x, p.y, p.z)).normalize();
+        result.material = material;
+    }
+    return result;
+}
+
+bool ParticleSet::hitDistanceAtRest(const Ray &ray, float maxDistance, float &distance, uint32_t &primitive) const
+{
+    distance = maxDistance;
+    primitive = closestParticle(ray, distance);
+    return primitive != std::numeric_limits<uint32_t>::max();
+}
+
+size_t ParticleSet::memoryBytes() const
+{
+    return sizeof(*this) + particles.capacity() * sizeof(Particle) + nodes.capacity() * sizeof(Node);
+}
+
+std::shared_ptr<ParticleSet> ParticleSet::load(const std::string &fileName, const Material &material)
+{
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+    {
+        std::cerr << "Could not open particle file: " << fileName << std::endl;
+        throw std::runtime_error("Could not open the particle file.");
+    }
+
+    std::streamoff bytes = file.tellg();
+    if (bytes <= 0 || bytes % sizeof(Particle) != 0)
+    {
+        std::cerr << "Particle file size is not a multiple of 16 bytes: " << fileName << std::endl;
+        throw std::runtime_error("Invalid particle file.");
+    }
+
+    std::vector<Particle> particles(static_cast<size_t>(bytes) / sizeof(Particle));
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char *>(particles.data()), bytes))
+    {
+        std::cerr << "Failed to read particle file: " << fileName << std::endl;
+        throw std::runtime_error("Could not read the particle file.");
+    }
+    return std::make_shared<ParticleSet>(std::move(particles), material);
+}
+
+void ParticleSet::save(const std::string &fileName, const std::vector<Particle> &particles)
+{
+    std::ofstream file(fileName, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Failed to open output file: " << fileName << std::endl;
+        throw std::runtime_error("Could not write the particle file.");
+    }
+    file.write(reinterpret_cast<const char *>(particles.data()), particles.size() * sizeof(Particle));
+}
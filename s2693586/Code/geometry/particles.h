@@ -0,0 +1,87 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "geometry.h" // Geometry base class, Intersection and Material
+
+// A large set of spheres sharing one material, stored compactly for particle-simulation exports
+// Each particle is a packed 16-byte record. The set builds its own BVH over the particles and is
+// placed in the scene as a single Geometry, so the scene BVH holds one entry for the whole set.
+// BVH leaves hold up to LEAF_SIZE particles, which are tested four at a time with SIMD.
+class ParticleSet : public Geometry
+{
+public:
+    // One particle: center and radius
+    struct Particle
+    {
+        float x, y, z;
+        float radius;
+    };
+
+    static constexpr int LEAF_SIZE = 8;
+
+    Material material; // Material shared by every particle
+
+    // Builds the set and its BVH
+    // Parameters:
+    // - particles: Particle records (reordered by the BVH build)
+    // - material: Material shared by all particles
+    ParticleSet(std::vector<Particle> particles, const Material &material);
+
+    // Loads particles from a raw binary file of consecutive records (x, y, z, radius as
+    // little-endian 32-bit floats, 16 bytes per particle, no header)
+    // Throws std::runtime_error if the file cannot be read or its size is not a whole number of records
+    static std::shared_ptr<ParticleSet> load(const std::string &fileName, const Material &material);
+
+    // Writes particles in the format read by load()
+    static void save(const std::string &fileName, const std::vector<Particle> &particles);
+
+    // Number of particles in the set
+    size_t size() const { return count; }
+
+    // Bytes used by the particle records and BVH nodes
+    size_t memoryBytes() const;
+
+    bool isAggregate() const override { return true; }
+
+    AABB boundingBox() const override { return bounds; }
+    Vector3 centroid() const override { return (bounds.minBounds + bounds.maxBounds) * 0.5f; }
+
+protected:
+    // Finds the closest particle hit by traversing the set's BVH
+    Intersection intersectAtRest(const Ray &ray) const override;
+
+    // Finds the closest particle without its normal; the primitive is its index in BVH leaf order
+    bool hitDistanceAtRest(const Ray &ray, float maxDistance, float &distance, uint32_t &primitive) const override;
+
+    // Particles share one material and are not textured; every point maps to (0, 0)
+    TextureCoordinates textureCoordinatesAtRest(const Vector3 &/*point*/) const override { return {0.0f, 0.0f, 1.0f}; }
+
+private:
+    // BVH node: a leaf holds particles [first, first + count); an inner node (count == 0)
+    // has its left child directly after it and its right child at index first
+    struct Node
+    {
+        float minBounds[3];
+        uint32_t first;
+        float maxBounds[3];
+        uint32_t count;
+    };
+
+    std::vector<Particle> particles; // Records in BVH leaf order, padded for four-wide loads
+    std::vector<Node> nodes;
+    size_t count;
+    AABB bounds;
+
+    // Builds the subtree over particles [begin, end) and returns its node index
+    uint32_t build(uint32_t begin, uint32_t end);
+
+    // Traverses the BVH for the closest particle hit before closest, which receives its distance
+    // Returns: The particle's index, or the largest uint32_t if none was hit
+    uint32_t closestParticle(const Ray &ray, float &closest) const;
+};
+
+#endif // PARTICLES_H
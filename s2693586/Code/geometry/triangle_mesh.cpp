@@ -0,0 +1,466 @@
+#include "triangle_mesh.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace
+{
+    // Stored coordinates of a vertex (quantized offsets or float bit patterns), for sharing vertices
+    struct VertexKey
+    {
+        uint32_t coordinates[3];
+
+        bool operator==(const VertexKey &other) const
+        {
+            return coordinates[0] == other.coordinates[0] && coordinates[1] == other.coordinates[1] &&
+                   coordinates[2] == other.coordinates[2];
+        }
+    };
+
+    struct VertexKeyHash
+    {
+        size_t operator()(const VertexKey &key) const
+        {
+            uint64_t hash = key.coordinates[0];
+            hash = hash * 0x9E3779B97F4A7C15ull ^ key.coordinates[1];
+            hash = hash * 0x9E3779B97F4A7C15ull ^ key.coordinates[2];
+            return static_cast<size_t>(hash ^ (hash >> 32));
+        }
+    };
+}
+
+// Steps of the vertex quantization grid
+static constexpr float VERTEX_STEPS = 65535.0f;
+
+// Material ID stored in table entries shared by triangles whose material ID is their object ID, as for
+// every shape read from JSON; hits take the ID from the triangle, so such triangles share entries by content
+static constexpr uint32_t OBJECT_MATERIAL_ID = std::numeric_limits<uint32_t>::max();
+
+// Returns true if two materials are identical, including their material ID
+static bool sameMaterial(const Material &a, const Material &b)
+{
+    return a.id == b.id && a.diffuseColor == b.diffuseColor && a.specularColor == b.specularColor && a.kd == b.kd &&
+           a.ks == b.ks && a.specularExponent == b.specularExponent && a.isReflective == b.isReflective &&
+           a.reflectivity == b.reflectivity && a.isRefractive == b.isRefractive && a.refractiveIndex == b.refractiveIndex &&
+           a.texture == b.texture;
+}
+
+// Hash of the fields sameMaterial compares, for finding table entries
+static size_t materialHash(const Material &material)
+{
+    uint64_t hash = material.id;
+    for (float value : {material.diffuseColor.x, material.diffuseColor.y, material.diffuseColor.z, material.specularColor.x,
+                        material.specularColor.y, material.specularColor.z, material.kd, material.ks, material.specularExponent,
+                        material.reflectivity, material.refractiveIndex})
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(float));
+        hash = hash * 0x9E3779B97F4A7C15ull ^ bits;
+    }
+    hash = hash * 0x9E3779B97F4A7C15ull ^ (material.isReflective + 2u * material.isRefractive);
+    return static_cast<size_t>(hash ^ (hash >> 32));
+}
+
+// Decodes a node's box from its quantized planes and its parent's decoded box
+// The first and last steps map exactly onto the parent's planes. The build decodes each box the
+// same way as traversal, so the boxes it checks are bit for bit the ones rays are tested against.
+template <typename Q>
+static inline void decodeBox(const Q *lower, const Q *upper, const float *parentMin, const float *parentMax, float *minBounds,
+                             float *maxBounds)
+{
+    constexpr uint32_t steps = std::numeric_limits<Q>::max();
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float step = (parentMax[axis] - parentMin[axis]) * (1.0f / steps);
+        minBounds[axis] = lower[axis] == steps ? parentMax[axis] : parentMin[axis] + step * lower[axis];
+        maxBounds[axis] = upper[axis] == steps ? parentMax[axis] : parentMin[axis] + step * upper[axis];
+    }
+}
+
+// Slab test of a box, returning false if it is missed or lies beyond maxDistance
+static inline bool hitBox(const float *minBounds, const float *maxBounds, const float *origin, const float *inverseDirection,
+                          float maxDistance, float &entryDistance)
+{
+    float tMin = 0.0f, tMax = maxDistance;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float t0 = (minBounds[axis] - origin[axis]) * inverseDirection[axis];
+        float t1 = (maxBounds[axis] - origin[axis]) * inverseDirection[axis];
+        tMin = std::max(tMin, std::min(t0, t1));
+        tMax = std::min(tMax, std::max(t0, t1));
+    }
+    entryDistance = tMin;
+    return tMin <= tMax;
+}
+
+TriangleMesh::TriangleMesh(const std::vector<Triangle> &triangles, int boundsBits, bool quantizeVertices)
+    : boundsBits(boundsBits)
+{
+    static_assert(sizeof(Node<uint8_t>) == 12 && sizeof(Node<uint16_t>) == 20, "Unexpected quantized node size");
+    if (boundsBits != 8 && boundsBits != 16)
+    {
+        std::cerr << "Invalid triangle mesh bounds precision: " << boundsBits << " bits (expected 8 or 16)" << std::endl;
+        throw std::invalid_argument("Invalid triangle mesh bounds precision.");
+    }
+    if (triangles.empty())
+    {
+        return;
+    }
+
+    // Quantization grid over the bounds of all vertices
+    Vector3 vertexMin(std::numeric_limits<float>::max()), vertexMax(-std::numeric_limits<float>::max());
+    for (const Triangle &triangle : triangles)
+    {
+        for (const Vector3 *position : {&triangle.v0, &triangle.v1, &triangle.v2})
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                vertexMin[axis] = std::min(vertexMin[axis], (*position)[axis]);
+                vertexMax[axis] = std::max(vertexMax[axis], (*position)[axis]);
+            }
+        }
+    }
+    vertexOrigin = vertexMin;
+    vertexStep = (vertexMax - vertexMin) * (1.0f / VERTEX_STEPS);
+
+    // Store each distinct vertex and material once
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> vertexIndex;
+    std::unordered_multimap<size_t, uint32_t> materialIndex; // Table entries by materialHash
+    faces.reserve(triangles.size());
+    faceIds.reserve(triangles.size());
+    for (const Triangle &triangle : triangles)
+    {
+        Face face;
+        const Vector3 *corners[3] = {&triangle.v0, &triangle.v1, &triangle.v2};
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            const Vector3 &position = *corners[corner];
+            VertexKey key;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                if (quantizeVertices)
+                {
+                    float offset = vertexStep[axis] > 0.0f ? (position[axis] - vertexOrigin[axis]) / vertexStep[axis] : 0.0f;
+                    key.coordinates[axis] = static_cast<uint32_t>(std::clamp(std::lround(offset), 0L, 65535L));
+                }
+                else
+                {
+                    std::memcpy(&key.coordinates[axis], &position[axis], sizeof(float));
+                }
+            }
+
+            auto inserted = vertexIndex.emplace(key, static_cast<uint32_t>(vertexTotal));
+            if (inserted.second)
+            {
+                if (quantizeVertices)
+                {
+                    quantizedVertices.insert(quantizedVertices.end(), key.coordinates, key.coordinates + 3);
+                }
+                else
+                {
+                    vertices.push_back(position);
+                }
+                vertexError = std::max(vertexError, (vertex(static_cast<uint32_t>(vertexTotal)) - position).length());
+                ++vertexTotal;
+            }
+            face.vertices[corner] = inserted.first->second;
+        }
+
+        Material material = triangle.material;
+        if (material.id == triangle.objectId)
+        {
+            material.id = OBJECT_MATERIAL_ID;
+        }
+        size_t hash = materialHash(material);
+        auto candidates = materialIndex.equal_range(hash);
+        auto match = std::find_if(candidates.first, candidates.second, [&](const std::pair<const size_t, uint32_t> &entry)
+                                  { return sameMaterial(materials[entry.second], material); });
+        if (match == candidates.second)
+        {
+            match = materialIndex.emplace(hash, static_cast<uint32_t>(materials.size()));
+            materials.push_back(material);
+        }
+        face.material = match->second;
+        faces.push_back(face);
+        faceIds.push_back({triangle.objectId, triangle.firstPrimitiveId});
+    }
+    quantizedVertices.shrink_to_fit();
+    vertices.shrink_to_fit();
+    materials.shrink_to_fit();
+
+    // Bounds and centroids of the stored (possibly quantized) triangles
+    std::vector<AABB> faceBounds(faces.size());
+    std::vector<Vector3> centroids(faces.size());
+    for (size_t i = 0; i < faces.size(); ++i)
+    {
+        Vector3 a = vertex(faces[i].vertices[0]), b = vertex(faces[i].vertices[1]), c = vertex(faces[i].vertices[2]);
+        faceBounds[i] = AABB(Vector3(std::min({a.x, b.x, c.x}), std::min({a.y, b.y, c.y}), std::min({a.z, b.z, c.z})),
+                             Vector3(std::max({a.x, b.x, c.x}), std::max({a.y, b.y, c.y}), std::max({a.z, b.z, c.z})));
+        centroids[i] = (a + b + c) / 3.0f;
+        bounds.expand(faceBounds[i]);
+    }
+
+    std::vector<uint32_t> order(faces.size());
+    for (uint32_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+    if (boundsBits == 8)
+    {
+        build(nodes8, order, 0, static_cast<uint32_t>(faces.size()), faceBounds, centroids, bounds);
+        nodes8.shrink_to_fit();
+    }
+    else
+    {
+        build(nodes16, order, 0, static_cast<uint32_t>(faces.size()), faceBounds, centroids, bounds);
+        nodes16.shrink_to_fit();
+    }
+
+    // Store the faces and their IDs in leaf order
+    std::vector<Face> ordered(faces.size());
+    std::vector<Ids> orderedIds(faces.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        ordered[i] = faces[order[i]];
+        orderedIds[i] = faceIds[order[i]];
+    }
+    faces = std::move(ordered);
+    faceIds = std::move(orderedIds);
+}
+
+Vector3 TriangleMesh::vertex(uint32_t index) const
+{
+    if (quantizedVertices.empty())
+    {
+        return vertices[index];
+    }
+    const uint16_t *offsets = &quantizedVertices[3 * static_cast<size_t>(index)];
+    return Vector3(vertexOrigin.x + vertexStep.x * offsets[0], vertexOrigin.y + vertexStep.y * offsets[1],
+                   vertexOrigin.z + vertexStep.z * offsets[2]);
+}
+
+size_t TriangleMesh::memoryBytes() const
+{
+    return sizeof(*this) + faces.capacity() * sizeof(Face) + faceIds.capacity() * sizeof(Ids) + materials.capacity() * sizeof(Material) +
+           quantizedVertices.capacity() * sizeof(uint16_t) + vertices.capacity() * sizeof(Vector3) +
+           nodes8.capacity() * sizeof(Node<uint8_t>) + nodes16.capacity() * sizeof(Node<uint16_t>);
+}
+
+// Builds the hierarchy recursively, splitting at the median centroid along the largest axis
+template <typename Q>
+uint32_t TriangleMesh::build(std::vector<Node<Q>> &nodes, std::vector<uint32_t> &order, uint32_t begin, uint32_t end,
+                             const std::vector<AABB> &faceBounds, const std::vector<Vector3> &centroids, const AABB &parent)
+{
+    uint32_t index = static_cast<uint32_t>(nodes.size());
+    nodes.push_back(Node<Q>());
+
+    AABB box;
+    Vector3 minCenter(std::numeric_limits<float>::max()), maxCenter(-std::numeric_limits<float>::max());
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        box.expand(faceBounds[order[i]]);
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            minCenter[axis] = std::min(minCenter[axis], centroids[order[i]][axis]);
+            maxCenter[axis] = std::max(maxCenter[axis], centroids[order[i]][axis]);
+        }
+    }
+
+    // Quantize the box within the parent's, then widen each plane by a step until the decoded box
+    // encloses the triangles; the parent's box encloses them already, so the end steps always do
+    constexpr uint32_t steps = std::numeric_limits<Q>::max();
+    const float parentMin[3] = {parent.minBounds.x, parent.minBounds.y, parent.minBounds.z};
+    const float parentMax[3] = {parent.maxBounds.x, parent.maxBounds.y, parent.maxBounds.z};
+    Node<Q> node = Node<Q>();
+    float minBounds[3], maxBounds[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float extent = parentMax[axis] - parentMin[axis];
+        float lower = extent > 0.0f ? std::floor((box.minBounds[axis] - parentMin[axis]) / extent * steps) : 0.0f;
+        float upper = extent > 0.0f ? std::ceil((box.maxBounds[axis] - parentMin[axis]) / extent * steps) : steps;
+        node.lower[axis] = static_cast<Q>(std::clamp(lower, 0.0f, static_cast<float>(steps)));
+        node.upper[axis] = static_cast<Q>(std::clamp(upper, 0.0f, static_cast<float>(steps)));
+    }
+    for (;;)
+    {
+        decodeBox(node.lower, node.upper, parentMin, parentMax, minBounds, maxBounds);
+        bool encloses = true;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (minBounds[axis] > box.minBounds[axis] && node.lower[axis] > 0)
+            {
+                --node.lower[axis];
+                encloses = false;
+            }
+            if (maxBounds[axis] < box.maxBounds[axis] && node.upper[axis] < steps)
+            {
+                ++node.upper[axis];
+                encloses = false;
+            }
+        }
+        if (encloses)
+        {
+            break;
+        }
+    }
+    AABB decoded(Vector3(minBounds[0], minBounds[1], minBounds[2]), Vector3(maxBounds[0], maxBounds[1], maxBounds[2]));
+
+    // Leaf node: small enough to test directly
+    if (end - begin <= LEAF_SIZE)
+    {
+        node.first = begin;
+        node.count = static_cast<uint16_t>(end - begin);
+        nodes[index] = node;
+        return index;
+    }
+
+    int splitAxis = 0;
+    for (int axis = 1; axis < 3; ++axis)
+    {
+        if (maxCenter[axis] - minCenter[axis] > maxCenter[splitAxis] - minCenter[splitAxis])
+        {
+            splitAxis = axis;
+        }
+    }
+    uint32_t mid = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, [&](uint32_t a, uint32_t b)
+                     { return centroids[a][splitAxis] < centroids[b][splitAxis]; });
+
+    // The left child follows this node; the right child's index is stored in first
+    build(nodes, order, begin, mid, faceBounds, centroids, decoded);
+    node.first = build(nodes, order, mid, end, faceBounds, centroids, decoded);
+    node.count = 0;
+    nodes[index] = node;
+    return index;
+}
+
+template <typename Q>
+uint32_t TriangleMesh::traverse(const std::vector<Node<Q>> &nodes, const Ray &ray, float &closest, bool anyHit) const
+{
+    const float origin[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+    float inverseDirection[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float direction = ray.direction[axis];
+        inverseDirection[axis] = std::fabs(direction) > 1e-8f ? 1.0f / direction : std::copysign(1e30f, direction);
+    }
+
+    // Stack entries carry the decoded box of the node
+    struct Entry
+    {
+        uint32_t node;
+        float minBounds[3], maxBounds[3];
+    };
+    Entry stack[64];
+    int stackSize = 1;
+    const float meshMin[3] = {bounds.minBounds.x, bounds.minBounds.y, bounds.minBounds.z};
+    const float meshMax[3] = {bounds.maxBounds.x, bounds.maxBounds.y, bounds.maxBounds.z};
+    stack[0].node = 0;
+    decodeBox(nodes[0].lower, nodes[0].upper, meshMin, meshMax, stack[0].minBounds, stack[0].maxBounds);
+
+    uint32_t closestFace = std::numeric_limits<uint32_t>::max();
+    while (stackSize > 0)
+    {
+        const Entry entry = stack[--stackSize];
+        float entryDistance;
+        if (!hitBox(entry.minBounds, entry.maxBounds, origin, inverseDirection, closest, entryDistance))
+        {
+            continue;
+        }
+        const Node<Q> &node = nodes[entry.node];
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i)
+            {
+                const Face &face = faces[i];
+                float distance;
+                if (intersectTriangle(ray, vertex(face.vertices[0]), vertex(face.vertices[1]), vertex(face.vertices[2]), distance) &&
+                    distance < closest)
+                {
+                    closest = distance;
+                    closestFace = i;
+                    if (anyHit)
+                    {
+                        stackSize = 0;
+                        break;
+                    }
+                }
+            }
+            continue;
+        }
+
+        // Decode both children and push the farther one first, so the nearer one is visited first
+        Entry children[2];
+        float childDistance[2];
+        bool childHit[2];
+        children[0].node = entry.node + 1;
+        children[1].node = node.first;
+        for (int c = 0; c < 2; ++c)
+        {
+            const Node<Q> &child = nodes[children[c].node];
+            decodeBox(child.lower, child.upper, entry.minBounds, entry.maxBounds, children[c].minBounds, children[c].maxBounds);
+            childHit[c] = hitBox(children[c].minBounds, children[c].maxBounds, origin, inverseDirection, closest, childDistance[c]);
+        }
+        int nearer = childDistance[1] < childDistance[0] ? 1 : 0;
+        for (int c : {1 - nearer, nearer})
+        {
+            if (childHit[c])
+            {
+                stack[stackSize++] = children[c];
+            }
+        }
+    }
+
+    return closestFace;
+}
+
+Intersection TriangleMesh::intersectAtRest(const Ray &ray) const
+{
+    if (faces.empty())
+    {
+        return Intersection();
+    }
+    Intersection result;
+    float closest = std::numeric_limits<float>::max();
+    uint32_t closestFace = boundsBits == 8 ? traverse(nodes8, ray, closest, false) : traverse(nodes16, ray, closest, false);
+    if (closestFace != std::numeric_limits<uint32_t>::max())
+    {
+        // Only the closest triangle's normal is needed
+        const Face &face = faces[closestFace];
+        result.hit = intersectTriangle(ray, vertex(face.vertices[0]), vertex(face.vertices[1]), vertex(face.vertices[2]),
+                                       result.distance, result.normal);
+        result.distance = closest;
+        result.point = ray.origin + ray.direction * closest;
+        result.material = materials[face.material];
+        if (result.material.id == OBJECT_MATERIAL_ID)
+        {
+            result.material.id = faceIds[closestFace].objectId;
+        }
+    }
+    return result;
+}
+
+bool TriangleMesh::occludesAtRest(const Ray &ray, float maxDistance) const
+{
+    if (faces.empty())
+    {
+        return false;
+    }
+    uint32_t face = boundsBits == 8 ? traverse(nodes8, ray, maxDistance, true) : traverse(nodes16, ray, maxDistance, true);
+    return face != std::numeric_limits<uint32_t>::max();
+}
+
+bool TriangleMesh::hitDistanceAtRest(const Ray &ray, float maxDistance, float &distance, uint32_t &primitive) const
+{
+    if (faces.empty())
+    {
+        return false;
+    }
+    distance = maxDistance;
+    primitive = boundsBits == 8 ? traverse(nodes8, ray, distance, false) : traverse(nodes16, ray, distance, false);
+    return primitive != std::numeric_limits<uint32_t>::max();
+}
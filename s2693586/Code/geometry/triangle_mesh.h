@@ -0,0 +1,117 @@
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+
+#include <cstdint>
+#include <vector>
+#include "geometry.h" // Geometry base class, Triangle and the shared triangle test
+
+// Static triangles packed for scenes too large to hold as separate Triangle objects
+// Vertices shared by several triangles are stored once, optionally quantized to 16 bits per
+// coordinate within the mesh bounds, and each triangle keeps only three vertex indices, its object
+// and primitive IDs, and the index of its material in a table of distinct materials. Like a ParticleSet, the mesh builds its
+// own BVH and is placed in the scene as a single Geometry. Each BVH node stores its box quantized to
+// 8 or 16 bits per plane within its parent's box, rounded outwards so it still encloses its
+// triangles, and the index of its children or of its triangles (12 or 20 bytes per node).
+// Traversal decodes the boxes on the way down, so it does more work per node than a float BVH.
+// Triangle motion and texture coordinates are not stored.
+class TriangleMesh : public Geometry
+{
+public:
+    static constexpr int LEAF_SIZE = 4;
+
+    // Packs the triangles and builds the BVH
+    // Parameters:
+    // - triangles: Triangles to pack
+    // - boundsBits: Bits per node plane, 8 or 16
+    // - quantizeVertices: Store vertices as 16-bit offsets within the mesh bounds rather than floats
+    // Throws std::invalid_argument for any other number of bits
+    TriangleMesh(const std::vector<Triangle> &triangles, int boundsBits, bool quantizeVertices = true);
+
+    size_t size() const { return faces.size(); }
+    size_t vertexCount() const { return vertexTotal; }
+    size_t nodeCount() const { return boundsBits == 8 ? nodes8.size() : nodes16.size(); }
+    size_t materialCount() const { return materials.size(); }
+
+    // Bytes used by the vertices, triangles, materials and BVH nodes
+    size_t memoryBytes() const;
+
+    // Largest distance a vertex was moved by quantization
+    float maxVertexError() const { return vertexError; }
+
+    bool isAggregate() const override { return true; }
+
+    // Packed triangles keep the IDs of the triangles they were packed from
+    uint32_t objectIdOf(uint32_t primitive) const override { return faceIds[primitive].objectId; }
+    uint32_t primitiveIdOf(uint32_t primitive) const override { return faceIds[primitive].primitiveId; }
+
+    AABB boundingBox() const override { return bounds; }
+    Vector3 centroid() const override { return (bounds.minBounds + bounds.maxBounds) * 0.5f; }
+
+protected:
+    // Finds the closest triangle hit by traversing the mesh's BVH
+    Intersection intersectAtRest(const Ray &ray) const override;
+
+    // Stops at the first triangle blocking the ray
+    bool occludesAtRest(const Ray &ray, float maxDistance) const override;
+
+    // Finds the closest triangle without its normal; the primitive is its index in BVH leaf order
+    bool hitDistanceAtRest(const Ray &ray, float maxDistance, float &distance, uint32_t &primitive) const override;
+
+    // Texture coordinates are not stored; every point maps to (0, 0)
+    TextureCoordinates textureCoordinatesAtRest(const Vector3 &/*point*/) const override { return {0.0f, 0.0f, 1.0f}; }
+
+private:
+    // Object and primitive IDs of one triangle
+    struct Ids
+    {
+        uint32_t objectId, primitiveId;
+    };
+
+    // One triangle: indices of its vertices and of its material
+    struct Face
+    {
+        uint32_t vertices[3];
+        uint32_t material;
+    };
+
+    // BVH node with its box quantized within its parent's box: a leaf holds faces
+    // [first, first + count); an inner node (count == 0) has its left child directly after it
+    // and its right child at index first
+    template <typename Q>
+    struct Node
+    {
+        Q lower[3], upper[3];
+        uint16_t count;
+        uint32_t first;
+    };
+
+    int boundsBits;
+    std::vector<Face> faces;                  // Triangles in BVH leaf order
+    std::vector<Ids> faceIds;                 // IDs of each triangle, in the order of faces
+    std::vector<Material> materials;          // Distinct materials of the triangles (see OBJECT_MATERIAL_ID)
+    std::vector<uint16_t> quantizedVertices;  // Three offsets per vertex when quantized
+    std::vector<Vector3> vertices;            // Full-precision vertices otherwise
+    Vector3 vertexOrigin, vertexStep;         // Position of offset 0 and size of one step per axis
+    std::vector<Node<uint8_t>> nodes8;
+    std::vector<Node<uint16_t>> nodes16;
+    size_t vertexTotal = 0;
+    float vertexError = 0.0f;
+    AABB bounds;
+
+    Vector3 vertex(uint32_t index) const;
+
+    // Builds the subtree over faces [begin, end), whose boxes and centroids are given by face
+    // index, inside the decoded box of its parent
+    // Returns: The index of the subtree's root node
+    template <typename Q>
+    uint32_t build(std::vector<Node<Q>> &nodes, std::vector<uint32_t> &order, uint32_t begin, uint32_t end,
+                   const std::vector<AABB> &faceBounds, const std::vector<Vector3> &centroids, const AABB &parent);
+
+    // Finds the closest triangle hit before closest, or with anyHit the first one found
+    // closest receives the distance to the triangle found
+    // Returns: The triangle's index, or the largest uint32_t if none was hit
+    template <typename Q>
+    uint32_t traverse(const std::vector<Node<Q>> &nodes, const Ray &ray, float &closest, bool anyHit) const;
+};
+
+#endif // TRIANGLE_MESH_H
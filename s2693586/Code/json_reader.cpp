@@ -1,6 +1,13 @@
 #include "json_reader.h"
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
+#include <stdexcept>
+#include "external/json.hpp" // Includes the nlohmann/json library for JSON parsing
+#include "texture/texture_cache.h" // Lazily loaded image textures
+
+using json = nlohmann::json; // Alias for easier use of the nlohmann::json namespace
 
 // Reads scene data from a JSON file and returns a SceneData object
 SceneData readSceneFromJson(const std::string &fileName)
@@ -64,20 +71,169 @@ SceneData readSceneFromJson(const std::string &fileName)
             {
                 renderMode = RenderMode::PHONG;
             }
+            else if (modeStr == "pathtrace")
+            {
+                renderMode = RenderMode::PATH_TRACE;
+            }
         }
 
         // Initialize the camera
         Camera camera(cameraPosition, lookAt, upVector, fov, width, height, exposure, aperture, focalDistance);
 
+        // Extract the optional shutter interval for motion blur
+        if (config["camera"].contains("shutter"))
+        {
+            float shutterOpen = config["camera"]["shutter"][0];
+            float shutterClose = config["camera"]["shutter"][1];
+            if (shutterOpen < 0.0f || shutterClose > 1.0f || shutterClose < shutterOpen)
+            {
+                std::cerr << "Invalid shutter interval (expected 0 <= open <= close <= 1)" << std::endl;
+                throw std::runtime_error("Invalid camera shutter.");
+            }
+            camera = camera.withShutter(shutterOpen, shutterClose);
+        }
+
         // Create SceneData object with render mode
         SceneData sceneData(camera, width, height, renderMode);
 
+        // Extract the optional camera animation
+        // Keyframes default to the settings of the previous keyframe (or of the camera block)
+        sceneData.animation.base = {0.0f, cameraPosition, lookAt, fov, aperture, focalDistance};
+        sceneData.animation.upVector = upVector;
+        if (config.contains("animation"))
+        {
+            const json &animation = config["animation"];
+            CameraAnimation &cameraAnimation = sceneData.animation;
+            cameraAnimation.firstFrame = animation["frames"][0];
+            cameraAnimation.lastFrame = animation["frames"][1];
+            if (animation.contains("fps"))
+            {
+                cameraAnimation.fps = animation["fps"];
+            }
+            if (cameraAnimation.fps <= 0.0f || cameraAnimation.frameCount() == 0)
+            {
+                std::cerr << "Invalid animation frame range or fps" << std::endl;
+                throw std::runtime_error("Invalid camera animation.");
+            }
+
+            if (animation.contains("keyframes"))
+            {
+                CameraKeyframe previous = cameraAnimation.base;
+                for (const auto &key : animation["keyframes"])
+                {
+                    CameraKeyframe keyframe = previous;
+                    keyframe.time = key["time"];
+                    if (key.contains("position"))
+                    {
+                        keyframe.position = Vector3(key["position"][0], key["position"][1], key["position"][2]);
+                    }
+                    if (key.contains("lookAt"))
+                    {
+                        keyframe.lookAt = Vector3(key["lookAt"][0], key["lookAt"][1], key["lookAt"][2]);
+                    }
+                    keyframe.fov = key.value("fov", keyframe.fov);
+                    keyframe.aperture = key.value("aperture", keyframe.aperture);
+                    keyframe.focalDistance = key.value("focalDistance", keyframe.focalDistance);
+                    cameraAnimation.keyframes.push_back(keyframe);
+                    previous = keyframe;
+                }
+                std::stable_sort(cameraAnimation.keyframes.begin(), cameraAnimation.keyframes.end(),
+                                 [](const CameraKeyframe &a, const CameraKeyframe &b)
+                                 { return a.time < b.time; });
+            }
+            else if (animation.contains("turntable"))
+            {
+                const json &turntable = animation["turntable"];
+                cameraAnimation.turntable = true;
+                if (turntable.contains("axis"))
+                {
+                    cameraAnimation.turntableAxis = Vector3(turntable["axis"][0], turntable["axis"][1], turntable["axis"][2]);
+                }
+                cameraAnimation.revolutions = turntable.value("revolutions", cameraAnimation.revolutions);
+            }
+            else
+            {
+                std::cerr << "Animation needs either keyframes or a turntable" << std::endl;
+                throw std::runtime_error("Invalid camera animation.");
+            }
+        }
+
         // Extract number of bounces for recursive ray tracing
         if (config.contains("nbounces"))
         {
             sceneData.nbounces = config["nbounces"];
         }
 
+        // Extract the weight below which secondary rays are pruned
+        if (config.contains("minrayweight"))
+        {
+            sceneData.minRayWeight = config["minrayweight"];
+            if (sceneData.minRayWeight < 0.0f)
+            {
+                std::cerr << "Invalid minrayweight (expected a weight >= 0)" << std::endl;
+                throw std::runtime_error("Invalid minrayweight.");
+            }
+        }
+
+        // Extract the interval of deferred BVH subtrees
+        if (config.contains("lazybvhdepth"))
+        {
+            sceneData.lazyBVHDepth = config["lazybvhdepth"];
+            if (sceneData.lazyBVHDepth < 0)
+            {
+                std::cerr << "Invalid lazybvhdepth (expected a depth >= 0)" << std::endl;
+                throw std::runtime_error("Invalid lazybvhdepth.");
+            }
+        }
+
+        // Extract the BVH bound precision of the low-memory triangle mesh
+        if (config.contains("lowmemorybits"))
+        {
+            sceneData.lowMemoryBits = config["lowmemorybits"];
+            if (sceneData.lowMemoryBits != 0 && sceneData.lowMemoryBits != 8 && sceneData.lowMemoryBits != 16)
+            {
+                std::cerr << "Invalid lowmemorybits (expected 0, 8 or 16)" << std::endl;
+                throw std::runtime_error("Invalid lowmemorybits.");
+            }
+        }
+
+        // Extract the number of children per BVH node
+        if (config.contains("bvhwidth"))
+        {
+            sceneData.bvhWidth = config["bvhwidth"];
+            if (sceneData.bvhWidth != 2 && sceneData.bvhWidth != 4 && sceneData.bvhWidth != 8)
+            {
+                std::cerr << "Invalid bvhwidth (expected 2, 4 or 8)" << std::endl;
+                throw std::runtime_error("Invalid bvhwidth.");
+            }
+        }
+
+        // Extract the reference duplication budget of the spatial-split BVH
+        if (config.contains("spatialsplitbudget"))
+        {
+            sceneData.spatialSplitBudget = config["spatialsplitbudget"];
+        }
+
+        // Extract the Morton code length and treelet size of the linear BVH
+        if (config.contains("mortonbits"))
+        {
+            sceneData.mortonBits = config["mortonbits"];
+            if (sceneData.mortonBits != 0 && sceneData.mortonBits != 30 && sceneData.mortonBits != 63)
+            {
+                std::cerr << "Invalid mortonbits (expected 0, 30 or 63)" << std::endl;
+                throw std::runtime_error("Invalid mortonbits.");
+            }
+        }
+        if (config.contains("treeletleaves"))
+        {
+            sceneData.treeletLeaves = config["treeletleaves"];
+            if (sceneData.treeletLeaves != 0 && (sceneData.treeletLeaves < 3 || sceneData.treeletLeaves > 8))
+            {
+                std::cerr << "Invalid treeletleaves (expected 0, or 3 to 8)" << std::endl;
+                throw std::runtime_error("Invalid treeletleaves.");
+            }
+        }
+
         // Extract background color
         if (config.contains("scene") && config["scene"].contains("backgroundcolor"))
         {
@@ -94,19 +250,53 @@ SceneData readSceneFromJson(const std::string &fileName)
             {
                 Vector3 position = Vector3(light["position"][0], light["position"][1], light["position"][2]);     // Light position
                 Vector3 intensity = Vector3(light["intensity"][0], light["intensity"][1], light["intensity"][2]); // Light intensity
-                sceneData.lights.emplace_back(position, intensity);                                               // Add to the list of lights
+                std::string type = light.value("type", "pointlight");
+                int samples = light.value("samples", 16); // Shadow rays per shading point for area lights
+                if (samples < 1 || samples > MAX_LIGHT_SAMPLES)
+                {
+                    std::cerr << "Light samples must be between 1 and " << MAX_LIGHT_SAMPLES << std::endl;
+                    throw std::runtime_error("Invalid light samples.");
+                }
+
+                if (type == "pointlight")
+                {
+                    sceneData.lights.emplace_back(position, intensity); // Add to the list of lights
+                }
+                else if (type == "rectanglelight")
+                {
+                    Vector3 edgeU(light["edge1"][0], light["edge1"][1], light["edge1"][2]);
+                    Vector3 edgeV(light["edge2"][0], light["edge2"][1], light["edge2"][2]);
+                    sceneData.lights.push_back(Light::rectangle(position, edgeU, edgeV, intensity, samples));
+                }
+                else if (type == "disklight")
+                {
+                    Vector3 normal(light["normal"][0], light["normal"][1], light["normal"][2]);
+                    sceneData.lights.push_back(Light::disk(position, normal, light["radius"], intensity, samples));
+                }
+                else if (type == "spherelight")
+                {
+                    sceneData.lights.push_back(Light::sphere(position, light["radius"], intensity, samples));
+                }
+                else
+                {
+                    std::cerr << "Unknown light type: " << type << std::endl;
+                    throw std::runtime_error("Invalid light source.");
+                }
             }
         }
 
         // Extract shapes from JSON (similar as before)
         if (config.contains("scene") && config["scene"].contains("shapes"))
         {
+            uint32_t materialId = 0;
+            uint32_t primitiveId = 0; // Last primitive ID given out; particle sets take one per particle
             for (const auto &shape : config["scene"]["shapes"])
             {
                 // Extract material properties if available
 
                 // Default material properties
                 Material material(Vector3(0.8, 0.8, 0.8), Vector3(1.0, 1.0, 1.0), 0.9, 0.1, 20.0, false, 1.0);
+                material.id = ++materialId; // One ID per shape entry, in file order
 
                 // Parse material properties if provided
                 if (shape.contains("material"))
@@ -120,6 +310,24 @@ SceneData readSceneFromJson(const std::string &fileName)
                     material.reflectivity = shape["material"]["reflectivity"];
                     material.isRefractive = shape["material"]["isrefractive"];
                     material.refractiveIndex = shape["material"]["refractiveindex"];
+
+                    // Optional image texture, relative to the scene file; only its header is read here
+                    if (shape["material"].contains("texture"))
+                    {
+                        std::filesystem::path texturePath = shape["material"]["texture"].get<std::string>();
+                        if (texturePath.is_relative())
+                        {
+                            texturePath = std::filesystem::path(fileName).parent_path() / texturePath;
+                        }
+                        material.texture = TextureCache::global().load(texturePath.string());
+                    }
+                }
+
+                // Parse the optional linear motion (translation from time 0 to time 1 of the frame)
+                Vector3 motion(0.0f, 0.0f, 0.0f);
+                if (shape.contains("motion"))
+                {
+                    motion = Vector3(shape["motion"][0], shape["motion"][1], shape["motion"][2]);
                 }
 
                 // Parse different shape types
@@ -128,6 +336,9 @@ SceneData readSceneFromJson(const std::string &fileName)
                     Vector3 center = Vector3(shape["center"][0], shape["center"][1], shape["center"][2]);
                     float radius = shape["radius"];
                     sceneData.spheres.emplace_back(center, radius, material);
+                    sceneData.spheres.back().motion = motion;
+                    sceneData.spheres.back().objectId = material.id;
+                    sceneData.spheres.back().firstPrimitiveId = ++primitiveId;
                 }
                 else if (shape["type"] == "cylinder")
                 {
@@ -136,6 +347,9 @@ SceneData readSceneFromJson(const std::string &fileName)
                     float radius = shape["radius"];
                     float height = shape["height"];
                     sceneData.cylinders.emplace_back(center, axis, radius, height, material);
+                    sceneData.cylinders.back().motion = motion;
+                    sceneData.cylinders.back().objectId = material.id;
+                    sceneData.cylinders.back().firstPrimitiveId = ++primitiveId;
                 }
                 else if (shape["type"] == "triangle")
                 {
@@ -143,6 +357,37 @@ SceneData readSceneFromJson(const std::string &fileName)
                     Vector3 v1 = Vector3(shape["v1"][0], shape["v1"][1], shape["v1"][2]);
                     Vector3 v2 = Vector3(shape["v2"][0], shape["v2"][1], shape["v2"][2]);
                     sceneData.triangles.emplace_back(v0, v1, v2, material);
+                    sceneData.triangles.back().motion = motion;
+                    sceneData.triangles.back().objectId = material.id;
+                    sceneData.triangles.back().firstPrimitiveId = ++primitiveId;
+
+                    // Optional per-vertex texture coordinates
+                    Triangle &triangle = sceneData.triangles.back();
+                    float *uvs[3] = {triangle.uv0, triangle.uv1, triangle.uv2};
+                    const char *uvKeys[3] = {"uv0", "uv1", "uv2"};
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        if (shape.contains(uvKeys[i]))
+                        {
+                            uvs[i][0] = shape[uvKeys[i]][0];
+                            uvs[i][1] = shape[uvKeys[i]][1];
+                        }
+                    }
+                }
+                else if (shape["type"] == "particles")
+                {
+                    // Particle file, relative to the scene file; all particles share the shape's material
+                    std::filesystem::path particlePath = shape["file"].get<std::string>();
+                    if (particlePath.is_relative())
+                    {
+                        particlePath = std::filesystem::path(fileName).parent_path() / particlePath;
+                    }
+                    auto particleSet = ParticleSet::load(particlePath.string(), material);
+                    particleSet->motion = motion;
+                    particleSet->objectId = material.id;
+                    particleSet->firstPrimitiveId = primitiveId + 1;
+                    primitiveId += static_cast<uint32_t>(particleSet->size());
+                    sceneData.particles.push_back(particleSet);
                 }
             }
         }
@@ -4,33 +4,48 @@
 // Includes
 #include <string>
 #include <vector>
-#include "external/json.hpp"   // Includes the nlohmann/json library for JSON parsing
 #include "camera/camera.h"     // Camera class for view setup
+#include "camera/camera_animation.h" // Keyframed camera paths
 #include "camera/light.h"      // Light definitions
 #include "material/material.h" // Material properties for rendering
 #include "geometry/geometry.h" // Geometric objects (spheres, cylinders, triangles, etc.)
-
-using json = nlohmann::json; // Alias for easier use of the nlohmann::json namespace
+#include "geometry/particles.h" // Compact particle sets
+#include <memory>
 
 // Enumeration for different render modes
 enum class RenderMode
 {
     BINARY, // Binary mode: pixels are either hit or miss
-    PHONG   // Phong mode: realistic shading based on lighting
+    PHONG,      // Phong mode: realistic shading based on lighting
+    PATH_TRACE  // Path tracing: one light path per sample with light sampling and Russian roulette
 };
 
+// Default weight below which the recursive shaders skip reflection and refraction rays: 0 traces every ray
+// Each pruned ray changes the pixel by less than its weight, but the errors of a ray tree add up, so
+// pruning is opt-in ("minrayweight" or --min-ray-weight)
+constexpr float DEFAULT_MIN_RAY_WEIGHT = 0.0f;
+
 class SceneData
 {
 public:
     Camera camera;                   // Camera object for defining the view
     int width, height;               // Dimensions of the render image
     int nbounces;                    // Number of bounces for recursive raytracing
+    float minRayWeight = DEFAULT_MIN_RAY_WEIGHT; // Reflection/refraction rays weighted below this are not traced
+    int lazyBVHDepth = 0;            // Defer BVH subtrees every this many levels until a ray reaches them (0 builds all up front)
+    int lowMemoryBits = 0;           // Pack static untextured triangles into a TriangleMesh with 8- or 16-bit BVH bounds (0 keeps separate triangles)
+    int bvhWidth = 2;                // Children per BVH node: 2, or 4 or 8 to collapse the binary BVH into a wide one
+    float spatialSplitBudget = -1.0f; // Build a spatial-split BVH adding up to this fraction of references by clipping (negative uses BVHNode::build)
+    int mortonBits = 0;              // Build the BVH from 30- or 63-bit Morton codes (0 uses BVHNode::build)
+    int treeletLeaves = 0;           // Optimise the treelets of a Morton-code BVH with up to this many leaves (0 skips it)
     RenderMode renderMode;           // Current render mode (BINARY or PHONG)
     std::vector<Light> lights;       // List of light sources in the scene
     std::vector<Sphere> spheres;     // List of spheres in the scene
     std::vector<Cylinder> cylinders; // List of cylinders in the scene
     std::vector<Triangle> triangles; // List of triangles in the scene
+    std::vector<std::shared_ptr<const ParticleSet>> particles; // Particle sets loaded from binary files
     Vector3 backgroundColor;         // Background color for the scene
+    CameraAnimation animation;       // Optional camera path for batch rendering
 
     // Constructor to initialize the scene data
     SceneData(const Camera& cam, int w, int h, RenderMode mode)
@@ -42,4 +57,10 @@ public:
           nbounces(nbounces) {}           // Default number of ray bounces
 };
 
+// Reads scene data from a JSON file
+// Parameters:
+// - fileName: Path to the scene JSON file
+// Returns: The parsed SceneData; throws std::runtime_error if the file cannot be read or parsed
+SceneData readSceneFromJson(const std::string &fileName);
+
 #endif // JSON_READER_H
@@ -1,384 +1,232 @@
+#include <algorithm>
 #include <iostream>
-#include <vector>
 #include <chrono>
-#include <limits>
 #include <random>
-#include <limits>
-#include <fstream>
-#include "json_reader.cpp"             // Handles JSON scene file parsing
-#include "camera/camera.cpp"           // Implements the camera functionality
-#include "camera/ray.h"                // Defines the ray structure
-#include "material/material.h"         // Contains material properties
-#include "camera/light.h"              // Defines light sources
-#include "shading/blinn_phong.cpp"     // Implements Blinn-Phong shading
-#include "geometry/geometry.cpp"       // Contains geometric objects and operations
-#include "tone/tone_mapping.cpp"       // Implements tone mapping techniques
-#include "bvh/bvh_node.h"              // Defines BVH (Bounding Volume Hierarchy) nodes
-#include "shading/blinn_phong_bvh.cpp" // Combines Blinn-Phong with BVH
-#include "geometry/intersection.h"     // Handles ray-object intersections
 #include <memory>
-#include <omp.h> // Enables parallel computing
-
-// Generates evenly distributed points for antialiasing
-std::vector<std::pair<float, float>> plot_evenly_distributed_points(int num_samples = 64, float lower_bound = -1.0f, float upper_bound = 1.0f)
+#include <string>
+#include <vector>
+#include "json_reader.h"     // Handles JSON scene file parsing
+#include "render/render.h"   // Image output helpers
+#include "render/renderer.h" // Scene and Renderer library API
+#include "render/animation.h" // Camera animation batch rendering
+#include "render/distributed.h" // Tile workers and the distributed coordinator
+#include "render/preview.h"     // Progressive preview published to shared memory
+#include "texture/texture_cache.h" // Texture cache statistics
+#include "bvh/shadow_cache.h"   // Shadow occluder cache statistics
+
+// Builds the output file name of an animation frame
+// A run of '#' in the pattern is replaced by the zero-padded frame number;
+// otherwise the number is inserted before the extension (out.ppm -> out_0001.ppm)
+static std::string frameFileName(const std::string &pattern, int frame)
 {
-    int grid_size = static_cast<int>(std::sqrt(num_samples)); // Approximate grid size
-    float step = (upper_bound - lower_bound) / grid_size;     // Distance between grid points
-
-    // Generate evenly distributed points with slight jitter
-    std::random_device rd;
-    std::mt19937 rng(rd());
-    std::uniform_real_distribution<float> jitter(-step / 5, step / 5); // Small jitter to avoid perfect alignment
-
-    std::vector<std::pair<float, float>> points;
-    for (int i = 0; i < grid_size; ++i)
+    size_t first = pattern.find('#');
+    std::string number = std::to_string(frame);
+    if (first == std::string::npos)
     {
-        for (int j = 0; j < grid_size; ++j)
+        size_t dot = pattern.find_last_of('.');
+        size_t slash = pattern.find_last_of('/');
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
         {
-            float x = lower_bound + i * step + jitter(rng); // Add jitter to x
-            float y = lower_bound + j * step + jitter(rng); // Add jitter to y
-            points.emplace_back(x, y);                      // Store the jittered point
+            dot = pattern.size();
         }
+        return pattern.substr(0, dot) + "_" + std::string(number.size() < 4 ? 4 - number.size() : 0, '0') + number + pattern.substr(dot);
     }
-    return points;
+    size_t last = pattern.find_first_not_of('#', first);
+    size_t digits = (last == std::string::npos ? pattern.size() : last) - first;
+    std::string padded = std::string(number.size() < digits ? digits - number.size() : 0, '0') + number;
+    return pattern.substr(0, first) + padded + (last == std::string::npos ? "" : pattern.substr(last));
 }
 
-// Writes a binary image to a PPM file
-void writeBinaryImageToPPM(const std::string &outputFileName, int width, int height, const std::vector<unsigned char> &image)
+// Inserts a suffix before the extension of a file name (out.ppm -> out_albedo.ppm)
+static std::string suffixedFileName(const std::string &fileName, const std::string &suffix)
 {
-    // Open the output file in binary mode
-    std::ofstream outFile(outputFileName, std::ios::binary); // Open file in binary mode
-
-    // Check if the file is open
-    if (outFile.is_open())
+    size_t dot = fileName.find_last_of('.');
+    size_t slash = fileName.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
     {
-        // Write PPM header (P6 format)
-        outFile << "P6\n"
-                << width << " " << height << "\n255\n";
-
-        // Write binary pixel data
-        outFile.write(reinterpret_cast<const char *>(image.data()), image.size());
-
-        // Close the file
-        outFile.close();
+        dot = fileName.size();
     }
-    else
-    {
-        // Output error message if the file cannot be opened
-        std::cerr << "Failed to open output file: " << outputFileName << std::endl;
-    }
-}
-
-// Function to set the color of a pixel in the image buffer
-void setPixelColor(int x, int y, int width, const Vector3 &toneMappedColor, std::vector<uint8_t> &image)
-{
-    // Calculate the index in the 1D image vector
-    int flippedX = width - 1 - x; // Flip x-axis to account for image orientation
-    int index = (y * width + flippedX) * 3;
-
-    // Set the RGB values, clamping them to [0, 255] and converting to uint8_t
-    image[index] = static_cast<uint8_t>(std::min(toneMappedColor.x * 255.0f, 255.0f));     // R
-    image[index + 1] = static_cast<uint8_t>(std::min(toneMappedColor.y * 255.0f, 255.0f)); // G
-    image[index + 2] = static_cast<uint8_t>(std::min(toneMappedColor.z * 255.0f, 255.0f)); // B
+    return fileName.substr(0, dot) + suffix + fileName.substr(dot);
 }
 
-// Collects all geometric objects (spheres, cylinders, triangles) from the scene data
-std::vector<std::shared_ptr<const Geometry>> collectGeometries(const SceneData &sceneData)
+// Writes viewable 8-bit versions of the auxiliary buffers next to the output image
+// Albedo is written as is, normals are mapped from [-1, 1] to [0, 255], depth is scaled so the
+// farthest hit is white, and every material ID gets its own color (black for the background)
+static void writeAovImages(const std::string &outputFileName, int width, int height, const std::vector<float> &albedo,
+                           const std::vector<float> &normal, const std::vector<float> &depth, const std::vector<uint32_t> &materialId)
 {
-    std::vector<std::shared_ptr<const Geometry>> geometries;
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    std::vector<uint8_t> image(pixelCount * 3);
+    auto toByte = [](float value)
+    { return static_cast<uint8_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f); };
 
-    // Add spheres to the geometries list
-    for (const auto &sphere : sceneData.spheres)
+    for (size_t i = 0; i < pixelCount * 3; ++i)
     {
-        geometries.push_back(std::make_shared<Sphere>(sphere));
+        image[i] = toByte(albedo[i]);
     }
+    writeBinaryImageToPPM(suffixedFileName(outputFileName, "_albedo"), width, height, image);
 
-    // Add cylinders to the geometries list
-    for (const auto &cylinder : sceneData.cylinders)
+    for (size_t i = 0; i < pixelCount * 3; ++i)
     {
-        geometries.push_back(std::make_shared<Cylinder>(cylinder));
+        image[i] = toByte(normal[i] * 0.5f + 0.5f);
     }
+    writeBinaryImageToPPM(suffixedFileName(outputFileName, "_normal"), width, height, image);
 
-    // Add triangles to the geometries list
-    for (const auto &triangle : sceneData.triangles)
+    float maxDepth = *std::max_element(depth.begin(), depth.end());
+    for (size_t i = 0; i < pixelCount; ++i)
     {
-        geometries.push_back(std::make_shared<Triangle>(triangle));
+        image[i * 3] = image[i * 3 + 1] = image[i * 3 + 2] = toByte(maxDepth > 0.0f ? depth[i] / maxDepth : 0.0f);
     }
+    writeBinaryImageToPPM(suffixedFileName(outputFileName, "_depth"), width, height, image);
 
-    return geometries;
-}
-
-// Renders the scene without acceleration structures
-void renderScene(const Camera &camera, const std::vector<Sphere> &spheres, const std::vector<Cylinder> &cylinders,
-                 const std::vector<Triangle> &triangles, const std::vector<Light> &lights,
-                 RenderMode renderMode, int width, int height, const Vector3 &backgroundColor, int nbounces,
-                 const std::string &outputFileName, bool applyToneMap, bool antialiasing)
-{
-    std::vector<uint8_t> image(width * height * 3, 0); // Initialize image buffer
-    std::vector<Vector3> hdrColors(width * height);    // Buffer to store HDR colors
-    std::vector<std::pair<float, float>> points;
-
-    // Generate antialiasing points if needed
-    if (antialiasing && renderMode == RenderMode::PHONG)
+    for (size_t i = 0; i < pixelCount; ++i)
     {
-        points = plot_evenly_distributed_points(16, -1.0f, 1.0f);
-    }
-    else
-    {
-        points = {{0.0f, 0.0f}};
+        uint32_t hash = materialId[i] * 0x9e3779b1u;
+        image[i * 3] = materialId[i] ? static_cast<uint8_t>(64 + (hash >> 24) % 192) : 0;
+        image[i * 3 + 1] = materialId[i] ? static_cast<uint8_t>(64 + (hash >> 16) % 192) : 0;
+        image[i * 3 + 2] = materialId[i] ? static_cast<uint8_t>(64 + (hash >> 8) % 192) : 0;
     }
+    writeBinaryImageToPPM(suffixedFileName(outputFileName, "_material"), width, height, image);
+}
 
-// First pass: calculate HDR colors for each pixel
-#pragma omp parallel for collapse(2)
-    for (int y = 0; y < height; ++y)
+// Writes the output of a visibility render
+// Masks are written as PBM, depths as 16-bit PGM and IDs as 32-bit PAM files; an output name ending in
+// .ppm instead gets a viewable 8-bit image (white coverage, grey depth, or a color per ID)
+static void writeVisibilityImage(const std::string &outputFileName, const VisibilityRequest &request, const std::vector<uint8_t> &mask,
+                                 const std::vector<uint16_t> &depth, const std::vector<uint32_t> &ids, float depthFar)
+{
+    int width = request.camera.imageWidth(), height = request.camera.imageHeight();
+    bool ppm = outputFileName.size() >= 4 && outputFileName.compare(outputFileName.size() - 4, 4, ".ppm") == 0;
+    if (!ppm)
     {
-        for (int x = 0; x < width; ++x)
+        if (request.mode == VisibilityMode::MASK)
         {
-            Vector3 color = Vector3(0.0f, 0.0f, 0.0f); // Initialize pixel color
-            float totalWeight = 0.0f;
-
-            for (const auto &point : points)
-            {
-                float u = x + point.first;
-                float v = y + point.second;
-
-                // Generate the ray from the camera
-                Ray ray = camera.generateRay(static_cast<float>(u), static_cast<float>(v));
-                Intersection closestIntersection = findClosestIntersection(ray, spheres, cylinders, triangles);
-
-                // Set pixel value based on render mode
-                if (closestIntersection.hit)
-                {
-                    // Handle intersection cases
-                    if (renderMode == RenderMode::BINARY)
-                    {
-                        // Binary shading: set color to red if there's an intersection
-                        color = Vector3(1.0f, 0.0f, 0.0f); // Binary shading
-                        totalWeight += 1.0f;
-                    }
-                    else if (renderMode == RenderMode::PHONG)
-                    {
-
-                        Vector3 tmpColor = blinnPhongShading(closestIntersection, ray, lights, spheres, cylinders, triangles, nbounces, backgroundColor);
-
-                        color += tmpColor;
-                        totalWeight += 1.0f;
-                    }
-                }
-                else
-                {
-                    // Handle cases with no intersection
-                    if (renderMode == RenderMode::BINARY)
-                    {
-                        // Binary shading: set color to red if there's an intersection
-                        color = Vector3(0.0f, 0.0f, 0.0f);
-                        totalWeight += 1.0f;
-                    }
-                    else if (renderMode == RenderMode::PHONG)
-                    {
-
-                        color += backgroundColor;
-                        totalWeight += 1.0f;
-                    }
-                }
-            }
-
-            color /= totalWeight; // Normalize color
-
-            // Store color in the HDR buffer
-            hdrColors[y * width + x] = color;
+            writeMaskToPBM(outputFileName, width, height, mask);
         }
-    }
-
-    // Second pass: Apply ACES tone mapping to each pixel
-    Vector3 minColor(std::numeric_limits<float>::max());
-    Vector3 maxColor(-std::numeric_limits<float>::max());
-
-    // Calculate min and max color values for tone mapping
-    if (applyToneMap)
-    {
-        for (const auto &color : hdrColors)
+        else if (request.mode == VisibilityMode::DEPTH)
         {
-            if (color != backgroundColor) // Exclude background colour
-            {
-                minColor = Vector3(
-                    std::min(minColor.x, color.x),
-                    std::min(minColor.y, color.y),
-                    std::min(minColor.z, color.z));
-
-                maxColor = Vector3(
-                    std::max(maxColor.x, color.x),
-                    std::max(maxColor.y, color.y),
-                    std::max(maxColor.z, color.z));
-            }
+            writeDepthToPGM(outputFileName, width, height, depth, depthFar);
         }
+        else
+        {
+            writeIdsToPAM(outputFileName, width, height, ids);
+        }
+        return;
     }
 
-#pragma omp parallel for collapse(2)
+    size_t rowBytes = (static_cast<size_t>(width) + 7) / 8;
+    std::vector<uint8_t> image(static_cast<size_t>(width) * height * 3);
     for (int y = 0; y < height; ++y)
     {
         for (int x = 0; x < width; ++x)
         {
-            if (renderMode == RenderMode::BINARY)
+            size_t pixel = static_cast<size_t>(y) * width + x;
+            uint8_t *out = &image[pixel * 3];
+            if (request.mode == VisibilityMode::MASK)
+            {
+                out[0] = out[1] = out[2] = (mask[y * rowBytes + x / 8] & (0x80 >> (x % 8))) ? 255 : 0;
+            }
+            else if (request.mode == VisibilityMode::DEPTH)
             {
-                Vector3 toneMappedColor = hdrColors[y * width + x];
-                setPixelColor(x, y, width, toneMappedColor, image);
+                out[0] = out[1] = out[2] = static_cast<uint8_t>(depth[pixel] >> 8);
             }
             else
             {
-                Vector3 hdrColor = hdrColors[y * width + x];
-                if (applyToneMap)
-                {
-                    hdrColor = toneMap(hdrColor, camera.exposure, minColor, maxColor, backgroundColor); // Apply tone mapping
-                }
-
-                setPixelColor(x, y, width, hdrColor, image); // Write pixel color
+                uint32_t hash = ids[pixel] * 0x9e3779b1u;
+                out[0] = ids[pixel] ? static_cast<uint8_t>(64 + (hash >> 24) % 192) : 0;
+                out[1] = ids[pixel] ? static_cast<uint8_t>(64 + (hash >> 16) % 192) : 0;
+                out[2] = ids[pixel] ? static_cast<uint8_t>(64 + (hash >> 8) % 192) : 0;
             }
         }
     }
-
-    // Write the binary image to file (PPM format)
     writeBinaryImageToPPM(outputFileName, width, height, image);
 }
 
-void renderSceneBVH(const Camera &camera, const BVHNode *root, const std::vector<Light> &lights,
-                    RenderMode renderMode, int width, int height, const Vector3 &backgroundColor,
-                    int nbounces, const std::string &outputFileName, bool applyToneMap, bool antialiasing)
+// Prints how the tiles of a distributed render were shared between the workers
+static void printDistributedStats(const DistributedStats &stats)
 {
-    // Implementation of rendering using the BVH acceleration structure
-    std::vector<uint8_t> image(width * height * 3, 0); // Image buffer
-    std::vector<Vector3> hdrColors(width * height);    // Buffer to store HDR colors
-    std::vector<std::pair<float, float>> points;
-
-    if (antialiasing && renderMode == RenderMode::PHONG)
+    for (const WorkerStats &worker : stats.workers)
     {
-        points = plot_evenly_distributed_points(16, -1.0f, 1.0f);
-    }
-    else
-    {
-        points = {{0.0f, 0.0f}};
-    }
-
-#pragma omp parallel for collapse(2)
-    for (int y = 0; y < height; ++y)
-    {
-        for (int x = 0; x < width; ++x)
+        std::cout << "Worker " << worker.address << ": " << worker.tiles << " tiles, " << worker.renderMs << " ms rendering";
+        if (worker.duplicates > 0)
         {
-            Vector3 color = Vector3(0.0f, 0.0f, 0.0f);
-            int flippedX = width - 1 - x;
-            float totalWeight = 0.0f;
-
-            for (const auto &point : points)
-            {
-                // Generate ray from camera
-                float u = x + point.first;
-                float v = y + point.second;
-                Ray ray = camera.generateRay(static_cast<float>(u), static_cast<float>(v));
-                Intersection closestIntersection;
-                closestIntersection.distance = std::numeric_limits<float>::max();
-
-                // Check for intersection with BVH root
-                if (root->intersect(ray, closestIntersection))
-                {
-                    // If intersection occurs, determine color based on render mode
-                    if (renderMode == RenderMode::BINARY)
-                    {
-                        color = Vector3(1.0f, 0.0f, 0.0f); // Set to red if intersection
-                        totalWeight += 1.0f;
-                    }
-                    else if (renderMode == RenderMode::PHONG)
-                    {
-                        color += blinnPhongShadingBVH(closestIntersection, ray, lights, root, nbounces - 1, backgroundColor);
-                        totalWeight += 1.0f;
-                    }
-                }
-                else
-                {
-                    if (renderMode == RenderMode::BINARY)
-                    {
-                        color = Vector3(0.0f, 0.0f, 0.0f); // Set to red if intersection
-                        totalWeight += 1.0f;
-                    }
-                    else if (renderMode == RenderMode::PHONG)
-                    {
-                        color += backgroundColor;
-                        totalWeight += 1.0f;
-                    }
-                }
-            }
-            color /= totalWeight;
-            hdrColors[y * width + x] = color;
+            std::cout << ", " << worker.duplicates << " duplicate tiles discarded";
         }
+        std::cout << (!worker.connected ? " (never connected)" : worker.failed ? " (failed)" : "") << std::endl;
     }
-    // Second pass: Apply ACES tone mapping to each pixel
-    Vector3 minColor(std::numeric_limits<float>::max());
-    Vector3 maxColor(-std::numeric_limits<float>::max());
+    std::cout << "Distributed render: " << stats.tiles << " tiles on " << stats.workers.size() << " workers in "
+              << stats.totalMs << " ms, " << stats.reassigned << " reassigned, " << stats.speculative
+              << " also given to a second worker" << std::endl;
+}
 
-    // Calculate min and max color values for tone mapping
-    if (applyToneMap)
+// Prints how much of a lazily built BVH was expanded by the render
+static void printBVHBuildStats()
+{
+    BVHBuildStats stats = BVHNode::buildStats();
+    if (stats.deferred == 0)
     {
-        for (const auto &color : hdrColors)
-        {
-            if (color != backgroundColor)
-            {
-                minColor = Vector3(
-                    std::min(minColor.x, color.x),
-                    std::min(minColor.y, color.y),
-                    std::min(minColor.z, color.z));
-
-                maxColor = Vector3(
-                    std::max(maxColor.x, color.x),
-                    std::max(maxColor.y, color.y),
-                    std::max(maxColor.z, color.z));
-            }
-        }
+        return;
     }
-
-#pragma omp parallel for collapse(2)
-    for (int y = 0; y < height; ++y)
+    std::cout << "Lazy BVH: " << stats.nodes << " nodes built in " << stats.buildMs << " ms, " << stats.expanded << " of "
+              << stats.deferred << " deferred subtrees expanded";
+    if (stats.discarded > 0)
     {
-        for (int x = 0; x < width; ++x)
-        {
-            if (renderMode == RenderMode::BINARY)
-            {
-                Vector3 hdrColor = hdrColors[y * width + x];
-                setPixelColor(x, y, width, hdrColor, image);
-            }
-            else
-            {
-                Vector3 hdrColor = hdrColors[y * width + x];
-                if (applyToneMap)
-                {
-                    hdrColor = toneMap(hdrColor, camera.exposure, minColor, maxColor, backgroundColor); // Use ACES tone mapping
-                }
-                setPixelColor(x, y, width, hdrColor, image);
-            }
-        }
+        std::cout << " (" << stats.discarded << " duplicate expansions discarded)";
     }
+    std::cout << std::endl;
+}
 
-    // Write the binary image to file (PPM format)
-    writeBinaryImageToPPM(outputFileName, width, height, image);
+// Prints the size of the triangles packed in low-memory mode
+static void printTriangleMeshStats(const Scene &scene)
+{
+    const TriangleMesh *mesh = scene.mesh();
+    if (!mesh)
+    {
+        return;
+    }
+    std::cout << "Low-memory mesh: " << mesh->size() << " triangles, " << mesh->vertexCount() << " shared vertices, "
+              << mesh->nodeCount() << " BVH nodes, " << static_cast<double>(mesh->memoryBytes()) / mesh->size()
+              << " bytes per triangle (vertex error up to " << mesh->maxVertexError() << ")" << std::endl;
 }
 
-void renderWithoutBVH(const SceneData &sceneData, const std::string &outputFileName, bool applyToneMap, bool antialiasing)
+// Prints texture cache hit rate and memory use when the scene has textures
+static void printTextureCacheStats()
 {
-    renderScene(sceneData.camera, sceneData.spheres, sceneData.cylinders, sceneData.triangles,
-                sceneData.lights, sceneData.renderMode, sceneData.width, sceneData.height,
-                sceneData.backgroundColor, sceneData.nbounces, outputFileName, applyToneMap, antialiasing);
+    TextureCacheStats stats = TextureCache::global().stats();
+    if (stats.textures == 0)
+    {
+        return;
+    }
+    const double megabyte = 1 << 20;
+    std::cout << "Texture cache: " << stats.textures << " textures, " << stats.hits << " hits, " << stats.misses << " misses ("
+              << 100.0 * stats.hitRate() << "% hit rate), " << stats.evictions << " evictions, "
+              << stats.residentBytes / megabyte << " MB resident, " << stats.peakBytes / megabyte << " MB peak of "
+              << stats.budgetBytes / megabyte << " MB budget" << std::endl;
 }
 
-void renderWithBVH(const SceneData &sceneData, BVHNode *root, const std::string &outputFileName, bool applyToneMap, bool antialiasing)
+// Prints how often the last-occluder cache answered shadow rays when it was used
+static void printShadowCacheStats()
 {
-    renderSceneBVH(sceneData.camera, root, sceneData.lights, sceneData.renderMode,
-                   sceneData.width, sceneData.height, sceneData.backgroundColor,
-                   sceneData.nbounces, outputFileName, applyToneMap, antialiasing);
+    ShadowCacheStats stats = ShadowCache::stats();
+    if (stats.queries == 0)
+    {
+        return;
+    }
+    std::cout << "Shadow cache: " << stats.queries << " shadow rays, " << stats.blocked << " blocked, " << stats.hits
+              << " by the cached occluder (" << 100.0 * stats.hitRate() << "% hit rate)" << std::endl;
 }
 
 int main(int argc, char *argv[])
 {
     if (argc < 6)
     {
-        std::cerr << "Usage: " << argv[0] << " <path_to_json_file> <output_file> <use_bvh (0 or 1)> <apply_tone_map (0 or 1)> <antialiasing (0 or 1)>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <path_to_json_file> <output_file> <use_bvh (0 or 1)> <apply_tone_map (0 or 1)> <antialiasing (0 or 1)>"
+                  << " [--seed <n>] [--resolution <width>x<height>] [--animation] [--frames <first>:<last>]"
+                  << " [--texture-cache <MB>] [--path-trace] [--spp <n>]"
+                  << " [--denoise] [--aovs] [--light-samples <n>] [--no-shadow-cache]"
+                  << " [--min-ray-weight <w>] [--worker <address>] [--workers <address>,...] [--local-workers <n>]"
+                  << " [--tile-size <n>] [--lazy-bvh <depth>] [--low-memory <bits>] [--bvh-width <n>] [--sbvh <budget>] [--lbvh <bits>] [--treelets <leaves>]"
+                  << " [--preview <shared memory name>] [--visibility <mask|depth|object-id|primitive-id>] [--depth-far <d>]" << std::endl;
         return 1;
     }
 
@@ -388,8 +236,324 @@ int main(int argc, char *argv[])
     bool applyToneMap = (std::stoi(argv[4]) != 0); // Apply tone mapping if the fourth argument is 1
     bool antialiasing = (std::stoi(argv[5]) != 0); // Enable antialiasing if the fifth argument is 1
 
-    // Load the scene from the JSON file
-    SceneData sceneData = readSceneFromJson(fileName);
+    // Optional flags following the positional arguments
+    unsigned int seed = std::random_device{}(); // Random unless a fixed seed is requested
+    int widthOverride = 0, heightOverride = 0;  // Keep the JSON resolution unless overridden
+    bool animate = false;                       // Render the JSON camera animation instead of one frame
+    int firstFrame = 0, lastFrame = -1;         // Keep the JSON frame range unless overridden
+    bool pathTrace = false;                     // Render Phong scenes with the path tracer
+    int samplesPerPixel = 0;                    // Keep the default sample count unless overridden
+    bool denoise = false;                       // Run the denoiser before tone mapping
+    bool writeAovs = false;                     // Also write the auxiliary buffers as images
+    int lightSamples = 0;                       // Keep the JSON shadow-ray counts of area lights unless overridden
+    float minRayWeight = -1.0f;                 // Keep the scene's secondary-ray pruning weight unless overridden
+    int lazyBVHDepth = -1;                      // Keep the scene's deferred BVH interval unless overridden
+    int lowMemoryBits = -1;                     // Keep the scene's low-memory triangle packing unless overridden
+    int bvhWidth = -1;                          // Keep the scene's BVH width unless overridden
+    float spatialSplitBudget = -1.0f;           // Keep the scene's BVH build unless a spatial-split budget is given
+    int mortonBits = -1;                        // Keep the scene's Morton code length unless overridden
+    int treeletLeaves = -1;                     // Keep the scene's treelet size unless overridden
+    std::string workerAddress;                  // Serve tiles on this address instead of rendering
+    std::vector<std::string> workerAddresses;   // Hand the tiles of the frame to these workers
+    int localWorkers = 0;                       // Start this many workers on this machine
+    std::string previewName;                    // Render progressively into this shared framebuffer, following edits
+    std::string visibility;                     // Write a mask, depth or ID output instead of shading
+    float depthFar = 0.0f;                      // Distance stored as the largest depth value (0 uses the farthest hit)
+    DistributedSettings distributedSettings;
+    std::vector<std::string> workerArguments(argv + 1, argv + 6); // Options passed on to local workers
+    for (int i = 6; i < argc; ++i)
+    {
+        std::string option = argv[i];
+        int optionStart = i;
+        if (option == "--worker" && i + 1 < argc)
+        {
+            workerAddress = argv[++i];
+        }
+        else if (option == "--workers" && i + 1 < argc)
+        {
+            std::string list = argv[++i];
+            for (size_t begin = 0, end; begin <= list.size(); begin = end + 1)
+            {
+                end = std::min(list.find(',', begin), list.size());
+                if (end > begin)
+                {
+                    workerAddresses.push_back(list.substr(begin, end - begin));
+                }
+            }
+        }
+        else if (option == "--local-workers" && i + 1 < argc)
+        {
+            localWorkers = std::stoi(argv[++i]);
+            if (localWorkers < 1)
+            {
+                std::cerr << "Invalid worker count: " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (option == "--tile-size" && i + 1 < argc)
+        {
+            distributedSettings.tileSize = std::stoi(argv[++i]);
+            if (distributedSettings.tileSize < 1)
+            {
+                std::cerr << "Invalid tile size: " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (option == "--preview" && i + 1 < argc)
+        {
+            previewName = argv[++i];
+        }
+        else if (option == "--visibility" && i + 1 < argc)
+        {
+            visibility = argv[++i];
+            if (visibility != "mask" && visibility != "depth" && visibility != "object-id" && visibility != "primitive-id")
+            {
+                std::cerr << "Invalid visibility output (expected mask, depth, object-id or primitive-id): " << visibility << std::endl;
+                return 1;
+            }
+        }
+        else if (option == "--depth-far" && i + 1 < argc)
+        {
+            depthFar = std::stof(argv[++i]);
+            if (depthFar <= 0.0f)
+            {
+                std::cerr << "Invalid far depth: " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (option == "--seed" && i + 1 < argc)
+        {
+            seed = static_cast<unsigned int>(std::stoul(argv[++i]));
+        }
+        else if (option == "--resolution" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            size_t separator = value.find('x');
+            if (separator == std::string::npos)
+            {
+                std::cerr << "Invalid resolution (expected <width>x<height>): " << value << std::endl;
+                return 1;
+            }
+            widthOverride = std::stoi(value.substr(0, separator));
+            heightOverride = std::stoi(value.substr(separator + 1));
+        }
+        else if (option == "--texture-cache" && i + 1 < argc)
+        {
+            TextureCache::global().setMemoryBudget(static_cast<size_t>(std::stod(argv[++i]) * (1 << 20)));
+        }
+        else if (option == "--path-trace")
+        {
+            pathTrace = true;
+        }
+        else if (option == "--spp" && i + 1 < argc)
+        {
+            samplesPerPixel = std::stoi(argv[++i]);
+            if (samplesPerPixel < 1)
+            {
+                std::cerr << "Invalid sample count: " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (option == "--light-samples" && i + 1 < argc)
+        {
+            lightSamples = std::stoi(argv[++i]);
+            if (lightSamples < 1 || lightSamples > MAX_LIGHT_SAMPLES)
+            {
+                std::cerr << "Invalid light sample count: " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (option == "--min-ray-weight" && i + 1 < argc)
+        {
+            minRayWeight = std::stof(argv[++i]);
+            if (minRayWeight < 0.0f)
+            {
+                std::cerr << "Invalid minimum ray weight: " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (option == "--lazy-bvh" && i + 1 < argc)
+        {
+            lazyBVHDepth = std::stoi(argv[++i]);
+            if (lazyBVHDepth < 0)
+            {
+                std::cerr << "Invalid lazy BVH depth: " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (option == "--low-memory" && i + 1 < argc)
+        {
+            lowMemoryBits = std::stoi(argv[++i]);
+            if (lowMemoryBits != 0 && lowMemoryBits != 8 && lowMemoryBits != 16)
+            {
+                std::cerr << "Invalid low-memory bound precision (expected 0, 8 or 16 bits): " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (option == "--bvh-width" && i + 1 < argc)
+        {
+            bvhWidth = std::stoi(argv[++i]);
+            if (bvhWidth != 2 && bvhWidth != 4 && bvhWidth != 8)
+            {
+                std::cerr << "Invalid BVH width (expected 2, 4 or 8): " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (option == "--sbvh" && i + 1 < argc)
+        {
+            spatialSplitBudget = std::stof(argv[++i]);
+            if (spatialSplitBudget < 0.0f)
+            {
+                std::cerr << "Invalid spatial-split duplication budget: " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (option == "--lbvh" && i + 1 < argc)
+        {
+            mortonBits = std::stoi(argv[++i]);
+            if (mortonBits != 0 && mortonBits != 30 && mortonBits != 63)
+            {
+                std::cerr << "Invalid Morton code length (expected 0, 30 or 63 bits): " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (option == "--treelets" && i + 1 < argc)
+        {
+            treeletLeaves = std::stoi(argv[++i]);
+            if (treeletLeaves != 0 && (treeletLeaves < 3 || treeletLeaves > 8))
+            {
+                std::cerr << "Invalid treelet size (expected 0, or 3 to 8 leaves): " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (option == "--no-shadow-cache")
+        {
+            ShadowCache::setEnabled(false);
+        }
+        else if (option == "--denoise")
+        {
+            denoise = true;
+        }
+        else if (option == "--aovs")
+        {
+            writeAovs = true;
+        }
+        else if (option == "--animation")
+        {
+            animate = true;
+        }
+        else if (option == "--frames" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            size_t separator = value.find(':');
+            if (separator == std::string::npos)
+            {
+                std::cerr << "Invalid frame range (expected <first>:<last>): " << value << std::endl;
+                return 1;
+            }
+            firstFrame = std::stoi(value.substr(0, separator));
+            lastFrame = std::stoi(value.substr(separator + 1));
+            animate = true;
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << option << std::endl;
+            return 1;
+        }
+
+        // Local workers render with the same scene options; coordinator options stay here
+        if (option != "--workers" && option != "--local-workers" && option != "--tile-size")
+        {
+            workerArguments.insert(workerArguments.end(), argv + optionStart, argv + i + 1);
+        }
+    }
+
+    // Load the scene from the JSON file and apply the overrides; the preview calls this again after each edit
+    auto loadScene = [&]
+    {
+        SceneData sceneData = readSceneFromJson(fileName);
+
+        // Apply the resolution override to both the scene and its camera
+        if (widthOverride > 0 && heightOverride > 0)
+        {
+            sceneData.width = widthOverride;
+            sceneData.height = heightOverride;
+            sceneData.camera = sceneData.camera.withResolution(widthOverride, heightOverride);
+        }
+
+        // Switch Phong scenes to the path-tracing integrator
+        if (pathTrace && sceneData.renderMode == RenderMode::PHONG)
+        {
+            sceneData.renderMode = RenderMode::PATH_TRACE;
+        }
+
+        // Apply the secondary-ray pruning override
+        if (minRayWeight >= 0.0f)
+        {
+            sceneData.minRayWeight = minRayWeight;
+        }
+
+        // Apply the deferred BVH interval override
+        if (lazyBVHDepth >= 0)
+        {
+            sceneData.lazyBVHDepth = lazyBVHDepth;
+        }
+
+        // Apply the low-memory triangle packing override
+        if (lowMemoryBits >= 0)
+        {
+            sceneData.lowMemoryBits = lowMemoryBits;
+        }
+
+        // Apply the BVH width override
+        if (bvhWidth > 0)
+        {
+            sceneData.bvhWidth = bvhWidth;
+        }
+
+        // Apply the spatial-split BVH override
+        if (spatialSplitBudget >= 0.0f)
+        {
+            sceneData.spatialSplitBudget = spatialSplitBudget;
+        }
+
+        // Apply the linear BVH overrides
+        if (mortonBits >= 0)
+        {
+            sceneData.mortonBits = mortonBits;
+        }
+        if (treeletLeaves >= 0)
+        {
+            sceneData.treeletLeaves = treeletLeaves;
+        }
+
+        // Apply the shadow-ray count override to every area light
+        if (lightSamples > 0)
+        {
+            for (Light &light : sceneData.lights)
+            {
+                light.samples = lightSamples;
+            }
+        }
+        return sceneData;
+    };
+    SceneData sceneData = loadScene();
+
+    // Apply the frame range override to the camera animation
+    CameraAnimation animation = sceneData.animation;
+    if (animate)
+    {
+        if (!animation.enabled())
+        {
+            std::cerr << "The scene has no camera animation: " << fileName << std::endl;
+            return 1;
+        }
+        if (lastFrame >= firstFrame)
+        {
+            animation.firstFrame = firstFrame;
+            animation.lastFrame = lastFrame;
+        }
+    }
 
     // Print whether BVH and tone mapping are enabled
     std::cout << "BVH enabled: " << (useBVH ? "Yes" : "No") << std::endl;
@@ -399,25 +563,207 @@ int main(int argc, char *argv[])
     // Start timing the render process
     auto start = std::chrono::high_resolution_clock::now();
 
-    if (useBVH)
+    // A coordinator hands the tiles of one frame to workers, which build their own BVH
+    bool distributed = !workerAddresses.empty() || localWorkers > 0;
+    if (distributed && (animate || !workerAddress.empty()))
     {
-        // Collect geometries from scene data
-        std::vector<std::shared_ptr<const Geometry>> geometries = collectGeometries(sceneData);
+        std::cerr << "Distributed rendering renders single frames and cannot be combined with --worker or --animation" << std::endl;
+        return 1;
+    }
 
-        // Build the BVH using collected geometries
-        std::unique_ptr<BVHNode> root = BVHNode::build(geometries);
-        renderWithBVH(sceneData, root.get(), outputFileName, applyToneMap, antialiasing);
+    // The preview reloads the scene itself whenever the file changes, until it is interrupted
+    if (!previewName.empty())
+    {
+        if (distributed || animate || !workerAddress.empty())
+        {
+            std::cerr << "The preview renders single frames locally and cannot be combined with workers or --animation" << std::endl;
+            return 1;
+        }
+        FrameRequest settings(sceneData.camera);
+        settings.applyToneMap = applyToneMap;
+        settings.antialiasing = antialiasing;
+        settings.seed = seed;
+        settings.samplesPerPixel = samplesPerPixel;
+        settings.denoise = denoise;
+        PreviewSettings previewSettings;
+        previewSettings.outputFileName = outputFileName;
+        std::cout << "Preview: publishing to shared memory " << previewName << " and watching " << fileName << std::endl;
+        return runPreview(fileName, loadScene, useBVH, settings, previewName, previewSettings, [](const PreviewGenerationStats &stats)
+                          {
+                              std::cout << "Preview " << stats.generation << ": scene loaded in " << stats.loadMs << " ms, first image in "
+                                        << stats.firstImageMs << " ms, ";
+                              if (stats.fullImageMs > 0.0)
+                              {
+                                  std::cout << "full resolution in " << stats.fullImageMs << " ms";
+                              }
+                              else
+                              {
+                                  std::cout << "restarted after " << stats.passes << " passes";
+                              }
+                              std::cout << std::endl;
+                          });
+    }
+
+    if (!visibility.empty() && (distributed || animate || !workerAddress.empty() || !previewName.empty()))
+    {
+        std::cerr << "Visibility outputs are rendered as single local frames and cannot be combined with workers, --animation or --preview" << std::endl;
+        return 1;
+    }
+    std::unique_ptr<LocalWorkerPool> localPool;
+    if (localWorkers > 0)
+    {
+        localPool = std::make_unique<LocalWorkerPool>(localWorkers, "/proc/self/exe", workerArguments);
+        workerAddresses.insert(workerAddresses.end(), localPool->addresses().begin(), localPool->addresses().end());
+    }
+
+    // Build the scene (and its BVH if enabled) once, then render one frame from the JSON camera
+    // or every frame of its animation
+    auto scene = std::make_shared<const Scene>(std::move(sceneData), useBVH && !distributed);
+    Renderer renderer(scene);
+
+    // A worker keeps the scene loaded and renders tiles for coordinators until it is terminated
+    if (!workerAddress.empty())
+    {
+        return runTileWorker(renderer, workerAddress);
+    }
+
+    const Camera &camera = scene->data().camera;
+
+    // Visibility outputs skip shading and are written in their own compact formats
+    if (!visibility.empty())
+    {
+        VisibilityRequest request(camera);
+        request.mode = visibility == "mask"        ? VisibilityMode::MASK
+                       : visibility == "depth"     ? VisibilityMode::DEPTH
+                       : visibility == "object-id" ? VisibilityMode::OBJECT_ID
+                                                   : VisibilityMode::PRIMITIVE_ID;
+        request.seed = seed;
+        request.depthFar = depthFar;
+        size_t pixelCount = static_cast<size_t>(camera.imageWidth()) * camera.imageHeight();
+        std::vector<uint8_t> mask;
+        std::vector<uint16_t> depth;
+        std::vector<uint32_t> ids;
+        if (request.mode == VisibilityMode::MASK)
+        {
+            mask.resize((static_cast<size_t>(camera.imageWidth()) + 7) / 8 * camera.imageHeight());
+            request.maskOutput = mask.data();
+        }
+        else if (request.mode == VisibilityMode::DEPTH)
+        {
+            depth.resize(pixelCount);
+            request.depthOutput = depth.data();
+        }
+        else
+        {
+            ids.resize(pixelCount);
+            request.idOutput = ids.data();
+        }
+
+        auto renderStart = std::chrono::high_resolution_clock::now();
+        float usedDepthFar = renderer.renderVisibility(request);
+        std::chrono::duration<double> renderElapsed = std::chrono::high_resolution_clock::now() - renderStart;
+        writeVisibilityImage(outputFileName, request, mask, depth, ids, usedDepthFar);
+
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+        std::cout << "Render Time: " << elapsed.count() << " seconds" << std::endl;
+        std::cout << "Visibility (" << visibility << "): " << pixelCount / (renderElapsed.count() * 1e6) << " Mrays/s";
+        if (request.mode == VisibilityMode::DEPTH)
+        {
+            std::cout << ", depth " << usedDepthFar << " stored as 65535";
+        }
+        std::cout << std::endl;
+        printBVHBuildStats();
+        printTriangleMeshStats(*scene);
+        return 0;
+    }
+
+    if (animate)
+    {
+        FrameRequest settings(camera);
+        settings.applyToneMap = applyToneMap;
+        settings.antialiasing = antialiasing;
+        settings.seed = seed;
+        settings.samplesPerPixel = samplesPerPixel;
+        settings.denoise = denoise;
+
+        // Frames are written on the output thread while the next frame renders
+        AnimationStats stats = renderAnimation(renderer, animation, settings, [&](int frame, const std::vector<uint8_t> &image)
+                                               { writeBinaryImageToPPM(frameFileName(outputFileName, frame), camera.imageWidth(), camera.imageHeight(), image); });
+
+        double renderMs = 0.0;
+        for (const AnimationFrameStats &frame : stats.frames)
+        {
+            std::cout << "Frame " << frame.frame << ": render " << frame.renderMs << " ms, output " << frame.outputMs << " ms, "
+                      << camera.imageWidth() * camera.imageHeight() / (frame.renderMs * 1000.0) << " Mpixels/s" << std::endl;
+            renderMs += frame.renderMs;
+        }
+        std::cout << "Animation: " << stats.frames.size() << " frames in " << stats.totalMs / 1000.0 << " seconds ("
+                  << stats.frames.size() * 1000.0 / stats.totalMs << " frames/s, "
+                  << stats.pixels / (stats.totalMs * 1000.0) << " Mpixels/s; rendering "
+                  << 100.0 * renderMs / stats.totalMs << "% of wall time)" << std::endl;
+
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsed = end - start;
+        std::cout << "Render Time: " << elapsed.count() << " seconds" << std::endl;
+        printBVHBuildStats();
+        printTriangleMeshStats(*scene);
+        printTextureCacheStats();
+        printShadowCacheStats();
+        return 0;
+    }
+
+    std::vector<uint8_t> image(static_cast<size_t>(camera.imageWidth()) * camera.imageHeight() * 3, 0);
+    FrameRequest request(camera);
+    request.applyToneMap = applyToneMap;
+    request.antialiasing = antialiasing;
+    request.seed = seed;
+    request.samplesPerPixel = samplesPerPixel;
+    request.denoise = denoise;
+    request.rgbOutput = image.data();
+
+    size_t pixelCount = static_cast<size_t>(camera.imageWidth()) * camera.imageHeight();
+    std::vector<float> albedo, normal, depth;
+    std::vector<uint32_t> materialId;
+    if (writeAovs)
+    {
+        albedo.resize(pixelCount * 3);
+        normal.resize(pixelCount * 3);
+        depth.resize(pixelCount);
+        materialId.resize(pixelCount);
+        request.albedoOutput = albedo.data();
+        request.normalOutput = normal.data();
+        request.depthOutput = depth.data();
+        request.materialIdOutput = materialId.data();
+    }
+    DistributedStats distributedStats;
+    if (distributed)
+    {
+        distributedStats = renderDistributed(workerAddresses, scene->data(), request, distributedSettings);
     }
     else
     {
-        // Render without BVH
-        renderWithoutBVH(sceneData, outputFileName, applyToneMap, antialiasing);
+        renderer.render(request);
+    }
+
+    // Write the binary image to file (PPM format)
+    writeBinaryImageToPPM(outputFileName, camera.imageWidth(), camera.imageHeight(), image);
+    if (writeAovs)
+    {
+        writeAovImages(outputFileName, camera.imageWidth(), camera.imageHeight(), albedo, normal, depth, materialId);
     }
 
     // Stop timing the render process
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> elapsed = end - start;
     std::cout << "Render Time: " << elapsed.count() << " seconds" << std::endl;
+    if (distributed)
+    {
+        printDistributedStats(distributedStats);
+    }
+    printBVHBuildStats();
+    printTriangleMeshStats(*scene);
+    printTextureCacheStats();
+    printShadowCacheStats();
 
     return 0;
 }
@@ -1,8 +1,11 @@
 #ifndef MATERIAL_H
 #define MATERIAL_H
 
+#include <cstdint>
 #include "../camera/vector3.h" // Include the Vector3 class for representing RGB colors
 
+class Texture; // Image texture, owned by the TextureCache
+
 // Class representing the material properties of a geometric object
 class Material
 {
@@ -24,6 +27,12 @@ public:
   bool isRefractive;     // Indicates whether the material is refractive
   float refractiveIndex; // Index of refraction for the material (e.g., 1.5 for glass)
 
+  // Optional image texture multiplied with the diffuse color
+  const Texture *texture = nullptr;
+
+  // Identifies the material in material-ID buffers (0 is reserved for the background)
+  uint32_t id = 0;
+
   // Constructor to initialize material properties with default values
   Material(const Vector3 &diffuse = Vector3(0.8f, 0.8f, 0.8f),  // Default diffuse color (gray)
            const Vector3 &specular = Vector3(1.0f, 1.0f, 1.0f), // Default specular color (white)
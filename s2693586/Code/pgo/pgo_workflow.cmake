@@ -0,0 +1,187 @@
+# Profile-guided optimisation workflow, run by the "pgo" target through "cmake -P"
+#
+# 1. Builds a baseline Raytracer without PGO for comparison
+# 2. Builds an instrumented Raytracer (RAYTRACER_PGO=GENERATE)
+# 3. Renders the training set: every scene in jsons/ plus generated stress scenes
+# 4. Merges the profile and rebuilds the same tree with RAYTRACER_PGO=USE
+# 5. Times the baseline and PGO binaries on each scene and reports the speedup
+#
+# Required variables:
+#   SOURCE_DIR     Renderer source directory (holding CMakeLists.txt and jsons/)
+#   WORK_DIR       Directory for the build trees, profile data, scenes and report
+#   STRESS_SCENE   Path to the stress scene generator
+#   CXX_COMPILER   Compiler used for the nested builds
+#   GENERATOR      CMake generator used for the nested builds
+# Optional variables:
+#   BUILD_TYPE (Release), RESOLUTION (300x200), REPEAT (3),
+#   NATIVE, LTO, OPENMP (forwarded as the RAYTRACER_* options of the nested builds)
+
+foreach(var SOURCE_DIR WORK_DIR STRESS_SCENE CXX_COMPILER GENERATOR)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "pgo_workflow.cmake: ${var} is not set")
+    endif()
+endforeach()
+if(NOT DEFINED BUILD_TYPE)
+    set(BUILD_TYPE Release)
+endif()
+if(NOT DEFINED RESOLUTION)
+    set(RESOLUTION 300x200)
+endif()
+if(NOT DEFINED REPEAT)
+    set(REPEAT 3)
+endif()
+
+set(extra_args "")
+foreach(option NATIVE LTO OPENMP)
+    if(DEFINED ${option})
+        list(APPEND extra_args -DRAYTRACER_${option}=${${option}})
+    endif()
+endforeach()
+
+set(profile_dir "${WORK_DIR}/profile")
+set(scene_dir "${WORK_DIR}/scenes")
+set(output_dir "${WORK_DIR}/output")
+file(REMOVE_RECURSE "${profile_dir}")
+file(MAKE_DIRECTORY "${profile_dir}" "${scene_dir}" "${output_dir}")
+
+# Runs a command and stops the workflow if it fails
+function(run_step description)
+    message(STATUS "PGO: ${description}")
+    execute_process(COMMAND ${ARGN} RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "PGO step failed: ${description}\n${output}")
+    endif()
+endfunction()
+
+# Configures and builds the Raytracer target in the given tree
+function(build_tree tree pgo_mode)
+    run_step("configure ${tree} (RAYTRACER_PGO=${pgo_mode})"
+        ${CMAKE_COMMAND} -S "${SOURCE_DIR}" -B "${WORK_DIR}/${tree}" -G "${GENERATOR}"
+        -DCMAKE_CXX_COMPILER=${CXX_COMPILER} -DCMAKE_BUILD_TYPE=${BUILD_TYPE}
+        -DRAYTRACER_PGO=${pgo_mode} -DRAYTRACER_PGO_DIR=${profile_dir} -DRAYTRACER_PGO_WORKFLOW=OFF
+        ${extra_args})
+    run_step("build ${tree}" ${CMAKE_COMMAND} --build "${WORK_DIR}/${tree}" --target Raytracer)
+endfunction()
+
+# Converts "Render Time: <seconds>" output to whole microseconds
+function(render_microseconds output result_var)
+    string(REGEX MATCH "Render Time: ([0-9.eE+-]+)" match "${output}")
+    set(value "${CMAKE_MATCH_1}")
+    if(value STREQUAL "" OR value MATCHES "[eE]")
+        # Exponent notation is only printed for times below 0.1 ms
+        set(${result_var} 0 PARENT_SCOPE)
+        return()
+    endif()
+    string(REGEX MATCH "^([0-9]+)\\.?([0-9]*)" match "${value}")
+    set(seconds "${CMAKE_MATCH_1}")
+    string(SUBSTRING "${CMAKE_MATCH_2}000000" 0 6 fraction)
+    string(REGEX REPLACE "^0+([0-9])" "\\1" fraction "${fraction}")
+    math(EXPR microseconds "${seconds} * 1000000 + ${fraction}")
+    set(${result_var} ${microseconds} PARENT_SCOPE)
+endfunction()
+
+# Renders a scene and returns the render time in microseconds
+function(time_render binary scene args result_var)
+    get_filename_component(name "${scene}" NAME_WE)
+    execute_process(COMMAND "${binary}" "${scene}" "${output_dir}/${name}.ppm" ${args} --seed 1 --resolution ${RESOLUTION}
+        RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE errors)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "Render of ${scene} failed:\n${output}${errors}")
+    endif()
+    render_microseconds("${output}" microseconds)
+    set(${result_var} ${microseconds} PARENT_SCOPE)
+endfunction()
+
+# Formats microseconds as milliseconds with two decimals
+function(format_ms microseconds result_var)
+    math(EXPR whole "${microseconds} / 1000")
+    math(EXPR hundredths "(${microseconds} % 1000) / 10")
+    if(hundredths LESS 10)
+        set(hundredths "0${hundredths}")
+    endif()
+    set(${result_var} "${whole}.${hundredths}" PARENT_SCOPE)
+endfunction()
+
+# Training set: the shipped scenes plus generated stress scenes
+run_step("generate stress scenes" "${STRESS_SCENE}" "${scene_dir}")
+file(GLOB shipped_scenes "${SOURCE_DIR}/jsons/*.json")
+file(GLOB stress_scenes "${scene_dir}/*.json")
+list(SORT shipped_scenes)
+list(SORT stress_scenes)
+set(training_scenes ${shipped_scenes} ${stress_scenes})
+
+build_tree(baseline OFF)
+build_tree(pgo GENERATE)
+
+# Production renders use the BVH path; the shipped scenes also train the brute-force path
+foreach(scene ${training_scenes})
+    time_render("${WORK_DIR}/pgo/Raytracer" "${scene}" "1;0;1" ignored)
+endforeach()
+foreach(scene ${shipped_scenes})
+    time_render("${WORK_DIR}/pgo/Raytracer" "${scene}" "0;0;0" ignored)
+endforeach()
+
+# Clang writes one raw profile per process; merge them for -fprofile-instr-use
+file(GLOB raw_profiles "${profile_dir}/*.profraw")
+if(raw_profiles)
+    get_filename_component(compiler_dir "${CXX_COMPILER}" DIRECTORY)
+    find_program(LLVM_PROFDATA NAMES llvm-profdata HINTS "${compiler_dir}")
+    if(NOT LLVM_PROFDATA)
+        message(FATAL_ERROR "llvm-profdata is required to merge Clang profiles")
+    endif()
+    run_step("merge profiles" "${LLVM_PROFDATA}" merge -output=${profile_dir}/raytracer.profdata ${raw_profiles})
+endif()
+
+build_tree(pgo USE)
+
+# Compare baseline and PGO binaries, keeping the best of REPEAT runs each
+set(report "PGO speedup (${BUILD_TYPE}, ${RESOLUTION}, best of ${REPEAT}, BVH, no antialiasing)\n")
+string(APPEND report "scene                                baseline ms      pgo ms   speedup\n")
+set(total_baseline 0)
+set(total_pgo 0)
+foreach(scene ${training_scenes})
+    set(best_baseline 0)
+    set(best_pgo 0)
+    foreach(run RANGE 1 ${REPEAT})
+        time_render("${WORK_DIR}/baseline/Raytracer" "${scene}" "1;0;0" baseline_us)
+        time_render("${WORK_DIR}/pgo/Raytracer" "${scene}" "1;0;0" pgo_us)
+        if(best_baseline EQUAL 0 OR baseline_us LESS best_baseline)
+            set(best_baseline ${baseline_us})
+        endif()
+        if(best_pgo EQUAL 0 OR pgo_us LESS best_pgo)
+            set(best_pgo ${pgo_us})
+        endif()
+    endforeach()
+    math(EXPR total_baseline "${total_baseline} + ${best_baseline}")
+    math(EXPR total_pgo "${total_pgo} + ${best_pgo}")
+
+    if(best_pgo GREATER 0)
+        math(EXPR ratio "${best_baseline} * 1000 / ${best_pgo}")
+    else()
+        set(ratio 0)
+    endif()
+    math(EXPR ratio_whole "${ratio} / 1000")
+    math(EXPR ratio_fraction "${ratio} % 1000 + 1000")
+    string(SUBSTRING "${ratio_fraction}" 1 3 ratio_fraction)
+    format_ms(${best_baseline} baseline_ms)
+    format_ms(${best_pgo} pgo_ms)
+
+    get_filename_component(name "${scene}" NAME)
+    string(LENGTH "${name}" name_length)
+    math(EXPR padding "37 - ${name_length}")
+    set(pad "")
+    foreach(i RANGE 1 ${padding})
+        string(APPEND pad " ")
+    endforeach()
+    string(APPEND report "${name}${pad}${baseline_ms}    ${pgo_ms}    ${ratio_whole}.${ratio_fraction}x\n")
+endforeach()
+
+math(EXPR total_ratio "${total_baseline} * 1000 / (${total_pgo} + 1)")
+math(EXPR total_whole "${total_ratio} / 1000")
+math(EXPR total_fraction "${total_ratio} % 1000 + 1000")
+string(SUBSTRING "${total_fraction}" 1 3 total_fraction)
+string(APPEND report "total speedup: ${total_whole}.${total_fraction}x\n")
+string(APPEND report "PGO binary: ${WORK_DIR}/pgo/Raytracer\n")
+
+file(WRITE "${WORK_DIR}/pgo_report.txt" "${report}")
+message("${report}")
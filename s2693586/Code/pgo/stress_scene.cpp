@@ -0,0 +1,145 @@
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "external/json.hpp" // nlohmann/json, used to write the scene files
+
+// Generates stress scenes for profile-guided optimisation training
+// The scenes follow the branch behaviour of production renders: many primitives that
+// most rays miss, and mostly diffuse materials with a few reflective or refractive ones
+
+using json = nlohmann::json;
+
+// Builds a material block in the scene file format
+static json makeMaterial(std::mt19937 &rng)
+{
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    float kind = unit(rng);
+
+    json material;
+    material["ks"] = 0.2;
+    material["kd"] = 0.8;
+    material["specularexponent"] = 20;
+    material["diffusecolor"] = {unit(rng), unit(rng), unit(rng)};
+    material["specularcolor"] = {1.0, 1.0, 1.0};
+    material["isreflective"] = kind > 0.9f;  // About 10% reflective
+    material["reflectivity"] = 0.5;
+    material["isrefractive"] = kind > 0.97f; // About 3% refractive
+    material["refractiveindex"] = 1.5;
+    return material;
+}
+
+// Builds the shared camera, lights and settings for a stress scene
+static json makeScene(const std::vector<float> &position, const std::vector<float> &lookAt)
+{
+    json scene;
+    scene["nbounces"] = 8;
+    scene["rendermode"] = "phong";
+    scene["camera"] = {{"type", "pinhole"}, {"width", 1200}, {"height", 800}, {"position", position}, {"lookAt", lookAt}, {"upVector", {0.0, 1.0, 0.0}}, {"fov", 45.0}, {"exposure", 0.1}};
+    scene["scene"]["backgroundcolor"] = {0.25, 0.25, 0.25};
+    scene["scene"]["lightsources"] = json::array();
+    for (float x : {-2.0f, 0.0f, 2.0f})
+    {
+        scene["scene"]["lightsources"].push_back({{"type", "pointlight"}, {"position", {x, 3.0f, 1.0f}}, {"intensity", {0.4, 0.4, 0.4}}});
+    }
+    scene["scene"]["shapes"] = json::array();
+    return scene;
+}
+
+// A grid of small spheres and cylinders above a ground plane
+static json sphereField(int gridSize, std::mt19937 &rng)
+{
+    json scene = makeScene({0.0f, 2.0f, -3.0f}, {0.0f, 0.0f, 2.0f});
+    json &shapes = scene["scene"]["shapes"];
+
+    float extent = 4.0f;
+    shapes.push_back({{"type", "triangle"}, {"v0", {-extent, 0.0f, -extent}}, {"v1", {extent, 0.0f, -extent}}, {"v2", {-extent, 0.0f, extent * 2}}, {"material", makeMaterial(rng)}});
+    shapes.push_back({{"type", "triangle"}, {"v0", {extent, 0.0f, -extent}}, {"v1", {extent, 0.0f, extent * 2}}, {"v2", {-extent, 0.0f, extent * 2}}, {"material", makeMaterial(rng)}});
+
+    float spacing = 2.0f * extent / gridSize;
+    for (int i = 0; i < gridSize; ++i)
+    {
+        for (int j = 0; j < gridSize; ++j)
+        {
+            float x = -extent + (i + 0.5f) * spacing;
+            float z = (j + 0.5f) * spacing;
+            if ((i + j) % 5 == 0)
+            {
+                shapes.push_back({{"type", "cylinder"}, {"center", {x, spacing * 0.3f, z}}, {"axis", {0.0, 1.0, 0.0}}, {"radius", spacing * 0.2f}, {"height", spacing * 0.3f}, {"material", makeMaterial(rng)}});
+            }
+            else
+            {
+                shapes.push_back({{"type", "sphere"}, {"center", {x, spacing * 0.3f, z}}, {"radius", spacing * 0.3f}, {"material", makeMaterial(rng)}});
+            }
+        }
+    }
+    return scene;
+}
+
+// A tessellated height field made of many small triangles
+static json triangleTerrain(int gridSize, std::mt19937 &rng)
+{
+    json scene = makeScene({0.0f, 2.5f, -3.0f}, {0.0f, 0.0f, 2.0f});
+    json &shapes = scene["scene"]["shapes"];
+
+    float extent = 4.0f;
+    float spacing = 2.0f * extent / gridSize;
+    auto height = [](float x, float z)
+    { return 0.3f * std::sin(x * 1.7f) * std::cos(z * 1.3f); };
+
+    for (int i = 0; i < gridSize; ++i)
+    {
+        for (int j = 0; j < gridSize; ++j)
+        {
+            float x0 = -extent + i * spacing, x1 = x0 + spacing;
+            float z0 = j * spacing, z1 = z0 + spacing;
+            json material = makeMaterial(rng);
+            shapes.push_back({{"type", "triangle"}, {"v0", {x0, height(x0, z0), z0}}, {"v1", {x1, height(x1, z0), z0}}, {"v2", {x0, height(x0, z1), z1}}, {"material", material}});
+            shapes.push_back({{"type", "triangle"}, {"v0", {x1, height(x1, z0), z0}}, {"v1", {x1, height(x1, z1), z1}}, {"v2", {x0, height(x0, z1), z1}}, {"material", material}});
+        }
+    }
+
+    // A few large glossy spheres casting shadows over the terrain
+    for (int k = 0; k < 4; ++k)
+    {
+        shapes.push_back({{"type", "sphere"}, {"center", {-1.5f + k, 0.8f, 2.0f + (k % 2)}}, {"radius", 0.4f}, {"material", makeMaterial(rng)}});
+    }
+    return scene;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <output_directory>" << std::endl;
+        return 1;
+    }
+
+    std::string outputDir = argv[1];
+    std::mt19937 rng(2024); // Fixed seed so the training set is the same on every run
+
+    struct
+    {
+        const char *name;
+        json scene;
+    } scenes[] = {
+        {"stress_sphere_field.json", sphereField(24, rng)},
+        {"stress_triangle_terrain.json", triangleTerrain(40, rng)},
+    };
+
+    for (const auto &entry : scenes)
+    {
+        std::string path = outputDir + "/" + entry.name;
+        std::ofstream out(path);
+        if (!out.is_open())
+        {
+            std::cerr << "Failed to open output file: " << path << std::endl;
+            return 1;
+        }
+        out << entry.scene.dump(2) << std::endl;
+        std::cout << "Wrote " << path << " (" << entry.scene["scene"]["shapes"].size() << " shapes)" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include "animation.h"
+#include <future>
+#include "render.h"    // HDR to 8-bit conversion
+#include "../timing.h" // Clock and millisecondsSince
+
+AnimationStats renderAnimation(const Renderer &renderer, const CameraAnimation &animation,
+                               const FrameRequest &settings, const FrameWriter &writer)
+{
+    const SceneData &sceneData = renderer.scene().data();
+    int width = settings.camera.imageWidth();
+    int height = settings.camera.imageHeight();
+    float exposure = settings.camera.exposure;
+    bool toneMapped = settings.applyToneMap && sceneData.renderMode != RenderMode::BINARY;
+    size_t pixelCount = static_cast<size_t>(width) * height;
+
+    AnimationStats stats;
+    stats.frames.resize(animation.frameCount());
+
+    // Two HDR buffers: one being rendered while the other is converted and written
+    std::vector<float> hdr[2] = {std::vector<float>(pixelCount * 3), std::vector<float>(pixelCount * 3)};
+    std::future<void> pending; // Output of the previous frame
+
+    auto start = Clock::now();
+    for (int i = 0; i < animation.frameCount(); ++i)
+    {
+        int frame = animation.firstFrame + i;
+        std::vector<float> &buffer = hdr[i % 2];
+
+        FrameRequest request = settings;
+        request.camera = animation.cameraAt(frame, width, height, exposure)
+                             .withShutter(settings.camera.shutterOpen(), settings.camera.shutterClose());
+        request.cropX = request.cropY = request.cropWidth = request.cropHeight = 0;
+        request.hdrOutput = buffer.data();
+        request.rgbOutput = nullptr;
+        request.albedoOutput = request.normalOutput = request.depthOutput = request.varianceOutput = nullptr;
+        request.materialIdOutput = nullptr;
+
+        auto renderStart = Clock::now();
+        renderer.render(request);
+        stats.frames[i].frame = frame;
+        stats.frames[i].renderMs = millisecondsSince(renderStart);
+
+        // The previous frame must be written before its buffer is reused
+        if (pending.valid())
+        {
+            pending.get();
+        }
+
+        const float *frameHdr = buffer.data();
+        AnimationFrameStats *frameStats = &stats.frames[i];
+        pending = std::async(std::launch::async, [&, frame, frameHdr, frameStats]
+                             {
+                                 auto outputStart = Clock::now();
+                                 std::vector<uint8_t> image(pixelCount * 3);
+                                 toneMapImage(frameHdr, width, height, toneMapped, exposure, sceneData.backgroundColor, image.data());
+                                 writer(frame, image);
+                                 frameStats->outputMs = millisecondsSince(outputStart); });
+    }
+    if (pending.valid())
+    {
+        pending.get();
+    }
+
+    stats.totalMs = millisecondsSince(start);
+    stats.pixels = static_cast<long long>(pixelCount) * animation.frameCount();
+    return stats;
+}
@@ -0,0 +1,41 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "renderer.h"                      // Renderer and FrameRequest
+#include "../camera/camera_animation.h"    // Camera path evaluated for each frame
+
+// Timing of one rendered animation frame
+struct AnimationFrameStats
+{
+    int frame;       // Frame number
+    double renderMs; // Time spent tracing the frame
+    double outputMs; // Time spent tone mapping and writing the frame (overlapped with the next render)
+};
+
+// Timing of a whole animation
+struct AnimationStats
+{
+    std::vector<AnimationFrameStats> frames;
+    double totalMs = 0.0; // Wall-clock time from the first render to the last write
+    long long pixels = 0; // Pixels rendered over all frames
+};
+
+// Receives the 8-bit image of a finished frame, e.g. to encode it to a file
+using FrameWriter = std::function<void(int frame, const std::vector<uint8_t> &image)>;
+
+// Renders every frame of a camera animation with one shared scene
+// Frames are rendered back to back; frame N is tone mapped and passed to the writer on a
+// separate thread while frame N + 1 is rendered, so output does not stall the renderer
+// Parameters:
+// - renderer: Renderer holding the scene (and BVH), built once for all frames
+// - animation: Camera path and frame range
+// - settings: Tone mapping, antialiasing and seed used for every frame; its camera sets the resolution and exposure
+// - writer: Called once per frame, in frame order, on the output thread
+// Returns: Per-frame and total timings; exceptions thrown by the writer are rethrown
+AnimationStats renderAnimation(const Renderer &renderer, const CameraAnimation &animation,
+                               const FrameRequest &settings, const FrameWriter &writer);
+
+#endif // ANIMATION_H
@@ -0,0 +1,179 @@
+#include "denoise.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+// Luminance of a linear RGB color
+static inline float luminance(const float *c)
+{
+    return 0.2126f * c[0] + 0.7152f * c[1] + 0.0722f * c[2];
+}
+
+void denoiseImage(float *hdr, const float *variance, const float *albedo, const float *normal, const float *depth,
+                  const uint32_t *materialId, int width, int height, const DenoiseSettings &settings)
+{
+    const long long pixelCount = static_cast<long long>(width) * height;
+    const float minAlbedo = 0.01f; // Keeps dark albedos from amplifying noise when dividing
+    const float kernel[3] = {3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f}; // B3-spline weights by tap distance
+
+    // Pixels only exchange light with pixels of the same material, and surfaces never with the background
+    auto compatible = [&](long long p, long long q)
+    {
+        return (!materialId || materialId[p] == materialId[q]) && ((depth[p] > 0.0f) == (depth[q] > 0.0f));
+    };
+
+    // Filter the lighting only: divide out the albedo
+    std::vector<float> safeAlbedo(pixelCount * 3), current(pixelCount * 3), next(pixelCount * 3);
+#pragma omp parallel for
+    for (long long i = 0; i < pixelCount * 3; ++i)
+    {
+        safeAlbedo[i] = std::max(albedo[i], minAlbedo);
+        current[i] = hdr[i] / safeAlbedo[i];
+    }
+
+    // Variance of the lighting, from the samples or else from the neighbourhood
+    std::vector<float> currentVariance(pixelCount), nextVariance(pixelCount);
+#pragma omp parallel for schedule(dynamic)
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const long long p = static_cast<long long>(y) * width + x;
+            if (variance)
+            {
+                float scale = std::max(luminance(&safeAlbedo[p * 3]), minAlbedo);
+                currentVariance[p] = variance[p] / (scale * scale);
+                continue;
+            }
+            float sum = 0.0f, sumSquares = 0.0f;
+            int count = 0;
+            for (int qy = std::max(0, y - 1); qy <= std::min(height - 1, y + 1); ++qy)
+            {
+                for (int qx = std::max(0, x - 1); qx <= std::min(width - 1, x + 1); ++qx)
+                {
+                    const long long q = static_cast<long long>(qy) * width + qx;
+                    if (compatible(p, q))
+                    {
+                        float l = luminance(&current[q * 3]);
+                        sum += l;
+                        sumSquares += l * l;
+                        ++count;
+                    }
+                }
+            }
+            float mean = sum / count;
+            currentVariance[p] = std::max(0.0f, sumSquares / count - mean * mean);
+        }
+    }
+
+    for (int pass = 0; pass < settings.iterations; ++pass)
+    {
+        const int step = 1 << pass;
+
+#pragma omp parallel for schedule(dynamic)
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                const long long p = static_cast<long long>(y) * width + x;
+                const float *colorP = &current[p * 3];
+                const float *normalP = &normal[p * 3];
+                const float *albedoP = &albedo[p * 3];
+                const float depthP = depth[p];
+                const float luminanceP = luminance(colorP);
+
+                // Noise level of the pixel, from its variance blurred over the 3x3 neighbourhood
+                float blurredVariance = 0.0f, blurWeight = 0.0f;
+                for (int dy = -1; dy <= 1; ++dy)
+                {
+                    for (int dx = -1; dx <= 1; ++dx)
+                    {
+                        int qx = std::clamp(x + dx, 0, width - 1), qy = std::clamp(y + dy, 0, height - 1);
+                        float w = kernel[std::abs(dx) + 1] * kernel[std::abs(dy) + 1];
+                        blurredVariance += w * currentVariance[static_cast<long long>(qy) * width + qx];
+                        blurWeight += w;
+                    }
+                }
+                const float luminanceScale = settings.colorSigma * std::sqrt(blurredVariance / blurWeight) + 1e-6f;
+
+                float sum[3] = {0.0f, 0.0f, 0.0f};
+                float weightSum = 0.0f, varianceSum = 0.0f;
+                for (int dy = -2; dy <= 2; ++dy)
+                {
+                    int qy = y + dy * step;
+                    if (qy < 0 || qy >= height)
+                    {
+                        continue;
+                    }
+                    for (int dx = -2; dx <= 2; ++dx)
+                    {
+                        int qx = x + dx * step;
+                        if (qx < 0 || qx >= width)
+                        {
+                            continue;
+                        }
+                        const long long q = static_cast<long long>(qy) * width + qx;
+                        if (!compatible(p, q))
+                        {
+                            continue;
+                        }
+
+                        const float *colorQ = &current[q * 3];
+                        const float *albedoQ = &albedo[q * 3];
+                        float weight = kernel[std::abs(dx)] * kernel[std::abs(dy)];
+
+                        float exponent = std::fabs(luminance(colorQ) - luminanceP) / luminanceScale;
+                        float albedoDistance2 = 0.0f;
+                        for (int c = 0; c < 3; ++c)
+                        {
+                            albedoDistance2 += (albedoP[c] - albedoQ[c]) * (albedoP[c] - albedoQ[c]);
+                        }
+                        exponent += albedoDistance2 / (settings.albedoSigma * settings.albedoSigma);
+                        if (depthP > 0.0f)
+                        {
+                            // Depth changes along slanted surfaces grow with the distance between pixels
+                            exponent += std::fabs(depthP - depth[q]) /
+                                        (settings.depthSigma * depthP * step * std::max(std::abs(dx), std::abs(dy)) + 1e-6f);
+                            const float *normalQ = &normal[q * 3];
+                            float cosine = normalP[0] * normalQ[0] + normalP[1] * normalQ[1] + normalP[2] * normalQ[2];
+                            weight *= std::pow(std::max(cosine, 0.0f), settings.normalPower);
+                        }
+                        weight *= std::exp(-exponent);
+
+                        sum[0] += weight * colorQ[0];
+                        sum[1] += weight * colorQ[1];
+                        sum[2] += weight * colorQ[2];
+                        weightSum += weight;
+                        varianceSum += weight * weight * currentVariance[q];
+                    }
+                }
+
+                float *out = &next[p * 3];
+                if (weightSum > 0.0f)
+                {
+                    out[0] = sum[0] / weightSum;
+                    out[1] = sum[1] / weightSum;
+                    out[2] = sum[2] / weightSum;
+                    nextVariance[p] = varianceSum / (weightSum * weightSum);
+                }
+                else
+                {
+                    out[0] = colorP[0];
+                    out[1] = colorP[1];
+                    out[2] = colorP[2];
+                    nextVariance[p] = currentVariance[p];
+                }
+            }
+        }
+        current.swap(next);
+        currentVariance.swap(nextVariance);
+    }
+
+    // Multiply the albedo back in
+#pragma omp parallel for
+    for (long long i = 0; i < pixelCount * 3; ++i)
+    {
+        hdr[i] = current[i] * safeAlbedo[i];
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef DENOISE_H
+#define DENOISE_H
+
+#include <cstdint>
+
+// Settings of the edge-aware denoiser
+struct DenoiseSettings
+{
+    int iterations = 5;        // Filter passes; pass i spreads its taps 2^i pixels apart
+    float colorSigma = 4.0f;   // Allowed lighting difference, in standard deviations of the pixel's noise
+    float normalPower = 64.0f; // Exponent applied to the cosine between normals
+    float depthSigma = 0.02f;  // Allowed depth difference, relative to the pixel's depth, per pixel of distance
+    float albedoSigma = 0.1f;  // Allowed albedo difference
+};
+
+// Denoises an HDR image in place with an edge-aware a-trous wavelet filter guided by auxiliary buffers
+// The color is divided by the albedo before filtering and multiplied back afterwards, so texture
+// and material detail are kept while the lighting is smoothed. Each pass blurs with a 5x5 B-spline
+// kernel whose taps are weighted down across differences in normal, depth and albedo, dropped across
+// material ID boundaries, and weighted by how far their lighting differs relative to the pixel's
+// estimated noise, so pixels whose samples agree are left sharp. Rows are filtered in parallel.
+// Parameters:
+// - hdr: Linear colors, three floats per pixel, row by row (filtered in place)
+// - variance: Variance of each pixel's mean luminance over its samples, one float per pixel; nullptr
+//   estimates it from the 3x3 neighbourhood (for single-sample renders)
+// - albedo: First-hit albedo, three floats per pixel
+// - normal: First-hit normal, three floats per pixel
+// - depth: First-hit distance, one float per pixel (0 where the pixel saw the background)
+// - materialId: First-hit material ID, one value per pixel (nullptr to ignore material boundaries)
+// - width, height: Image dimensions
+// - settings: Filter settings
+void denoiseImage(float *hdr, const float *variance, const float *albedo, const float *normal, const float *depth,
+                  const uint32_t *materialId, int width, int height, const DenoiseSettings &settings = DenoiseSettings());
+
+#endif // DENOISE_H
@@ -0,0 +1,948 @@
+#include "distributed.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "denoise.h"    // Edge-aware denoiser run on the assembled frame
+#include "render.h"     // HDR to 8-bit conversion
+#include "../timing.h" // Clock and millisecondsSince
+
+extern char **environ; // Passed on to worker processes
+
+// Messages of the tile protocol
+// On connecting, the worker sends a WorkerHello. The coordinator then sends TileRequests and the
+// worker answers each, in order, with a TileReply followed by its pixels: width * height values for
+// every channel, channel by channel (colors, then albedo, normal, depth, variance and material ID
+// when AOVs were requested), each channel row by row.
+static const uint32_t PROTOCOL_MAGIC = 0x52545431; // "RTT1"
+static const uint32_t TILE_ANTIALIASING = 1;       // TileRequest flag: use 16 samples per pixel
+static const uint32_t TILE_AOVS = 2;               // TileRequest flag: also return the auxiliary buffers
+static const int COLOR_CHANNELS = 3;
+static const int AOV_CHANNELS = 3 + 3 + 1 + 1 + 1; // Albedo, normal, depth, variance, material ID
+
+struct WorkerHello
+{
+    uint32_t magic;
+    int32_t imageWidth, imageHeight;
+};
+
+struct TileRequest
+{
+    uint32_t magic;
+    uint32_t tileId;
+    int32_t x, y, width, height; // Region in image pixels
+    uint32_t seed;
+    int32_t samplesPerPixel;
+    uint32_t flags;
+};
+
+struct TileReply
+{
+    uint32_t magic;
+    uint32_t tileId;
+    int32_t width, height;
+    int32_t channels;
+    float renderMs;
+};
+
+// Reads exactly size bytes; returns false on error, timeout or end of stream
+static bool readAll(int fd, void *data, size_t size)
+{
+    char *bytes = static_cast<char *>(data);
+    while (size > 0)
+    {
+        ssize_t n = recv(fd, bytes, size, 0);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        bytes += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Writes exactly size bytes; returns false on error or timeout
+static bool writeAll(int fd, const void *data, size_t size)
+{
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0)
+    {
+        ssize_t n = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        bytes += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Writes as much of the buffer as the non-blocking socket accepts and removes it from the buffer
+// Returns: false if the connection failed
+static bool flushOutput(int fd, std::vector<char> &buffer)
+{
+    size_t sent = 0;
+    while (sent < buffer.size())
+    {
+        ssize_t n = send(fd, buffer.data() + sent, buffer.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    buffer.erase(buffer.begin(), buffer.begin() + sent);
+    return true;
+}
+
+// Appends everything the non-blocking socket has received to the buffer
+// Returns: false once the connection is closed or failed (bytes received before that are kept)
+static bool receiveInput(int fd, std::vector<char> &buffer)
+{
+    constexpr size_t CHUNK = 65536;
+    for (;;)
+    {
+        size_t size = buffer.size();
+        buffer.resize(size + CHUNK);
+        ssize_t n = recv(fd, buffer.data() + size, CHUNK, 0);
+        buffer.resize(size + static_cast<size_t>(std::max<ssize_t>(n, 0)));
+        if (n > 0 || (n < 0 && errno == EINTR))
+        {
+            continue;
+        }
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+}
+
+// Splits "<host>:<port>" at the last colon; throws if there is no port
+static void splitHostPort(const std::string &address, std::string &host, std::string &port)
+{
+    size_t colon = address.find_last_of(':');
+    if (colon == std::string::npos || colon + 1 == address.size())
+    {
+        std::cerr << "Invalid worker address (expected unix:<path> or <host>:<port>): " << address << std::endl;
+        throw std::runtime_error("Invalid worker address: " + address);
+    }
+    host = address.substr(0, colon);
+    port = address.substr(colon + 1);
+}
+
+// Fills a UNIX socket address for "unix:<path>"; throws if the path is too long
+static sockaddr_un unixAddress(const std::string &address)
+{
+    std::string path = address.substr(5);
+    sockaddr_un result{};
+    result.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(result.sun_path))
+    {
+        std::cerr << "Invalid UNIX socket path: " << path << std::endl;
+        throw std::runtime_error("Invalid UNIX socket path: " + path);
+    }
+    std::strcpy(result.sun_path, path.c_str());
+    return result;
+}
+
+static bool isUnixAddress(const std::string &address)
+{
+    return address.rfind("unix:", 0) == 0;
+}
+
+// Opens a listening socket on the address; returns -1 on failure
+static int listenOn(const std::string &address)
+{
+    if (isUnixAddress(address))
+    {
+        sockaddr_un local = unixAddress(address);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(local.sun_path); // Left behind by an earlier worker
+        if (fd < 0 || bind(fd, reinterpret_cast<sockaddr *>(&local), sizeof(local)) != 0 || listen(fd, 4) != 0)
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            return -1;
+        }
+        return fd;
+    }
+
+    std::string host, port;
+    splitHostPort(address, host, port);
+    addrinfo hints{}, *addresses = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &addresses) != 0)
+    {
+        return -1;
+    }
+    int fd = -1;
+    for (addrinfo *a = addresses; a && fd < 0; a = a->ai_next)
+    {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        int yes = 1;
+        if (fd >= 0 && (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) != 0 ||
+                        bind(fd, a->ai_addr, a->ai_addrlen) != 0 || listen(fd, 4) != 0))
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    return fd;
+}
+
+// Starts a non-blocking connection to a socket address
+// Returns: The socket, or -1 if the connection was refused; inProgress is set while it is still being made
+static int startConnect(int family, int type, int protocol, const sockaddr *remote, socklen_t length, bool &inProgress)
+{
+    int fd = socket(family, type, protocol);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    if (connect(fd, remote, length) == 0)
+    {
+        return fd;
+    }
+    if (errno == EINPROGRESS)
+    {
+        inProgress = true;
+        return fd;
+    }
+    close(fd);
+    return -1;
+}
+
+// Starts connecting to a worker without waiting: an unreachable host must not stall the coordinator
+// Parameters:
+// - address: unix:<path> or <host>:<port>
+// - inProgress: Set if the connection completes later, when the socket becomes writable
+// Returns: The non-blocking socket, or -1 if the worker is not (yet) listening
+static int connectTo(const std::string &address, bool &inProgress)
+{
+    inProgress = false;
+    if (isUnixAddress(address))
+    {
+        sockaddr_un remote = unixAddress(address);
+        return startConnect(AF_UNIX, SOCK_STREAM, 0, reinterpret_cast<sockaddr *>(&remote), sizeof(remote), inProgress);
+    }
+
+    std::string host, port;
+    splitHostPort(address, host, port);
+    addrinfo hints{}, *addresses = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0)
+    {
+        return -1;
+    }
+    int fd = -1;
+    for (addrinfo *a = addresses; a && fd < 0; a = a->ai_next)
+    {
+        fd = startConnect(a->ai_family, a->ai_socktype, a->ai_protocol, a->ai_addr, a->ai_addrlen, inProgress);
+    }
+    freeaddrinfo(addresses);
+    if (fd >= 0)
+    {
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes)); // Requests are small and latency bound
+    }
+    return fd;
+}
+
+// Returns true if the tile lies inside the image and asks for a valid sample count
+static bool validTile(const TileRequest &tile, const Camera &camera)
+{
+    return tile.x >= 0 && tile.y >= 0 && tile.width > 0 && tile.height > 0 && tile.samplesPerPixel >= 0 &&
+           static_cast<int64_t>(tile.x) + tile.width <= camera.imageWidth() &&
+           static_cast<int64_t>(tile.y) + tile.height <= camera.imageHeight();
+}
+
+// Renders the tile requests of one coordinator until it disconnects
+static void serveCoordinator(const Renderer &renderer, int fd)
+{
+    const Camera &camera = renderer.scene().data().camera;
+    WorkerHello hello{PROTOCOL_MAGIC, camera.imageWidth(), camera.imageHeight()};
+    if (!writeAll(fd, &hello, sizeof(hello)))
+    {
+        return;
+    }
+
+    std::vector<float> pixels;
+    std::vector<uint32_t> materialId;
+    TileRequest tile;
+    while (readAll(fd, &tile, sizeof(tile)))
+    {
+        if (tile.magic != PROTOCOL_MAGIC)
+        {
+            std::cerr << "Worker: ignoring a coordinator speaking another protocol" << std::endl;
+            return;
+        }
+        if (!validTile(tile, camera))
+        {
+            // Checked before the buffers are sized from the request
+            std::cerr << "Worker: ignoring a coordinator requesting tile " << tile.width << "x" << tile.height << " at ("
+                      << tile.x << ", " << tile.y << ") of a " << camera.imageWidth() << "x" << camera.imageHeight() << " image" << std::endl;
+            return;
+        }
+        auto start = Clock::now();
+        bool aovs = (tile.flags & TILE_AOVS) != 0;
+        int channels = COLOR_CHANNELS + (aovs ? AOV_CHANNELS : 0);
+        size_t area = static_cast<size_t>(tile.width) * tile.height;
+        pixels.assign(area * channels, 0.0f);
+        materialId.assign(aovs ? area : 0, 0);
+
+        FrameRequest request(camera);
+        request.antialiasing = (tile.flags & TILE_ANTIALIASING) != 0;
+        request.samplesPerPixel = tile.samplesPerPixel;
+        request.seed = tile.seed;
+        request.cropX = tile.x;
+        request.cropY = tile.y;
+        request.cropWidth = tile.width;
+        request.cropHeight = tile.height;
+        request.hdrOutput = pixels.data();
+        if (aovs)
+        {
+            request.albedoOutput = pixels.data() + area * 3;
+            request.normalOutput = pixels.data() + area * 6;
+            request.depthOutput = pixels.data() + area * 9;
+            request.varianceOutput = pixels.data() + area * 10;
+            request.materialIdOutput = materialId.data();
+        }
+        try
+        {
+            renderer.render(request);
+        }
+        catch (const std::exception &error)
+        {
+            std::cerr << "Worker: cannot render tile " << tile.tileId << ": " << error.what() << std::endl;
+            return; // Dropping the connection makes the coordinator reassign the tile
+        }
+        if (aovs)
+        {
+            std::memcpy(pixels.data() + area * 11, materialId.data(), area * sizeof(uint32_t));
+        }
+
+        TileReply reply{PROTOCOL_MAGIC, tile.tileId, tile.width, tile.height, channels, static_cast<float>(millisecondsSince(start))};
+        if (!writeAll(fd, &reply, sizeof(reply)) || !writeAll(fd, pixels.data(), pixels.size() * sizeof(float)))
+        {
+            return;
+        }
+    }
+}
+
+int runTileWorker(const Renderer &renderer, const std::string &address)
+{
+    int listener = listenOn(address);
+    if (listener < 0)
+    {
+        std::cerr << "Worker: cannot listen on " << address << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    std::cout << "Worker listening on " << address << std::endl;
+    for (;;)
+    {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            std::cerr << "Worker: accept failed: " << std::strerror(errno) << std::endl;
+            close(listener);
+            return 1;
+        }
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes)); // Replies go out as header and pixels; fails harmlessly on UNIX sockets
+        serveCoordinator(renderer, fd);
+        close(fd);
+    }
+}
+
+namespace
+{
+    // A region of the frame and its progress
+    struct Tile
+    {
+        int x, y, width, height; // In image pixels
+        bool done = false;
+        int copies = 0; // Workers currently holding the tile
+    };
+
+    // Stages of a coordinator's connection to a worker
+    enum class ConnectionState
+    {
+        DISCONNECTED, // No socket: not listening yet, or dropped
+        CONNECTING,   // Non-blocking connect in progress
+        GREETING,     // Connected, waiting for the WorkerHello
+        READY         // Greeted; takes tiles
+    };
+
+    // Coordinator-side state of one worker
+    // Sockets are non-blocking and every message goes through the buffers, so one slow or unreachable
+    // worker never holds up the others
+    struct WorkerConnection
+    {
+        std::string address;
+        int fd = -1;
+        ConnectionState state = ConnectionState::DISCONNECTED;
+        bool dead = false;
+        std::vector<char> input;        // Bytes received and not yet handled
+        std::vector<char> output;       // Requests not yet written to the socket
+        std::deque<int> outstanding;    // Tiles sent and not yet returned, in the order the worker renders them
+        Clock::time_point lastProgress; // Last reply, or the send that woke an idle worker
+    };
+}
+
+DistributedStats renderDistributed(const std::vector<std::string> &workers, const SceneData &sceneData,
+                                   const FrameRequest &request, const DistributedSettings &settings)
+{
+    const int imageWidth = request.camera.imageWidth();
+    const int imageHeight = request.camera.imageHeight();
+    const int width = request.cropWidth > 0 ? request.cropWidth : imageWidth - request.cropX;
+    const int height = request.cropHeight > 0 ? request.cropHeight : imageHeight - request.cropY;
+    if (request.cropX < 0 || request.cropY < 0 || width <= 0 || height <= 0 ||
+        request.cropX + width > imageWidth || request.cropY + height > imageHeight)
+    {
+        throw std::invalid_argument("FrameRequest crop lies outside the image");
+    }
+    if (!request.hdrOutput && !request.rgbOutput)
+    {
+        throw std::invalid_argument("FrameRequest has no output buffer");
+    }
+    if (workers.empty())
+    {
+        throw std::invalid_argument("Distributed render without workers");
+    }
+
+    // Assemble into the caller's buffers where given, otherwise into scratch buffers
+    const size_t pixelCount = static_cast<size_t>(width) * height;
+    const bool denoise = request.denoise && sceneData.renderMode != RenderMode::BINARY;
+    const bool aovs = denoise || request.albedoOutput || request.normalOutput || request.depthOutput ||
+                      request.materialIdOutput || request.varianceOutput;
+    std::vector<float> scratch;
+    std::vector<uint32_t> materialIdScratch;
+    scratch.resize(pixelCount * (COLOR_CHANNELS + (aovs ? AOV_CHANNELS - 1 : 0))); // Material IDs are kept apart
+    auto floatBuffer = [&](float *given, size_t offset) -> float *
+    { return given ? given : scratch.data() + offset; };
+    float *hdr = floatBuffer(request.hdrOutput, 0);
+    float *albedo = aovs ? floatBuffer(request.albedoOutput, pixelCount * 3) : nullptr;
+    float *normal = aovs ? floatBuffer(request.normalOutput, pixelCount * 6) : nullptr;
+    float *depth = aovs ? floatBuffer(request.depthOutput, pixelCount * 9) : nullptr;
+    float *variance = aovs ? floatBuffer(request.varianceOutput, pixelCount * 10) : nullptr;
+    uint32_t *materialId = request.materialIdOutput;
+    if (aovs && !materialId)
+    {
+        materialIdScratch.resize(pixelCount);
+        materialId = materialIdScratch.data();
+    }
+
+    // Split the region into tiles, queued row by row
+    const int tileSize = std::max(1, settings.tileSize);
+    std::vector<Tile> tiles;
+    for (int y = 0; y < height; y += tileSize)
+    {
+        for (int x = 0; x < width; x += tileSize)
+        {
+            Tile tile;
+            tile.x = request.cropX + x;
+            tile.y = request.cropY + y;
+            tile.width = std::min(tileSize, width - x);
+            tile.height = std::min(tileSize, height - y);
+            tiles.push_back(tile);
+        }
+    }
+    std::deque<int> queue;
+    for (int i = 0; i < static_cast<int>(tiles.size()); ++i)
+    {
+        queue.push_back(i);
+    }
+    int remaining = static_cast<int>(tiles.size());
+
+    DistributedStats stats;
+    stats.tiles = remaining;
+    stats.workers.resize(workers.size());
+    std::vector<WorkerConnection> connections(workers.size());
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        connections[i].address = stats.workers[i].address = workers[i];
+    }
+
+    auto start = Clock::now();
+    auto secondsSince = [](Clock::time_point time)
+    { return std::chrono::duration<double>(Clock::now() - time).count(); };
+
+    // Drops a worker and queues again the tiles no other worker holds
+    auto fail = [&](size_t w, const std::string &reason)
+    {
+        WorkerConnection &connection = connections[w];
+        std::cerr << "Worker " << connection.address << " dropped: " << reason << std::endl;
+        close(connection.fd);
+        connection.fd = -1;
+        connection.state = ConnectionState::DISCONNECTED;
+        connection.dead = true;
+        connection.input.clear();
+        connection.output.clear();
+        stats.workers[w].failed = true;
+        for (auto it = connection.outstanding.rbegin(); it != connection.outstanding.rend(); ++it)
+        {
+            Tile &tile = tiles[*it];
+            if (--tile.copies == 0 && !tile.done)
+            {
+                queue.push_front(*it);
+                ++stats.reassigned;
+            }
+        }
+        connection.outstanding.clear();
+    };
+
+    // Queues a tile request to a worker and writes what the socket accepts
+    auto send = [&](size_t w, int index)
+    {
+        WorkerConnection &connection = connections[w];
+        const Tile &tile = tiles[index];
+        TileRequest message{PROTOCOL_MAGIC, static_cast<uint32_t>(index), tile.x, tile.y, tile.width, tile.height,
+                            request.seed, request.samplesPerPixel,
+                            (request.antialiasing ? TILE_ANTIALIASING : 0) | (aovs ? TILE_AOVS : 0)};
+        if (connection.outstanding.empty())
+        {
+            connection.lastProgress = Clock::now();
+        }
+        connection.outstanding.push_back(index);
+        ++tiles[index].copies;
+        const char *bytes = reinterpret_cast<const char *>(&message);
+        connection.output.insert(connection.output.end(), bytes, bytes + sizeof(message));
+        if (!flushOutput(connection.fd, connection.output))
+        {
+            fail(w, "cannot send a tile");
+        }
+    };
+
+    // Copies a tile result into the frame
+    auto store = [&](size_t w, int index, const float *pixels)
+    {
+        const Tile &tile = tiles[index];
+        const size_t area = static_cast<size_t>(tile.width) * tile.height;
+        if (tile.done)
+        {
+            ++stats.workers[w].duplicates;
+            return;
+        }
+
+        // Scatter the tile's channels into the frame buffers
+        auto copyChannel = [&](float *frame, int components, int firstChannel)
+        {
+            for (int y = 0; y < tile.height; ++y)
+            {
+                const float *source = pixels + area * firstChannel + static_cast<size_t>(y) * tile.width * components;
+                size_t row = static_cast<size_t>(tile.y - request.cropY + y) * width + (tile.x - request.cropX);
+                std::memcpy(frame + row * components, source, sizeof(float) * tile.width * components);
+            }
+        };
+        copyChannel(hdr, 3, 0);
+        if (aovs)
+        {
+            copyChannel(albedo, 3, 3);
+            copyChannel(normal, 3, 6);
+            copyChannel(depth, 1, 9);
+            copyChannel(variance, 1, 10);
+            copyChannel(reinterpret_cast<float *>(materialId), 1, 11); // Same size; copied bit for bit
+        }
+        tiles[index].done = true;
+        ++stats.workers[w].tiles;
+        --remaining;
+    };
+
+    // Handles the complete messages a worker has sent: its greeting, then tile results
+    // A message still arriving stays in the input buffer until the rest of it is received
+    std::vector<float> pixels;
+    auto handleInput = [&](size_t w)
+    {
+        WorkerConnection &connection = connections[w];
+        const int channels = COLOR_CHANNELS + (aovs ? AOV_CHANNELS : 0);
+        size_t consumed = 0;
+        while (connection.fd >= 0)
+        {
+            const char *data = connection.input.data() + consumed;
+            const size_t available = connection.input.size() - consumed;
+            if (connection.state == ConnectionState::GREETING)
+            {
+                WorkerHello hello;
+                if (available < sizeof(hello))
+                {
+                    break;
+                }
+                std::memcpy(&hello, data, sizeof(hello));
+                consumed += sizeof(hello);
+                if (hello.magic != PROTOCOL_MAGIC)
+                {
+                    fail(w, "no valid greeting");
+                }
+                else if (hello.imageWidth != imageWidth || hello.imageHeight != imageHeight)
+                {
+                    fail(w, "renders at " + std::to_string(hello.imageWidth) + "x" + std::to_string(hello.imageHeight) +
+                                " instead of " + std::to_string(imageWidth) + "x" + std::to_string(imageHeight));
+                }
+                else
+                {
+                    connection.state = ConnectionState::READY;
+                    stats.workers[w].connected = true;
+                }
+                continue;
+            }
+
+            // The header is checked as soon as it arrives, before waiting for the pixels it announces
+            TileReply reply;
+            if (available < sizeof(reply))
+            {
+                break;
+            }
+            std::memcpy(&reply, data, sizeof(reply));
+            int expected = connection.outstanding.empty() ? -1 : connection.outstanding.front();
+            if (expected < 0 || reply.magic != PROTOCOL_MAGIC || static_cast<int>(reply.tileId) != expected || reply.channels != channels ||
+                reply.width != tiles[expected].width || reply.height != tiles[expected].height)
+            {
+                fail(w, "unexpected reply");
+                break;
+            }
+            const size_t area = static_cast<size_t>(reply.width) * reply.height;
+            const size_t payload = area * channels * sizeof(float);
+            if (available < sizeof(reply) + payload)
+            {
+                break;
+            }
+            pixels.resize(area * channels);
+            std::memcpy(pixels.data(), data + sizeof(reply), payload);
+            consumed += sizeof(reply) + payload;
+
+            connection.outstanding.pop_front();
+            connection.lastProgress = Clock::now();
+            --tiles[expected].copies;
+            stats.workers[w].renderMs += reply.renderMs;
+            store(w, expected, pixels.data());
+        }
+        if (connection.fd >= 0)
+        {
+            connection.input.erase(connection.input.begin(), connection.input.begin() + consumed);
+        }
+    };
+
+    auto lastConnectAttempt = Clock::time_point();
+    while (remaining > 0)
+    {
+        // Connect to workers that were not listening yet. A worker busy with another coordinator accepts
+        // the connection but greets only when it is free, so greetings are awaited like connections, up to
+        // the connect timeout.
+        bool connecting = false;
+        const bool connectPhase = secondsSince(start) < settings.connectTimeout;
+        const bool retry = connectPhase && secondsSince(lastConnectAttempt) > 0.05;
+        for (size_t w = 0; w < connections.size(); ++w)
+        {
+            WorkerConnection &connection = connections[w];
+            if (connection.dead || connection.state == ConnectionState::READY)
+            {
+                continue;
+            }
+            if (!connectPhase)
+            {
+                if (connection.state == ConnectionState::GREETING)
+                {
+                    fail(w, "no greeting before the connect timeout");
+                }
+                else if (connection.state == ConnectionState::CONNECTING)
+                {
+                    close(connection.fd);
+                    connection.fd = -1;
+                    connection.state = ConnectionState::DISCONNECTED;
+                }
+                continue;
+            }
+            connecting = true;
+            if (connection.state == ConnectionState::DISCONNECTED && retry)
+            {
+                bool inProgress = false;
+                connection.fd = connectTo(connection.address, inProgress);
+                if (connection.fd >= 0)
+                {
+                    connection.state = inProgress ? ConnectionState::CONNECTING : ConnectionState::GREETING;
+                }
+            }
+        }
+        if (retry)
+        {
+            lastConnectAttempt = Clock::now();
+        }
+
+        // Keep every live worker's queue full; once the queue is empty, idle workers take copies of
+        // tiles another worker still holds, oldest first
+        bool live = false;
+        for (size_t w = 0; w < connections.size(); ++w)
+        {
+            WorkerConnection &connection = connections[w];
+            while (connection.state == ConnectionState::READY && static_cast<int>(connection.outstanding.size()) < settings.tilesPerWorker)
+            {
+                while (!queue.empty() && tiles[queue.front()].done)
+                {
+                    queue.pop_front();
+                }
+                if (!queue.empty())
+                {
+                    int index = queue.front();
+                    queue.pop_front();
+                    send(w, index);
+                    continue;
+                }
+                if (!connection.outstanding.empty())
+                {
+                    break;
+                }
+                int best = -1;
+                Clock::time_point bestTime = Clock::time_point::max();
+                for (const WorkerConnection &other : connections)
+                {
+                    if (other.state != ConnectionState::READY || other.outstanding.empty())
+                    {
+                        continue;
+                    }
+                    int index = other.outstanding.front();
+                    if (!tiles[index].done && tiles[index].copies == 1 && other.lastProgress < bestTime)
+                    {
+                        best = index;
+                        bestTime = other.lastProgress;
+                    }
+                }
+                if (best < 0)
+                {
+                    break;
+                }
+                ++stats.speculative;
+                send(w, best);
+            }
+            live = live || connection.state == ConnectionState::READY;
+        }
+        if (!live && !connecting)
+        {
+            std::cerr << "Distributed render failed: no worker is available and " << remaining << " tiles remain" << std::endl;
+            throw std::runtime_error("Distributed render failed: no worker available");
+        }
+
+        // Wait for connections, greetings, results and room for queued requests
+        std::vector<pollfd> fds;
+        std::vector<size_t> owners;
+        for (size_t w = 0; w < connections.size(); ++w)
+        {
+            const WorkerConnection &connection = connections[w];
+            if (connection.fd >= 0)
+            {
+                short events = connection.state == ConnectionState::CONNECTING ? POLLOUT
+                                                                                 : POLLIN | (connection.output.empty() ? 0 : POLLOUT);
+                fds.push_back({connection.fd, events, 0});
+                owners.push_back(w);
+            }
+        }
+        int ready = poll(fds.data(), fds.size(), 50);
+        if (ready < 0 && errno != EINTR)
+        {
+            std::cerr << "Distributed render failed: poll: " << std::strerror(errno) << std::endl;
+            throw std::runtime_error("Distributed render failed: poll");
+        }
+        for (size_t i = 0; ready > 0 && i < fds.size(); ++i)
+        {
+            size_t w = owners[i];
+            WorkerConnection &connection = connections[w];
+            if (!fds[i].revents || connection.fd != fds[i].fd)
+            {
+                continue;
+            }
+            if (connection.state == ConnectionState::CONNECTING)
+            {
+                // A refused connection is retried, as when connect() fails at once
+                int error = 0;
+                socklen_t length = sizeof(error);
+                getsockopt(connection.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+                if (error != 0)
+                {
+                    close(connection.fd);
+                    connection.fd = -1;
+                    connection.state = ConnectionState::DISCONNECTED;
+                }
+                else
+                {
+                    connection.state = ConnectionState::GREETING;
+                }
+                continue;
+            }
+            if ((fds[i].revents & POLLOUT) && !flushOutput(connection.fd, connection.output))
+            {
+                fail(w, "cannot send a tile");
+                continue;
+            }
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                // Results received before the connection closed are still used
+                bool open = receiveInput(connection.fd, connection.input);
+                handleInput(w);
+                if (!open && connection.fd >= 0)
+                {
+                    fail(w, "connection lost");
+                }
+            }
+        }
+
+        // Drop workers that stopped making progress
+        for (size_t w = 0; w < connections.size(); ++w)
+        {
+            WorkerConnection &connection = connections[w];
+            if (connection.state == ConnectionState::READY && !connection.outstanding.empty() &&
+                secondsSince(connection.lastProgress) > settings.tileTimeout)
+            {
+                fail(w, "timed out");
+            }
+        }
+    }
+
+    // Workers stay up for the next frame; only the connections are closed
+    for (WorkerConnection &connection : connections)
+    {
+        if (connection.fd >= 0)
+        {
+            close(connection.fd);
+        }
+    }
+
+    // Finish the frame as Renderer does: denoise across tile borders, then convert to 8 bits
+    if (denoise)
+    {
+        int samples = request.samplesPerPixel > 0 ? request.samplesPerPixel : (request.antialiasing ? 16 : 1);
+        bool multipleSamples = static_cast<int>(std::sqrt(samples)) > 1;
+        denoiseImage(hdr, multipleSamples ? variance : nullptr, albedo, normal, depth, materialId, width, height);
+    }
+    if (request.rgbOutput)
+    {
+        bool toneMapped = request.applyToneMap && sceneData.renderMode != RenderMode::BINARY;
+        toneMapImage(hdr, width, height, toneMapped, request.camera.exposure, sceneData.backgroundColor, request.rgbOutput);
+    }
+    stats.totalMs = millisecondsSince(start);
+    return stats;
+}
+
+LocalWorkerPool::LocalWorkerPool(int count, const std::string &executable, const std::vector<std::string> &arguments)
+{
+    // Share the cores between the workers unless the caller chose a thread count
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    std::string threads = "OMP_NUM_THREADS=" + std::to_string(std::max(1u, cores / static_cast<unsigned int>(std::max(1, count))));
+    bool setThreads = std::getenv("OMP_NUM_THREADS") == nullptr;
+
+    for (int i = 0; i < count; ++i)
+    {
+        std::string address = "unix:/tmp/raytracer-" + std::to_string(getpid()) + "-" + std::to_string(i) + ".sock";
+
+        // Everything the child needs is prepared before forking
+        std::vector<std::string> childArguments = {executable};
+        childArguments.insert(childArguments.end(), arguments.begin(), arguments.end());
+        childArguments.push_back("--worker");
+        childArguments.push_back(address);
+        std::vector<char *> argv;
+        for (std::string &argument : childArguments)
+        {
+            argv.push_back(&argument[0]);
+        }
+        argv.push_back(nullptr);
+        std::vector<char *> envp;
+        for (char **variable = environ; *variable; ++variable)
+        {
+            envp.push_back(*variable);
+        }
+        if (setThreads)
+        {
+            envp.push_back(&threads[0]);
+        }
+        envp.push_back(nullptr);
+
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            for (pid_t started : pids)
+            {
+                ::kill(started, SIGTERM);
+                waitpid(started, nullptr, 0);
+            }
+            std::cerr << "Cannot start worker process: " << std::strerror(errno) << std::endl;
+            throw std::runtime_error("Cannot start worker process");
+        }
+        if (pid == 0)
+        {
+            // Workers report on stderr only
+            int devNull = open("/dev/null", O_WRONLY);
+            if (devNull >= 0)
+            {
+                dup2(devNull, STDOUT_FILENO);
+            }
+            execve(executable.c_str(), argv.data(), envp.data());
+            _exit(127);
+        }
+        pids.push_back(pid);
+        workerAddresses.push_back(address);
+    }
+}
+
+LocalWorkerPool::~LocalWorkerPool()
+{
+    for (size_t i = 0; i < pids.size(); ++i)
+    {
+        if (pids[i] > 0)
+        {
+            ::kill(pids[i], SIGTERM);
+            waitpid(pids[i], nullptr, 0);
+        }
+        unlink(workerAddresses[i].substr(5).c_str());
+    }
+}
+
+void LocalWorkerPool::kill(int index)
+{
+    if (pids.at(index) > 0)
+    {
+        ::kill(pids[index], SIGKILL);
+        waitpid(pids[index], nullptr, 0);
+        pids[index] = -1;
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "renderer.h" // Renderer and FrameRequest
+
+// Distributed rendering: a coordinator splits a frame into tiles and hands them to worker
+// processes over sockets. Each worker loads the scene and builds its BVH once, then renders
+// any number of tiles (and frames) and streams back their linear colors. Addresses are either
+// "unix:<path>" for a UNIX domain socket or "<host>:<port>" for TCP. Tiles travel as raw
+// floats, so workers must share the coordinator's byte order (checked when they connect).
+
+// Settings of a distributed render
+struct DistributedSettings
+{
+    int tileSize = 32;            // Width and height of the tiles handed to workers
+    int tilesPerWorker = 2;       // Tiles queued on each worker at once, so it never waits for the next one
+    double tileTimeout = 60.0;    // Seconds a worker may go without returning a tile before it is dropped
+    double connectTimeout = 60.0; // Seconds to keep retrying workers that are not listening or have not greeted yet (e.g. still building their BVH)
+};
+
+// Work done by one worker during a distributed render
+struct WorkerStats
+{
+    std::string address;
+    int tiles = 0;           // Tiles whose results were used
+    int duplicates = 0;      // Results discarded because another worker returned the tile first
+    double renderMs = 0.0;   // Time the worker spent rendering, as reported by it
+    bool connected = false;  // The worker answered before the connect timeout
+    bool failed = false;     // Dropped after an error or timeout; its tiles were reassigned
+};
+
+// Summary of a distributed render
+struct DistributedStats
+{
+    std::vector<WorkerStats> workers; // In the order of the addresses
+    int tiles = 0;                    // Tiles in the frame
+    int reassigned = 0;               // Tiles queued again after their worker failed
+    int speculative = 0;              // Tiles also handed to an idle worker while a slower one still had them
+    double totalMs = 0.0;             // Wall-clock time from the first connection attempt to the finished frame
+};
+
+// Serves tile requests from coordinators until the process is terminated
+// Listens on the address and handles one coordinator at a time; the scene stays loaded between
+// connections, so a worker can serve frame after frame. A request for a tile outside the image
+// closes the connection.
+// Parameters:
+// - renderer: Renderer holding the scene; its camera sets the resolution coordinators must use
+// - address: Address to listen on ("unix:<path>", "<host>:<port>" or ":<port>" for all interfaces)
+// Returns: Nonzero if the address could not be opened
+int runTileWorker(const Renderer &renderer, const std::string &address);
+
+// Renders a frame request on remote workers
+// The request's crop is split into tiles that are queued on the workers as they connect. Tiles of
+// a worker that disconnects, fails or times out are queued again; once the queue is empty, idle
+// workers also take the tiles still outstanding on others and whichever copy arrives first is kept.
+// The assembled colors are then denoised (if requested) and tone mapped exactly as Renderer does,
+// so the output matches a single-process render of the same request.
+// All sockets are non-blocking and polled together, so a worker that is unreachable, slow to greet or
+// slow to send a tile never delays the others.
+// Parameters:
+// - workers: Addresses of workers serving the same scene at the same resolution
+// - sceneData: The scene, for its render mode and background color
+// - request: Frame to render, with its output buffers
+// - settings: Tiling, queueing and timeouts
+// Returns: Per-worker and total statistics
+// Throws std::runtime_error if no worker connects or all workers fail before the frame is done
+DistributedStats renderDistributed(const std::vector<std::string> &workers, const SceneData &sceneData,
+                                   const FrameRequest &request, const DistributedSettings &settings = DistributedSettings());
+
+// Worker processes started on this machine, each listening on its own UNIX socket
+// The processes are terminated and their sockets removed when the pool is destroyed
+class LocalWorkerPool
+{
+public:
+    // Starts the workers
+    // Parameters:
+    // - count: Number of worker processes
+    // - executable: Program to run
+    // - arguments: Its arguments, to which "--worker <address>" is appended
+    // Each worker runs with OMP_NUM_THREADS set to an equal share of the cores unless it is already set
+    LocalWorkerPool(int count, const std::string &executable, const std::vector<std::string> &arguments);
+    ~LocalWorkerPool();
+
+    LocalWorkerPool(const LocalWorkerPool &) = delete;
+    LocalWorkerPool &operator=(const LocalWorkerPool &) = delete;
+
+    const std::vector<std::string> &addresses() const { return workerAddresses; }
+
+    // Kills one worker, e.g. to test that its tiles are reassigned
+    void kill(int index);
+
+private:
+    std::vector<pid_t> pids;
+    std::vector<std::string> workerAddresses;
+};
+
+#endif // DISTRIBUTED_H
@@ -0,0 +1,214 @@
+#include "preview.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include "denoise.h"            // Edge-aware denoiser run on the last pass
+#include "render.h"             // HDR to 8-bit conversion and PPM output
+#include "shared_framebuffer.h" // Frames published to viewers
+#include "../timing.h"          // Clock and millisecondsSince
+
+// Set by SIGINT and SIGTERM to end the preview
+static volatile std::sig_atomic_t stopRequested = 0;
+
+static void requestStop(int)
+{
+    stopRequested = 1;
+}
+
+// What identifies one version of the scene file: editors either rewrite it or replace it with a new file
+struct FileVersion
+{
+    bool exists = false;
+    ino_t inode = 0;
+    off_t size = 0;
+    long long modifiedNs = 0;
+
+    bool operator==(const FileVersion &other) const
+    {
+        return exists == other.exists && inode == other.inode && size == other.size && modifiedNs == other.modifiedNs;
+    }
+    bool operator!=(const FileVersion &other) const { return !(*this == other); }
+};
+
+static FileVersion fileVersion(const std::string &fileName)
+{
+    FileVersion version;
+    struct stat status;
+    if (stat(fileName.c_str(), &status) == 0)
+    {
+        version.exists = true;
+        version.inode = status.st_ino;
+        version.size = status.st_size;
+        version.modifiedNs = static_cast<long long>(status.st_mtim.tv_sec) * 1000000000LL + status.st_mtim.tv_nsec;
+    }
+    return version;
+}
+
+// Renders the passes of one scene load and publishes each of them
+// Returns: false if the scene file changed (or a stop was requested) before the last pass completed
+static bool renderPasses(const Renderer &renderer, const FrameRequest &request, const std::function<bool()> &interrupted,
+                         SharedFramebuffer &output, const PreviewSettings &settings, Clock::time_point changeSeen,
+                         PreviewGenerationStats &stats)
+{
+    const SceneData &sceneData = renderer.scene().data();
+    const Camera &camera = sceneData.camera;
+    const int width = camera.imageWidth(), height = camera.imageHeight();
+    const bool toneMapped = request.applyToneMap && sceneData.renderMode != RenderMode::BINARY;
+    std::vector<uint8_t> image(static_cast<size_t>(width) * height * 3);
+
+    for (int scale = std::max(1, settings.firstScale);; scale = std::max(1, scale / 2))
+    {
+        const bool last = scale == 1;
+        const int passWidth = (width + scale - 1) / scale, passHeight = (height + scale - 1) / scale;
+        const size_t passPixels = static_cast<size_t>(passWidth) * passHeight;
+        FrameRequest pass(camera.withResolution(passWidth, passHeight));
+        pass.applyToneMap = request.applyToneMap;
+        pass.seed = request.seed;
+        pass.antialiasing = last && request.antialiasing;
+        pass.samplesPerPixel = last ? request.samplesPerPixel : 1;
+
+        // The last pass gathers the buffers the denoiser needs over the whole image, then filters it once
+        int samples = pass.samplesPerPixel > 0 ? pass.samplesPerPixel : (pass.antialiasing ? 16 : 1);
+        bool denoise = last && request.denoise && sceneData.renderMode != RenderMode::BINARY;
+        std::vector<float> hdr(passPixels * 3), albedo, normal, depth, variance;
+        std::vector<uint32_t> materialId;
+        if (denoise)
+        {
+            albedo.resize(passPixels * 3);
+            normal.resize(passPixels * 3);
+            depth.resize(passPixels);
+            variance.resize(passPixels);
+            materialId.resize(passPixels);
+        }
+
+        // Bands of about 16K pixels, checking for a scene change before each
+        const int bandRows = std::max(1, 16384 / passWidth);
+        for (int y = 0; y < passHeight; y += bandRows)
+        {
+            if (interrupted())
+            {
+                return false;
+            }
+            FrameRequest band = pass;
+            band.cropY = y;
+            band.cropHeight = std::min(bandRows, passHeight - y);
+            size_t offset = static_cast<size_t>(y) * passWidth;
+            band.hdrOutput = hdr.data() + offset * 3;
+            if (denoise)
+            {
+                band.albedoOutput = albedo.data() + offset * 3;
+                band.normalOutput = normal.data() + offset * 3;
+                band.depthOutput = depth.data() + offset;
+                band.varianceOutput = variance.data() + offset;
+                band.materialIdOutput = materialId.data() + offset;
+            }
+            renderer.render(band);
+        }
+        if (denoise)
+        {
+            // A single sample has no variance of its own; the denoiser then estimates it from the neighbours
+            bool sampled = static_cast<int>(std::sqrt(static_cast<float>(samples))) > 1;
+            denoiseImage(hdr.data(), sampled ? variance.data() : nullptr, albedo.data(), normal.data(), depth.data(),
+                         materialId.data(), passWidth, passHeight);
+        }
+
+        // Tone map the pass at its own resolution, then repeat each pixel over its block
+        std::vector<uint8_t> passImage(passPixels * 3);
+        toneMapImage(hdr.data(), passWidth, passHeight, toneMapped, camera.exposure, sceneData.backgroundColor, passImage.data());
+        for (int y = 0; y < height; ++y)
+        {
+            const uint8_t *source = passImage.data() + static_cast<size_t>(y / scale) * passWidth * 3;
+            uint8_t *target = image.data() + static_cast<size_t>(y) * width * 3;
+            for (int x = 0; x < width; ++x)
+            {
+                std::copy(source + (x / scale) * 3, source + (x / scale) * 3 + 3, target + x * 3);
+            }
+        }
+
+        double elapsedMs = millisecondsSince(changeSeen);
+        output.publish(image.data(), width, height, scale, stats.generation, elapsedMs);
+        if (stats.passes++ == 0)
+        {
+            stats.firstImageMs = elapsedMs;
+        }
+        if (last)
+        {
+            stats.fullImageMs = elapsedMs;
+            if (!settings.outputFileName.empty())
+            {
+                writeBinaryImageToPPM(settings.outputFileName, width, height, image);
+            }
+            return true;
+        }
+    }
+}
+
+int runPreview(const std::string &fileName, const std::function<SceneData()> &loadScene, bool useBVH, const FrameRequest &request,
+               const std::string &framebuffer, const PreviewSettings &settings, const PreviewReporter &reporter)
+{
+    SharedFramebuffer output(framebuffer);
+    stopRequested = 0;
+    auto previousInterrupt = std::signal(SIGINT, requestStop);
+    auto previousTerminate = std::signal(SIGTERM, requestStop);
+
+    // Sleeps until the scene file differs from the given version or a stop is requested
+    auto waitForChange = [&](const FileVersion &version)
+    {
+        while (!stopRequested && fileVersion(fileName) == version)
+        {
+            std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(settings.pollMs));
+        }
+    };
+
+    int result = 0;
+    int generation = 0, completed = 0;
+    auto changeSeen = Clock::now();
+    while (!stopRequested)
+    {
+        // The version is taken before loading, so an edit made during the load interrupts the first pass
+        FileVersion version = fileVersion(fileName);
+        std::shared_ptr<const Scene> scene;
+        try
+        {
+            scene = std::make_shared<const Scene>(loadScene(), useBVH);
+        }
+        catch (const std::exception &error)
+        {
+            std::cerr << "Preview: cannot load " << fileName << ": " << error.what() << std::endl;
+            if (generation == 0)
+            {
+                result = 1;
+                break;
+            }
+            waitForChange(version);
+            changeSeen = Clock::now();
+            continue;
+        }
+
+        PreviewGenerationStats stats;
+        stats.generation = ++generation;
+        stats.loadMs = millisecondsSince(changeSeen);
+        Renderer renderer(scene);
+        bool complete = renderPasses(renderer, request, [&] { return stopRequested || fileVersion(fileName) != version; },
+                                     output, settings, changeSeen, stats);
+        reporter(stats);
+        if (complete && settings.maxGenerations > 0 && ++completed >= settings.maxGenerations)
+        {
+            break;
+        }
+        if (complete)
+        {
+            waitForChange(version);
+        }
+        changeSeen = Clock::now();
+    }
+
+    std::signal(SIGINT, previousInterrupt);
+    std::signal(SIGTERM, previousTerminate);
+    return result;
+}
@@ -0,0 +1,51 @@
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+#include <functional>
+#include <string>
+#include "renderer.h" // Scene, Renderer and FrameRequest
+
+// Settings of the interactive preview
+struct PreviewSettings
+{
+    int firstScale = 16;      // The first pass renders one pixel per firstScale x firstScale block; each pass halves it
+    double pollMs = 5.0;      // Interval at which the scene file is checked once the image is complete
+    int maxGenerations = 0;   // Return after rendering this many scene loads at full resolution (0 runs until interrupted)
+    std::string outputFileName; // Written with each full-resolution image when not empty
+};
+
+// Timing of one scene load in the preview, measured from the moment the change was seen
+struct PreviewGenerationStats
+{
+    int generation = 0;        // Scene loads so far, counting this one
+    double loadMs = 0.0;       // Parsing the JSON and building the scene (and BVH)
+    double firstImageMs = 0.0; // Until the first, coarsest pass was published
+    double fullImageMs = 0.0;  // Until the full-resolution image was published (0 if interrupted)
+    int passes = 0;            // Passes published
+};
+
+// Receives the timing of every scene load when it completes or is interrupted
+using PreviewReporter = std::function<void(const PreviewGenerationStats &stats)>;
+
+// Keeps a scene loaded and renders it progressively into a shared framebuffer, restarting when the scene
+// file changes
+// Each pass renders the camera at 1 / scale of the resolution along each axis, from settings.firstScale
+// down to 1, and publishes it scaled up with nearest-neighbour filtering, so viewers show a blocky image
+// within milliseconds that sharpens as passes complete. Passes other than the last trace a single sample
+// per pixel; the last uses the request's samples and denoiser. Passes are rendered in bands of rows and the
+// scene file's modification time is checked between bands, so an edit interrupts the pass in progress and
+// the scene is reloaded at once. A scene file that fails to parse (e.g. while an editor is still writing
+// it) is reported and skipped until the next change.
+// Parameters:
+// - fileName: Scene JSON file to watch
+// - loadScene: Reads the scene file and applies any overrides; called again after each change
+// - useBVH: Build a BVH over the loaded scenes
+// - request: Tone mapping, antialiasing, samples, seed and denoising of the passes (camera and buffers unused)
+// - framebuffer: Shared-memory name published to (see SharedFramebuffer)
+// - settings: Pass, polling and output settings
+// - reporter: Called with the timing of each scene load
+// Returns: Nonzero if the first scene could not be loaded
+int runPreview(const std::string &fileName, const std::function<SceneData()> &loadScene, bool useBVH, const FrameRequest &request,
+               const std::string &framebuffer, const PreviewSettings &settings, const PreviewReporter &reporter);
+
+#endif // PREVIEW_H
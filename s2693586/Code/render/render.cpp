@@ -0,0 +1,219 @@
+#include "render.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include "../tone/tone_mapping.h" // Tone mapping of HDR colors
+
+// Generates evenly distributed points for antialiasing
+std::vector<std::pair<float, float>> plot_evenly_distributed_points(int num_samples, float lower_bound, float upper_bound, unsigned int seed)
+{
+    int grid_size = static_cast<int>(std::sqrt(num_samples)); // Approximate grid size
+    float step = (upper_bound - lower_bound) / grid_size;     // Distance between grid points
+
+    // Generate evenly distributed points with slight jitter
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> jitter(-step / 5, step / 5); // Small jitter to avoid perfect alignment
+
+    std::vector<std::pair<float, float>> points;
+    for (int i = 0; i < grid_size; ++i)
+    {
+        for (int j = 0; j < grid_size; ++j)
+        {
+            float x = lower_bound + i * step + jitter(rng); // Add jitter to x
+            float y = lower_bound + j * step + jitter(rng); // Add jitter to y
+            points.emplace_back(x, y);                      // Store the jittered point
+        }
+    }
+    return points;
+}
+
+// Derives a per-pixel seed from the render seed
+// Sampling then only depends on the seed and the pixel, not on how OpenMP schedules the rows
+unsigned int pixelSeed(unsigned int seed, int x, int y)
+{
+    uint32_t h = seed ^ (static_cast<uint32_t>(x) * 0x8da6b343u) ^ (static_cast<uint32_t>(y) * 0xd8163841u);
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+// Writes a binary image to a PPM file
+void writeBinaryImageToPPM(const std::string &outputFileName, int width, int height, const std::vector<unsigned char> &image)
+{
+    // Open the output file in binary mode
+    std::ofstream outFile(outputFileName, std::ios::binary); // Open file in binary mode
+
+    // Check if the file is open
+    if (outFile.is_open())
+    {
+        // Write PPM header (P6 format)
+        outFile << "P6\n"
+                << width << " " << height << "\n255\n";
+
+        // Write binary pixel data
+        outFile.write(reinterpret_cast<const char *>(image.data()), image.size());
+
+        // Close the file
+        outFile.close();
+    }
+    else
+    {
+        // Output error message if the file cannot be opened
+        std::cerr << "Failed to open output file: " << outputFileName << std::endl;
+    }
+}
+
+void writeMaskToPBM(const std::string &outputFileName, int width, int height, const std::vector<uint8_t> &mask)
+{
+    std::ofstream outFile(outputFileName, std::ios::binary);
+    if (!outFile.is_open())
+    {
+        std::cerr << "Failed to open output file: " << outputFileName << std::endl;
+        return;
+    }
+    outFile << "P4\n" << width << " " << height << "\n";
+    std::vector<uint8_t> inverted(mask.size());
+    std::transform(mask.begin(), mask.end(), inverted.begin(), [](uint8_t bits) { return static_cast<uint8_t>(~bits); });
+    outFile.write(reinterpret_cast<const char *>(inverted.data()), inverted.size());
+}
+
+void writeDepthToPGM(const std::string &outputFileName, int width, int height, const std::vector<uint16_t> &depth, float depthFar)
+{
+    std::ofstream outFile(outputFileName, std::ios::binary);
+    if (!outFile.is_open())
+    {
+        std::cerr << "Failed to open output file: " << outputFileName << std::endl;
+        return;
+    }
+    outFile << "P5\n# depth_far " << depthFar << "\n" << width << " " << height << "\n65535\n";
+
+    // PGM samples above 255 are stored most significant byte first
+    std::vector<uint8_t> bytes(depth.size() * 2);
+    for (size_t i = 0; i < depth.size(); ++i)
+    {
+        bytes[i * 2] = static_cast<uint8_t>(depth[i] >> 8);
+        bytes[i * 2 + 1] = static_cast<uint8_t>(depth[i]);
+    }
+    outFile.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+}
+
+void writeIdsToPAM(const std::string &outputFileName, int width, int height, const std::vector<uint32_t> &ids)
+{
+    std::ofstream outFile(outputFileName, std::ios::binary);
+    if (!outFile.is_open())
+    {
+        std::cerr << "Failed to open output file: " << outputFileName << std::endl;
+        return;
+    }
+    outFile << "P7\nWIDTH " << width << "\nHEIGHT " << height << "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE ID32\nENDHDR\n";
+    std::vector<uint8_t> bytes(ids.size() * 4);
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+        for (int byte = 0; byte < 4; ++byte)
+        {
+            bytes[i * 4 + byte] = static_cast<uint8_t>(ids[i] >> (24 - 8 * byte));
+        }
+    }
+    outFile.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+}
+
+// Collects all geometric objects (spheres, cylinders, triangles, particle sets) from the scene data
+std::vector<std::shared_ptr<const Geometry>> collectGeometries(const SceneData &sceneData)
+{
+    std::vector<std::shared_ptr<const Geometry>> geometries;
+
+    // Add spheres to the geometries list
+    for (const auto &sphere : sceneData.spheres)
+    {
+        geometries.push_back(std::make_shared<Sphere>(sphere));
+    }
+
+    // Add cylinders to the geometries list
+    for (const auto &cylinder : sceneData.cylinders)
+    {
+        geometries.push_back(std::make_shared<Cylinder>(cylinder));
+    }
+
+    // Add triangles to the geometries list
+    for (const auto &triangle : sceneData.triangles)
+    {
+        geometries.push_back(std::make_shared<Triangle>(triangle));
+    }
+
+    // Particle sets are added whole; each keeps its own BVH over its particles
+    for (const auto &particleSet : sceneData.particles)
+    {
+        geometries.push_back(particleSet);
+    }
+
+    return geometries;
+}
+
+// Quantises HDR colors to 8-bit RGB, compiled once with and once without tone mapping
+// Parameters:
+// - minColor, maxColor: Range of the image's non-background colors, used when ToneMapped
+template <bool ToneMapped>
+static void quantiseImage(const float *hdr, size_t pixelCount, float exposure, const Vector3 &minColor, const Vector3 &maxColor,
+                          const Vector3 &backgroundColor, uint8_t *image)
+{
+#pragma omp parallel for
+    for (long long i = 0; i < static_cast<long long>(pixelCount); ++i)
+    {
+        Vector3 color(hdr[i * 3], hdr[i * 3 + 1], hdr[i * 3 + 2]);
+        if constexpr (ToneMapped)
+        {
+            color = toneMap(color, exposure, minColor, maxColor, backgroundColor); // Apply tone mapping
+        }
+
+        // Set the RGB values, clamping them to [0, 255] and converting to uint8_t
+        image[i * 3] = static_cast<uint8_t>(std::min(color.x * 255.0f, 255.0f));     // R
+        image[i * 3 + 1] = static_cast<uint8_t>(std::min(color.y * 255.0f, 255.0f)); // G
+        image[i * 3 + 2] = static_cast<uint8_t>(std::min(color.z * 255.0f, 255.0f)); // B
+    }
+}
+
+// Converts an HDR image to 8-bit RGB, optionally tone mapping it first
+void toneMapImage(const float *hdr, int width, int height, bool applyToneMap, float exposure,
+                  const Vector3 &backgroundColor, uint8_t *image)
+{
+    size_t pixelCount = static_cast<size_t>(width) * height;
+
+    // Calculate min and max color values for tone mapping
+    Vector3 minColor(std::numeric_limits<float>::max());
+    Vector3 maxColor(-std::numeric_limits<float>::max());
+    if (applyToneMap)
+    {
+        for (size_t i = 0; i < pixelCount; ++i)
+        {
+            Vector3 color(hdr[i * 3], hdr[i * 3 + 1], hdr[i * 3 + 2]);
+            if (color != backgroundColor) // Exclude background colour
+            {
+                minColor = Vector3(
+                    std::min(minColor.x, color.x),
+                    std::min(minColor.y, color.y),
+                    std::min(minColor.z, color.z));
+
+                maxColor = Vector3(
+                    std::max(maxColor.x, color.x),
+                    std::max(maxColor.y, color.y),
+                    std::max(maxColor.z, color.z));
+            }
+        }
+    }
+
+    if (applyToneMap)
+    {
+        quantiseImage<true>(hdr, pixelCount, exposure, minColor, maxColor, backgroundColor, image);
+    }
+    else
+    {
+        quantiseImage<false>(hdr, pixelCount, exposure, minColor, maxColor, backgroundColor, image);
+    }
+}
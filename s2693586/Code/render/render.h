@@ -0,0 +1,52 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../json_reader.h"       // SceneData and RenderMode
+#include "../geometry/geometry.h" // Geometric objects in the scene
+
+// Generates evenly distributed points for antialiasing
+// Parameters:
+// - num_samples: Number of samples (rounded down to a square grid)
+// - lower_bound, upper_bound: Range of the sample offsets within a pixel
+// - seed: Seed for the jitter applied to each grid point
+// Returns: The jittered sample offsets
+std::vector<std::pair<float, float>> plot_evenly_distributed_points(int num_samples = 64, float lower_bound = -1.0f, float upper_bound = 1.0f, unsigned int seed = std::random_device{}());
+
+// Derives a per-pixel seed from the render seed
+unsigned int pixelSeed(unsigned int seed, int x, int y);
+
+// Writes a binary image to a PPM file
+void writeBinaryImageToPPM(const std::string &outputFileName, int width, int height, const std::vector<unsigned char> &image);
+
+// Writes a packed 1-bit mask (8 pixels per byte, rows starting on a new byte) to a PBM (P4) file
+// PBM stores 1 as black, so the bits are inverted on the way out and set pixels appear white
+void writeMaskToPBM(const std::string &outputFileName, int width, int height, const std::vector<uint8_t> &mask);
+
+// Writes 16-bit values to a PGM (P5) file with a maximum of 65535
+// depthFar, the distance stored as 65535, is recorded in a "# depth_far" header comment
+void writeDepthToPGM(const std::string &outputFileName, int width, int height, const std::vector<uint16_t> &depth, float depthFar);
+
+// Writes 32-bit IDs to a PAM (P7) file of four bytes per pixel, most significant byte first
+void writeIdsToPAM(const std::string &outputFileName, int width, int height, const std::vector<uint32_t> &ids);
+
+// Collects all geometric objects (spheres, cylinders, triangles) from the scene data
+std::vector<std::shared_ptr<const Geometry>> collectGeometries(const SceneData &sceneData);
+
+// Converts an HDR image (three floats per pixel) to 8-bit RGB
+// Parameters:
+// - hdr: Linear colors, row by row
+// - width, height: Image dimensions
+// - applyToneMap: Tone map the colors (normalised over this image) before quantising
+// - exposure: Camera exposure passed to the tone mapper
+// - backgroundColor: Background color, left unchanged by tone mapping
+// - image: Output buffer of width * height * 3 bytes
+void toneMapImage(const float *hdr, int width, int height, bool applyToneMap, float exposure,
+                  const Vector3 &backgroundColor, uint8_t *image);
+
+#endif // RENDER_H
@@ -0,0 +1,651 @@
+#include "renderer.h"
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include "render.h"                   // Sampling and tone-mapping helpers
+#include "denoise.h"                  // Edge-aware denoising post-pass
+#include "../geometry/intersection.h" // Closest-hit queries for the brute-force path
+#include "../shading/blinn_phong.h"   // Blinn-Phong shading (with and without BVH)
+#include "../shading/path_tracer.h"   // Path-tracing integrator
+#include "../bvh/spatial_split_bvh.h" // Spatial-split BVH build
+#include "../bvh/linear_bvh.h"        // Morton-code BVH build
+
+// Scene constructor: keeps the scene data and builds the BVH over its shapes
+Scene::Scene(SceneData sceneData, bool useBVH)
+    : sceneData(std::move(sceneData))
+{
+    // Checked before triangles move into the packed mesh
+    auto specular = [](const auto &shape)
+    { return shape.material.isReflective || shape.material.isRefractive; };
+    const SceneData &data = this->sceneData;
+    secondaryRays = std::any_of(data.spheres.begin(), data.spheres.end(), specular) ||
+                    std::any_of(data.cylinders.begin(), data.cylinders.end(), specular) ||
+                    std::any_of(data.triangles.begin(), data.triangles.end(), specular) ||
+                    std::any_of(data.particles.begin(), data.particles.end(), [&](const auto &set) { return specular(*set); });
+
+    if (useBVH)
+    {
+        std::vector<Triangle> &triangles = this->sceneData.triangles;
+        if (this->sceneData.lowMemoryBits > 0)
+        {
+            // Moving and textured triangles need their own motion and texture coordinates, so they stay separate
+            auto packed = std::stable_partition(triangles.begin(), triangles.end(), [](const Triangle &triangle)
+                                                { return triangle.isMoving() || triangle.material.texture; });
+            if (packed != triangles.end())
+            {
+                triangleMesh = std::make_shared<const TriangleMesh>(std::vector<Triangle>(packed, triangles.end()),
+                                                                    this->sceneData.lowMemoryBits);
+                triangles.erase(packed, triangles.end());
+                triangles.shrink_to_fit();
+            }
+        }
+        geometries = collectGeometries(this->sceneData);
+        if (triangleMesh)
+        {
+            geometries.push_back(triangleMesh);
+        }
+        if (this->sceneData.spatialSplitBudget >= 0.0f)
+        {
+            root = SpatialSplitBVH::build(geometries, this->sceneData.spatialSplitBudget);
+        }
+        else if (this->sceneData.mortonBits > 0)
+        {
+            root = LinearBVH::build(geometries, this->sceneData.mortonBits, this->sceneData.treeletLeaves);
+        }
+        else if (this->sceneData.bvhWidth > 2)
+        {
+            // Collapsing needs the whole binary hierarchy, so nothing is deferred
+            root = BVHNode::build(geometries);
+        }
+        else
+        {
+            root = BVHNode::build(geometries, 0, this->sceneData.lazyBVHDepth);
+        }
+        if (this->sceneData.bvhWidth > 2)
+        {
+            root->widen(this->sceneData.bvhWidth);
+        }
+    }
+}
+
+std::shared_ptr<const Scene> Scene::load(const std::string &fileName, bool useBVH)
+{
+    return std::make_shared<const Scene>(readSceneFromJson(fileName), useBVH);
+}
+
+Renderer::Renderer(std::shared_ptr<const Scene> scene)
+    : scenePtr(std::move(scene))
+{
+}
+
+void Renderer::render(const FrameRequest &request) const
+{
+    render(std::vector<FrameRequest>{request});
+}
+
+std::string RenderFeatures::name() const
+{
+    std::string name = mode == RenderMode::BINARY ? "binary" : (mode == RenderMode::PATH_TRACE ? "path" : "phong");
+    for (auto [enabled, label] : {std::pair<bool, const char *>{multisample, "+aa"}, {secondaryRays, "+secondary"}, {aovs, "+aovs"},
+                                  {lens, "+lens"}, {toneMapped, "+tonemap"}})
+    {
+        if (enabled)
+        {
+            name += label;
+        }
+    }
+    return name;
+}
+
+// Pixels along a row whose camera rays are generated together
+static constexpr int RAY_TILE_WIDTH = 32;
+
+// Returns the sample offsets within each pixel for a request (the pixel center alone without antialiasing)
+static std::vector<std::pair<float, float>> samplePoints(const FrameRequest &request, RenderMode mode)
+{
+    int samples = request.samplesPerPixel > 0 ? request.samplesPerPixel : (request.antialiasing ? 16 : 1);
+    if (samples > 1 && mode != RenderMode::BINARY)
+    {
+        return plot_evenly_distributed_points(samples, -1.0f, 1.0f, request.seed);
+    }
+    return {{0.0f, 0.0f}};
+}
+
+// Per-request state shared by all rows of one frame
+namespace
+{
+    struct FrameJob
+    {
+        const FrameRequest *request;
+        int width, height;                           // Size of the rendered region
+        std::vector<std::pair<float, float>> points; // Sample offsets within each pixel
+        std::unique_ptr<CameraRayGenerator> rays;    // Camera rays for those offsets
+        void (*renderRow)(const Scene &scene, const FrameJob &job, int localY); // Kernel compiled for the frame's features
+        std::vector<float> scratch;                  // HDR storage when the caller supplied none
+        float *hdr;                                  // HDR output for the region
+
+        // Auxiliary buffers, kept in scratch storage when only the denoiser needs them
+        bool aovs;
+        std::vector<float> albedoScratch, normalScratch, depthScratch;
+        std::vector<uint32_t> materialIdScratch;
+        std::vector<float> varianceScratch;
+        float *albedo, *normal, *depth, *variance;
+        uint32_t *materialId;
+    };
+
+    // Returns the caller's buffer, or scratch storage of the given size when the denoiser needs one
+    template <typename T>
+    T *aovBuffer(T *output, bool needed, std::vector<T> &scratch, size_t size)
+    {
+        if (output || !needed)
+        {
+            return output;
+        }
+        scratch.resize(size);
+        return scratch.data();
+    }
+
+    // First-hit auxiliary values of one pixel
+    struct PixelAovs
+    {
+        Vector3 albedo, normal;
+        float depth, variance;
+        uint32_t materialId;
+    };
+
+    // Renders one row of a frame: localY counts rows from the top of the rendered region
+    using RowKernel = void (*)(const Scene &scene, const FrameJob &job, int localY);
+}
+
+// Generates the camera rays of one image row a tile at a time and calls visit for each pixel
+// The written image is mirrored horizontally relative to camera x, so written column 0 is camera column
+// firstX and later written columns lie to its left
+// Parameters:
+// - generator: Camera rays of the frame
+// - firstX: Camera x of the row's first written pixel
+// - width: Pixels written in the row
+// - y: Camera row
+// - seed: Frame seed, combined with the pixel coordinates to seed each pixel's generator
+// - visit: Called with the tile's rays, the pixel's column in the tile, its written column and its generator
+template <typename Visit>
+static void forEachRayTile(const CameraRayGenerator &generator, int firstX, int width, int y, unsigned int seed, Visit visit)
+{
+    CameraRayBlock rays;
+    std::minstd_rand rngs[RAY_TILE_WIDTH];
+    for (int start = 0; start < width; start += RAY_TILE_WIDTH)
+    {
+        int tileWidth = std::min(RAY_TILE_WIDTH, width - start);
+        int tileX = firstX - (start + tileWidth - 1);
+        for (int column = 0; column < tileWidth; ++column)
+        {
+            rngs[column].seed(pixelSeed(seed, tileX + column, y));
+        }
+        generator.generate(tileX, y, tileWidth, 1, rngs, rays);
+        for (int column = 0; column < tileWidth; ++column)
+        {
+            visit(rays, column, firstX - (tileX + column), rngs[column]);
+        }
+    }
+}
+
+// Finds the closest hit along a ray, through the BVH when the scene has one
+static bool traceClosest(const Ray &ray, const SceneData &sceneData, const BVHNode *root, Intersection &intersection)
+{
+    if (root)
+    {
+        intersection.distance = std::numeric_limits<float>::max();
+        return root->intersect(ray, intersection);
+    }
+    intersection = findClosestIntersection(ray, sceneData.spheres, sceneData.cylinders, sceneData.triangles, sceneData.particles);
+    return intersection.hit;
+}
+
+// Calls test on every shape of the scene until it returns true, for rays traced without a BVH
+// Returns: true if test returned true for any shape
+template <typename Test>
+static bool anyShape(const SceneData &sceneData, Test test)
+{
+    return std::any_of(sceneData.spheres.begin(), sceneData.spheres.end(), test) ||
+           std::any_of(sceneData.cylinders.begin(), sceneData.cylinders.end(), test) ||
+           std::any_of(sceneData.triangles.begin(), sceneData.triangles.end(), test) ||
+           std::any_of(sceneData.particles.begin(), sceneData.particles.end(), [&](const auto &set) { return test(*set); });
+}
+
+// Returns true if the ray hits anything, stopping at the first hit found
+static bool traceAny(const Ray &ray, const SceneData &sceneData, const BVHNode *root)
+{
+    const float maxDistance = std::numeric_limits<float>::max();
+    if (root)
+    {
+        return root->intersectShadowRay(ray, maxDistance);
+    }
+    return anyShape(sceneData, [&](const Geometry &shape) { return shape.occludes(ray, maxDistance); });
+}
+
+// Finds the distance to the closest hit along a ray and what it hit
+static bool traceVisibility(const Ray &ray, const SceneData &sceneData, const BVHNode *root, VisibilityHit &closest)
+{
+    if (root)
+    {
+        return root->intersect(ray, closest);
+    }
+    anyShape(sceneData, [&](const Geometry &shape)
+             {
+                 shape.intersectCloser(ray, closest);
+                 return false; });
+    return closest.object != nullptr;
+}
+
+// Follows perfect mirrors and glass from a camera ray's first hit to the surface seen in them, so the
+// auxiliary buffers (and the denoiser's edges) describe reflected and refracted detail
+// Returns false if the chain leaves the scene; ray becomes the last ray followed and distance the length travelled
+static bool followSpecularChain(Ray &ray, Intersection &intersection, const SceneData &sceneData, const BVHNode *root, float &distance)
+{
+    const int maxDepth = 4;
+    const float epsilon = 0.001f;
+    distance = intersection.distance;
+    for (int depth = 0; depth < maxDepth; ++depth)
+    {
+        const Material &material = intersection.material;
+        Vector3 direction;
+        if (material.isRefractive)
+        {
+            if (!calculateRefraction(ray.direction, intersection.normal, material.refractiveIndex, direction))
+            {
+                direction = ray.direction - intersection.normal * 2.0f * ray.direction.dot(intersection.normal);
+            }
+        }
+        else if (material.isReflective && material.reflectivity >= 1.0f)
+        {
+            direction = ray.direction - intersection.normal * 2.0f * ray.direction.dot(intersection.normal);
+        }
+        else
+        {
+            return true;
+        }
+        direction = direction.normalize();
+        Vector3 origin = intersection.point + intersection.normal * (direction.dot(intersection.normal) < 0 ? -epsilon : epsilon);
+        ray = Ray(origin, direction, ray.time);
+        if (!traceClosest(ray, sceneData, root, intersection))
+        {
+            return false;
+        }
+        distance += intersection.distance;
+    }
+    return true;
+}
+
+// Traces all samples of one pixel of a block of camera rays and returns its HDR color
+// Also fills aovs when it is not nullptr
+// Template parameters (see RenderFeatures): features left out are compiled out, while a feature compiled in
+// is still checked at run time, so the kernel with all of them renders any frame of its mode
+// - Mode: The scene's render mode
+// - Multisample: Trace every sample of the block; without it, only the first
+// - SecondaryRays: Shade with reflection and refraction
+// - Aovs: Fill aovs
+// Parameters:
+// - scene: Scene to trace
+// - rays: Camera rays of the tile holding the pixel
+// - column, row: Pixel within the tile
+// - rng: The pixel's generator, after the camera rays were drawn from it
+template <RenderMode Mode, bool Multisample, bool SecondaryRays, bool Aovs>
+static Vector3 renderPixel(const Scene &scene, const CameraRayBlock &rays, int column, int row, std::minstd_rand &rng, PixelAovs *aovs)
+{
+    const SceneData &sceneData = scene.data();
+    const BVHNode *root = scene.bvh();
+    const bool surface = Aovs && aovs;
+    const int samples = Multisample ? rays.samples : 1;
+
+    Vector3 color = Vector3(0.0f, 0.0f, 0.0f); // Initialize pixel color
+    float totalWeight = 0.0f;
+
+    // Auxiliary values summed over the samples; depth and normal only over samples that hit
+    Vector3 albedoSum(0.0f), normalSum(0.0f);
+    float depthSum = 0.0f;
+    float luminanceSum = 0.0f, luminanceSquares = 0.0f; // For the variance of the pixel's mean
+    int hits = 0;
+    uint32_t firstMaterialId = 0;
+
+    for (int sample = 0; sample < samples; ++sample)
+    {
+        Ray ray = rays.ray(rays.index(column, row, sample));
+
+        Vector3 previousColor = color;
+        Intersection closestIntersection;
+
+        // Binary renders only need to know whether anything was hit, unless the buffers describe the surface
+        bool hit = Mode == RenderMode::BINARY && !surface ? traceAny(ray, sceneData, root)
+                                                          : traceClosest(ray, sceneData, root, closestIntersection);
+
+        if (surface)
+        {
+            Intersection surface = closestIntersection;
+            Ray surfaceRay = ray;
+            float distance = 0.0f;
+            bool surfaceHit = hit && followSpecularChain(surfaceRay, surface, sceneData, root, distance);
+            if (surfaceHit)
+            {
+                albedoSum += diffuseColorAt(surface, surfaceRay);
+                normalSum += surface.normal.dot(surfaceRay.direction) > 0.0f ? -surface.normal : surface.normal;
+                depthSum += distance;
+                ++hits;
+            }
+            else
+            {
+                albedoSum += Vector3(1.0f);
+            }
+            if (sample == 0)
+            {
+                firstMaterialId = surfaceHit ? surface.material.id : 0;
+            }
+        }
+
+        // Set pixel value based on render mode
+        if constexpr (Mode == RenderMode::BINARY)
+        {
+            // Binary shading: red if there's an intersection, black otherwise
+            color = hit ? Vector3(1.0f, 0.0f, 0.0f) : Vector3(0.0f, 0.0f, 0.0f);
+        }
+        else if (!hit)
+        {
+            color += sceneData.backgroundColor;
+        }
+        else if constexpr (Mode == RenderMode::PATH_TRACE)
+        {
+            color += tracePath(closestIntersection, ray, sceneData, root, rng);
+        }
+        else if (root)
+        {
+            color += blinnPhongShadingBVH<SecondaryRays>(closestIntersection, ray, sceneData.lights, root, sceneData.nbounces - 1, sceneData.backgroundColor,
+                                          1.0f, sceneData.minRayWeight);
+        }
+        else
+        {
+            color += blinnPhongShading<SecondaryRays>(closestIntersection, ray, sceneData.lights, sceneData.spheres, sceneData.cylinders,
+                                       sceneData.triangles, sceneData.particles, sceneData.nbounces, sceneData.backgroundColor,
+                                       1.0f, sceneData.minRayWeight);
+        }
+        totalWeight += 1.0f;
+
+        if (surface)
+        {
+            Vector3 sample = color - previousColor;
+            float luminance = 0.2126f * sample.x + 0.7152f * sample.y + 0.0722f * sample.z;
+            luminanceSum += luminance;
+            luminanceSquares += luminance * luminance;
+        }
+    }
+
+    if (surface)
+    {
+        aovs->albedo = albedoSum / totalWeight;
+        aovs->normal = hits > 0 && normalSum.length() > 0.0f ? normalSum.normalize() : Vector3(0.0f);
+        aovs->depth = hits > 0 ? depthSum / hits : 0.0f;
+        aovs->materialId = firstMaterialId;
+        float mean = luminanceSum / totalWeight;
+        aovs->variance = std::max(0.0f, luminanceSquares / totalWeight - mean * mean) / totalWeight;
+    }
+
+    return color / totalWeight; // Normalize color
+}
+
+// Renders one row of a frame into its buffers, with the pixel kernel compiled for the given features
+template <RenderMode Mode, bool Multisample, bool SecondaryRays, bool Aovs>
+static void renderRow(const Scene &scene, const FrameJob &job, int localY)
+{
+    const FrameRequest &request = *job.request;
+    int y = request.cropY + localY;
+    forEachRayTile(*job.rays, request.camera.imageWidth() - 1 - request.cropX, job.width, y, request.seed,
+                   [&](const CameraRayBlock &rays, int column, int localX, std::minstd_rand &rng)
+    {
+        PixelAovs aovs;
+        Vector3 color = renderPixel<Mode, Multisample, SecondaryRays, Aovs>(scene, rays, column, 0, rng, job.aovs ? &aovs : nullptr);
+
+        size_t pixel = static_cast<size_t>(localY) * job.width + localX;
+        float *out = job.hdr + pixel * 3;
+        out[0] = color.x;
+        out[1] = color.y;
+        out[2] = color.z;
+        if constexpr (Aovs)
+        {
+            if (job.albedo)
+            {
+                job.albedo[pixel * 3] = aovs.albedo.x;
+                job.albedo[pixel * 3 + 1] = aovs.albedo.y;
+                job.albedo[pixel * 3 + 2] = aovs.albedo.z;
+            }
+            if (job.normal)
+            {
+                job.normal[pixel * 3] = aovs.normal.x;
+                job.normal[pixel * 3 + 1] = aovs.normal.y;
+                job.normal[pixel * 3 + 2] = aovs.normal.z;
+            }
+            if (job.depth)
+            {
+                job.depth[pixel] = aovs.depth;
+            }
+            if (job.materialId)
+            {
+                job.materialId[pixel] = aovs.materialId;
+            }
+            if (job.variance)
+            {
+                job.variance[pixel] = aovs.variance;
+            }
+        }
+    });
+}
+
+// Returns the row kernel for the remaining flags (multisample, secondary rays, AOVs), choosing one
+// template argument per flag
+template <RenderMode Mode, bool... Chosen>
+static RowKernel selectRowKernel(const bool *flags)
+{
+    if constexpr (sizeof...(Chosen) == 3)
+    {
+        return &renderRow<Mode, Chosen...>;
+    }
+    else
+    {
+        return flags[0] ? selectRowKernel<Mode, Chosen..., true>(flags + 1) : selectRowKernel<Mode, Chosen..., false>(flags + 1);
+    }
+}
+
+// Returns the row kernel compiled for a frame's features
+static RowKernel rowKernelFor(const RenderFeatures &features)
+{
+    const bool flags[] = {features.multisample, features.secondaryRays, features.aovs};
+    switch (features.mode)
+    {
+    case RenderMode::BINARY:
+        return selectRowKernel<RenderMode::BINARY>(flags);
+    case RenderMode::PATH_TRACE:
+        return selectRowKernel<RenderMode::PATH_TRACE>(flags);
+    default:
+        return selectRowKernel<RenderMode::PHONG>(flags);
+    }
+}
+
+RenderFeatures Renderer::features(const FrameRequest &request) const
+{
+    const SceneData &sceneData = scenePtr->data();
+    RenderFeatures features;
+    features.mode = sceneData.renderMode;
+    features.multisample = samplePoints(request, sceneData.renderMode).size() > 1;
+    features.secondaryRays = sceneData.renderMode == RenderMode::PHONG && scenePtr->hasSecondaryRays();
+    features.aovs = request.albedoOutput || request.normalOutput || request.depthOutput || request.materialIdOutput ||
+                    request.varianceOutput || request.denoise;
+    features.lens = request.camera.hasAperture();
+    features.toneMapped = request.rgbOutput && request.applyToneMap && sceneData.renderMode != RenderMode::BINARY;
+    return features;
+}
+
+void Renderer::render(const std::vector<FrameRequest> &requests) const
+{
+    const SceneData &sceneData = scenePtr->data();
+
+    // Validate the requests and resolve crops and buffers
+    std::vector<FrameJob> jobs(requests.size());
+    std::vector<size_t> firstRow(requests.size() + 1, 0); // Prefix sum of rows over all jobs
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+        const FrameRequest &request = requests[i];
+        int imageWidth = request.camera.imageWidth();
+        int imageHeight = request.camera.imageHeight();
+        FrameJob &job = jobs[i];
+        job.request = &request;
+        job.width = request.cropWidth > 0 ? request.cropWidth : imageWidth - request.cropX;
+        job.height = request.cropHeight > 0 ? request.cropHeight : imageHeight - request.cropY;
+
+        if (request.cropX < 0 || request.cropY < 0 || job.width <= 0 || job.height <= 0 ||
+            request.cropX + job.width > imageWidth || request.cropY + job.height > imageHeight)
+        {
+            throw std::invalid_argument("FrameRequest crop lies outside the image");
+        }
+        if (!request.hdrOutput && !request.rgbOutput)
+        {
+            throw std::invalid_argument("FrameRequest has no output buffer");
+        }
+
+        job.points = samplePoints(request, sceneData.renderMode);
+        job.rays = std::make_unique<CameraRayGenerator>(request.camera, job.points);
+
+        if (request.hdrOutput)
+        {
+            job.hdr = request.hdrOutput;
+        }
+        else
+        {
+            job.scratch.resize(static_cast<size_t>(job.width) * job.height * 3);
+            job.hdr = job.scratch.data();
+        }
+        size_t pixelCount = static_cast<size_t>(job.width) * job.height;
+        job.albedo = aovBuffer(request.albedoOutput, request.denoise, job.albedoScratch, pixelCount * 3);
+        job.normal = aovBuffer(request.normalOutput, request.denoise, job.normalScratch, pixelCount * 3);
+        job.depth = aovBuffer(request.depthOutput, request.denoise, job.depthScratch, pixelCount);
+        job.materialId = aovBuffer(request.materialIdOutput, request.denoise, job.materialIdScratch, pixelCount);
+        job.variance = aovBuffer(request.varianceOutput, request.denoise, job.varianceScratch, pixelCount);
+        job.aovs = job.albedo || job.normal || job.depth || job.materialId || job.variance;
+
+        // The general kernel compiles in every feature of the render mode and checks for each as it goes
+        RenderFeatures kernel = features(request);
+        if (!request.specialisedKernel)
+        {
+            kernel.multisample = kernel.secondaryRays = kernel.aovs = true;
+        }
+        job.renderRow = rowKernelFor(kernel);
+        firstRow[i + 1] = firstRow[i] + job.height;
+    }
+
+    // First pass: calculate HDR colors, with the rows of every frame sharing the threads
+    long long totalRows = static_cast<long long>(firstRow.back());
+#pragma omp parallel for schedule(dynamic)
+    for (long long row = 0; row < totalRows; ++row)
+    {
+        size_t jobIndex = std::upper_bound(firstRow.begin(), firstRow.end(), static_cast<size_t>(row)) - firstRow.begin() - 1;
+        const FrameJob &job = jobs[jobIndex];
+        int localY = static_cast<int>(row - firstRow[jobIndex]);
+        job.renderRow(*scenePtr, job, localY);
+    }
+
+    // Optional denoising pass, before tone mapping
+    for (const FrameJob &job : jobs)
+    {
+        if (job.request->denoise && sceneData.renderMode != RenderMode::BINARY)
+        {
+            // A single sample has no variance of its own; the denoiser then estimates it from the neighbours
+            const float *variance = job.points.size() > 1 ? job.variance : nullptr;
+            denoiseImage(job.hdr, variance, job.albedo, job.normal, job.depth, job.materialId, job.width, job.height);
+        }
+    }
+
+    // Second pass: convert each frame to 8-bit colors
+    for (const FrameJob &job : jobs)
+    {
+        if (job.request->rgbOutput)
+        {
+            bool toneMapped = job.request->applyToneMap && sceneData.renderMode != RenderMode::BINARY;
+            toneMapImage(job.hdr, job.width, job.height, toneMapped, job.request->camera.exposure,
+                         sceneData.backgroundColor, job.request->rgbOutput);
+        }
+    }
+}
+
+float Renderer::renderVisibility(const VisibilityRequest &request) const
+{
+    const SceneData &sceneData = scenePtr->data();
+    const BVHNode *root = scenePtr->bvh();
+    const Camera &camera = request.camera;
+    int imageWidth = camera.imageWidth();
+    int width = request.cropWidth > 0 ? request.cropWidth : imageWidth - request.cropX;
+    int height = request.cropHeight > 0 ? request.cropHeight : camera.imageHeight() - request.cropY;
+    if (request.cropX < 0 || request.cropY < 0 || width <= 0 || height <= 0 || request.cropX + width > imageWidth ||
+        request.cropY + height > camera.imageHeight())
+    {
+        throw std::invalid_argument("VisibilityRequest crop lies outside the image");
+    }
+    bool mask = request.mode == VisibilityMode::MASK, depth = request.mode == VisibilityMode::DEPTH;
+    if ((mask && !request.maskOutput) || (depth && !request.depthOutput) || (!mask && !depth && !request.idOutput))
+    {
+        throw std::invalid_argument("VisibilityRequest has no output buffer for its mode");
+    }
+
+    // Depths are kept as floats until the farthest hit is known
+    size_t rowBytes = (static_cast<size_t>(width) + 7) / 8;
+    std::vector<float> distances(depth ? static_cast<size_t>(width) * height : 0);
+    float farthest = 0.0f;
+    const CameraRayGenerator rays(camera, {{0.0f, 0.0f}}); // Through the pixel centers
+
+#pragma omp parallel for schedule(dynamic) reduction(max : farthest)
+    for (int localY = 0; localY < height; ++localY)
+    {
+        int y = request.cropY + localY;
+        if (mask)
+        {
+            std::fill_n(request.maskOutput + localY * rowBytes, rowBytes, 0);
+        }
+        forEachRayTile(rays, imageWidth - 1 - request.cropX, width, y, request.seed,
+                       [&](const CameraRayBlock &block, int column, int localX, std::minstd_rand &)
+        {
+            Ray ray = block.ray(block.index(column, 0, 0));
+            size_t pixel = static_cast<size_t>(localY) * width + localX;
+            if (mask)
+            {
+                if (traceAny(ray, sceneData, root))
+                {
+                    request.maskOutput[localY * rowBytes + localX / 8] |= static_cast<uint8_t>(0x80 >> (localX % 8));
+                }
+                return;
+            }
+
+            VisibilityHit closest;
+            bool hit = traceVisibility(ray, sceneData, root, closest);
+            if (depth)
+            {
+                distances[pixel] = hit ? closest.distance : 0.0f;
+                farthest = std::max(farthest, distances[pixel]);
+            }
+            else if (request.mode == VisibilityMode::OBJECT_ID)
+            {
+                request.idOutput[pixel] = hit ? closest.object->objectIdOf(closest.primitive) : 0;
+            }
+            else
+            {
+                request.idOutput[pixel] = hit ? closest.object->primitiveIdOf(closest.primitive) : 0;
+            }
+        });
+    }
+
+    // Hits map to 1 to 65535, so even the nearest differs from the background
+    float depthFar = request.depthFar > 0.0f ? request.depthFar : farthest;
+    if (depth)
+    {
+        float scale = depthFar > 0.0f ? 65535.0f / depthFar : 0.0f;
+        for (size_t i = 0; i < distances.size(); ++i)
+        {
+            request.depthOutput[i] = distances[i] > 0.0f ? static_cast<uint16_t>(std::clamp(distances[i] * scale + 0.5f, 1.0f, 65535.0f)) : 0;
+        }
+    }
+    return depthFar;
+}
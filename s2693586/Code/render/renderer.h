@@ -0,0 +1,162 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "../json_reader.h"       // SceneData and RenderMode
+#include "../camera/camera.h"     // Camera used to generate primary rays
+#include "../camera/camera_rays.h" // Primary rays generated a tile at a time
+#include "../geometry/geometry.h" // Geometric objects in the scene
+#include "../geometry/triangle_mesh.h" // Packed triangles of the low-memory mode
+#include "../bvh/bvh_node.h"      // BVH acceleration structure
+
+// A parsed scene together with its acceleration structure
+// A Scene is immutable once built, so one instance can be shared by any number of
+// renderers and frames, including frames rendered concurrently
+class Scene
+{
+public:
+    // Builds the scene from parsed scene data
+    // Parameters:
+    // - sceneData: Scene description (camera, lights, shapes, settings)
+    // - useBVH: Build a BVH over the shapes (deferring subtrees if sceneData.lazyBVHDepth is set);
+    //   otherwise rays test every shape. With sceneData.lowMemoryBits set, the static untextured
+    //   triangles are moved out of the scene data into a TriangleMesh, which the BVH holds as one shape.
+    //   With sceneData.spatialSplitBudget set, the BVH is built by SpatialSplitBVH, or else with
+    //   sceneData.mortonBits set by LinearBVH (neither defers subtrees).
+    //   With sceneData.bvhWidth above 2, the BVH is built in full and collapsed into a wide one
+    explicit Scene(SceneData sceneData, bool useBVH = true);
+
+    // Reads a scene JSON file and builds the scene from it
+    static std::shared_ptr<const Scene> load(const std::string &fileName, bool useBVH = true);
+
+    const SceneData &data() const { return sceneData; }
+
+    // Root of the BVH, or nullptr when the scene was built without one
+    const BVHNode *bvh() const { return root.get(); }
+
+    // Triangles packed in low-memory mode, or nullptr
+    const TriangleMesh *mesh() const { return triangleMesh.get(); }
+
+    // True if any shape's material is reflective or refractive, so Phong shading traces secondary rays
+    bool hasSecondaryRays() const { return secondaryRays; }
+
+private:
+    SceneData sceneData;
+    bool secondaryRays = false;
+    std::vector<std::shared_ptr<const Geometry>> geometries; // Shapes referenced by the BVH
+    std::shared_ptr<const TriangleMesh> triangleMesh;
+    std::unique_ptr<BVHNode> root;
+};
+
+// Describes one frame (or one region of a frame) to render
+// The crop is given in output image pixels; buffers hold cropWidth * cropHeight pixels,
+// row by row, with three values (RGB) per pixel. At least one buffer must be supplied.
+struct FrameRequest
+{
+    Camera camera;             // Camera and image resolution to render with
+    bool applyToneMap = false; // Tone map the 8-bit output
+    bool antialiasing = false; // Use 16 jittered samples per pixel
+    bool denoise = false;      // Filter the colors with the edge-aware denoiser before tone mapping
+    int samplesPerPixel = 0;   // Overrides the sample count (rounded down to a square number; 0 keeps the default)
+    unsigned int seed = 0;     // Seed for the antialiasing jitter and lens samples
+
+    int cropX = 0, cropY = 0;          // Top-left corner of the region to render
+    int cropWidth = 0, cropHeight = 0; // Size of the region (0 extends it to the image edge)
+
+    float *hdrOutput = nullptr;   // Optional linear colors before tone mapping
+    uint8_t *rgbOutput = nullptr; // Optional 8-bit colors, tone mapped if requested
+
+    // Optional auxiliary buffers (AOVs) describing the first surface seen through each pixel
+    float *albedoOutput = nullptr;        // Diffuse color averaged over the samples, 3 floats (1 for the background)
+    float *normalOutput = nullptr;        // Unit normal facing the camera, 3 floats (0 for the background)
+    float *depthOutput = nullptr;         // Mean hit distance along the camera rays, 1 float (0 for the background)
+    uint32_t *materialIdOutput = nullptr; // Material ID hit by the first sample (0 for the background)
+    float *varianceOutput = nullptr;      // Variance of the pixel's mean luminance over its samples, 1 float
+
+    bool specialisedKernel = true; // Render with the kernels compiled for the frame's features (false uses the
+                                   // general ones, which check every feature as they go, for comparisons)
+
+    explicit FrameRequest(const Camera &camera) : camera(camera) {}
+};
+
+// Features of a frame that select the kernels it is rendered with
+// Each combination has its own compiled pixel kernel, chosen once per frame, so a feature the frame lacks
+// costs no branches in it: a diffuse-only scene, for instance, shades without any reflection or refraction code
+struct RenderFeatures
+{
+    RenderMode mode = RenderMode::PHONG;
+    bool multisample = false;   // More than one sample per pixel
+    bool secondaryRays = false; // Phong shading of a scene with reflective or refractive materials
+    bool aovs = false;          // Auxiliary buffers are filled (requested, or needed by the denoiser)
+    bool lens = false;          // Depth of field: camera rays start across the aperture
+    bool toneMapped = false;    // The 8-bit output is tone mapped
+
+    // Short description such as "phong+aa+secondary", for reports
+    std::string name() const;
+};
+
+// Outputs of visibility-only renders, which trace one ray per pixel and do no shading
+enum class VisibilityMode
+{
+    MASK,        // 1 bit per pixel, set where any object is seen (found with any-hit rays)
+    DEPTH,       // 16 bits per pixel: distance to the closest hit, scaled so depthFar is 65535 (0 for the background)
+    OBJECT_ID,   // 32 bits per pixel: Geometry::objectIdOf of the closest hit (0 for the background)
+    PRIMITIVE_ID // 32 bits per pixel: Geometry::primitiveIdOf of the closest hit (0 for the background)
+};
+
+// Describes one visibility-only render (or one region of it)
+// The crop works as in FrameRequest. Buffers hold one value per pixel, row by row, except masks, which
+// pack 8 pixels per byte (most significant bit first) with each row starting on a new byte, as in PBM.
+struct VisibilityRequest
+{
+    Camera camera;                              // Camera and image resolution to render with
+    VisibilityMode mode = VisibilityMode::MASK; // Output to compute
+    unsigned int seed = 0;                      // Seed for the lens and shutter samples
+    float depthFar = 0.0f;                      // Distance stored as 65535 in depth outputs (0 uses the farthest hit in the region)
+
+    int cropX = 0, cropY = 0;          // Top-left corner of the region to render
+    int cropWidth = 0, cropHeight = 0; // Size of the region (0 extends it to the image edge)
+
+    uint8_t *maskOutput = nullptr;   // (cropWidth + 7) / 8 bytes per row for MASK
+    uint16_t *depthOutput = nullptr; // For DEPTH
+    uint32_t *idOutput = nullptr;    // For OBJECT_ID and PRIMITIVE_ID
+
+    explicit VisibilityRequest(const Camera &camera) : camera(camera) {}
+};
+
+// Renders frames of a shared scene into caller-provided buffers
+// render() does no file I/O and keeps no mutable state, so it may be called from several
+// threads at once; a batch of requests is also rendered in parallel internally
+class Renderer
+{
+public:
+    explicit Renderer(std::shared_ptr<const Scene> scene);
+
+    // Renders a single frame request
+    void render(const FrameRequest &request) const;
+
+    // Renders several frame requests, sharing the worker threads between them
+    // Throws std::invalid_argument if a request has an invalid crop or no output buffer
+    void render(const std::vector<FrameRequest> &requests) const;
+
+    // Renders a visibility-only request, tracing the rows in parallel
+    // Rays go through the pixel centers and only find what they hit, so no normal, material or shading is
+    // computed, and nothing is tone mapped
+    // Throws std::invalid_argument if the request has an invalid crop or lacks the buffer of its mode
+    // Returns: The distance stored as 65535 in depth outputs (depthFar, or the farthest hit when it is 0)
+    float renderVisibility(const VisibilityRequest &request) const;
+
+    // Features the kernels of a frame request are selected by
+    RenderFeatures features(const FrameRequest &request) const;
+
+    const Scene &scene() const { return *scenePtr; }
+
+private:
+    std::shared_ptr<const Scene> scenePtr;
+};
+
+#endif // RENDERER_H
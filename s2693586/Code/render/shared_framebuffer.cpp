@@ -0,0 +1,173 @@
+#include "shared_framebuffer.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "The frame sequence must be lock-free to be shared between processes");
+
+// Pixels start on a cache line of their own
+static constexpr size_t HEADER_BYTES = (sizeof(SharedFrameHeader) + 63) / 64 * 64;
+
+SharedFramebuffer::SharedFramebuffer(const std::string &name) : segmentName(name)
+{
+    if (name.size() < 2 || name[0] != '/' || name.find('/', 1) != std::string::npos)
+    {
+        std::cerr << "Invalid shared-memory name (expected /<name>): " << name << std::endl;
+        throw std::runtime_error("Invalid shared-memory name: " + name);
+    }
+    shm_unlink(name.c_str());
+    fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        std::cerr << "Cannot create shared memory " << name << ": " << std::strerror(errno) << std::endl;
+        throw std::runtime_error("Cannot create shared memory: " + name);
+    }
+    map(0);
+    SharedFrameHeader *frame = new (mapping) SharedFrameHeader(); // Zeroed, with no frame published
+    frame->headerBytes = HEADER_BYTES;
+    std::atomic_thread_fence(std::memory_order_release);
+    frame->magic = SharedFrameHeader::MAGIC;
+}
+
+SharedFramebuffer::~SharedFramebuffer()
+{
+    if (mapping)
+    {
+        munmap(mapping, mappedBytes);
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+        shm_unlink(segmentName.c_str());
+    }
+}
+
+void SharedFramebuffer::map(uint64_t capacity)
+{
+    size_t bytes = HEADER_BYTES + capacity;
+    if (mapping)
+    {
+        munmap(mapping, mappedBytes);
+        mapping = nullptr;
+    }
+    if (ftruncate(fd, static_cast<off_t>(bytes)) != 0)
+    {
+        std::cerr << "Cannot resize shared memory " << segmentName << ": " << std::strerror(errno) << std::endl;
+        throw std::runtime_error("Cannot resize shared memory: " + segmentName);
+    }
+    void *address = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED)
+    {
+        std::cerr << "Cannot map shared memory " << segmentName << ": " << std::strerror(errno) << std::endl;
+        throw std::runtime_error("Cannot map shared memory: " + segmentName);
+    }
+    mapping = address;
+    mappedBytes = bytes;
+}
+
+uint64_t SharedFramebuffer::publish(const uint8_t *rgb, int width, int height, int scale, uint32_t generation, double elapsedMs)
+{
+    uint64_t bytes = static_cast<uint64_t>(width) * height * 3;
+    if (bytes > header()->capacity)
+    {
+        // Viewers re-map the segment once they find it larger than their mapping
+        map(bytes);
+        header()->capacity = bytes;
+    }
+
+    SharedFrameHeader &frame = *header();
+    uint64_t sequence = frame.sequence.load(std::memory_order_relaxed) + 1;
+    frame.sequence.store(sequence, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    frame.width = width;
+    frame.height = height;
+    frame.scale = scale;
+    frame.generation = generation;
+    frame.elapsedMs = elapsedMs;
+    std::memcpy(static_cast<uint8_t *>(mapping) + HEADER_BYTES, rgb, bytes);
+
+    frame.sequence.store(sequence + 1, std::memory_order_release);
+    return sequence + 1;
+}
+
+bool SharedFramebuffer::read(const std::string &name, SharedFrame &frame)
+{
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    bool complete = false;
+    void *mapping = MAP_FAILED;
+    size_t mappedBytes = 0;
+    for (int attempt = 0; attempt < 1000 && !complete; ++attempt)
+    {
+        // Map the whole segment, again if the writer grew it since the last attempt
+        struct stat status;
+        if (fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < HEADER_BYTES)
+        {
+            break;
+        }
+        if (mapping != MAP_FAILED && mappedBytes != static_cast<size_t>(status.st_size))
+        {
+            munmap(mapping, mappedBytes);
+            mapping = MAP_FAILED;
+        }
+        if (mapping == MAP_FAILED)
+        {
+            mappedBytes = status.st_size;
+            mapping = mmap(nullptr, mappedBytes, PROT_READ, MAP_SHARED, fd, 0);
+            if (mapping == MAP_FAILED)
+            {
+                break;
+            }
+        }
+        const SharedFrameHeader &header = *static_cast<const SharedFrameHeader *>(mapping);
+        if (header.magic != SharedFrameHeader::MAGIC)
+        {
+            break;
+        }
+
+        uint64_t before = header.sequence.load(std::memory_order_acquire);
+        if (before == 0)
+        {
+            break; // Nothing published yet
+        }
+        if (before % 2 == 1)
+        {
+            std::this_thread::yield(); // The writer is mid-frame
+            continue;
+        }
+        frame.sequence = before;
+        frame.width = header.width;
+        frame.height = header.height;
+        frame.scale = header.scale;
+        frame.generation = header.generation;
+        frame.elapsedMs = header.elapsedMs;
+        size_t bytes = static_cast<size_t>(frame.width) * frame.height * 3;
+        if (header.headerBytes + bytes > mappedBytes)
+        {
+            continue; // Grown since it was mapped
+        }
+        frame.rgb.resize(bytes);
+        std::memcpy(frame.rgb.data(), static_cast<const uint8_t *>(mapping) + header.headerBytes, bytes);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        complete = header.sequence.load(std::memory_order_relaxed) == before;
+    }
+
+    if (mapping != MAP_FAILED)
+    {
+        munmap(mapping, mappedBytes);
+    }
+    close(fd);
+    return complete;
+}
@@ -0,0 +1,87 @@
+#ifndef SHARED_FRAMEBUFFER_H
+#define SHARED_FRAMEBUFFER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// An 8-bit RGB image published in a POSIX shared-memory segment, for viewers in other processes
+// The segment starts with a SharedFrameHeader and is followed by the pixels, row by row. The writer
+// makes the sequence odd before it changes the frame and even again once the frame is complete, so a
+// viewer copies the frame between two equal, even reads of the sequence (a sequence lock) and never
+// blocks the writer. The segment grows when the resolution does; viewers re-map it when capacity
+// exceeds the size they mapped.
+struct SharedFrameHeader
+{
+    static constexpr uint32_t MAGIC = 0x42465452; // "RTFB" in little-endian bytes
+
+    uint32_t magic;                 // MAGIC once the header is valid
+    uint32_t headerBytes;           // Offset of the pixels from the start of the segment
+    std::atomic<uint64_t> sequence; // Odd while the frame is being written; advances by 2 per frame
+    uint64_t capacity;              // Pixel bytes the segment holds
+    uint32_t width, height;         // Image size in pixels
+    uint32_t scale;                 // Image pixels per rendered pixel along each axis (1 at full resolution)
+    uint32_t generation;            // Scene loads so far; changes when the scene is edited
+    double elapsedMs;               // Time from the scene change to this frame
+};
+
+// A frame copied out of a shared framebuffer
+struct SharedFrame
+{
+    uint64_t sequence = 0;
+    int width = 0, height = 0;
+    int scale = 0;
+    uint32_t generation = 0;
+    double elapsedMs = 0.0;
+    std::vector<uint8_t> rgb; // width * height * 3 bytes
+};
+
+// Writer side of a shared framebuffer
+class SharedFramebuffer
+{
+public:
+    // Creates the segment, replacing any left by an earlier writer of the same name
+    // Parameters:
+    // - name: POSIX shared-memory name, starting with '/' (e.g. "/raytracer")
+    // Throws std::runtime_error if the segment cannot be created or mapped
+    explicit SharedFramebuffer(const std::string &name);
+
+    // Unmaps and removes the segment
+    ~SharedFramebuffer();
+
+    SharedFramebuffer(const SharedFramebuffer &) = delete;
+    SharedFramebuffer &operator=(const SharedFramebuffer &) = delete;
+
+    // Copies a complete frame into the segment, growing it first if needed
+    // Parameters:
+    // - rgb: width * height * 3 bytes
+    // - width, height: Image size
+    // - scale: Image pixels per rendered pixel along each axis
+    // - generation: Scene load the frame belongs to
+    // - elapsedMs: Time from the scene change to this frame
+    // Returns: The sequence number of the published frame
+    uint64_t publish(const uint8_t *rgb, int width, int height, int scale, uint32_t generation, double elapsedMs);
+
+    // Copies the latest complete frame of a segment, as a viewer would
+    // Parameters:
+    // - name: Shared-memory name the writer was created with
+    // - frame: Receives the frame
+    // Returns: false if the segment does not exist or holds no complete frame yet
+    static bool read(const std::string &name, SharedFrame &frame);
+
+    const std::string &name() const { return segmentName; }
+
+private:
+    std::string segmentName;
+    int fd = -1;
+    void *mapping = nullptr;
+    size_t mappedBytes = 0;
+
+    SharedFrameHeader *header() const { return static_cast<SharedFrameHeader *>(mapping); }
+
+    // Resizes the segment to hold the given pixel bytes and maps all of it
+    void map(uint64_t capacity);
+};
+
+#endif // SHARED_FRAMEBUFFER_H
@@ -1,6 +1,9 @@
 #include "blinn_phong.h"
 #include <cmath>
 #include <algorithm>
+#include "../texture/texture_cache.h" // Texture sampling for textured materials
+#include "light_sampling.h"            // Stratified area light samples
+#include "ray_tree_stats.h"            // Counters of traced and pruned secondary rays
 
 // Function to calculate Fresnel reflection using Schlick's approximation
 // Parameters:
@@ -51,18 +54,38 @@ bool calculateRefraction(const Vector3 &incident, const Vector3 &normal, float e
     }
 }
 
+// Returns the diffuse color at an intersection, sampling the material's texture if it has one
+Vector3 diffuseColorAt(const Intersection &intersection, const Ray &ray)
+{
+    const Material &material = intersection.material;
+    if (!material.texture || !intersection.object)
+    {
+        return material.diffuseColor;
+    }
+
+    // Texture coordinates are only computed here, for textured materials
+    TextureCoordinates uv = intersection.object->textureCoordinates(intersection.point, ray.time);
+    float footprint = (ray.coneWidth + ray.coneAngle * intersection.distance) / uv.scale; // Pixel size in texture space
+    return material.diffuseColor * TextureCache::global().sample(*material.texture, uv.u, uv.v, footprint);
+}
+
 // Function to perform Blinn-Phong shading
 // Parameters:
 // - intersection: Information about the intersection point
 // - ray: The ray that hit the object
 // - lights: A list of light sources in the scene
 // - spheres, cylinders, triangles: Geometric objects in the scene
+// - particles: Particle sets in the scene
 // - nbounces: Number of remaining recursion bounces for reflections/refractions
 // - backgroundColor: The color to return if no intersection occurs
+// - weight: Share of the pixel color this shading point contributes
+// - minWeight: Reflection and refraction rays weighted below this are not traced
 // Returns: The calculated color at the intersection point
+template <bool SecondaryRays>
 Vector3 blinnPhongShading(const Intersection &intersection, const Ray &ray, const std::vector<Light> &lights,
                           const std::vector<Sphere> &spheres, const std::vector<Cylinder> &cylinders, const std::vector<Triangle> &triangles,
-                          int nbounces, Vector3 backgroundColor)
+                          const std::vector<std::shared_ptr<const ParticleSet>> &particles, int nbounces, Vector3 backgroundColor,
+                          float weight, float minWeight)
 {
     if (nbounces <= 0) // Terminate recursion when bounce limit is reached
     {
@@ -70,95 +93,132 @@ Vector3 blinnPhongShading(const Intersection &intersection, const Ray &ray, cons
     }
 
     const Material &material = intersection.material; // Material properties of the hit object
+    Vector3 diffuseColor = diffuseColorAt(intersection, ray); // Diffuse color, textured if the material has a texture
     Vector3 normal = intersection.normal;             // Surface normal at the intersection point
     Vector3 viewDir = (-ray.direction).normalize();   // View direction (towards the camera)
     Vector3 color(0.0f, 0.0f, 0.0f);                  // Initialize color to black
     const float epsilon = 0.0001f;                    // Offset to avoid self-intersections
 
     // Blinn-Phong shading for direct illumination
+    std::minstd_rand lightRng = lightSampleGenerator(intersection.point); // Jitter for area light samples
     for (const auto &light : lights)
     {
-        Vector3 lightDir = (light.position - intersection.point).normalize();   // Direction to the light source
-        float distanceToLight = (light.position - intersection.point).length(); // Distance to the light source
-        Vector3 shadowOrigin = intersection.point + normal * epsilon;           // Offset origin to avoid self-intersection
-        Ray shadowRay(shadowOrigin, lightDir);
-
-        bool inShadow = false; // Check for shadowing
-        // Test for shadows caused by spheres
-        for (const auto &sphere : spheres)
+        // Each sample point acts as a point light with an equal share of the intensity
+        int sampleCount = lightSampleCount(light);
+        float sampleWeight = 1.0f / sampleCount;
+        for (int sample = 0; sample < sampleCount; ++sample)
         {
-            Intersection shadowIntersection = sphere.intersect(shadowRay);
-            if (shadowIntersection.hit && shadowIntersection.distance < distanceToLight)
+            Vector3 lightPosition = lightSamplePoint(light, sample, sampleCount, intersection.point, lightRng);
+            Vector3 lightDir = (lightPosition - intersection.point).normalize();   // Direction to the light source
+            float distanceToLight = (lightPosition - intersection.point).length(); // Distance to the light source
+            Vector3 shadowOrigin = intersection.point + normal * epsilon;          // Offset origin to avoid self-intersection
+            Ray shadowRay(shadowOrigin, lightDir, ray.time);
+
+            // Check for shadowing; the first blocker found ends the search
+            bool inShadow = false;
+            // Test for shadows caused by spheres
+            for (const auto &sphere : spheres)
             {
-                inShadow = true;
-                break;
+                Intersection shadowIntersection = sphere.intersect(shadowRay);
+                if (shadowIntersection.hit && shadowIntersection.distance < distanceToLight)
+                {
+                    inShadow = true;
+                    break;
+                }
             }
-        }
-        // Test for shadows caused by cylinders
-        for (const auto &cylinder : cylinders)
-        {
-            Intersection shadowIntersection = cylinder.intersect(shadowRay);
-            if (shadowIntersection.hit && shadowIntersection.distance < distanceToLight)
+            // Test for shadows caused by cylinders
+            for (size_t i = 0; !inShadow && i < cylinders.size(); ++i)
             {
-                inShadow = true;
-                break;
+                Intersection shadowIntersection = cylinders[i].intersect(shadowRay);
+                if (shadowIntersection.hit && shadowIntersection.distance < distanceToLight)
+                {
+                    inShadow = true;
+                }
             }
-        }
-        // Test for shadows caused by triangles
-        for (const auto &triangle : triangles)
-        {
-            Intersection shadowIntersection = triangle.intersect(shadowRay);
-            if (shadowIntersection.hit && shadowIntersection.distance < distanceToLight)
+            // Test for shadows caused by triangles
+            for (size_t i = 0; !inShadow && i < triangles.size(); ++i)
             {
-                inShadow = true;
-                break;
+                Intersection shadowIntersection = triangles[i].intersect(shadowRay);
+                if (shadowIntersection.hit && shadowIntersection.distance < distanceToLight)
+                {
+                    inShadow = true;
+                }
+            }
+            // Test for shadows caused by particles
+            for (size_t i = 0; !inShadow && i < particles.size(); ++i)
+            {
+                Intersection shadowIntersection = particles[i]->intersect(shadowRay);
+                if (shadowIntersection.hit && shadowIntersection.distance < distanceToLight)
+                {
+                    inShadow = true;
+                }
             }
-        }
 
-        // Calculate attenuation based on distance to light
-        float k1 = 0.1f;  // Linear attenuation coefficient
-        float k2 = 0.01f; // Quadratic attenuation coefficient
-        float attenuation = 1.0f / (1.0f + k1 * distanceToLight + k2 * distanceToLight * distanceToLight);
-        Vector3 effectiveLightIntensity = light.intensity * attenuation;
-        // Calculate ambient lighting
-        Vector3 ambient = material.kd * material.diffuseColor * effectiveLightIntensity;
+            // Calculate attenuation based on distance to light
+            float k1 = 0.1f;  // Linear attenuation coefficient
+            float k2 = 0.01f; // Quadratic attenuation coefficient
+            float attenuation = 1.0f / (1.0f + k1 * distanceToLight + k2 * distanceToLight * distanceToLight);
+            Vector3 effectiveLightIntensity = light.intensity * (attenuation * sampleWeight);
+            // Calculate ambient lighting
+            Vector3 ambient = material.kd * diffuseColor * effectiveLightIntensity;
 
-        if (inShadow) // Add only ambient lighting if in shadow
-        {
-            color += ambient;
-            continue;
-        }
+            if (inShadow) // Add only ambient lighting if in shadow
+            {
+                color += ambient;
+                continue;
+            }
+
+            // Normalize the vectors for correct Blinn-Phong calculations
+            Vector3 viewDirNormalized = viewDir.normalize();
+            Vector3 lightDirNormalized = lightDir.normalize();
 
-        // Normalize the vectors for correct Blinn-Phong calculations
-        Vector3 viewDirNormalized = viewDir.normalize();
-        Vector3 lightDirNormalized = lightDir.normalize();
+            // Calculate the diffuse component
+            float diff = std::max(normal.dot(lightDirNormalized), 0.0f);
+            Vector3 diffuse = material.kd * diff * diffuseColor * effectiveLightIntensity;
 
-        // Calculate the diffuse component
-        float diff = std::max(normal.dot(lightDirNormalized), 0.0f);
-        Vector3 diffuse = material.kd * diff * material.diffuseColor * effectiveLightIntensity;
+            // Calculate the halfway vector for Blinn-Phong specular highlights
+            Vector3 halfDir = (viewDirNormalized + lightDirNormalized).normalize();
+            float spec = std::pow(std::max(normal.dot(halfDir), 0.0f), material.specularExponent);
+            Vector3 specular = material.ks * spec * material.specularColor * effectiveLightIntensity;
 
-        // Calculate the halfway vector for Blinn-Phong specular highlights
-        Vector3 halfDir = (viewDirNormalized + lightDirNormalized).normalize();
-        float spec = std::pow(std::max(normal.dot(halfDir), 0.0f), material.specularExponent);
-        Vector3 specular = material.ks * spec * material.specularColor * effectiveLightIntensity;
+            // Accumulate the lighting components
+            color += ambient + diffuse + specular;
+        }
+    }
 
-        // Accumulate the lighting components
-        color += ambient + diffuse + specular;
+    // Without reflective or refractive materials in the scene, the direct light is the whole color
+    if constexpr (!SecondaryRays)
+    {
+        return color.clamp(0.0f, 1.0f);
     }
 
+    // Weights of the secondary rays, the most each can change the pixel by (see blinnPhongShadingBVH)
+    float fresnelReflectance = material.isRefractive ? fresnelSchlick(std::abs(viewDir.dot(normal)), material.refractiveIndex) : 0.0f;
+    float reflectionWeight = weight * material.reflectivity * (material.reflectivity + fresnelReflectance);
+    float refractionWeight = weight * (1.0f - fresnelReflectance) * (1.0f - material.reflectivity);
+
     // Reflection component
     Vector3 reflectionColor = backgroundColor;
     if (material.isReflective && nbounces > 0)
     {
+        bool traceReflection = reflectionWeight >= minWeight; // Pruned rays keep the background color
+        RayTreeStats::record(material.id, false, !traceReflection);
+
         Vector3 reflectionDir = (ray.direction - normal * 2.0f * ray.direction.dot(normal)).normalize();
         Vector3 reflectionOrigin = intersection.point + normal * epsilon; // Offset to avoid self-intersection
-        Ray reflectionRay(reflectionOrigin, reflectionDir);
+        Ray reflectionRay(reflectionOrigin, reflectionDir, ray.time);
+        reflectionRay.inheritCone(ray, intersection.distance);
 
-        Intersection closestReflectionIntersection = findClosestIntersection(reflectionRay, spheres, cylinders, triangles);
+        Intersection closestReflectionIntersection;
+        if (traceReflection)
+        {
+            closestReflectionIntersection = findClosestIntersection(reflectionRay, spheres, cylinders, triangles, particles);
+        }
 
         if (closestReflectionIntersection.hit)
         {
-            reflectionColor = blinnPhongShading(closestReflectionIntersection, reflectionRay, lights, spheres, cylinders, triangles, nbounces - 1, backgroundColor);
+            reflectionColor = blinnPhongShading(closestReflectionIntersection, reflectionRay, lights, spheres, cylinders, triangles, particles, nbounces - 1,
+                                                backgroundColor, reflectionWeight, minWeight);
         }
 
         // Scale reflection color by reflectivity
@@ -174,17 +234,25 @@ Vector3 blinnPhongShading(const Intersection &intersection, const Ray &ray, cons
     if (material.isRefractive && nbounces > 0)
     {
         Vector3 refractionDir;
-        float fresnelReflectance = fresnelSchlick(std::abs(viewDir.dot(normal)), material.refractiveIndex);
         if (calculateRefraction(ray.direction, normal, material.refractiveIndex, refractionDir))
         {
+            bool traceRefraction = refractionWeight >= minWeight; // Pruned rays keep the background color
+            RayTreeStats::record(material.id, true, !traceRefraction);
+
             Vector3 refractionOrigin = refractionDir.dot(normal) < 0 ? intersection.point - normal * epsilon : intersection.point + normal * epsilon; // Offset slightly to avoid self-intersection
-            Ray refractionRay(refractionOrigin, refractionDir.normalize());
+            Ray refractionRay(refractionOrigin, refractionDir.normalize(), ray.time);
+            refractionRay.inheritCone(ray, intersection.distance);
 
-            Intersection closestRefractionIntersection = findClosestIntersection(refractionRay, spheres, cylinders, triangles);
+            Intersection closestRefractionIntersection;
+            if (traceRefraction)
+            {
+                closestRefractionIntersection = findClosestIntersection(refractionRay, spheres, cylinders, triangles, particles);
+            }
 
             if (closestRefractionIntersection.hit)
             {
-                refractionColor = blinnPhongShading(closestRefractionIntersection, refractionRay, lights, spheres, cylinders, triangles, nbounces - 1, backgroundColor);
+                refractionColor = blinnPhongShading(closestRefractionIntersection, refractionRay, lights, spheres, cylinders, triangles, particles, nbounces - 1,
+                                                    backgroundColor, refractionWeight, minWeight);
             }
             else
             {
@@ -199,3 +267,10 @@ Vector3 blinnPhongShading(const Intersection &intersection, const Ray &ray, cons
 
     return color.clamp(0.0f, 1.0f);
 }
+
+template Vector3 blinnPhongShading<true>(const Intersection &, const Ray &, const std::vector<Light> &, const std::vector<Sphere> &,
+                                         const std::vector<Cylinder> &, const std::vector<Triangle> &,
+                                         const std::vector<std::shared_ptr<const ParticleSet>> &, int, Vector3, float, float);
+template Vector3 blinnPhongShading<false>(const Intersection &, const Ray &, const std::vector<Light> &, const std::vector<Sphere> &,
+                                          const std::vector<Cylinder> &, const std::vector<Triangle> &,
+                                          const std::vector<std::shared_ptr<const ParticleSet>> &, int, Vector3, float, float);
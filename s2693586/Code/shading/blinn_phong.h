@@ -8,7 +8,7 @@
 #include "../camera/light.h"            // Defines the Light structure
 #include "../material/material.h"       // Material properties such as diffuse, specular, and reflectivity
 #include "../bvh/bvh_node.h"            // BVHNode definitions for acceleration structures
-#include "../geometry/intersection.cpp" // For calculating intersections between rays and objects
+#include "../geometry/intersection.h"   // For calculating intersections between rays and objects
 
 // Calculates the Fresnel effect using Schlick's approximation
 // Parameters:
@@ -26,28 +26,38 @@ float fresnelSchlick(float cosTheta, float refractiveIndex);
 // Returns: True if refraction is successful, false otherwise
 bool calculateRefraction(const Vector3 &incident, const Vector3 &normal, float eta, Vector3 &refractionDir);
 
-// Finds the closest intersection of a ray with geometric objects in the scene
+// Returns the diffuse color at an intersection, multiplied by the material's texture if it has one
 // Parameters:
-// - ray: The input ray
-// - spheres, cylinders, triangles: Lists of geometric objects in the scene
-// Returns: The closest intersection point or a default intersection if no hit occurs
-Intersection findClosestIntersection(const Ray &ray, const std::vector<Sphere> &spheres,
-                                     const std::vector<Cylinder> &cylinders, const std::vector<Triangle> &triangles);
+// - intersection: The intersection point details
+// - ray: The ray that hit the point; its cone selects the texture's mip level
+// Returns: The diffuse color to shade with
+Vector3 diffuseColorAt(const Intersection &intersection, const Ray &ray);
 
 // Implements the Blinn-Phong shading model without BVH acceleration
+// Template parameters:
+// - SecondaryRays: Trace reflection and refraction rays; false compiles the shading without them, for
+//   scenes with no reflective or refractive material
 // Parameters:
 // - intersection: The intersection point details
 // - ray: The incoming ray
 // - lights: List of lights in the scene
 // - spheres, cylinders, triangles: Lists of geometric objects
+// - particles: Particle sets
 // - nbounces: Number of allowed recursive bounces for reflection/refraction
 // - backgroundColor: The color of the background for unhit rays
+// - weight: Share of the final pixel color this point contributes (1 for camera rays)
+// - minWeight: Reflection and refraction rays whose weight falls below this are not traced and
+//   take the background color instead, as if out of bounces (0 traces every ray)
 // Returns: The computed color for the given intersection point
+template <bool SecondaryRays = true>
 Vector3 blinnPhongShading(const Intersection &intersection, const Ray &ray, const std::vector<Light> &lights,
                           const std::vector<Sphere> &spheres, const std::vector<Cylinder> &cylinders,
-                          const std::vector<Triangle> &triangles, int nbounces, Vector3 backgroundColor);
+                          const std::vector<Triangle> &triangles, const std::vector<std::shared_ptr<const ParticleSet>> &particles,
+                          int nbounces, Vector3 backgroundColor, float weight = 1.0f, float minWeight = 0.0f);
 
 // Implements the Blinn-Phong shading model using BVH acceleration
+// Template parameters:
+// - SecondaryRays: As for blinnPhongShading
 // Parameters:
 // - intersection: The intersection point details
 // - ray: The incoming ray
@@ -55,8 +65,11 @@ Vector3 blinnPhongShading(const Intersection &intersection, const Ray &ray, cons
 // - root: Pointer to the root of the BVH tree
 // - nbounces: Number of allowed recursive bounces for reflection/refraction
 // - backgroundColor: The color of the background for unhit rays
+// - weight: Share of the final pixel color this point contributes (1 for camera rays)
+// - minWeight: Reflection and refraction rays whose weight falls below this are not traced (0 traces every ray)
 // Returns: The computed color for the given intersection point
+template <bool SecondaryRays = true>
 Vector3 blinnPhongShadingBVH(const Intersection &intersection, const Ray &ray, const std::vector<Light> &lights,
-                             const BVHNode *root, int nbounces, const Vector3 &backgroundColor);
+                             const BVHNode *root, int nbounces, const Vector3 &backgroundColor, float weight = 1.0f, float minWeight = 0.0f);
 
 #endif // BLINN_PHONG_H
@@ -1,6 +1,10 @@
 #include "blinn_phong.h"
 #include <cmath>
 #include <algorithm>
+#include <limits>
+#include "light_sampling.h" // Stratified area light samples
+#include "../bvh/shadow_cache.h" // Last-occluder cache for shadow rays
+#include "ray_tree_stats.h"       // Counters of traced and pruned secondary rays
 
 // Function to perform Blinn-Phong shading using a BVH acceleration structure
 // Parameters:
@@ -10,8 +14,12 @@
 // - root: The root node of the BVH acceleration structure
 // - nbounces: Remaining recursion depth for reflections/refractions
 // - backgroundColor: The color to return if no further intersections occur
+// - weight: Share of the pixel color this shading point contributes
+// - minWeight: Reflection and refraction rays weighted below this are not traced
 // Returns: The computed color for the intersection point
-Vector3 blinnPhongShadingBVH(const Intersection &intersection, const Ray &ray, const std::vector<Light> &lights, const BVHNode *root, int nbounces, const Vector3 &backgroundColor)
+template <bool SecondaryRays>
+Vector3 blinnPhongShadingBVH(const Intersection &intersection, const Ray &ray, const std::vector<Light> &lights, const BVHNode *root, int nbounces,
+                             const Vector3 &backgroundColor, float weight, float minWeight)
 {
     // Terminate recursion if the maximum depth is reached
     if (nbounces <= 0)
@@ -20,70 +28,102 @@ Vector3 blinnPhongShadingBVH(const Intersection &intersection, const Ray &ray, c
     }
     // Material and geometric properties of the intersected object
     const Material &material = intersection.material;
+    Vector3 diffuseColor = diffuseColorAt(intersection, ray); // Diffuse color, textured if the material has a texture
     Vector3 normal = intersection.normal;           // Surface normal at the intersection point
     Vector3 viewDir = (-ray.direction).normalize(); // Direction toward the viewer
     Vector3 color(0.0f, 0.0f, 0.0f);                // Initialize the resulting color to black
     const float epsilon = 0.001f;                   // Offset to avoid self-intersections
 
     // Step 1: Direct Illumination using Blinn-Phong Model
-    for (const auto &light : lights)
+    std::minstd_rand lightRng = lightSampleGenerator(intersection.point); // Jitter for area light samples
+    for (size_t lightIndex = 0; lightIndex < lights.size(); ++lightIndex)
     {
-        // Compute the direction and distance to the light source
-        Vector3 lightDir = (light.position - intersection.point).normalize();
-        float distanceToLight = (light.position - intersection.point).length();
-        Vector3 shadowOrigin = intersection.point + normal * epsilon; // Offset to prevent self-shadowing
-        Ray shadowRay(shadowOrigin, lightDir);
-
-        // Use BVH to check if the point is in shadow
-        Intersection shadowIntersection;
-        bool inShadow = root->intersectShadowRay(shadowRay, distanceToLight);
-
-        // Calculate attenuation based on distance to light
-        float k1 = 0.1f;  // Linear attenuation coefficient
-        float k2 = 0.01f; // Quadratic attenuation coefficient
-        float attenuation = 1.0f / (1.0f + k1 * distanceToLight + k2 * distanceToLight * distanceToLight);
-        Vector3 effectiveLightIntensity = light.intensity * attenuation;
-
-        // Compute ambient lighting
-        Vector3 ambient = material.kd * material.diffuseColor * effectiveLightIntensity;
-
-        // If the point is in shadow, only add the ambient light
-        if (inShadow)
+        const Light &light = lights[lightIndex];
+        // Each sample point acts as a point light with an equal share of the intensity
+        int sampleCount = lightSampleCount(light);
+        float sampleWeight = 1.0f / sampleCount;
+        for (int sample = 0; sample < sampleCount; ++sample)
         {
-            color += ambient; // Add ambient light only if in shadow
-            continue;
-        }
+            // Compute the direction and distance to the light sample
+            Vector3 lightPosition = lightSamplePoint(light, sample, sampleCount, intersection.point, lightRng);
+            Vector3 lightDir = (lightPosition - intersection.point).normalize();
+            float distanceToLight = (lightPosition - intersection.point).length();
+            Vector3 shadowOrigin = intersection.point + normal * epsilon; // Offset to prevent self-shadowing
+            Ray shadowRay(shadowOrigin, lightDir, ray.time);
+
+            // Use BVH to check if the point is in shadow (any hit ends the traversal), trying the
+            // light's last occluder first
+            bool inShadow = ShadowCache::occluded(*root, shadowRay, distanceToLight, lightIndex);
+
+            // Calculate attenuation based on distance to light
+            float k1 = 0.1f;  // Linear attenuation coefficient
+            float k2 = 0.01f; // Quadratic attenuation coefficient
+            float attenuation = 1.0f / (1.0f + k1 * distanceToLight + k2 * distanceToLight * distanceToLight);
+            Vector3 effectiveLightIntensity = light.intensity * (attenuation * sampleWeight);
+
+            // Compute ambient lighting
+            Vector3 ambient = material.kd * diffuseColor * effectiveLightIntensity;
+
+            // If the point is in shadow, only add the ambient light
+            if (inShadow)
+            {
+                color += ambient; // Add ambient light only if in shadow
+                continue;
+            }
+
+            // Diffuse component
+            float diff = std::max(normal.dot(lightDir), 0.0f); // Dot product for diffuse intensity
+            Vector3 diffuse = material.kd * diff * diffuseColor * effectiveLightIntensity;
 
-        // Diffuse component
-        float diff = std::max(normal.dot(lightDir), 0.0f); // Dot product for diffuse intensity
-        Vector3 diffuse = material.kd * diff * material.diffuseColor * effectiveLightIntensity;
+            // Specular component
+            Vector3 halfDir = (viewDir + lightDir).normalize(); // Halfway vector
+            float spec = std::pow(std::max(normal.dot(halfDir), 0.0f), material.specularExponent);
+            Vector3 specular = material.ks * spec * material.specularColor * effectiveLightIntensity;
 
-        // Specular component
-        Vector3 halfDir = (viewDir + lightDir).normalize(); // Halfway vector
-        float spec = std::pow(std::max(normal.dot(halfDir), 0.0f), material.specularExponent);
-        Vector3 specular = material.ks * spec * material.specularColor * effectiveLightIntensity;
+            // Accumulate lighting contributions
+            color += ambient + diffuse + specular;
+        }
+    }
 
-        // Accumulate lighting contributions
-        color += ambient + diffuse + specular;
+    // Without reflective or refractive materials in the scene, the direct light is the whole color
+    if constexpr (!SecondaryRays)
+    {
+        return color.clamp(0.0f, 1.0f);
     }
 
+    // Weights of the secondary rays: their colors are clamped to [0, 1], so a ray can change the pixel
+    // by at most its weight. The reflection is scaled by the reflectivity twice (and, on glass, also
+    // by the Fresnel reflectance); the refraction by the Fresnel transmittance and 1 - reflectivity.
+    float fresnelReflectance = material.isRefractive ? fresnelSchlick(std::abs(viewDir.dot(normal)), material.refractiveIndex) : 0.0f;
+    float reflectionWeight = weight * material.reflectivity * (material.reflectivity + fresnelReflectance);
+    float refractionWeight = weight * (1.0f - fresnelReflectance) * (1.0f - material.reflectivity);
+
     // Step 2: Reflection Component
     Vector3 reflectionColor(0.0f, 0.0f, 0.0f);
 
     if (material.isReflective)
     {
+        bool traceReflection = reflectionWeight >= minWeight;
+        RayTreeStats::record(material.id, false, !traceReflection);
+
         // Compute reflection direction using the surface normal
         Vector3 reflectionDir = (ray.direction - normal * 2.0f * ray.direction.dot(normal)).normalize();
         Vector3 reflectionOrigin = intersection.point + normal * epsilon;
-        Ray reflectionRay(reflectionOrigin, reflectionDir);
+        Ray reflectionRay(reflectionOrigin, reflectionDir, ray.time);
+        reflectionRay.inheritCone(ray, intersection.distance);
 
         // Check for the closest intersection along the reflection ray
         Intersection closestReflectionIntersection;
         closestReflectionIntersection.distance = std::numeric_limits<float>::max();
-        if (root->intersect(reflectionRay, closestReflectionIntersection))
+        if (!traceReflection)
+        {
+            reflectionColor = backgroundColor; // Pruned: treated like a ray that has run out of bounces
+        }
+        else if (root->intersect(reflectionRay, closestReflectionIntersection))
         {
             // Recursively compute the reflection color
-            reflectionColor = blinnPhongShadingBVH(closestReflectionIntersection, reflectionRay, lights, root, nbounces - 1, backgroundColor);
+            reflectionColor = blinnPhongShadingBVH(closestReflectionIntersection, reflectionRay, lights, root, nbounces - 1, backgroundColor,
+                                                   reflectionWeight, minWeight);
         }
         else
         {
@@ -102,23 +142,30 @@ Vector3 blinnPhongShadingBVH(const Intersection &intersection, const Ray &ray, c
     if (material.isRefractive)
     {
         Vector3 refractionDir;
-        // Compute Fresnel reflectance for blending reflection and refraction
-        float fresnelReflectance = fresnelSchlick(std::abs(viewDir.dot(normal)), material.refractiveIndex);
 
         // Calculate refraction direction using Snell's Law
         if (calculateRefraction(ray.direction, normal, material.refractiveIndex, refractionDir))
         {
+            bool traceRefraction = refractionWeight >= minWeight;
+            RayTreeStats::record(material.id, true, !traceRefraction);
+
             // Offset the origin to avoid self-intersections
             Vector3 refractionOrigin = refractionDir.dot(normal) < 0 ? intersection.point - normal * epsilon : intersection.point + normal * epsilon;
-            Ray refractionRay(refractionOrigin, refractionDir.normalize());
+            Ray refractionRay(refractionOrigin, refractionDir.normalize(), ray.time);
+            refractionRay.inheritCone(ray, intersection.distance);
 
             // Check for the closest intersection along the refraction ray
             Intersection closestRefractionIntersection;
             closestRefractionIntersection.distance = std::numeric_limits<float>::max();
-            if (root->intersect(refractionRay, closestRefractionIntersection))
+            if (!traceRefraction)
+            {
+                refractionColor = backgroundColor; // Pruned: treated like a ray that has run out of bounces
+            }
+            else if (root->intersect(refractionRay, closestRefractionIntersection))
             {
                 // Recursively compute the refraction color
-                refractionColor = blinnPhongShadingBVH(closestRefractionIntersection, refractionRay, lights, root, nbounces - 1, backgroundColor);
+                refractionColor = blinnPhongShadingBVH(closestRefractionIntersection, refractionRay, lights, root, nbounces - 1, backgroundColor,
+                                                       refractionWeight, minWeight);
             }
             else
             {
@@ -132,4 +179,9 @@ Vector3 blinnPhongShadingBVH(const Intersection &intersection, const Ray &ray, c
     }
     // Clamp the resulting color to the range [0, 1] to ensure valid output
     return color.clamp(0.0f, 1.0f);
-}
\ No newline at end of file
+}
+
+template Vector3 blinnPhongShadingBVH<true>(const Intersection &, const Ray &, const std::vector<Light> &, const BVHNode *, int,
+                                            const Vector3 &, float, float);
+template Vector3 blinnPhongShadingBVH<false>(const Intersection &, const Ray &, const std::vector<Light> &, const BVHNode *, int,
+                                             const Vector3 &, float, float);
@@ -0,0 +1,45 @@
+#include "light_sampling.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+std::minstd_rand lightSampleGenerator(const Vector3 &point)
+{
+    uint32_t bits[3];
+    std::memcpy(&bits[0], &point.x, sizeof(float));
+    std::memcpy(&bits[1], &point.y, sizeof(float));
+    std::memcpy(&bits[2], &point.z, sizeof(float));
+
+    uint32_t h = bits[0] * 0x8da6b343u ^ bits[1] * 0xd8163841u ^ bits[2] * 0xcb1ab31fu;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return std::minstd_rand(h);
+}
+
+int lightSampleCount(const Light &light)
+{
+    if (!light.isArea())
+    {
+        return 1;
+    }
+    int strata = static_cast<int>(std::sqrt(static_cast<float>(std::clamp(light.samples, 1, MAX_LIGHT_SAMPLES))));
+    return strata * strata;
+}
+
+Vector3 lightSamplePoint(const Light &light, int index, int count, const Vector3 &from, std::minstd_rand &rng)
+{
+    if (!light.isArea())
+    {
+        return light.position;
+    }
+    int strata = static_cast<int>(std::sqrt(static_cast<float>(count)) + 0.5f);
+    float cell = 1.0f / strata;
+    std::uniform_real_distribution<float> jitter(0.0f, cell);
+    float u = (index / strata) * cell + jitter(rng);
+    float v = (index % strata) * cell + jitter(rng);
+    return light.samplePoint(u, v, from);
+}
@@ -0,0 +1,33 @@
+#ifndef LIGHT_SAMPLING_H
+#define LIGHT_SAMPLING_H
+
+#include <random>
+#include "../camera/light.h"   // Light shapes and sample points
+#include "../camera/vector3.h" // Vector3
+
+// Returns a generator for the light samples of a shading point
+// It is seeded from the point's position, so the recursive shaders draw soft-shadow samples that
+// are independent of the pixel's own samples and renders stay reproducible without threading a
+// generator through them.
+// Parameters:
+// - point: The shading point
+std::minstd_rand lightSampleGenerator(const Vector3 &point);
+
+// Returns the number of shadow rays to send to a light from each shading point
+// Point lights take one; area lights take light.samples rounded down to a square, at most MAX_LIGHT_SAMPLES.
+// Parameters:
+// - light: The light to sample
+int lightSampleCount(const Light &light);
+
+// Returns the point to send one of a light's shadow rays to
+// Area lights are divided into a square grid of count cells and sample i is jittered within cell i,
+// so the shadow estimate converges faster than with independent points.
+// Parameters:
+// - light: The light to sample
+// - index: The sample, from 0 to count - 1
+// - count: The number of samples, from lightSampleCount
+// - from: The shading point
+// - rng: Generator for the jitter within each cell
+Vector3 lightSamplePoint(const Light &light, int index, int count, const Vector3 &from, std::minstd_rand &rng);
+
+#endif // LIGHT_SAMPLING_H
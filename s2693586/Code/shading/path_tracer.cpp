@@ -0,0 +1,158 @@
+#include "path_tracer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "blinn_phong.h"               // Fresnel, refraction and textured diffuse color helpers
+#include "light_sampling.h"            // Stratified area light samples
+#include "../geometry/intersection.h"  // Closest-hit queries without a BVH
+#include "../bvh/shadow_cache.h"        // Last-occluder cache for shadow rays
+
+namespace
+{
+    const float PI = 3.14159265358979f;
+
+    // Finds the closest hit along a ray, through the BVH when there is one
+    bool closestHit(const Ray &ray, const SceneData &sceneData, const BVHNode *root, Intersection &hit)
+    {
+        if (root)
+        {
+            hit.distance = std::numeric_limits<float>::max();
+            return root->intersect(ray, hit);
+        }
+        hit = findClosestIntersection(ray, sceneData.spheres, sceneData.cylinders, sceneData.triangles, sceneData.particles);
+        return hit.hit;
+    }
+
+    // Returns true if anything blocks the ray before maxDistance, a shadow ray towards the light lightIndex
+    bool occluded(const Ray &ray, float maxDistance, size_t lightIndex, const SceneData &sceneData, const BVHNode *root)
+    {
+        if (root)
+        {
+            return ShadowCache::occluded(*root, ray, maxDistance, lightIndex);
+        }
+        Intersection hit = findClosestIntersection(ray, sceneData.spheres, sceneData.cylinders, sceneData.triangles, sceneData.particles);
+        return hit.hit && hit.distance < maxDistance;
+    }
+
+    // Samples a direction around the normal with probability proportional to the cosine
+    Vector3 cosineSampleHemisphere(const Vector3 &normal, std::minstd_rand &rng)
+    {
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        float r = std::sqrt(uniform(rng));
+        float phi = 2.0f * PI * uniform(rng);
+
+        // Orthonormal basis around the normal
+        Vector3 tangent = std::fabs(normal.x) > 0.9f ? Vector3(0.0f, 1.0f, 0.0f) : Vector3(1.0f, 0.0f, 0.0f);
+        tangent = (tangent - normal * normal.dot(tangent)).normalize();
+        Vector3 bitangent = normal.cross(tangent);
+
+        float z = std::sqrt(std::max(0.0f, 1.0f - r * r));
+        return (tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + normal * z).normalize();
+    }
+}
+
+Vector3 tracePath(const Intersection &intersection, const Ray &ray, const SceneData &sceneData, const BVHNode *root,
+                  std::minstd_rand &rng)
+{
+    const float epsilon = 0.001f; // Offset to avoid self-intersections
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    Vector3 radiance(0.0f, 0.0f, 0.0f);
+    Vector3 throughput(1.0f, 1.0f, 1.0f); // Weight of everything found further along the path
+    Intersection hit = intersection;
+    Ray current = ray;
+
+    for (int bounce = 0; bounce < sceneData.nbounces; ++bounce)
+    {
+        const Material &material = hit.material;
+        Vector3 viewDir = -current.direction;
+        Vector3 nextDir;
+        Vector3 nextOrigin;
+
+        if (material.isRefractive)
+        {
+            // Dielectric: choose reflection or refraction by the Fresnel reflectance
+            float fresnelReflectance = fresnelSchlick(std::abs(viewDir.dot(hit.normal)), material.refractiveIndex);
+            Vector3 refractionDir;
+            if (calculateRefraction(current.direction, hit.normal, material.refractiveIndex, refractionDir) &&
+                uniform(rng) >= fresnelReflectance)
+            {
+                nextDir = refractionDir.normalize();
+            }
+            else
+            {
+                nextDir = (current.direction - hit.normal * 2.0f * current.direction.dot(hit.normal)).normalize();
+            }
+            nextOrigin = hit.point + hit.normal * (nextDir.dot(hit.normal) < 0 ? -epsilon : epsilon);
+        }
+        else if (material.isReflective && uniform(rng) < material.reflectivity)
+        {
+            // Mirror bounce, chosen in proportion to the reflectivity
+            nextDir = (current.direction - hit.normal * 2.0f * current.direction.dot(hit.normal)).normalize();
+            nextOrigin = hit.point + hit.normal * (nextDir.dot(hit.normal) < 0 ? -epsilon : epsilon);
+        }
+        else
+        {
+            // Shade on the side the ray arrived from
+            Vector3 normal = hit.normal.dot(viewDir) < 0.0f ? -hit.normal : hit.normal;
+            Vector3 diffuseColor = diffuseColorAt(hit, current);
+            Vector3 shadowOrigin = hit.point + normal * epsilon;
+
+            // Next-event estimation: shadow rays towards each light (stratified over area lights)
+            for (size_t lightIndex = 0; lightIndex < sceneData.lights.size(); ++lightIndex)
+            {
+                const Light &light = sceneData.lights[lightIndex];
+                int sampleCount = lightSampleCount(light);
+                float sampleWeight = 1.0f / sampleCount;
+                for (int sample = 0; sample < sampleCount; ++sample)
+                {
+                    Vector3 toLight = lightSamplePoint(light, sample, sampleCount, hit.point, rng) - hit.point;
+                    float distanceToLight = toLight.length();
+                    Vector3 lightDir = toLight / distanceToLight;
+                    float diff = normal.dot(lightDir);
+                    if (diff <= 0.0f || occluded(Ray(shadowOrigin, lightDir, current.time), distanceToLight, lightIndex, sceneData, root))
+                    {
+                        continue;
+                    }
+
+                    // Same attenuation, diffuse and specular terms as Blinn-Phong shading
+                    float attenuation = 1.0f / (1.0f + 0.1f * distanceToLight + 0.01f * distanceToLight * distanceToLight);
+                    Vector3 effectiveLightIntensity = light.intensity * (attenuation * sampleWeight);
+                    Vector3 halfDir = (viewDir + lightDir).normalize();
+                    float spec = std::pow(std::max(normal.dot(halfDir), 0.0f), material.specularExponent);
+                    radiance += throughput * (material.kd * diff * diffuseColor + material.ks * spec * material.specularColor) * effectiveLightIntensity;
+                }
+            }
+
+            // Indirect light: a cosine-weighted bounce; BRDF * cosine / pdf reduces to the albedo
+            throughput = throughput * (material.kd * diffuseColor);
+            nextDir = cosineSampleHemisphere(normal, rng);
+            nextOrigin = shadowOrigin;
+        }
+
+        if (bounce + 1 >= sceneData.nbounces)
+        {
+            break; // Bounce limit reached
+        }
+
+        // Russian roulette on the path throughput
+        if (bounce + 1 >= PATH_ROULETTE_START)
+        {
+            float survival = std::min(0.95f, std::max(throughput.x, std::max(throughput.y, throughput.z)));
+            if (uniform(rng) >= survival)
+            {
+                break;
+            }
+            throughput = throughput * (1.0f / survival);
+        }
+
+        current = Ray(nextOrigin, nextDir, current.time);
+        if (!closestHit(current, sceneData, root, hit))
+        {
+            radiance += throughput * sceneData.backgroundColor;
+            break;
+        }
+    }
+
+    return radiance;
+}
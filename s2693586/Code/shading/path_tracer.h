@@ -0,0 +1,36 @@
+#ifndef PATH_TRACER_H
+#define PATH_TRACER_H
+
+#include <random>
+#include "../json_reader.h"          // SceneData: lights, shapes, bounce limit and background
+#include "../bvh/bvh_node.h"         // BVHNode for closest-hit and shadow queries
+#include "../geometry/geometry.h"    // Intersection
+#include "../camera/ray.h"           // Ray
+
+// Paths are not terminated by Russian roulette before this many bounces
+constexpr int PATH_ROULETTE_START = 3;
+
+// Traces one light path from a camera ray's first hit (path-tracing render mode)
+// Unlike the recursive Blinn-Phong shaders, each bounce follows a single randomly chosen
+// direction, so the cost of a path grows linearly with its length:
+// - Direct light is gathered at every diffuse hit with one shadow ray per light (next-event
+//   estimation), using the same diffuse and specular terms as Blinn-Phong but without the
+//   ambient term, which the indirect bounce replaces.
+// - Diffuse hits continue in a cosine-weighted direction, weighted by kd * diffusecolor.
+// - Reflective materials follow the mirror direction with probability reflectivity; refractive
+//   materials reflect with the Fresnel probability and refract otherwise.
+// - Rays that leave the scene pick up the background color, which acts as uniform sky light.
+// - After PATH_ROULETTE_START bounces a path survives with probability equal to its largest
+//   throughput component (at most 0.95) and is reweighted, so dim paths end early without bias.
+// Paths end after nbounces hits.
+// Parameters:
+// - intersection: First hit of the camera ray
+// - ray: The camera ray
+// - sceneData: Scene lights, shapes, bounce limit and background color
+// - root: BVH over the scene, or nullptr to test every shape
+// - rng: Per-pixel random number generator
+// Returns: The radiance carried back along the camera ray (not clamped)
+Vector3 tracePath(const Intersection &intersection, const Ray &ray, const SceneData &sceneData, const BVHNode *root,
+                  std::minstd_rand &rng);
+
+#endif // PATH_TRACER_H
@@ -0,0 +1,62 @@
+#include "ray_tree_stats.h"
+#include <algorithm>
+
+namespace
+{
+    // Counters of one material; index 0 reflections, 1 refractions, 2 and 3 their pruned counts
+    struct MaterialCounters
+    {
+        std::atomic<uint64_t> counts[4];
+    };
+
+    MaterialCounters materials[RayTreeStats::MAX_MATERIALS];
+    std::atomic<uint32_t> highestId{0};
+}
+
+std::atomic<bool> &RayTreeStats::enabledFlag()
+{
+    static std::atomic<bool> enabled{false};
+    return enabled;
+}
+
+void RayTreeStats::count(uint32_t materialId, bool refraction, bool pruned)
+{
+    uint32_t index = std::min(materialId, MAX_MATERIALS - 1);
+    MaterialCounters &counters = materials[index];
+    counters.counts[refraction ? 1 : 0].fetch_add(1, std::memory_order_relaxed);
+    if (pruned)
+    {
+        counters.counts[refraction ? 3 : 2].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint32_t highest = highestId.load(std::memory_order_relaxed);
+    while (index > highest && !highestId.compare_exchange_weak(highest, index, std::memory_order_relaxed))
+    {
+    }
+}
+
+std::vector<RayTreeCounts> RayTreeStats::snapshot()
+{
+    std::vector<RayTreeCounts> result(highestId.load(std::memory_order_relaxed) + 1);
+    for (size_t i = 0; i < result.size(); ++i)
+    {
+        const MaterialCounters &counters = materials[i];
+        result[i].reflections = counters.counts[0].load(std::memory_order_relaxed);
+        result[i].refractions = counters.counts[1].load(std::memory_order_relaxed);
+        result[i].prunedReflections = counters.counts[2].load(std::memory_order_relaxed);
+        result[i].prunedRefractions = counters.counts[3].load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+void RayTreeStats::reset()
+{
+    for (MaterialCounters &counters : materials)
+    {
+        for (auto &count : counters.counts)
+        {
+            count.store(0, std::memory_order_relaxed);
+        }
+    }
+    highestId.store(0, std::memory_order_relaxed);
+}
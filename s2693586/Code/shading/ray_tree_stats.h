@@ -0,0 +1,55 @@
+#ifndef RAY_TREE_STATS_H
+#define RAY_TREE_STATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Reflection and refraction rays spawned by the surfaces of one material
+struct RayTreeCounts
+{
+    uint64_t reflections = 0;       // Reflection rays spawned
+    uint64_t refractions = 0;       // Refraction rays spawned
+    uint64_t prunedReflections = 0; // Reflection rays skipped for their low weight
+    uint64_t prunedRefractions = 0; // Refraction rays skipped for their low weight
+
+    uint64_t spawned() const { return reflections + refractions; }
+    uint64_t pruned() const { return prunedReflections + prunedRefractions; }
+};
+
+// Optional counters of the secondary rays spawned by the recursive Blinn-Phong shaders, per material ID
+// Counting is off by default and costs a single relaxed load per secondary ray until it is enabled.
+// Materials with IDs beyond MAX_MATERIALS share the last entry.
+class RayTreeStats
+{
+public:
+    static constexpr uint32_t MAX_MATERIALS = 1024;
+
+    // Turns counting on or off
+    static void setEnabled(bool enabled) { enabledFlag().store(enabled, std::memory_order_relaxed); }
+
+    // Counts a secondary ray spawned by a surface
+    // Parameters:
+    // - materialId: Material of the surface
+    // - refraction: True for a refraction ray, false for a reflection ray
+    // - pruned: True if the ray was skipped for its low weight
+    static void record(uint32_t materialId, bool refraction, bool pruned)
+    {
+        if (enabledFlag().load(std::memory_order_relaxed))
+        {
+            count(materialId, refraction, pruned);
+        }
+    }
+
+    // Returns the counts indexed by material ID, up to the highest ID seen
+    static std::vector<RayTreeCounts> snapshot();
+
+    // Clears the counts
+    static void reset();
+
+private:
+    static std::atomic<bool> &enabledFlag();
+    static void count(uint32_t materialId, bool refraction, bool pruned);
+};
+
+#endif // RAY_TREE_STATS_H
@@ -0,0 +1,104 @@
+# Golden-image regression test for a single scene, run by CTest through "cmake -P"
+#
+# Renders SCENE with a fixed seed and resolution, then compares the result with the
+# stored reference using image_diff. The render time is recorded next to the
+# comparison and checked against the stored baseline time for the case.
+#
+# Required variables:
+#   RAYTRACER      Path to the Raytracer executable
+#   IMAGE_DIFF     Path to the image_diff executable
+#   CASE_NAME      Name of the test case (used for reference and output files)
+#   SCENE          Path to the scene JSON file
+#   USE_BVH, TONE_MAP, ANTIALIASING  Positional flags passed to Raytracer (0 or 1)
+#   REFERENCE_DIR  Directory holding <case>.ppm references and <case>.time baselines
+#   OUTPUT_DIR     Directory for rendered images, masks and the results file
+# Optional variables:
+#   EXTRA_ARGS (space-separated options for Raytracer), REFERENCE_CASE (case whose reference and baseline are
+#   compared against, CASE_NAME by default; such cases never update the reference), RESOLUTION, SEED, MAX_RMSE, MIN_PSNR, PIXEL_TOLERANCE, MAX_MASKED,
+#   TIME_TOLERANCE, FAIL_ON_TIME, UPDATE (regenerate the reference and baseline)
+
+foreach(var RAYTRACER IMAGE_DIFF CASE_NAME SCENE USE_BVH TONE_MAP ANTIALIASING REFERENCE_DIR OUTPUT_DIR)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "golden_test.cmake: ${var} is not set")
+    endif()
+endforeach()
+
+if(NOT DEFINED RESOLUTION)
+    set(RESOLUTION 300x200)
+endif()
+if(NOT DEFINED REFERENCE_CASE)
+    set(REFERENCE_CASE ${CASE_NAME})
+endif()
+if(NOT DEFINED SEED)
+    set(SEED 1234)
+endif()
+
+file(MAKE_DIRECTORY "${OUTPUT_DIR}")
+set(rendered "${OUTPUT_DIR}/${CASE_NAME}.ppm")
+set(reference "${REFERENCE_DIR}/${REFERENCE_CASE}.ppm")
+set(baseline "${REFERENCE_DIR}/${REFERENCE_CASE}.time")
+
+# Render the scene with the fixed seed
+set(render_args ${USE_BVH} ${TONE_MAP} ${ANTIALIASING})
+if(EXTRA_ARGS)
+    separate_arguments(extra_args UNIX_COMMAND "${EXTRA_ARGS}")
+    list(APPEND render_args ${extra_args})
+endif()
+string(REPLACE ";" " " args_text "${render_args}")
+execute_process(
+    COMMAND "${RAYTRACER}" "${SCENE}" "${rendered}" ${render_args} --seed ${SEED} --resolution ${RESOLUTION}
+    RESULT_VARIABLE render_result
+    OUTPUT_VARIABLE render_output
+    ERROR_VARIABLE render_error)
+if(NOT render_result EQUAL 0)
+    message(FATAL_ERROR "Render of ${SCENE} failed (${render_result}):\n${render_output}${render_error}")
+endif()
+
+# The renderer reports "Render Time: <seconds> seconds"
+string(REGEX MATCH "Render Time: ([0-9.eE+-]+)" time_match "${render_output}")
+set(render_time "${CMAKE_MATCH_1}")
+
+if(UPDATE AND REFERENCE_CASE STREQUAL CASE_NAME)
+    configure_file("${rendered}" "${reference}" COPYONLY)
+    file(WRITE "${baseline}" "${render_time}\n")
+    message(STATUS "Updated reference and baseline time (${render_time} s) for ${CASE_NAME}")
+    return()
+endif()
+
+if(NOT EXISTS "${reference}")
+    message(FATAL_ERROR "Missing reference image ${reference}; configure with -DGOLDEN_UPDATE=ON to create it")
+endif()
+
+set(diff_args --mask "${OUTPUT_DIR}/${CASE_NAME}_mask.ppm")
+foreach(pair "MAX_RMSE;--max-rmse" "MIN_PSNR;--min-psnr" "PIXEL_TOLERANCE;--pixel-tolerance"
+             "MAX_MASKED;--max-masked" "TIME_TOLERANCE;--time-tolerance")
+    list(GET pair 0 var)
+    list(GET pair 1 flag)
+    if(DEFINED ${var})
+        list(APPEND diff_args ${flag} ${${var}})
+    endif()
+endforeach()
+if(NOT render_time STREQUAL "")
+    list(APPEND diff_args --time ${render_time})
+endif()
+if(EXISTS "${baseline}")
+    file(STRINGS "${baseline}" baseline_time LIMIT_COUNT 1)
+    list(APPEND diff_args --baseline-time ${baseline_time})
+endif()
+if(FAIL_ON_TIME)
+    list(APPEND diff_args --fail-on-time)
+endif()
+
+execute_process(
+    COMMAND "${IMAGE_DIFF}" "${reference}" "${rendered}" ${diff_args}
+    RESULT_VARIABLE diff_result
+    OUTPUT_VARIABLE diff_output
+    ERROR_VARIABLE diff_error)
+
+# Keep the comparison and timing together for later inspection
+file(WRITE "${OUTPUT_DIR}/${CASE_NAME}.txt" "${CASE_NAME}: ${SCENE} ${args_text}\n${diff_output}${diff_error}")
+message("${diff_output}${diff_error}")
+
+if(NOT diff_result EQUAL 0)
+    message(FATAL_ERROR "Golden-image comparison failed for ${CASE_NAME}")
+endif()
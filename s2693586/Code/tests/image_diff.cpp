@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Compares a rendered PPM (P6) image against a reference image
+// Reports RMSE, PSNR and the fraction of pixels outside a per-pixel tolerance,
+// optionally checks the render time against a stored baseline, and exits with a
+// non-zero status when any of the thresholds are exceeded
+
+// Simple 8-bit RGB image as written by writeBinaryImageToPPM
+struct PPMImage
+{
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels; // Interleaved RGB values
+};
+
+// Skips whitespace and '#' comments between PPM header tokens
+static void skipHeaderSeparators(std::istream &in)
+{
+    while (in)
+    {
+        int c = in.peek();
+        if (c == '#')
+        {
+            in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        }
+        else if (std::isspace(c))
+        {
+            in.get();
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+// Reads a binary PPM file, returning false if it cannot be read
+static bool readPPM(const std::string &fileName, PPMImage &image)
+{
+    std::ifstream in(fileName, std::ios::binary);
+    if (!in.is_open())
+    {
+        std::cerr << "Failed to open image: " << fileName << std::endl;
+        return false;
+    }
+
+    std::string magic;
+    int maxValue = 0;
+    in >> magic;
+    skipHeaderSeparators(in);
+    in >> image.width;
+    skipHeaderSeparators(in);
+    in >> image.height;
+    skipHeaderSeparators(in);
+    in >> maxValue;
+    in.get(); // Single whitespace byte before the pixel data
+
+    if (magic != "P6" || maxValue != 255 || image.width <= 0 || image.height <= 0)
+    {
+        std::cerr << "Unsupported PPM file (expected 8-bit P6): " << fileName << std::endl;
+        return false;
+    }
+
+    image.pixels.resize(static_cast<size_t>(image.width) * image.height * 3);
+    in.read(reinterpret_cast<char *>(image.pixels.data()), image.pixels.size());
+    if (in.gcount() != static_cast<std::streamsize>(image.pixels.size()))
+    {
+        std::cerr << "Truncated PPM file: " << fileName << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Writes the tolerance mask as a PPM: white where a pixel is outside the tolerance
+static void writeMask(const std::string &fileName, int width, int height, const std::vector<uint8_t> &mask)
+{
+    std::ofstream out(fileName, std::ios::binary);
+    if (!out.is_open())
+    {
+        std::cerr << "Failed to open mask file: " << fileName << std::endl;
+        return;
+    }
+    out << "P6\n"
+        << width << " " << height << "\n255\n";
+    for (uint8_t m : mask)
+    {
+        char value = m ? static_cast<char>(255) : 0;
+        out.put(value).put(value).put(value);
+    }
+}
+
+static void printUsage(const char *program)
+{
+    std::cerr << "Usage: " << program << " <reference.ppm> <rendered.ppm>"
+              << " [--max-rmse <v>] [--min-psnr <dB>] [--pixel-tolerance <0-255>] [--max-masked <fraction>]"
+              << " [--mask <mask.ppm>] [--time <seconds>] [--baseline-time <seconds>] [--time-tolerance <percent>]"
+              << " [--min-time <seconds>] [--fail-on-time]" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    std::string referenceFile = argv[1];
+    std::string renderedFile = argv[2];
+    double maxRmse = 2.0;          // RMSE limit in 8-bit units
+    double minPsnr = 40.0;         // PSNR floor in dB
+    int pixelTolerance = 16;       // Largest channel difference a pixel may have before it is masked
+    double maxMasked = 0.005;      // Fraction of pixels allowed outside the tolerance
+    std::string maskFile;          // Optional output for the tolerance mask
+    double renderTime = -1.0;      // Measured render time (seconds)
+    double baselineTime = -1.0;    // Stored render time (seconds)
+    double timeTolerance = 25.0;   // Allowed render time change in percent
+    double minTime = 0.05;         // Renders shorter than this are too noisy to compare
+    bool failOnTime = false;       // Treat a time change as a failure instead of a warning
+
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string option = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (option == "--max-rmse" && hasValue)
+            maxRmse = std::stod(argv[++i]);
+        else if (option == "--min-psnr" && hasValue)
+            minPsnr = std::stod(argv[++i]);
+        else if (option == "--pixel-tolerance" && hasValue)
+            pixelTolerance = std::stoi(argv[++i]);
+        else if (option == "--max-masked" && hasValue)
+            maxMasked = std::stod(argv[++i]);
+        else if (option == "--mask" && hasValue)
+            maskFile = argv[++i];
+        else if (option == "--time" && hasValue)
+            renderTime = std::stod(argv[++i]);
+        else if (option == "--baseline-time" && hasValue)
+            baselineTime = std::stod(argv[++i]);
+        else if (option == "--time-tolerance" && hasValue)
+            timeTolerance = std::stod(argv[++i]);
+        else if (option == "--min-time" && hasValue)
+            minTime = std::stod(argv[++i]);
+        else if (option == "--fail-on-time")
+            failOnTime = true;
+        else
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    PPMImage reference, rendered;
+    if (!readPPM(referenceFile, reference) || !readPPM(renderedFile, rendered))
+    {
+        return 2;
+    }
+    if (reference.width != rendered.width || reference.height != rendered.height)
+    {
+        std::cerr << "Image size mismatch: reference is " << reference.width << "x" << reference.height
+                  << ", rendered is " << rendered.width << "x" << rendered.height << std::endl;
+        return 1;
+    }
+
+    // Accumulate squared error and build the tolerance mask
+    size_t pixelCount = static_cast<size_t>(reference.width) * reference.height;
+    std::vector<uint8_t> mask(pixelCount, 0);
+    double squaredError = 0.0;
+    size_t maskedPixels = 0;
+    int maxDifference = 0;
+    for (size_t p = 0; p < pixelCount; ++p)
+    {
+        int pixelDifference = 0;
+        for (int c = 0; c < 3; ++c)
+        {
+            int difference = std::abs(static_cast<int>(reference.pixels[p * 3 + c]) - static_cast<int>(rendered.pixels[p * 3 + c]));
+            squaredError += static_cast<double>(difference) * difference;
+            pixelDifference = std::max(pixelDifference, difference);
+        }
+        maxDifference = std::max(maxDifference, pixelDifference);
+        if (pixelDifference > pixelTolerance)
+        {
+            mask[p] = 1;
+            ++maskedPixels;
+        }
+    }
+
+    double rmse = std::sqrt(squaredError / (pixelCount * 3.0));
+    double psnr = rmse > 0.0 ? 20.0 * std::log10(255.0 / rmse) : std::numeric_limits<double>::infinity();
+    double maskedFraction = static_cast<double>(maskedPixels) / pixelCount;
+
+    std::cout << "RMSE: " << rmse << " (limit " << maxRmse << ")" << std::endl;
+    std::cout << "PSNR: " << psnr << " dB (limit " << minPsnr << " dB)" << std::endl;
+    std::cout << "Max pixel difference: " << maxDifference << std::endl;
+    std::cout << "Pixels outside tolerance " << pixelTolerance << ": " << maskedPixels << " ("
+              << maskedFraction * 100.0 << "%, limit " << maxMasked * 100.0 << "%)" << std::endl;
+
+    if (!maskFile.empty())
+    {
+        writeMask(maskFile, reference.width, reference.height, mask);
+    }
+
+    bool failed = false;
+    if (rmse > maxRmse)
+    {
+        std::cout << "FAIL: RMSE above limit" << std::endl;
+        failed = true;
+    }
+    if (psnr < minPsnr)
+    {
+        std::cout << "FAIL: PSNR below limit" << std::endl;
+        failed = true;
+    }
+    if (maskedFraction > maxMasked)
+    {
+        std::cout << "FAIL: too many pixels outside tolerance" << std::endl;
+        failed = true;
+    }
+
+    // Compare the render time against the stored baseline
+    if (renderTime >= 0.0)
+    {
+        std::cout << "Render time: " << renderTime << " s";
+        if (baselineTime > 0.0)
+        {
+            double change = (renderTime - baselineTime) / baselineTime * 100.0;
+            std::cout << " (baseline " << baselineTime << " s, " << (change >= 0 ? "+" : "") << change << "%)" << std::endl;
+            if (std::fabs(change) > timeTolerance && std::max(renderTime, baselineTime) >= minTime)
+            {
+                std::cout << (failOnTime ? "FAIL" : "WARNING") << ": render time moved more than "
+                          << timeTolerance << "% from the baseline" << std::endl;
+                failed = failed || failOnTime;
+            }
+        }
+        else
+        {
+            std::cout << " (no baseline)" << std::endl;
+        }
+    }
+
+    return failed ? 1 : 0;
+}
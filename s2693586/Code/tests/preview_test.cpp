@@ -0,0 +1,86 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "json_reader.h"
+#include "render/preview.h"
+#include "render/renderer.h"
+#include "render/shared_framebuffer.h"
+
+// Checks the interactive preview against an ordinary render of the same frame
+// The preview runs for a single scene load (maxGenerations = 1), starting at firstScale 4 so it publishes
+// three passes. When the load completes, the last frame is copied out of the shared framebuffer with
+// SharedFramebuffer::read, as a viewer would, and compared byte for byte with the frame rendered directly
+// by a Renderer. Exits with a non-zero status on any difference.
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <scene.json> [--resolution <width>x<height>]" << std::endl;
+        return 2;
+    }
+    const std::string scenePath = argv[1];
+    int width = 150, height = 100;
+    if (argc >= 4 && std::string(argv[2]) == "--resolution")
+    {
+        std::string value = argv[3];
+        size_t separator = value.find('x');
+        width = std::stoi(value.substr(0, separator));
+        height = std::stoi(value.substr(separator + 1));
+    }
+
+    SceneData sceneData = readSceneFromJson(scenePath);
+    sceneData.camera = sceneData.camera.withResolution(width, height);
+    FrameRequest request(sceneData.camera);
+    request.applyToneMap = true;
+    request.antialiasing = true;
+    request.seed = 1234;
+
+    PreviewSettings settings;
+    settings.firstScale = 4;
+    settings.maxGenerations = 1;
+    const std::string name = "/raytracer_preview_test_" + std::to_string(getpid());
+
+    // The segment is removed when runPreview returns, so the frame is read when the load is reported
+    SharedFrame frame;
+    bool frameRead = false;
+    int passes = 0;
+    int result = runPreview(scenePath, [&] { return sceneData; }, true, request, name, settings,
+                            [&](const PreviewGenerationStats &stats)
+                            {
+                                passes = stats.passes;
+                                frameRead = SharedFramebuffer::read(name, frame);
+                            });
+    if (result != 0 || !frameRead)
+    {
+        std::cerr << "Preview of " << scenePath << " failed (result " << result << ", frame read: " << frameRead << ")" << std::endl;
+        return 1;
+    }
+    if (passes != 3 || frame.generation != 1 || frame.scale != 1 || frame.width != width || frame.height != height)
+    {
+        std::cerr << "Unexpected preview frame: " << passes << " passes, generation " << frame.generation << ", scale "
+                  << frame.scale << ", " << frame.width << "x" << frame.height << std::endl;
+        return 1;
+    }
+
+    std::vector<uint8_t> expected(static_cast<size_t>(width) * height * 3);
+    request.rgbOutput = expected.data();
+    Renderer(std::make_shared<const Scene>(sceneData, true)).render(request);
+
+    size_t differing = 0;
+    int largest = 0;
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        int difference = std::abs(static_cast<int>(frame.rgb[i]) - static_cast<int>(expected[i]));
+        differing += difference > 0;
+        largest = std::max(largest, difference);
+    }
+    std::cout << "Preview: " << passes << " passes, " << differing << " of " << expected.size()
+              << " values differ from the direct render (largest difference " << largest << ")" << std::endl;
+    return differing == 0 ? 0 : 1;
+}
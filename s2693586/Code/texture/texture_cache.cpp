@@ -0,0 +1,316 @@
+#include "texture_cache.h"
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+// Reads the next whitespace-separated token of a PPM header, skipping '#' comments
+static std::string readHeaderToken(std::istream &in)
+{
+    std::string token;
+    int c;
+    while ((c = in.get()) != EOF)
+    {
+        if (c == '#')
+        {
+            while ((c = in.get()) != EOF && c != '\n')
+            {
+            }
+        }
+        else if (!std::isspace(c))
+        {
+            token.push_back(static_cast<char>(c));
+            break;
+        }
+    }
+    while ((c = in.peek()) != EOF && !std::isspace(c))
+    {
+        token.push_back(static_cast<char>(in.get()));
+    }
+    return token;
+}
+
+// Packs a texture id, mip level and tile position into one cache key
+static uint64_t tileKey(uint32_t textureId, int level, int tileX, int tileY)
+{
+    return (static_cast<uint64_t>(textureId) << 44) | (static_cast<uint64_t>(level) << 40) |
+           (static_cast<uint64_t>(tileY) << 20) | static_cast<uint64_t>(tileX);
+}
+
+// Spreads neighbouring tile keys over different shards
+static size_t shardIndex(uint64_t key, size_t shardCount)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return static_cast<size_t>(key % shardCount);
+}
+
+TextureCache &TextureCache::global()
+{
+    static TextureCache cache;
+    return cache;
+}
+
+TextureCache::TextureCache(size_t budgetBytes)
+    : budget(budgetBytes)
+{
+}
+
+const Texture *TextureCache::load(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(textureMutex);
+    for (const auto &texture : textures)
+    {
+        if (texture->path == path)
+        {
+            return texture.get();
+        }
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Could not open texture: " << path << std::endl;
+        throw std::runtime_error("Could not open the texture file.");
+    }
+
+    // Only the header is read here; texels are read per tile when first sampled
+    std::string magic = readHeaderToken(file);
+    int width = std::atoi(readHeaderToken(file).c_str());
+    int height = std::atoi(readHeaderToken(file).c_str());
+    int maxValue = std::atoi(readHeaderToken(file).c_str());
+    file.get(); // Single whitespace character before the texels
+    if (magic != "P6" || width <= 0 || height <= 0 || maxValue != 255)
+    {
+        std::cerr << "Unsupported texture (expected an 8-bit binary P6 PPM): " << path << std::endl;
+        throw std::runtime_error("Unsupported texture format.");
+    }
+
+    auto texture = std::make_unique<Texture>();
+    texture->path = path;
+    texture->width = width;
+    texture->height = height;
+    texture->levels = static_cast<int>(std::floor(std::log2(std::max(width, height)))) + 1;
+    texture->dataOffset = file.tellg();
+    texture->id = static_cast<uint32_t>(textures.size());
+
+    file.seekg(0, std::ios::end);
+    if (file.tellg() < texture->dataOffset + static_cast<std::streamoff>(width) * height * 3)
+    {
+        std::cerr << "Texture file is truncated: " << path << std::endl;
+        throw std::runtime_error("Truncated texture file.");
+    }
+
+    textures.push_back(std::move(texture));
+    return textures.back().get();
+}
+
+Vector3 TextureCache::sample(const Texture &texture, float u, float v, float footprint)
+{
+    // Choose the mip level whose texels match the footprint
+    float lod = 0.0f;
+    if (footprint > 0.0f)
+    {
+        lod = std::log2(std::max(footprint * std::max(texture.width, texture.height), 1.0f));
+        lod = std::min(lod, static_cast<float>(texture.levels - 1));
+    }
+
+    // Repeat the texture outside [0, 1)
+    u -= std::floor(u);
+    v -= std::floor(v);
+
+    int level = static_cast<int>(lod);
+    float blend = lod - level;
+    Vector3 color = sampleLevel(texture, level, u, v);
+    if (blend > 0.0f && level + 1 < texture.levels)
+    {
+        color = color * (1.0f - blend) + sampleLevel(texture, level + 1, u, v) * blend;
+    }
+    return color;
+}
+
+Vector3 TextureCache::sampleLevel(const Texture &texture, int level, float u, float v)
+{
+    int width = texture.levelWidth(level);
+    int height = texture.levelHeight(level);
+    float x = u * width - 0.5f;
+    float y = v * height - 0.5f;
+    int x0 = static_cast<int>(std::floor(x));
+    int y0 = static_cast<int>(std::floor(y));
+    float fx = x - x0;
+    float fy = y - y0;
+
+    // The four texels usually share a tile, so keep the last one looked up
+    TilePtr current;
+    int currentX = -1, currentY = -1;
+    auto texel = [&](int tx, int ty)
+    {
+        tx = ((tx % width) + width) % width;
+        ty = ((ty % height) + height) % height;
+        int tileX = tx / TILE_SIZE, tileY = ty / TILE_SIZE;
+        if (tileX != currentX || tileY != currentY)
+        {
+            current = tile(texture, level, tileX, tileY);
+            currentX = tileX;
+            currentY = tileY;
+        }
+        const uint8_t *p = &current->texels[((ty % TILE_SIZE) * TILE_SIZE + tx % TILE_SIZE) * 3];
+        return Vector3(p[0], p[1], p[2]) * (1.0f / 255.0f);
+    };
+
+    Vector3 top = texel(x0, y0) * (1.0f - fx) + texel(x0 + 1, y0) * fx;
+    Vector3 bottom = texel(x0, y0 + 1) * (1.0f - fx) + texel(x0 + 1, y0 + 1) * fx;
+    return top * (1.0f - fy) + bottom * fy;
+}
+
+TextureCache::TilePtr TextureCache::tile(const Texture &texture, int level, int tileX, int tileY)
+{
+    uint64_t key = tileKey(texture.id, level, tileX, tileY);
+    Shard &shard = shards[shardIndex(key, SHARD_COUNT)];
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it != shard.index.end())
+        {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second); // Mark as most recently used
+            ++shard.hits;
+            return it->second->second;
+        }
+        ++shard.misses;
+    }
+
+    // Build the tile without holding the shard lock
+    TilePtr built = (level == 0) ? readTile(texture, tileX, tileY) : filterTile(texture, level, tileX, tileY);
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end())
+    {
+        return it->second->second; // Another thread built the same tile first
+    }
+    shard.lru.emplace_front(key, built);
+    shard.index[key] = shard.lru.begin();
+    shard.bytes += TILE_BYTES;
+    size_t now = resident.fetch_add(TILE_BYTES, std::memory_order_relaxed) + TILE_BYTES;
+    size_t highest = peak.load(std::memory_order_relaxed);
+    while (now > highest && !peak.compare_exchange_weak(highest, now, std::memory_order_relaxed))
+    {
+    }
+    evict(shard);
+    return built;
+}
+
+TextureCache::TilePtr TextureCache::readTile(const Texture &texture, int tileX, int tileY) const
+{
+    auto result = std::make_shared<Tile>();
+    result->texels.assign(TILE_BYTES, 0);
+
+    int x0 = tileX * TILE_SIZE, y0 = tileY * TILE_SIZE;
+    int columns = std::min(TILE_SIZE, texture.width - x0);
+    int rows = std::min(TILE_SIZE, texture.height - y0);
+
+    // Read each row of the tile directly from its position in the file
+    std::ifstream file(texture.path, std::ios::binary);
+    for (int row = 0; row < rows && file; ++row)
+    {
+        file.seekg(texture.dataOffset + (static_cast<std::streamoff>(y0 + row) * texture.width + x0) * 3);
+        file.read(reinterpret_cast<char *>(&result->texels[row * TILE_SIZE * 3]), columns * 3);
+    }
+    if (!file)
+    {
+        std::cerr << "Failed to read texture tile from: " << texture.path << std::endl;
+    }
+    return result;
+}
+
+TextureCache::TilePtr TextureCache::filterTile(const Texture &texture, int level, int tileX, int tileY)
+{
+    auto result = std::make_shared<Tile>();
+    result->texels.assign(TILE_BYTES, 0);
+
+    int x0 = tileX * TILE_SIZE, y0 = tileY * TILE_SIZE;
+    int columns = std::min(TILE_SIZE, texture.levelWidth(level) - x0);
+    int rows = std::min(TILE_SIZE, texture.levelHeight(level) - y0);
+    int childWidth = texture.levelWidth(level - 1);
+    int childHeight = texture.levelHeight(level - 1);
+
+    // Each texel averages a 2x2 block of the level below; the block covers up to four child tiles
+    TilePtr children[2][2];
+    for (int y = 0; y < rows; ++y)
+    {
+        for (int x = 0; x < columns; ++x)
+        {
+            int sum[3] = {0, 0, 0};
+            for (int dy = 0; dy < 2; ++dy)
+            {
+                for (int dx = 0; dx < 2; ++dx)
+                {
+                    int cx = std::min(2 * (x0 + x) + dx, childWidth - 1);
+                    int cy = std::min(2 * (y0 + y) + dy, childHeight - 1);
+                    int slotX = cx / TILE_SIZE - 2 * tileX, slotY = cy / TILE_SIZE - 2 * tileY;
+                    TilePtr &child = children[slotY][slotX];
+                    if (!child)
+                    {
+                        child = tile(texture, level - 1, cx / TILE_SIZE, cy / TILE_SIZE);
+                    }
+                    const uint8_t *p = &child->texels[((cy % TILE_SIZE) * TILE_SIZE + cx % TILE_SIZE) * 3];
+                    sum[0] += p[0];
+                    sum[1] += p[1];
+                    sum[2] += p[2];
+                }
+            }
+            uint8_t *out = &result->texels[(y * TILE_SIZE + x) * 3];
+            out[0] = static_cast<uint8_t>((sum[0] + 2) / 4);
+            out[1] = static_cast<uint8_t>((sum[1] + 2) / 4);
+            out[2] = static_cast<uint8_t>((sum[2] + 2) / 4);
+        }
+    }
+    return result;
+}
+
+void TextureCache::evict(Shard &shard)
+{
+    size_t shardBudget = std::max(TILE_BYTES, budget.load(std::memory_order_relaxed) / SHARD_COUNT);
+    while (shard.bytes > shardBudget && shard.lru.size() > 1)
+    {
+        // Tiles still in use by a lookup stay alive through their shared pointer
+        shard.index.erase(shard.lru.back().first);
+        shard.lru.pop_back();
+        shard.bytes -= TILE_BYTES;
+        resident.fetch_sub(TILE_BYTES, std::memory_order_relaxed);
+        ++shard.evictions;
+    }
+}
+
+void TextureCache::setMemoryBudget(size_t budgetBytes)
+{
+    budget.store(budgetBytes, std::memory_order_relaxed);
+    for (Shard &shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        evict(shard);
+    }
+}
+
+TextureCacheStats TextureCache::stats() const
+{
+    TextureCacheStats result;
+    for (const Shard &shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        result.hits += shard.hits;
+        result.misses += shard.misses;
+        result.evictions += shard.evictions;
+    }
+    result.residentBytes = resident.load(std::memory_order_relaxed);
+    result.peakBytes = peak.load(std::memory_order_relaxed);
+    result.budgetBytes = budget.load(std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(textureMutex);
+        result.textures = textures.size();
+    }
+    return result;
+}
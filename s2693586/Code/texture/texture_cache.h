@@ -0,0 +1,120 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ios>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../camera/vector3.h" // Vector3 class for RGB colors
+
+// An image texture stored in a binary PPM (P6) file
+// Only the header is read when the texture is loaded; texels are read tile by tile on demand
+class Texture
+{
+public:
+    std::string path;          // Path of the PPM file
+    int width, height;         // Size of the full-resolution image
+    int levels;                // Number of mip levels (level 0 is full resolution)
+    std::streamoff dataOffset; // Byte offset of the first texel in the file
+    uint32_t id;               // Index of the texture in the cache, used in tile keys
+
+    // Size of a mip level (each level halves the previous one, down to 1 texel)
+    int levelWidth(int level) const { return std::max(1, width >> level); }
+    int levelHeight(int level) const { return std::max(1, height >> level); }
+};
+
+// Counters reported by TextureCache::stats()
+struct TextureCacheStats
+{
+    uint64_t hits = 0;        // Tile lookups served from the cache
+    uint64_t misses = 0;      // Tile lookups that loaded or built a tile
+    uint64_t evictions = 0;   // Tiles dropped to stay within the memory budget
+    size_t residentBytes = 0; // Memory held by cached tiles
+    size_t peakBytes = 0;     // Highest residentBytes seen
+    size_t budgetBytes = 0;   // Memory budget
+    size_t textures = 0;      // Number of loaded textures
+
+    double hitRate() const { return hits + misses > 0 ? static_cast<double>(hits) / (hits + misses) : 0.0; }
+};
+
+// Cache of mip-mapped texture tiles shared by all render threads
+// Textures are split into TILE_SIZE x TILE_SIZE tiles per mip level. Level 0 tiles are read from
+// the file on first access and higher levels are filtered from the four tiles below them, so only
+// the tiles a render touches are ever built. Tiles are kept in least-recently-used order and evicted
+// once the memory budget is exceeded. The cache is split into shards, each with its own lock, so
+// concurrent lookups of different tiles rarely wait on each other; tiles are loaded outside the locks.
+class TextureCache
+{
+public:
+    static constexpr int TILE_SIZE = 64;
+
+    // The cache used by scenes and shading
+    static TextureCache &global();
+
+    explicit TextureCache(size_t budgetBytes = 64u << 20);
+
+    // Loads a texture header, returning the already loaded texture for a repeated path
+    // Throws std::runtime_error if the file cannot be opened or is not an 8-bit binary PPM
+    // The returned texture lives as long as the cache
+    const Texture *load(const std::string &path);
+
+    // Samples a texture with trilinear filtering and repeating texture coordinates
+    // Parameters:
+    // - texture: Texture to sample
+    // - u, v: Texture coordinates (v = 0 is the top row of the image)
+    // - footprint: Size of the sampled area in texture coordinates, selecting the mip level
+    // Returns: The filtered color, with channels in [0, 1]
+    Vector3 sample(const Texture &texture, float u, float v, float footprint);
+
+    // Sets the memory budget, evicting tiles if the cache is over it
+    void setMemoryBudget(size_t budgetBytes);
+
+    TextureCacheStats stats() const;
+
+private:
+    // Texels of one tile, three bytes per texel, TILE_SIZE texels per row
+    struct Tile
+    {
+        std::vector<uint8_t> texels;
+    };
+    using TilePtr = std::shared_ptr<const Tile>;
+
+    // One shard of the cache; tiles hash to a shard by their key
+    struct alignas(64) Shard
+    {
+        mutable std::mutex mutex;
+        std::list<std::pair<uint64_t, TilePtr>> lru; // Most recently used first
+        std::unordered_map<uint64_t, std::list<std::pair<uint64_t, TilePtr>>::iterator> index;
+        size_t bytes = 0;
+        uint64_t hits = 0, misses = 0, evictions = 0;
+    };
+    static constexpr int SHARD_COUNT = 64;
+    static constexpr size_t TILE_BYTES = TILE_SIZE * TILE_SIZE * 3;
+
+    Shard shards[SHARD_COUNT];
+    std::atomic<size_t> budget;
+    std::atomic<size_t> resident{0}, peak{0};
+
+    mutable std::mutex textureMutex;                // Guards texture loading only
+    std::vector<std::unique_ptr<Texture>> textures; // Loaded textures, never removed
+
+    // Returns a tile of a mip level, reading (level 0) or filtering (higher levels) it on a miss
+    TilePtr tile(const Texture &texture, int level, int tileX, int tileY);
+    TilePtr readTile(const Texture &texture, int tileX, int tileY) const;
+    TilePtr filterTile(const Texture &texture, int level, int tileX, int tileY);
+
+    // Evicts least recently used tiles from a locked shard until it fits its share of the budget
+    void evict(Shard &shard);
+
+    // Bilinearly filtered color of one mip level
+    Vector3 sampleLevel(const Texture &texture, int level, float u, float v);
+};
+
+#endif // TEXTURE_CACHE_H
@@ -0,0 +1,16 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+// Includes
+#include <chrono>
+
+// Clock used to time builds, renders and benchmarks
+using Clock = std::chrono::high_resolution_clock;
+
+// Milliseconds elapsed since start
+inline double millisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+#endif // TIMING_H
@@ -1,5 +1,7 @@
 #include "tone_mapping.h"
 #include <vector>
+#include <algorithm>
+#include <cmath>
 
 // Clamps the input color vector to ensure its components fall within the specified min and max bounds
 // Parameters:
@@ -11,7 +11,8 @@
 // - exposure: The exposure level to adjust the brightness of the image
 // - minColor: The minimum RGB values for tone mapping (used to normalize the color range)
 // - maxColor: The maximum RGB values for tone mapping (used to normalize the color range)
+// - backgroundColour: Background color of the scene, passed through unchanged
 // Returns: A tone-mapped color as a Vector3
-Vector3 toneMap(const Vector3 &color, float exposure, const Vector3 &minColor, const Vector3 &maxColor);
+Vector3 toneMap(const Vector3 &color, float exposure, const Vector3 &minColor, const Vector3 &maxColor, const Vector3 &backgroundColour);
 
 #endif // TONE_MAPPING_H